@@ -0,0 +1,913 @@
+/*
+ * Decoder hot paths benchmark
+ *
+ * Micro benchmarks of the channel decoding kernels and of the burst search, and end-to-end
+ * decoding of a recorded (-i) or synthetic burst stream through TetraDecoder. With -c,
+ * kernels are checked bit exact against reference implementations instead: the string
+ * Viterbi codec, the clause 8 formulas and the original Reed-Muller parity checks. The
+ * program then exits with failure on the first mismatching kernel. With -a, heap
+ * allocations per burst are counted on the second half of the stream, once the first half
+ * warmed the decoder up, and the program exits with failure above the given average.
+ *
+ * Build with the decoder sources except main.cc, eg.
+ *   g++ -O2 -pthread bench/decoderbench.cc decoder.cc mac/(*).cc <upper layers sources> -o decoderbench
+ *
+ * Usage: decoderbench [-c] [-a <allocations>] [-n <iterations>] [-i <file of unpacked bits>] [-j <workers>]
+ *
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../decoder.h"
+#include "../mac/blockcodec.h"
+#include "../mac/lowermac.h"
+#include "../mac/viterbi.h"
+#include "../mac/viterbiacs.h"
+#include "../mac/viterbidecoder.h"
+
+using namespace Tetra;
+
+static volatile uint64_t gSink = 0;                                             // results sink so benchmarked calls are not optimised out
+
+static std::atomic<bool> gCountAllocations(false);                              // count heap allocations, see checkAllocations
+static std::atomic<uint64_t> gAllocations(0);                                   // heap allocations counted
+static std::atomic<uint64_t> gAllocatedBytes(0);                                // heap bytes allocated while counting
+
+/**
+ * @brief Counting global allocation functions, from any thread so pipeline workers are included
+ *
+ */
+
+static void * countedAlloc(std::size_t len)
+{
+    if (gCountAllocations.load(std::memory_order_relaxed))
+    {
+        gAllocations.fetch_add(1, std::memory_order_relaxed);
+        gAllocatedBytes.fetch_add(len, std::memory_order_relaxed);
+    }
+
+    void * res = malloc(len > 0 ? len : 1);
+    if (!res)
+    {
+        throw std::bad_alloc();
+    }
+
+    return res;
+}
+
+void * operator new(std::size_t len)
+{
+    return countedAlloc(len);
+}
+
+void * operator new[](std::size_t len)
+{
+    return countedAlloc(len);
+}
+
+void operator delete(void * ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void * ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void * ptr, std::size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void * ptr, std::size_t) noexcept
+{
+    free(ptr);
+}
+
+/**
+ * @brief Deterministic xorshift64 pseudo random generator
+ *
+ */
+
+static uint64_t randomValue(uint64_t * state)
+{
+    uint64_t val = *state;
+    val ^= val << 13;
+    val ^= val >> 7;
+    val ^= val << 17;
+    *state = val;
+
+    return val;
+}
+
+static void randomBits(uint64_t * state, uint8_t * res, const std::size_t len)
+{
+    for (std::size_t idx = 0; idx < len; idx++)
+    {
+        res[idx] = (uint8_t)(randomValue(state) & 1);
+    }
+}
+
+/**
+ * @brief Run fn iterations times and print time per call, and per bit when bits > 0
+ *
+ */
+
+template <typename F>
+static void bench(const char * name, const std::size_t iterations, const std::size_t bits, F fn)
+{
+    fn();                                                                       // warm up tables and caches
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (std::size_t idx = 0; idx < iterations; idx++)
+    {
+        fn();
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (double)iterations;
+
+    if (bits > 0)
+    {
+        printf("%-40s %10.1f ns/call %8.2f ns/bit\n", name, ns, ns / (double)bits);
+    }
+    else
+    {
+        printf("%-40s %10.1f ns/call\n", name, ns);
+    }
+}
+
+/**
+ * @brief RCPC 16-state mother code of rate 1/4 encoder - 8.2.3.1.1, len input bits to 4 * len bits
+ *
+ */
+
+static void motherCodeEncode(const uint8_t * data, const std::size_t len, uint8_t * res)
+{
+    const uint8_t polynomials[4] = {0b10011, 0b11101, 0b10111, 0b11011};       // bit k is the coefficient of D^k
+
+    uint8_t history = 0;                                                        // bit k - 1 is the input k steps ago
+    for (std::size_t idx = 0; idx < len; idx++)
+    {
+        for (std::size_t parity = 0; parity < 4; parity++)
+        {
+            uint8_t val = polynomials[parity] & data[idx] & 1;
+            for (uint8_t k = 1; k <= 4; k++)
+            {
+                val ^= (polynomials[parity] >> k) & (history >> (k - 1)) & 1;
+            }
+            res[4 * idx + parity] = val;
+        }
+        history = (uint8_t)((history << 1) | data[idx]);
+    }
+}
+
+/**
+ * @brief Test vector for Viterbi: DECODED_LEN bits (4 tail bits) encoded, 2/3 punctured
+ *        and with errors on the kept bits
+ *
+ */
+
+struct ViterbiVector {
+    std::vector<uint8_t> bits;                                                  ///< Encoded bits
+    std::vector<uint8_t> hard;                                                  ///< Depunctured mother code, 2 for erased bits
+    std::vector<int8_t>  soft;                                                  ///< Depunctured soft mother code, 0 for erased bits
+};
+
+static ViterbiVector viterbiVector(uint64_t * state, const std::size_t len, const uint32_t errorsPerThousand)
+{
+    ViterbiVector res;
+    res.bits.resize(len);
+    randomBits(state, res.bits.data(), len - 4);
+    for (std::size_t idx = len - 4; idx < len; idx++)
+    {
+        res.bits[idx] = 0;                                                      // tail bits
+    }
+
+    std::vector<uint8_t> encoded(4 * len);
+    motherCodeEncode(res.bits.data(), len, encoded.data());
+
+    res.hard.resize(4 * len);
+    res.soft.resize(4 * len);
+    for (std::size_t idx = 0; idx < 4 * len; idx++)
+    {
+        std::size_t pos = idx % 8;
+        if ((pos == 0) || (pos == 1) || (pos == 4))                             // kept by 2/3 puncturing - 8.2.3.1.3
+        {
+            uint8_t bit = encoded[idx];
+            if (randomValue(state) % 1000 < errorsPerThousand)
+            {
+                bit ^= 1;
+            }
+            int8_t magnitude = (int8_t)(16 + randomValue(state) % 100);
+            res.hard[idx] = bit;
+            res.soft[idx] = bit ? magnitude : (int8_t)(-magnitude);
+        }
+        else
+        {
+            res.hard[idx] = 2;
+            res.soft[idx] = 0;
+        }
+    }
+
+    return res;
+}
+
+/**
+ * @brief Reference descrambling, deinterleaving (K,a) and 2/3 depuncturing written from the formulas of 8.2.5, 8.2.4 and 8.2.3.1.3
+ *
+ */
+
+static std::vector<uint8_t> referenceDeinterleaveDepuncture(const uint8_t * data, const uint8_t * sequence, const uint32_t K, const uint32_t a)
+{
+    std::vector<uint8_t> descrambled(K);
+    for (uint32_t idx = 0; idx < K; idx++)
+    {
+        descrambled[idx] = data[idx] ^ sequence[idx];
+    }
+
+    std::vector<uint8_t> deinterleaved(K);
+    for (uint32_t j = 1; j <= K; j++)
+    {
+        uint32_t k = 1 + (a * j) % K;
+        deinterleaved[j - 1] = descrambled[k - 1];
+    }
+
+    const uint8_t P[] = {0, 1, 2, 5};
+    const uint32_t t = 3;
+    const uint32_t period = 8;
+
+    std::vector<uint8_t> res(4 * K * 2 / 3, 2);
+    for (uint32_t i = 1; i <= K; i++)
+    {
+        uint32_t m = period * ((i - 1) / t) + P[i - t * ((i - 1) / t)];
+        res[m - 1] = deinterleaved[i - 1];
+    }
+
+    return res;
+}
+
+/**
+ * @brief Reference bit by bit CRC16-CCITT
+ *
+ */
+
+static bool referenceCrc16Ccitt(const uint8_t * data, const int len)
+{
+    uint16_t crc = 0xFFFF;
+    for (int idx = 0; idx < len; idx++)
+    {
+        crc ^= (uint16_t)data[idx] << 15;
+        crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+
+    return crc == 0x1D0F;
+}
+
+/**
+ * @brief Reference Reed-Muller (30,14) decoder, the parity checks formulas LowerMac was first written with
+ *
+ * FEC thanks to Lollo Gollo @logollo see "issue #21"
+ *
+ */
+
+static void referenceReedMuller3014Decode(const uint8_t * data, uint8_t * res)
+{
+    uint8_t q[5];
+
+    q[0] = data[0];
+    q[1] = (data[13 + 3] + data[13 + 5] + data[13 + 6] + data[13 + 7] + data[13 + 11]) % 2;
+    q[2] = (data[13 + 1] + data[13 + 2] + data[13 + 5] + data[13 + 6] + data[13 + 8] + data[13 + 9]) % 2;
+    q[3] = (data[13 + 2] + data[13 + 3] + data[13 + 4] + data[13 + 5] + data[13 + 9] + data[13 + 10]) % 2;
+    q[4] = (data[13 + 1] + data[13 + 4] + data[13 + 5] + data[13 + 7] + data[13 + 8] + data[13 + 10] + data[13 + 11]) % 2;
+    res[0] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
+
+    q[0] = data[1];
+    q[1] = (data[13 + 1] + data[13 + 4] + data[13 + 5] + data[13 + 9] + data[13 + 11]) % 2;
+    q[2] = (data[13 + 1] + data[13 + 2] + data[13 + 5] + data[13 + 6] + data[13 + 7] + data[13 + 10]) % 2;
+    q[3] = (data[13 + 2] + data[13 + 3] + data[13 + 4] + data[13 + 5] + data[13 + 7] + data[13 + 8]) % 2;
+    q[4] = (data[13 + 3] + data[13 + 5] + data[13 + 6] + data[13 + 8] + data[13 + 9] + data[13 + 10] + data[13 + 11]) % 2;
+    res[1] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
+
+    q[0] = data[2];
+    q[1] = (data[13 + 2] + data[13 + 5] + data[13 + 8] + data[13 + 10] + data[13 + 11]) % 2;
+    q[2] = (data[13 + 1] + data[13 + 3] + data[13 + 5] + data[13 + 7] + data[13 + 9] + data[13 + 10]) % 2;
+    q[3] = (data[13 + 4] + data[13 + 5] + data[13 + 6] + data[13 + 7] + data[13 + 8] + data[13 + 9]) % 2;
+    q[4] = (data[13 + 1] + data[13 + 2] + data[13 + 3] + data[13 + 4] + data[13 + 5] + data[13 + 6] + data[13 + 11]) % 2;
+    res[2] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
+
+    q[0] = data[3];
+    q[1] = (data[13 + 7] + data[13 + 8] + data[13 + 9] + data[13 + 12] + data[13 + 13] + data[13 + 14]) % 2;
+    q[2] = (data[13 + 1] + data[13 + 2] + data[13 + 3] + data[13 + 11] + data[13 + 12] + data[13 + 13] + data[13 + 14]) % 2;
+    q[3] = (data[13 + 2] + data[13 + 4] + data[13 + 6] + data[13 + 8] + data[13 + 10] + data[13 + 11] + data[13 + 12] + data[13 + 13] + data[13 + 14]) % 2;
+    q[4] = (data[13 + 1] + data[13 + 3] + data[13 + 4] + data[13 + 6] + data[13 + 7] + data[13 + 9] + data[13 + 10] + data[13 + 12] + data[13 + 13] + data[13 + 14]) % 2;
+    res[3] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
+
+    q[0] = data[4];
+    q[1] = (data[13 + 1] + data[13 + 4] + data[13 + 5] + data[13 + 11] + data[13 + 12] + data[13 + 13] + data[13 + 15]) % 2;
+    q[2] = (data[13 + 3] + data[13 + 5] + data[13 + 6] + data[13 + 8] + data[13 + 10] + data[13 + 11] + data[13 + 12] + data[13 + 13] + data[13 + 15]) % 2;
+    q[3] = (data[13 + 1] + data[13 + 2] + data[13 + 5] + data[13 + 6] + data[13 + 7] + data[13 + 9] + data[13 + 10] + data[13 + 12] + data[13 + 13] + data[13 + 15]) % 2;
+    q[4] = (data[13 + 2] + data[13 + 3] + data[13 + 4] + data[13 + 5] + data[13 + 7] + data[13 + 8] + data[13 + 9] + data[13 + 12] + data[13 + 13] + data[13 + 15]) % 2;
+    res[4] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
+
+    q[0] = data[5];
+    q[1] = (data[13 + 7] + data[13 + 9] + data[13 + 10] + data[13 + 12] + data[13 + 14] + data[13 + 15]) % 2;
+    q[2] = (data[13 + 2] + data[13 + 4] + data[13 + 6] + data[13 + 11] + data[13 + 12] + data[13 + 14] + data[13 + 15]) % 2;
+    q[3] = (data[13 + 1] + data[13 + 2] + data[13 + 3] + data[13 + 8] + data[13 + 10] + data[13 + 11] + data[13 + 12] + data[13 + 14] + data[13 + 15]) % 2;
+    q[4] = (data[13 + 1] + data[13 + 3] + data[13 + 4] + data[13 + 6] + data[13 + 7] + data[13 + 8] + data[13 + 9] + data[13 + 12] + data[13 + 14] + data[13 + 15]) % 2;
+    res[5] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
+
+    q[0] = data[6];
+    q[1] = (data[13 + 3] + data[13 + 5] + data[13 + 6] + data[13 + 11] + data[13 + 13] + data[13 + 14] + data[13 + 15]) % 2;
+    q[2] = (data[13 + 1] + data[13 + 4] + data[13 + 5] + data[13 + 8] + data[13 + 10] + data[13 + 11] + data[13 + 13] + data[13 + 14] + data[13 + 15]) % 2;
+    q[3] = (data[13 + 1] + data[13 + 2] + data[13 + 5] + data[13 + 6] + data[13 + 7] + data[13 + 8] + data[13 + 9] + data[13 + 13] + data[13 + 14] + data[13 + 15]) % 2;
+    q[4] = (data[13 + 2] + data[13 + 3] + data[13 + 4] + data[13 + 5] + data[13 + 7] + data[13 + 9] + data[13 + 10] + data[13 + 13] + data[13 + 14] + data[13 + 15]) % 2;
+    res[6] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
+
+    q[0] = data[7];
+    q[1] = (data[13 + 2] + data[13 + 5] + data[13 + 7] + data[13 + 9] + data[13 + 12] + data[13 + 13] + data[13 + 14] + data[13 + 15] + data[13 + 16]) % 2;
+    q[2] = (data[13 + 1] + data[13 + 3] + data[13 + 5] + data[13 + 8] + data[13 + 11] + data[13 + 12] + data[13 + 13] + data[13 + 14] + data[13 + 15] + data[13 + 16]) % 2;
+    q[3] = (data[13 + 4] + data[13 + 5] + data[13 + 6] + data[13 + 10] + data[13 + 11] + data[13 + 12] + data[13 + 13] + data[13 + 14] + data[13 + 15] + data[13 + 16]) % 2;
+    q[4] = (data[13 + 1] + data[13 + 2] + data[13 + 3] + data[13 + 4] + data[13 + 5] + data[13 + 6] + data[13 + 7] + data[13 + 8] + data[13 + 9] + data[13 + 10] + data[13 + 12] + data[13 + 13] + data[13 + 14] + data[13 + 15] + data[13 + 16]) % 2;
+    res[7] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
+
+    q[0] = data[8];
+    q[1] = (data[13 + 2] + data[13 + 3] + data[13 + 9] + data[13 + 12] + data[13 + 13] + data[13 + 16]) % 2;
+    q[2] = (data[13 + 1] + data[13 + 7] + data[13 + 8] + data[13 + 11] + data[13 + 12] + data[13 + 13] + data[13 + 16]) % 2;
+    q[3] = (data[13 + 3] + data[13 + 4] + data[13 + 6] + data[13 + 7] + data[13 + 10] + data[13 + 11] + data[13 + 12] + data[13 + 13] + data[13 + 16]) % 2;
+    q[4] = (data[13 + 1] + data[13 + 2] + data[13 + 4] + data[13 + 6] + data[13 + 8] + data[13 + 9] + data[13 + 10] + data[13 + 12] + data[13 + 13] + data[13 + 16]) % 2;
+    res[8] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
+
+    q[0] = data[9];
+    q[1] = (data[13 + 1] + data[13 + 3] + data[13 + 8] + data[13 + 12] + data[13 + 14] + data[13 + 16]) % 2;
+    q[2] = (data[13 + 4] + data[13 + 6] + data[13 + 10] + data[13 + 12] + data[13 + 14] + data[13 + 16]) % 2;
+    q[3] = (data[13 + 2] + data[13 + 7] + data[13 + 9] + data[13 + 11] + data[13 + 12] + data[13 + 14] + data[13 + 16]) % 2;
+    q[4] = (data[13 + 1] + data[13 + 2] + data[13 + 3] + data[13 + 4] + data[13 + 6] + data[13 + 7] + data[13 + 8] + data[13 + 9] + data[13 + 10] + data[13 + 11] + data[13 + 12] + data[13 + 14] + data[13 + 16]) % 2;
+    res[9] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
+
+    q[0] = data[10];
+    q[1] = (data[13 + 1] + data[13 + 2] + data[13 + 7] + data[13 + 13] + data[13 + 14] + data[13 + 16]) % 2;
+    q[2] = (data[13 + 3] + data[13 + 8] + data[13 + 9] + data[13 + 11] + data[13 + 13] + data[13 + 14] + data[13 + 16]) % 2;
+    q[3] = (data[13 + 1] + data[13 + 4] + data[13 + 6] + data[13 + 9] + data[13 + 10] + data[13 + 11] + data[13 + 13] + data[13 + 14] + data[13 + 16]) % 2;
+    q[4] = (data[13 + 2] + data[13 + 3] + data[13 + 4] + data[13 + 6] + data[13 + 7] + data[13 + 8] + data[13 + 10] + data[13 + 13] + data[13 + 14] + data[13 + 16]) % 2;
+    res[10] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
+
+    q[0] = data[11];
+    q[1] = (data[13 + 2] + data[13 + 6] + data[13 + 9] + data[13 + 12] + data[13 + 15] + data[13 + 16]) % 2;
+    q[2] = (data[13 + 4] + data[13 + 7] + data[13 + 10] + data[13 + 11] + data[13 + 12] + data[13 + 15] + data[13 + 16]) % 2;
+    q[3] = (data[13 + 1] + data[13 + 3] + data[13 + 6] + data[13 + 7] + data[13 + 8] + data[13 + 11] + data[13 + 12] + data[13 + 15] + data[13 + 16]) % 2;
+    q[4] = (data[13 + 1] + data[13 + 2] + data[13 + 3] + data[13 + 4] + data[13 + 8] + data[13 + 9] + data[13 + 10] + data[13 + 12] + data[13 + 15] + data[13 + 16]) % 2;
+    res[11] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
+
+    q[0] = data[12];
+    q[1] = (data[13 + 5] + data[13 + 8] + data[13 + 10] + data[13 + 11] + data[13 + 13] + data[13 + 15] + data[13 + 16]) % 2;
+    q[2] = (data[13 + 1] + data[13 + 3] + data[13 + 4] + data[13 + 5] + data[13 + 6] + data[13 + 11] + data[13 + 13] + data[13 + 15] + data[13 + 16]) % 2;
+    q[3] = (data[13 + 1] + data[13 + 2] + data[13 + 3] + data[13 + 5] + data[13 + 7] + data[13 + 9] + data[13 + 10] + data[13 + 13] + data[13 + 15] + data[13 + 16]) % 2;
+    q[4] = (data[13 + 2] + data[13 + 4] + data[13 + 5] + data[13 + 6] + data[13 + 7] + data[13 + 8] + data[13 + 9] + data[13 + 13] + data[13 + 15] + data[13 + 16]) % 2;
+    res[12] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
+
+    q[0] = data[13];
+    q[1] = (data[13 + 2] + data[13 + 4] + data[13 + 7] + data[13 + 14] + data[13 + 15] + data[13 + 16]) % 2;
+    q[2] = (data[13 + 6] + data[13 + 9] + data[13 + 10] + data[13 + 11] + data[13 + 14] + data[13 + 15] + data[13 + 16]) % 2;
+    q[3] = (data[13 + 1] + data[13 + 3] + data[13 + 4] + data[13 + 8] + data[13 + 9] + data[13 + 11] + data[13 + 14] + data[13 + 15] + data[13 + 16]) % 2;
+    q[4] = (data[13 + 1] + data[13 + 2] + data[13 + 3] + data[13 + 6] + data[13 + 7] + data[13 + 8] + data[13 + 10] + data[13 + 14] + data[13 + 15] + data[13 + 16]) % 2;
+    res[13] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
+}
+
+/**
+ * @brief Report a comparison result, exit on mismatch
+ *
+ */
+
+static void compareResult(const char * name, const std::size_t vectors, const std::size_t mismatches)
+{
+    printf("%-40s %10zu vectors, %zu mismatches\n", name, vectors, mismatches);
+    if (mismatches > 0)
+    {
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Bit exact comparisons of kernels against the reference implementations
+ *
+ */
+
+static void compareKernels(const std::size_t iterations)
+{
+    uint64_t state = 0x9E3779B97F4A7C15;
+    Log log(LogLevel::NONE);
+    LowerMac lowerMac(&log);
+
+    // Viterbi kernels against reference string codec (hard) and against scalar kernel (soft)
+    std::vector<int> polynomials;
+    polynomials.push_back(0b10011);
+    polynomials.push_back(0b11101);
+    polynomials.push_back(0b10111);
+    polynomials.push_back(0b11011);
+    ViterbiCodec codec(6, polynomials);
+
+    std::vector<const ViterbiAcsKernel *> kernels = viterbiAcsKernels();
+    ViterbiDecoder1614 scalar("scalar");
+
+    for (std::size_t kernel = 0; kernel < kernels.size(); kernel++)
+    {
+        ViterbiDecoder1614 decoder(kernels[kernel]->name);
+        std::size_t mismatches = 0;
+        std::size_t vectors = iterations / 10 + 1;
+
+        for (std::size_t vec = 0; vec < vectors; vec++)
+        {
+            ViterbiVector val = viterbiVector(&state, (vec % 2) ? ViterbiDecoder1614::MAX_STEPS : 144, 20);
+
+            std::string sIn;
+            for (std::size_t idx = 0; idx < val.hard.size(); idx++)
+            {
+                sIn += (char)('0' + val.hard[idx]);
+            }
+            std::string sOut = codec.Decode(sIn);
+
+            uint8_t res[ViterbiDecoder1614::MAX_STEPS];
+            std::size_t count = decoder.decode(val.hard.data(), val.hard.size(), res);
+            bool bMatch = (count == sOut.size());
+            for (std::size_t idx = 0; bMatch && (idx < count); idx++)
+            {
+                bMatch = (res[idx] == (uint8_t)(sOut[idx] - '0'));
+            }
+
+            uint8_t softRes[ViterbiDecoder1614::MAX_STEPS];
+            uint8_t scalarRes[ViterbiDecoder1614::MAX_STEPS];
+            std::size_t softCount   = decoder.decodeSoft(val.soft.data(), val.soft.size(), softRes);
+            std::size_t scalarCount = scalar.decodeSoft(val.soft.data(), val.soft.size(), scalarRes);
+            bMatch = bMatch && (softCount == scalarCount) && (memcmp(softRes, scalarRes, softCount) == 0);
+
+            mismatches += bMatch ? 0 : 1;
+        }
+
+        std::string name = std::string("viterbi ") + kernels[kernel]->name;
+        compareResult(name.c_str(), vectors, mismatches);
+    }
+
+    // batch Viterbi kernels against single block decoding, partial batches and several passes included
+    std::vector<const ViterbiBatchAcsKernel *> batchKernels = viterbiBatchAcsKernels();
+
+    for (std::size_t kernel = 0; kernel < batchKernels.size(); kernel++)
+    {
+        ViterbiBatchDecoder1614 decoder(batchKernels[kernel]->name);
+        std::size_t mismatches = 0;
+        std::size_t vectors = 0;
+
+        for (std::size_t batch = 0; batch < iterations / 100 + 1; batch++)
+        {
+            std::size_t count = 1 + batch % (2 * ViterbiBatchDecoder1614::MAX_LANES + 3);
+            std::size_t len   = (batch % 3 == 0) ? 80 : (batch % 3 == 1) ? 144 : ViterbiDecoder1614::MAX_STEPS;
+
+            std::vector<ViterbiVector> vals;
+            std::vector<const uint8_t *> hard;
+            std::vector<const int8_t *> soft;
+            std::vector<std::vector<uint8_t> > res(count, std::vector<uint8_t>(ViterbiDecoder1614::MAX_STEPS));
+            std::vector<std::vector<uint8_t> > softRes(count, std::vector<uint8_t>(ViterbiDecoder1614::MAX_STEPS));
+            std::vector<uint8_t *> resPtr;
+            std::vector<uint8_t *> softResPtr;
+
+            for (std::size_t idx = 0; idx < count; idx++)
+            {
+                vals.push_back(viterbiVector(&state, len, 20 + 10 * (idx % 5)));
+                hard.push_back(vals[idx].hard.data());
+                soft.push_back(vals[idx].soft.data());
+                resPtr.push_back(res[idx].data());
+                softResPtr.push_back(softRes[idx].data());
+            }
+
+            std::size_t hardCount = decoder.decode(hard.data(), count, 4 * len, resPtr.data());
+            std::size_t softCount = decoder.decodeSoft(soft.data(), count, 4 * len, softResPtr.data());
+
+            for (std::size_t idx = 0; idx < count; idx++)
+            {
+                uint8_t scalarRes[ViterbiDecoder1614::MAX_STEPS];
+                std::size_t scalarCount = scalar.decode(hard[idx], 4 * len, scalarRes);
+                bool bMatch = (hardCount == scalarCount) && (memcmp(resPtr[idx], scalarRes, scalarCount) == 0);
+
+                scalarCount = scalar.decodeSoft(soft[idx], 4 * len, scalarRes);
+                bMatch = bMatch && (softCount == scalarCount) && (memcmp(softResPtr[idx], scalarRes, scalarCount) == 0);
+
+                mismatches += bMatch ? 0 : 1;
+            }
+            vectors += count;
+        }
+
+        std::string name = std::string("viterbi batch ") + batchKernels[kernel]->name;
+        compareResult(name.c_str(), vectors, mismatches);
+    }
+
+    // block codecs against deinterleave and depuncture formulas
+    uint8_t sequence[LowerMac::SCRAMBLING_SEQUENCE_LEN];
+    uint8_t data[LowerMac::SCRAMBLING_SEQUENCE_LEN];
+    std::size_t mismatches = 0;
+    std::size_t vectors = 0;
+
+    BschCodec bsch;
+    HalfSlotCodec halfSlot;
+    FullSlotCodec fullSlot;
+
+    for (std::size_t vec = 0; vec < iterations / 10 + 1; vec++)
+    {
+        randomBits(&state, sequence, sizeof(sequence));
+        randomBits(&state, data, sizeof(data));
+
+        const BschCodec::MotherCode & bschRes = bsch.deinterleaveDepuncture(data, sequence);
+        mismatches += (std::vector<uint8_t>(bschRes.begin(), bschRes.end()) == referenceDeinterleaveDepuncture(data, sequence, 120, 11)) ? 0 : 1;
+
+        const HalfSlotCodec::MotherCode & halfSlotRes = halfSlot.deinterleaveDepuncture(data, sequence);
+        mismatches += (std::vector<uint8_t>(halfSlotRes.begin(), halfSlotRes.end()) == referenceDeinterleaveDepuncture(data, sequence, 216, 101)) ? 0 : 1;
+
+        const FullSlotCodec::MotherCode & fullSlotRes = fullSlot.deinterleaveDepuncture(data, sequence);
+        mismatches += (std::vector<uint8_t>(fullSlotRes.begin(), fullSlotRes.end()) == referenceDeinterleaveDepuncture(data, sequence, 432, 103)) ? 0 : 1;
+
+        vectors += 3;
+    }
+    compareResult("deinterleave depuncture23", vectors, mismatches);
+
+    // CRC table against bit by bit CRC, random lengths and valid CRC
+    mismatches = 0;
+    vectors = iterations + 1;
+    for (std::size_t vec = 0; vec < vectors; vec++)
+    {
+        int len = (int)(randomValue(&state) % 300);
+        randomBits(&state, data, sizeof(data));
+
+        if (vec % 2)
+        {
+            len = 76 + 16 * (int)(vec % 14);                                    // force a valid CRC: append ~CRC of data
+            uint16_t crc = 0xFFFF;
+            for (int idx = 0; idx < len - 16; idx++)
+            {
+                crc ^= (uint16_t)data[idx] << 15;
+                crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+            }
+            crc = (uint16_t)~crc;
+            for (int idx = 0; idx < 16; idx++)
+            {
+                data[len - 16 + idx] = (uint8_t)((crc >> (15 - idx)) & 1);
+            }
+        }
+
+        bool bValid = lowerMac.checkCrc16Ccitt(data, len);
+        mismatches += (bValid == referenceCrc16Ccitt(data, len)) ? 0 : 1;
+        mismatches += ((vec % 2) && !bValid) ? 1 : 0;
+    }
+    compareResult("crc16 ccitt", vectors, mismatches);
+
+    // Reed-Muller against parity checks formulas, random words with any number of errors
+    mismatches = 0;
+    vectors = iterations + 1;
+    for (std::size_t vec = 0; vec < vectors; vec++)
+    {
+        randomBits(&state, data, 30);
+
+        uint8_t res[14];
+        uint8_t refRes[14];
+        lowerMac.reedMuller3014Decode(data, res);
+        referenceReedMuller3014Decode(data, refRes);
+        mismatches += (memcmp(res, refRes, sizeof(res)) == 0) ? 0 : 1;
+    }
+    compareResult("reed muller 30,14", vectors, mismatches);
+}
+
+/**
+ * @brief Kernels micro benchmarks
+ *
+ */
+
+static void benchKernels(const std::size_t iterations)
+{
+    uint64_t state = 0x2545F4914F6CDD1D;
+    Log log(LogLevel::NONE);
+    LowerMac lowerMac(&log);
+
+    ViterbiVector val = viterbiVector(&state, ViterbiDecoder1614::MAX_STEPS, 20);
+    uint8_t res[ViterbiDecoder1614::MAX_STEPS];
+
+    std::vector<int> polynomials;
+    polynomials.push_back(0b10011);
+    polynomials.push_back(0b11101);
+    polynomials.push_back(0b10111);
+    polynomials.push_back(0b11011);
+    ViterbiCodec codec(6, polynomials);
+    std::string sIn;
+    for (std::size_t idx = 0; idx < val.hard.size(); idx++)
+    {
+        sIn += (char)('0' + val.hard[idx]);
+    }
+
+    bench("ViterbiCodec::Decode SCH/F (reference)", iterations / 100 + 1, ViterbiDecoder1614::MAX_STEPS, [&]() {
+        gSink += codec.Decode(sIn).size();
+    });
+
+    std::vector<const ViterbiAcsKernel *> kernels = viterbiAcsKernels();
+    for (std::size_t kernel = 0; kernel < kernels.size(); kernel++)
+    {
+        ViterbiDecoder1614 decoder(kernels[kernel]->name);
+
+        std::string name = std::string("viterbi ") + kernels[kernel]->name + " SCH/F";
+        bench(name.c_str(), iterations, ViterbiDecoder1614::MAX_STEPS, [&]() {
+            gSink += decoder.decode(val.hard.data(), val.hard.size(), res);
+        });
+
+        name = std::string("viterbi ") + kernels[kernel]->name + " soft SCH/F";
+        bench(name.c_str(), iterations, ViterbiDecoder1614::MAX_STEPS, [&]() {
+            gSink += decoder.decodeSoft(val.soft.data(), val.soft.size(), res);
+        });
+    }
+
+    // batches of SCH/F blocks, ns/bit can be compared with single block kernels
+    std::vector<ViterbiVector> batchVals;
+    std::vector<const uint8_t *> batchHard;
+    std::vector<const int8_t *> batchSoft;
+    std::vector<std::vector<uint8_t> > batchRes(ViterbiBatchDecoder1614::MAX_LANES, std::vector<uint8_t>(ViterbiDecoder1614::MAX_STEPS));
+    std::vector<uint8_t *> batchResPtr;
+    for (std::size_t idx = 0; idx < ViterbiBatchDecoder1614::MAX_LANES; idx++)
+    {
+        batchVals.push_back(viterbiVector(&state, ViterbiDecoder1614::MAX_STEPS, 20));
+        batchHard.push_back(batchVals[idx].hard.data());
+        batchSoft.push_back(batchVals[idx].soft.data());
+        batchResPtr.push_back(batchRes[idx].data());
+    }
+
+    std::vector<const ViterbiBatchAcsKernel *> batchKernels = viterbiBatchAcsKernels();
+    for (std::size_t kernel = 0; kernel < batchKernels.size(); kernel++)
+    {
+        ViterbiBatchDecoder1614 decoder(batchKernels[kernel]->name);
+        const std::size_t lanes = ViterbiBatchDecoder1614::MAX_LANES;
+
+        std::string name = std::string("viterbi batch ") + batchKernels[kernel]->name + " 16 x SCH/F";
+        bench(name.c_str(), iterations / lanes + 1, lanes * ViterbiDecoder1614::MAX_STEPS, [&]() {
+            gSink += decoder.decode(batchHard.data(), lanes, 4 * ViterbiDecoder1614::MAX_STEPS, batchResPtr.data());
+        });
+
+        name = std::string("viterbi batch ") + batchKernels[kernel]->name + " soft 16 x SCH/F";
+        bench(name.c_str(), iterations / lanes + 1, lanes * ViterbiDecoder1614::MAX_STEPS, [&]() {
+            gSink += decoder.decodeSoft(batchSoft.data(), lanes, 4 * ViterbiDecoder1614::MAX_STEPS, batchResPtr.data());
+        });
+    }
+
+    uint8_t data[LowerMac::SCRAMBLING_SEQUENCE_LEN];
+    uint8_t sequence[LowerMac::SCRAMBLING_SEQUENCE_LEN];
+    randomBits(&state, data, sizeof(data));
+    randomBits(&state, sequence, sizeof(sequence));
+
+    bench("LowerMac::descramble 432", iterations, 432, [&]() {
+        lowerMac.descramble(data, 432, 0x12345678);
+        gSink += data[0];
+    });
+
+    BschCodec bsch;
+    bench("deinterleave depuncture23 BSCH", iterations, BschCodec::BLOCK_LEN, [&]() {
+        gSink += bsch.deinterleaveDepuncture(data, sequence)[0];
+    });
+
+    HalfSlotCodec halfSlot;
+    bench("deinterleave depuncture23 SCH/HD", iterations, HalfSlotCodec::BLOCK_LEN, [&]() {
+        gSink += halfSlot.deinterleaveDepuncture(data, sequence)[0];
+    });
+
+    FullSlotCodec fullSlot;
+    bench("deinterleave depuncture23 SCH/F", iterations, FullSlotCodec::BLOCK_LEN, [&]() {
+        gSink += fullSlot.deinterleaveDepuncture(data, sequence)[0];
+    });
+
+    bench("LowerMac::reedMuller3014Decode", iterations, 30, [&]() {
+        gSink += lowerMac.reedMuller3014Decode(data, res);
+    });
+
+    bench("LowerMac::checkCrc16Ccitt SCH/F", iterations, 284, [&]() {
+        gSink += lowerMac.checkCrc16Ccitt(data, 284);
+    });
+}
+
+/**
+ * @brief Synthetic stream of NDB with valid training sequences and random blocks, bursts
+ *        are found by the synchronizer and fully channel decoded but fail CRC
+ *
+ */
+
+static std::vector<uint8_t> syntheticStream(const std::size_t bursts)
+{
+    const uint8_t trainingSeq1[22]     = {1,1,0,1,0,0,0,0,1,1,1,0,1,0,0,1,1,1,0,1,0,0}; // 9.4.4.3.2 n1..n22
+    const uint8_t trainingSeq3Begin[12] = {0,0,0,1,1,0,1,0,1,1,0,1};                     // q11..q22
+    const uint8_t trainingSeq3End[10]   = {1,0,1,1,0,1,1,1,0,0};                         // q1..q10
+
+    uint64_t state = 0xD1B54A32D192ED03;
+    std::vector<uint8_t> res(bursts * Mac::BURST_LEN);
+
+    for (std::size_t burst = 0; burst < bursts; burst++)
+    {
+        uint8_t * data = res.data() + burst * Mac::BURST_LEN;
+        randomBits(&state, data, Mac::BURST_LEN);
+        memcpy(data,       trainingSeq3Begin, sizeof(trainingSeq3Begin));
+        memcpy(data + 244, trainingSeq1,      sizeof(trainingSeq1));
+        memcpy(data + 500, trainingSeq3End,   sizeof(trainingSeq3End));
+    }
+
+    return res;
+}
+
+/**
+ * @brief End-to-end decoding through TetraDecoder::rxData, by spans as file replay does
+ *
+ */
+
+static void benchDecoder(const std::vector<uint8_t> & stream, const std::size_t macWorkersCount, const char * name)
+{
+    const std::size_t SPAN_LEN = 4096;
+
+    fflush(stdout);                                                             // decoded PDU printed by layers are discarded
+    int savedStdout = dup(STDOUT_FILENO);
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+
+    TetraDecoder * decoder = new TetraDecoder(-1, true, LogLevel::NONE, false, macWorkersCount);
+
+    std::size_t bursts = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (std::size_t pos = 0; pos < stream.size(); pos += SPAN_LEN)
+    {
+        bursts += decoder->rxData(stream.data() + pos, std::min(SPAN_LEN, stream.size() - pos), RX_FORMAT_UNPACKED);
+    }
+    delete decoder;                                                             // pipeline bursts in flight are delivered
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fflush(stdout);
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+    close(devNull);
+
+    printf("%-40s %10zu bursts %10.0f bursts/s %8.2f ns/bit\n", name, bursts,
+           (elapsed > 0.0) ? (double)bursts / elapsed : 0.0, (stream.size() > 0) ? elapsed * 1e9 / (double)stream.size() : 0.0);
+}
+
+/**
+ * @brief Count heap allocations per burst in steady state of end-to-end decoding
+ *
+ * The first half of the stream warms the decoder up (cell informations, reassemblies
+ * pool, buffers capacity), allocations are then counted while the second half is decoded.
+ *
+ * @return false when allocations per burst exceed maxPerBurst
+ *
+ */
+
+static bool checkAllocations(const std::vector<uint8_t> & stream, const std::size_t macWorkersCount, const double maxPerBurst, const char * name)
+{
+    const std::size_t SPAN_LEN = 4096;
+
+    fflush(stdout);                                                             // decoded PDU printed by layers are discarded
+    int savedStdout = dup(STDOUT_FILENO);
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+
+    TetraDecoder * decoder = new TetraDecoder(-1, true, LogLevel::NONE, false, macWorkersCount);
+
+    std::size_t half = (stream.size() / 2 / SPAN_LEN) * SPAN_LEN;
+    for (std::size_t pos = 0; pos < half; pos += SPAN_LEN)
+    {
+        decoder->rxData(stream.data() + pos, SPAN_LEN, RX_FORMAT_UNPACKED);
+    }
+    decoder->flush();
+
+    gAllocations    = 0;
+    gAllocatedBytes = 0;
+    gCountAllocations = true;
+
+    std::size_t bursts = 0;
+    for (std::size_t pos = half; pos < stream.size(); pos += SPAN_LEN)
+    {
+        bursts += decoder->rxData(stream.data() + pos, std::min(SPAN_LEN, stream.size() - pos), RX_FORMAT_UNPACKED);
+    }
+    decoder->flush();                                                           // bursts in flight are counted
+
+    gCountAllocations = false;
+
+    delete decoder;
+
+    fflush(stdout);
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+    close(devNull);
+
+    double perBurst = (bursts > 0) ? (double)gAllocations / (double)bursts : 0.0;
+    printf("%-40s %10zu bursts %10.2f allocations/burst %8.1f bytes/burst\n", name, bursts,
+           perBurst, (bursts > 0) ? (double)gAllocatedBytes / (double)bursts : 0.0);
+
+    return perBurst <= maxPerBurst;
+}
+
+/**
+ * @brief Read a file of unpacked bits
+ *
+ */
+
+static std::vector<uint8_t> readFile(const char * filename)
+{
+    std::vector<uint8_t> res;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Couldn't open input bits file '%s'\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    uint8_t buf[65536];
+    ssize_t len;
+    while ((len = read(fd, buf, sizeof(buf))) > 0)
+    {
+        res.insert(res.end(), buf, buf + len);
+    }
+    close(fd);
+
+    return res;
+}
+
+int main(int argc, char * argv[])
+{
+    std::size_t iterations = 10000;
+    std::size_t macWorkersCount = 0;
+    bool bCompare = false;
+    double maxAllocations = -1.0;
+    const char * filename = NULL;
+
+    int option;
+    while ((option = getopt(argc, argv, "hca:n:i:j:")) != -1)
+    {
+        switch (option)
+        {
+        case 'c':
+            bCompare = true;
+            break;
+
+        case 'a':
+            maxAllocations = atof(optarg);
+            break;
+
+        case 'n':
+            iterations = (std::size_t)atol(optarg);
+            break;
+
+        case 'i':
+            filename = optarg;
+            break;
+
+        case 'j':
+            macWorkersCount = (std::size_t)atol(optarg);
+            break;
+
+        default:
+            fprintf(stderr, "Usage: decoderbench [-c] [-a <allocations>] [-n <iterations>] [-i <file of unpacked bits>] [-j <workers>]\n"
+                    "  -c compare kernels bit exact against reference implementations, exit with failure on mismatch\n"
+                    "  -a <allocations> count steady state heap allocations per burst of end-to-end decoding, exit with failure above\n"
+                    "  -n <iterations> micro benchmarks iterations [default 10000]\n"
+                    "  -i <file> end-to-end benchmark on recorded unpacked bits instead of synthetic bursts\n"
+                    "  -j <workers> lower MAC worker threads in end-to-end benchmark [default 0, inline]\n"
+                    "  -h print this help\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (bCompare)
+    {
+        compareKernels(iterations);
+        return EXIT_SUCCESS;
+    }
+
+    if (maxAllocations >= 0.0)
+    {
+        bool bPass = filename ? checkAllocations(readFile(filename), macWorkersCount, maxAllocations, filename) :
+                                checkAllocations(syntheticStream(iterations), macWorkersCount, maxAllocations, "synthetic NDB");
+        return bPass ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    benchKernels(iterations);
+
+    std::vector<uint8_t> noise(iterations * Mac::BURST_LEN);
+    uint64_t state = 0x853C49E6748FEA9B;
+    randomBits(&state, noise.data(), noise.size());
+    benchDecoder(noise, macWorkersCount, "sync search on random bits");
+
+    if (filename)
+    {
+        benchDecoder(readFile(filename), macWorkersCount, filename);
+    }
+    else
+    {
+        benchDecoder(syntheticStream(iterations), macWorkersCount, "synthetic NDB");
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,761 @@
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "capture.h"
+#include "decoder.h"
+
+using namespace Tetra;
+
+static const char FILE_MAGIC[]   = "TKCAP001";
+static const char CHUNK_MAGIC[]  = "TKCK";
+static const char INDEX_MAGIC[]  = "TKIX";
+static const char FOOTER_MAGIC[] = "TKCAPEND";
+
+/**
+ * @brief Write little endian value of len bytes
+ *
+ */
+
+static void putLe(uint8_t * dst, uint64_t val, std::size_t len)
+{
+    for (std::size_t idx = 0; idx < len; idx++)
+    {
+        dst[idx] = (uint8_t)(val >> (8 * idx));
+    }
+}
+
+/**
+ * @brief Read little endian value of len bytes
+ *
+ */
+
+static uint64_t getLe(const uint8_t * src, std::size_t len)
+{
+    uint64_t res = 0;
+    for (std::size_t idx = 0; idx < len; idx++)
+    {
+        res |= (uint64_t)src[idx] << (8 * idx);
+    }
+
+    return res;
+}
+
+/**
+ * @brief Read exactly len bytes at offset
+ *
+ */
+
+static bool readAt(int fd, uint8_t * dst, std::size_t len, uint64_t offset)
+{
+    while (len > 0)
+    {
+        ssize_t count = pread(fd, dst, len, (off_t)offset);
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            return false;
+        }
+
+        dst    += count;
+        len    -= (std::size_t)count;
+        offset += (uint64_t)count;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Wall clock time in ns since epoch
+ *
+ */
+
+static uint64_t wallClockNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Capture writer on an open file, header is written by open()
+ *
+ */
+
+CaptureWriter::CaptureWriter(int fd, const uint8_t rxFormat) : m_ring(RING_LEN)
+{
+    m_fd          = fd;
+    m_rxFormat    = rxFormat;
+    m_bStop       = false;
+    m_bWriteError = false;
+
+    m_chunkTimestampNs = 0;
+    m_streamOffset     = 0;
+    m_fileOffset       = Capture::HEADER_LEN;
+    m_bytesCaptured    = 0;
+    m_burstsIndexed    = 0;
+    m_chunksDropped    = 0;
+
+    m_chunkData.reserve(CHUNK_LEN);
+
+    m_bStarted = (pthread_create(&m_thread, NULL, writerThread, this) == 0);
+    if (!m_bStarted)
+    {
+        fprintf(stderr, "Couldn't create capture writer thread\n");
+    }
+}
+
+/**
+ * @brief Destructor, last chunk and trailer index are written and file is closed
+ *
+ * Without writer thread, the ring content is written synchronously from this thread.
+ *
+ */
+
+CaptureWriter::~CaptureWriter()
+{
+    closeChunk();
+
+    if (!m_bStarted)
+    {
+        m_bStop = true;                                                         // writeFile() returns once the ring is drained, see push()
+    }
+
+    // trailer index
+    uint8_t buf[Capture::INDEX_ENTRY_LEN];
+    memcpy(buf, INDEX_MAGIC, 4);
+    putLe(buf + 4, m_chunks.size(), 4);
+    push(buf, Capture::INDEX_HEADER_LEN);
+
+    for (std::size_t idx = 0; idx < m_chunks.size(); idx++)
+    {
+        const Capture::Chunk & chunk = m_chunks[idx];
+        putLe(buf,      chunk.fileOffset,   8);
+        putLe(buf + 8,  chunk.streamOffset, 8);
+        putLe(buf + 16, chunk.timestampNs,  8);
+        putLe(buf + 24, chunk.dataLen,      4);
+        putLe(buf + 28, chunk.burstsCount,  4);
+        push(buf, Capture::INDEX_ENTRY_LEN);
+    }
+
+    putLe(buf, m_fileOffset, 8);
+    memcpy(buf + 8, FOOTER_MAGIC, 8);
+    push(buf, Capture::FOOTER_LEN);
+
+    m_bStop = true;
+    if (m_bStarted)
+    {
+        pthread_join(m_thread, NULL);
+    }
+    else
+    {
+        writeFile();                                                            // no writer thread, write the ring content left
+    }
+
+    close(m_fd);
+}
+
+/**
+ * @brief Create capture file and write its header
+ *
+ * @return NULL if file can't be created
+ *
+ */
+
+CaptureWriter * CaptureWriter::open(const char * filename, const uint8_t rxFormat)
+{
+    int fd = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP);
+    if (fd < 0)
+    {
+        perror("Couldn't create capture file");
+        return NULL;
+    }
+
+    uint8_t header[Capture::HEADER_LEN];
+    memset(header, 0, sizeof(header));
+    memcpy(header, FILE_MAGIC, 8);
+    putLe(header + 8, Capture::VERSION, 4);
+    header[12] = rxFormat;
+
+    if (::write(fd, header, sizeof(header)) != (ssize_t)sizeof(header))
+    {
+        perror("Couldn't write capture file");
+        close(fd);
+        return NULL;
+    }
+
+    return new CaptureWriter(fd, rxFormat);
+}
+
+/**
+ * @brief Append received bytes to current chunk (decoding thread)
+ *
+ */
+
+void CaptureWriter::write(const uint8_t * data, const std::size_t len)
+{
+    std::size_t pos = 0;
+
+    while (pos < len)
+    {
+        if (!m_chunkData.empty() && ((m_chunkData.size() >= CHUNK_LEN) || (wallClockNs() - m_chunkTimestampNs >= CHUNK_PERIOD_NS)))
+        {
+            closeChunk();                                                       // closed only when more data comes, so it gets its bursts
+        }
+
+        if (m_chunkData.empty())
+        {
+            m_chunkTimestampNs = wallClockNs();
+        }
+
+        std::size_t count = std::min(len - pos, CHUNK_LEN - m_chunkData.size());
+        m_chunkData.insert(m_chunkData.end(), data + pos, data + pos + count);
+        pos += count;
+    }
+}
+
+/**
+ * @brief Add a burst found at symbol position to current chunk index (decoding thread)
+ *
+ */
+
+void CaptureWriter::addBurst(const uint64_t symbolPosition, const TetraTime & time, const int burstType)
+{
+    uint64_t offset = (m_rxFormat == RX_FORMAT_PACKED) ? symbolPosition / 8 : symbolPosition;
+
+    std::size_t pos = m_chunkBursts.size();
+    m_chunkBursts.resize(pos + Capture::BURST_LEN);
+    uint8_t * entry = m_chunkBursts.data() + pos;
+
+    putLe(entry, offset, 8);
+    entry[8]  = (uint8_t)time.tn;
+    entry[9]  = (uint8_t)time.fn;
+    entry[10] = (uint8_t)time.mn;
+    entry[11] = (uint8_t)burstType;
+}
+
+/**
+ * @brief Close current chunk, bursts found afterwards are not indexed
+ *
+ */
+
+void CaptureWriter::flush()
+{
+    closeChunk();
+}
+
+/**
+ * @brief Encode current chunk and hand it to writer thread, chunk is dropped if ring is full
+ *
+ */
+
+void CaptureWriter::closeChunk()
+{
+    if (m_chunkData.empty())
+    {
+        return;
+    }
+
+    // unpacked bits are stored 8 per byte
+    bool bPack = (m_rxFormat == RX_FORMAT_UNPACKED);
+    for (std::size_t idx = 0; bPack && (idx < m_chunkData.size()); idx++)
+    {
+        bPack = (m_chunkData[idx] <= 1);
+    }
+
+    std::size_t storedLen = bPack ? (m_chunkData.size() + 7) / 8 : m_chunkData.size();
+    uint32_t burstsCount  = (uint32_t)(m_chunkBursts.size() / Capture::BURST_LEN);
+
+    m_chunkBuffer.assign(Capture::CHUNK_HEADER_LEN + storedLen + m_chunkBursts.size(), 0);
+    uint8_t * buf = m_chunkBuffer.data();
+
+    memcpy(buf, CHUNK_MAGIC, 4);
+    putLe(buf + 4,  bPack ? Capture::FLAG_BITS_PACKED : 0, 4);
+    putLe(buf + 8,  m_chunkTimestampNs, 8);
+    putLe(buf + 16, m_streamOffset, 8);
+    putLe(buf + 24, m_chunkData.size(), 4);
+    putLe(buf + 28, storedLen, 4);
+    putLe(buf + 32, burstsCount, 4);
+
+    uint8_t * stored = buf + Capture::CHUNK_HEADER_LEN;
+    if (bPack)
+    {
+        for (std::size_t idx = 0; idx < m_chunkData.size(); idx++)
+        {
+            stored[idx / 8] |= (uint8_t)(m_chunkData[idx] << (7 - idx % 8));
+        }
+    }
+    else
+    {
+        memcpy(stored, m_chunkData.data(), m_chunkData.size());
+    }
+    if (!m_chunkBursts.empty())
+    {
+        memcpy(stored + storedLen, m_chunkBursts.data(), m_chunkBursts.size());
+    }
+
+    if (m_ring.write(m_chunkBuffer.data(), m_chunkBuffer.size()))
+    {
+        Capture::Chunk chunk;
+        chunk.fileOffset   = m_fileOffset;
+        chunk.streamOffset = m_streamOffset;
+        chunk.timestampNs  = m_chunkTimestampNs;
+        chunk.dataLen      = (uint32_t)m_chunkData.size();
+        chunk.burstsCount  = burstsCount;
+        m_chunks.push_back(chunk);
+
+        m_fileOffset    += m_chunkBuffer.size();
+        m_bytesCaptured += m_chunkData.size();
+        m_burstsIndexed += burstsCount;
+    }
+    else
+    {
+        m_chunksDropped++;                                                      // disk can't keep up, don't stall decoding
+    }
+
+    m_streamOffset += m_chunkData.size();
+    m_chunkData.clear();
+    m_chunkBursts.clear();
+}
+
+/**
+ * @brief Hand bytes to writer thread, waiting for space (trailer index only)
+ *
+ * Without writer thread, nothing would ever make space: the ring is then written to the
+ * file from the calling thread, stop must already be requested.
+ *
+ */
+
+void CaptureWriter::push(const uint8_t * data, const std::size_t len)
+{
+    while (!m_ring.write(data, len))
+    {
+        if (!m_bStarted)
+        {
+            writeFile();
+            continue;
+        }
+        usleep(1000);
+    }
+}
+
+/**
+ * @brief Writer thread entry point
+ *
+ */
+
+void * CaptureWriter::writerThread(void * arg)
+{
+    ((CaptureWriter *)arg)->writeFile();
+
+    return NULL;
+}
+
+/**
+ * @brief Write ring content to file until stop is requested and ring is empty
+ *
+ */
+
+void CaptureWriter::writeFile()
+{
+    while (true)
+    {
+        bool bStop = m_bStop.load(std::memory_order_acquire);                   // read before the ring so last bytes are not missed
+
+        const uint8_t * span;
+        std::size_t len = m_ring.peek(&span);
+        if (len == 0)
+        {
+            if (bStop)
+            {
+                break;
+            }
+            usleep(1000);
+            continue;
+        }
+
+        if (!m_bWriteError)
+        {
+            std::size_t pos = 0;
+            while (pos < len)
+            {
+                ssize_t count = ::write(m_fd, span + pos, len - pos);
+                if (count < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (count <= 0)
+                {
+                    perror("Couldn't write capture file");
+                    m_bWriteError = true;                                       // keep draining the ring
+                    break;
+                }
+                pos += (std::size_t)count;
+            }
+        }
+
+        m_ring.consume(len);
+    }
+}
+
+/**
+ * @brief Print counters
+ *
+ */
+
+void CaptureWriter::printStats()
+{
+    fprintf(stderr, "Capture     : %llu bytes in %zu chunks, %llu bursts indexed, %llu chunks dropped%s\n",
+            (unsigned long long)m_bytesCaptured, m_chunks.size(), (unsigned long long)m_burstsIndexed, (unsigned long long)m_chunksDropped,
+            m_bWriteError ? ", write error" : "");
+}
+
+/**
+ * @brief Capture reader on an open file, index is loaded by open()
+ *
+ */
+
+CaptureReader::CaptureReader(int fd, const uint8_t rxFormat)
+{
+    m_fd       = fd;
+    m_rxFormat = rxFormat;
+}
+
+/**
+ * @brief Destructor, file is not closed
+ *
+ */
+
+CaptureReader::~CaptureReader()
+{
+}
+
+/**
+ * @brief Open capture on file descriptor
+ *
+ * @return NULL if file is not a capture
+ *
+ */
+
+CaptureReader * CaptureReader::open(int fd)
+{
+    struct stat st;
+    if ((fstat(fd, &st) != 0) || !S_ISREG(st.st_mode))
+    {
+        return NULL;
+    }
+
+    uint8_t header[Capture::HEADER_LEN];
+    if (!readAt(fd, header, sizeof(header), 0) || (memcmp(header, FILE_MAGIC, 8) != 0))
+    {
+        return NULL;
+    }
+
+    if (getLe(header + 8, 4) != Capture::VERSION)
+    {
+        fprintf(stderr, "Unsupported capture version %u\n", (uint32_t)getLe(header + 8, 4));
+        return NULL;
+    }
+
+    CaptureReader * reader = new CaptureReader(fd, header[12]);
+
+    if (!reader->readIndex((uint64_t)st.st_size))
+    {
+        reader->scanChunks((uint64_t)st.st_size);                               // recording was interrupted
+        fprintf(stderr, "Capture has no index, %zu chunks found\n", reader->m_chunks.size());
+    }
+
+    return reader;
+}
+
+/**
+ * @brief Load trailer index
+ *
+ * @return false if trailer is missing or invalid
+ *
+ */
+
+bool CaptureReader::readIndex(uint64_t fileLen)
+{
+    if (fileLen < Capture::HEADER_LEN + Capture::INDEX_HEADER_LEN + Capture::FOOTER_LEN)
+    {
+        return false;
+    }
+
+    uint8_t footer[Capture::FOOTER_LEN];
+    if (!readAt(m_fd, footer, sizeof(footer), fileLen - Capture::FOOTER_LEN) || (memcmp(footer + 8, FOOTER_MAGIC, 8) != 0))
+    {
+        return false;
+    }
+
+    uint64_t indexOffset = getLe(footer, 8);
+    if (indexOffset + Capture::INDEX_HEADER_LEN + Capture::FOOTER_LEN > fileLen)
+    {
+        return false;
+    }
+
+    uint8_t indexHeader[Capture::INDEX_HEADER_LEN];
+    if (!readAt(m_fd, indexHeader, sizeof(indexHeader), indexOffset) || (memcmp(indexHeader, INDEX_MAGIC, 4) != 0))
+    {
+        return false;
+    }
+
+    uint64_t count = getLe(indexHeader + 4, 4);
+    if (indexOffset + Capture::INDEX_HEADER_LEN + count * Capture::INDEX_ENTRY_LEN + Capture::FOOTER_LEN != fileLen)
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> entries((std::size_t)count * Capture::INDEX_ENTRY_LEN);
+    if (!readAt(m_fd, entries.data(), entries.size(), indexOffset + Capture::INDEX_HEADER_LEN))
+    {
+        return false;
+    }
+
+    m_chunks.resize((std::size_t)count);
+    for (std::size_t idx = 0; idx < m_chunks.size(); idx++)
+    {
+        const uint8_t * entry = entries.data() + idx * Capture::INDEX_ENTRY_LEN;
+        m_chunks[idx].fileOffset   = getLe(entry,      8);
+        m_chunks[idx].streamOffset = getLe(entry + 8,  8);
+        m_chunks[idx].timestampNs  = getLe(entry + 16, 8);
+        m_chunks[idx].dataLen      = (uint32_t)getLe(entry + 24, 4);
+        m_chunks[idx].burstsCount  = (uint32_t)getLe(entry + 28, 4);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Rebuild index by reading chunks headers, stops at first truncated chunk
+ *
+ */
+
+void CaptureReader::scanChunks(uint64_t fileLen)
+{
+    uint64_t offset = Capture::HEADER_LEN;
+    uint8_t header[Capture::CHUNK_HEADER_LEN];
+
+    m_chunks.clear();
+
+    while (offset + Capture::CHUNK_HEADER_LEN <= fileLen)
+    {
+        if (!readAt(m_fd, header, sizeof(header), offset) || (memcmp(header, CHUNK_MAGIC, 4) != 0))
+        {
+            break;
+        }
+
+        uint32_t burstsCount = (uint32_t)getLe(header + 32, 4);
+        uint64_t chunkLen = Capture::CHUNK_HEADER_LEN + getLe(header + 28, 4) + (uint64_t)burstsCount * Capture::BURST_LEN;
+        if (offset + chunkLen > fileLen)
+        {
+            break;
+        }
+
+        Capture::Chunk chunk;
+        chunk.fileOffset   = offset;
+        chunk.streamOffset = getLe(header + 16, 8);
+        chunk.timestampNs  = getLe(header + 8,  8);
+        chunk.dataLen      = (uint32_t)getLe(header + 24, 4);
+        chunk.burstsCount  = burstsCount;
+        m_chunks.push_back(chunk);
+
+        offset += chunkLen;
+    }
+}
+
+/**
+ * @brief Return received data format, RxFormat value
+ *
+ */
+
+uint8_t CaptureReader::rxFormat() const
+{
+    return m_rxFormat;
+}
+
+/**
+ * @brief Return chunks index
+ *
+ */
+
+const std::vector<Capture::Chunk> & CaptureReader::chunks() const
+{
+    return m_chunks;
+}
+
+/**
+ * @brief Return index of the last chunk starting at or before timestamp, 0 if none
+ *
+ */
+
+std::size_t CaptureReader::chunkAtTime(const uint64_t timestampNs) const
+{
+    std::size_t res = 0;
+
+    for (std::size_t idx = 0; idx < m_chunks.size(); idx++)
+    {
+        if (m_chunks[idx].timestampNs > timestampNs)
+        {
+            break;
+        }
+        res = idx;
+    }
+
+    return res;
+}
+
+/**
+ * @brief Return index of the chunk holding stream offset, chunks count if after end
+ *
+ */
+
+std::size_t CaptureReader::chunkAtOffset(const uint64_t streamOffset) const
+{
+    for (std::size_t idx = 0; idx < m_chunks.size(); idx++)
+    {
+        if (streamOffset < m_chunks[idx].streamOffset + m_chunks[idx].dataLen)
+        {
+            return idx;
+        }
+    }
+
+    return m_chunks.size();
+}
+
+/**
+ * @brief Read bursts index of chunk idx
+ *
+ */
+
+bool CaptureReader::readBursts(const std::size_t idx, std::vector<Capture::Burst> * res)
+{
+    res->clear();
+
+    if (idx >= m_chunks.size())
+    {
+        return false;
+    }
+
+    const Capture::Chunk & chunk = m_chunks[idx];
+
+    uint8_t header[Capture::CHUNK_HEADER_LEN];
+    if (!readAt(m_fd, header, sizeof(header), chunk.fileOffset))
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> entries((std::size_t)chunk.burstsCount * Capture::BURST_LEN);
+    if (!readAt(m_fd, entries.data(), entries.size(), chunk.fileOffset + Capture::CHUNK_HEADER_LEN + getLe(header + 28, 4)))
+    {
+        return false;
+    }
+
+    res->resize(chunk.burstsCount);
+    for (std::size_t pos = 0; pos < res->size(); pos++)
+    {
+        const uint8_t * entry = entries.data() + pos * Capture::BURST_LEN;
+        Capture::Burst & burst = (*res)[pos];
+        burst.streamOffset = getLe(entry, 8);
+        burst.time.tn      = entry[8];
+        burst.time.fn      = entry[9];
+        burst.time.mn      = entry[10];
+        burst.burstType    = entry[11];
+    }
+
+    return true;
+}
+
+/**
+ * @brief Find stream offset of the first burst of multiframe mn at or after stream offset from
+ *
+ * Only chunks bursts indexes are read, not their data.
+ *
+ * @return false if no such burst
+ *
+ */
+
+bool CaptureReader::multiframeOffset(const uint16_t mn, const uint64_t from, uint64_t * res)
+{
+    std::vector<Capture::Burst> bursts;
+
+    for (std::size_t idx = chunkAtOffset(from); idx < m_chunks.size(); idx++)
+    {
+        if (!readBursts(idx, &bursts))
+        {
+            return false;
+        }
+
+        for (std::size_t pos = 0; pos < bursts.size(); pos++)
+        {
+            if ((bursts[pos].time.mn == mn) && (bursts[pos].streamOffset >= from))
+            {
+                *res = bursts[pos].streamOffset;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Read stream bytes of chunk idx, returned buffer is valid until next call
+ *
+ * @return NULL if chunk can't be read
+ *
+ */
+
+const uint8_t * CaptureReader::readChunk(const std::size_t idx, std::size_t * len)
+{
+    if (idx >= m_chunks.size())
+    {
+        return NULL;
+    }
+
+    const Capture::Chunk & chunk = m_chunks[idx];
+
+    uint8_t header[Capture::CHUNK_HEADER_LEN];
+    if (!readAt(m_fd, header, sizeof(header), chunk.fileOffset) || (memcmp(header, CHUNK_MAGIC, 4) != 0))
+    {
+        return NULL;
+    }
+
+    uint32_t flags     = (uint32_t)getLe(header + 4, 4);
+    std::size_t dataLen   = (std::size_t)getLe(header + 24, 4);
+    std::size_t storedLen = (std::size_t)getLe(header + 28, 4);
+
+    m_stored.resize(storedLen);
+    if (!readAt(m_fd, m_stored.data(), storedLen, chunk.fileOffset + Capture::CHUNK_HEADER_LEN))
+    {
+        return NULL;
+    }
+
+    if (flags & Capture::FLAG_BITS_PACKED)
+    {
+        if (storedLen < (dataLen + 7) / 8)
+        {
+            return NULL;
+        }
+
+        m_data.resize(dataLen);
+        for (std::size_t pos = 0; pos < dataLen; pos++)
+        {
+            m_data[pos] = (m_stored[pos / 8] >> (7 - pos % 8)) & 1;
+        }
+        *len = dataLen;
+
+        return m_data.data();
+    }
+
+    *len = std::min(dataLen, storedLen);
+
+    return m_stored.data();
+}
@@ -0,0 +1,175 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <pthread.h>
+
+#include "common/tetra.h"
+#include "common/spscqueue.h"
+
+namespace Tetra {
+
+    /**
+     * @brief Indexed capture container
+     *
+     * Received bytes are stored by chunks, each chunk carries the wall clock time its first
+     * byte was received and the index of the bursts found in it, so a replay can start at a
+     * time or a multiframe without decoding the capture from the beginning. A trailer index
+     * of the chunks is written when the capture is closed, a capture without trailer (eg.
+     * interrupted recording) is still read by scanning the chunks.
+     *
+     * File format, little endian:
+     *
+     *   File header
+     *     offset  size
+     *          0     8  magic "TKCAP001"
+     *          8     4  version, VERSION
+     *         12     1  received data format, RxFormat value
+     *         13     3  reserved, 0
+     *
+     *   Chunk
+     *          0     4  magic "TKCK"
+     *          4     4  flags, FLAG_BITS_PACKED when unpacked bits are stored 8 per byte
+     *          8     8  wall clock time of first byte, ns since epoch
+     *         16     8  stream offset of first byte (received bytes before this chunk)
+     *         24     4  stream bytes count
+     *         28     4  stored bytes count
+     *         32     4  bursts count
+     *         36     4  reserved, 0
+     *         40     n  stored bytes (first bit in MSB when packed)
+     *          -  12*b  bursts, u64 stream offset of burst first symbol, TN, FN, MN, burst type
+     *
+     *   Trailer index, after the last chunk
+     *          0     4  magic "TKIX"
+     *          4     4  chunks count
+     *          8  32*c  chunks, u64 file offset, u64 stream offset, u64 time, u32 stream bytes, u32 bursts
+     *          -     8  file offset of trailer index
+     *          -     8  magic "TKCAPEND"
+     *
+     * Burst stream offsets are absolute, a burst found in a chunk may start in the previous
+     * one. TN/FN/MN are the MAC time when the burst was received, they are only meaningful
+     * once the decoder has received a SYNC.
+     *
+     */
+
+    namespace Capture {
+        static const uint32_t    VERSION          = 1;                          ///< Format version
+        static const uint32_t    FLAG_BITS_PACKED = 0x01;                       ///< Chunk bytes are unpacked bits stored 8 per byte
+        static const std::size_t HEADER_LEN       = 16;                         ///< File header length
+        static const std::size_t CHUNK_HEADER_LEN = 40;                         ///< Chunk header length
+        static const std::size_t BURST_LEN        = 12;                         ///< Burst index entry length
+        static const std::size_t INDEX_HEADER_LEN = 8;                          ///< Trailer index header length
+        static const std::size_t INDEX_ENTRY_LEN  = 32;                         ///< Trailer index entry length
+        static const std::size_t FOOTER_LEN       = 16;                         ///< File offset of trailer index and end magic
+
+        /** @brief Chunk description */
+
+        struct Chunk {
+            uint64_t fileOffset;                                                ///< Chunk header position in file
+            uint64_t streamOffset;                                              ///< Stream offset of first byte
+            uint64_t timestampNs;                                               ///< Wall clock time of first byte
+            uint32_t dataLen;                                                   ///< Stream bytes count
+            uint32_t burstsCount;                                               ///< Bursts in chunk index
+        };
+
+        /** @brief Burst index entry */
+
+        struct Burst {
+            uint64_t streamOffset;                                              ///< Stream offset of burst first symbol
+            TetraTime time;                                                     ///< MAC time when the burst was received
+            uint8_t burstType;                                                  ///< BurstType value
+        };
+    };
+
+    /**
+     * @brief Capture writer
+     *
+     * Chunks are built on the decoding thread and handed to a writer thread through a
+     * lock-free ring so file writes never stall decoding. A chunk is closed by the first
+     * bytes received once it holds CHUNK_LEN bytes or is older than CHUNK_PERIOD_NS, so
+     * bursts ending in its last bytes are still indexed in it. Chunks not fitting in the
+     * ring because the disk can't keep up are dropped and counted, the capture stays
+     * consistent.
+     *
+     */
+
+    class CaptureWriter {
+    public:
+        ~CaptureWriter();
+
+        static CaptureWriter * open(const char * filename, const uint8_t rxFormat);
+
+        void write(const uint8_t * data, const std::size_t len);
+        void addBurst(const uint64_t symbolPosition, const TetraTime & time, const int burstType);
+        void flush();
+        void printStats();
+
+    private:
+        CaptureWriter(int fd, const uint8_t rxFormat);
+
+        static const std::size_t CHUNK_LEN       = 64 * 1024;                   ///< Stream bytes per chunk
+        static const uint64_t    CHUNK_PERIOD_NS = 1000000000;                  ///< Longest chunk duration, time seek resolution
+        static const std::size_t RING_LEN        = 16 * 1024 * 1024;            ///< Chunks waiting to be written
+
+        static void * writerThread(void * arg);
+        void writeFile();
+        void closeChunk();
+        void push(const uint8_t * data, const std::size_t len);
+
+        int m_fd;                                                               ///< Capture file, owned
+        uint8_t m_rxFormat;                                                     ///< Received data format
+        SpscByteRing m_ring;                                                    ///< Bytes to write to file
+        pthread_t m_thread;                                                     ///< Writer thread
+        bool m_bStarted;                                                        ///< True when thread is running
+        std::atomic<bool> m_bStop;                                              ///< Request writer thread to exit once ring is empty
+        std::atomic<bool> m_bWriteError;                                        ///< Write to file failed, capture is truncated
+
+        std::vector<uint8_t> m_chunkData;                                       ///< Stream bytes of current chunk
+        std::vector<uint8_t> m_chunkBursts;                                     ///< Bursts index of current chunk, encoded
+        std::vector<uint8_t> m_chunkBuffer;                                     ///< Encoded chunk
+        uint64_t m_chunkTimestampNs;                                            ///< Wall clock time of current chunk first byte
+        uint64_t m_streamOffset;                                                ///< Stream offset of current chunk first byte
+        uint64_t m_fileOffset;                                                  ///< File offset of next chunk
+        std::vector<Capture::Chunk> m_chunks;                                   ///< Chunks written, trailer index
+
+        uint64_t m_bytesCaptured;                                               ///< Stream bytes in written chunks
+        uint64_t m_burstsIndexed;                                               ///< Bursts in written chunks
+        uint64_t m_chunksDropped;                                               ///< Chunks dropped because ring was full
+    };
+
+    /**
+     * @brief Capture reader, random access to chunks and bursts index
+     *
+     */
+
+    class CaptureReader {
+    public:
+        ~CaptureReader();
+
+        static CaptureReader * open(int fd);
+
+        uint8_t rxFormat() const;
+        const std::vector<Capture::Chunk> & chunks() const;
+        std::size_t chunkAtTime(const uint64_t timestampNs) const;
+        std::size_t chunkAtOffset(const uint64_t streamOffset) const;
+        bool readBursts(const std::size_t idx, std::vector<Capture::Burst> * res);
+        bool multiframeOffset(const uint16_t mn, const uint64_t from, uint64_t * res);
+        const uint8_t * readChunk(const std::size_t idx, std::size_t * len);
+
+    private:
+        CaptureReader(int fd, const uint8_t rxFormat);
+
+        bool readIndex(uint64_t fileLen);
+        void scanChunks(uint64_t fileLen);
+
+        int m_fd;                                                               ///< Capture file, not owned
+        uint8_t m_rxFormat;                                                     ///< Received data format
+        std::vector<Capture::Chunk> m_chunks;                                   ///< Chunks index
+        std::vector<uint8_t> m_stored;                                          ///< Chunk as stored
+        std::vector<uint8_t> m_data;                                            ///< Chunk stream bytes
+    };
+
+};
+
+#endif /* CAPTURE_H */
@@ -0,0 +1,193 @@
+/*
+ *  tetra-kit
+ *  Copyright (C) 2020  LarryTh <dev@logami.fr>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef BIT_BUFFER_H
+#define BIT_BUFFER_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "pdu.h"
+#include "pduview.h"
+
+namespace Tetra {
+
+    /**
+     * @brief Growable bits buffer packed in 64-bit words
+     *
+     * Bit k is held by word k / 64, first bit in MSB, so getValue() and appending values
+     * are a couple of shifts whatever the length up to 64 bits. Bits after size() in the last
+     * word are always 0.
+     *
+     * Reading past the end of the buffer returns 0 bits, as for Pdu::getValue.
+     *
+     */
+
+    class BitBuffer {
+    public:
+        BitBuffer() : m_size(0) {}
+
+        std::size_t size() const { return m_size; }
+        bool isEmpty() const { return m_size == 0; }
+        const uint64_t * words() const { return m_words.data(); }
+        void reserve(const std::size_t len) { m_words.reserve((len + 63) / 64); }
+        void clear() { m_words.clear(); m_size = 0; }                           ///< capacity is kept
+
+        /** @brief Append the len (len <= 64) low bits of value, MSB first */
+
+        void appendValue(uint64_t value, const std::size_t len)
+        {
+            if (len == 0)
+            {
+                return;
+            }
+            if (len < 64)
+            {
+                value &= ((uint64_t)1 << len) - 1;
+            }
+
+            std::size_t room = (m_size & 63) ? 64 - (m_size & 63) : 0;          // free bits in last word
+
+            if (room == 0)
+            {
+                m_words.push_back(value << (64 - len));
+            }
+            else if (len <= room)
+            {
+                m_words.back() |= value << (room - len);
+            }
+            else
+            {
+                m_words.back() |= value >> (len - room);
+                m_words.push_back(value << (64 - (len - room)));
+            }
+
+            m_size += len;
+        }
+
+        /** @brief Append len bits stored one bit per byte */
+
+        void append(const uint8_t * bits, const std::size_t len)
+        {
+            std::size_t pos = 0;
+
+            for (; pos + 64 <= len; pos += 64)
+            {
+                uint64_t word = 0;
+                for (std::size_t idx = 0; idx < 64; idx++)
+                {
+                    word = (word << 1) | (bits[pos + idx] & 1);
+                }
+                appendValue(word, 64);
+            }
+
+            uint64_t word = 0;
+            for (std::size_t idx = pos; idx < len; idx++)
+            {
+                word = (word << 1) | (bits[idx] & 1);
+            }
+            appendValue(word, len - pos);
+        }
+
+        void append(const PduView & view)
+        {
+            append(view.data(), view.size());
+        }
+
+        void append(const BitBuffer & buffer)
+        {
+            for (std::size_t pos = 0; pos < buffer.m_size; pos += 64)
+            {
+                std::size_t len = buffer.m_size - pos < 64 ? buffer.m_size - pos : 64;
+                appendValue(buffer.getValue(pos, len), len);
+            }
+        }
+
+        /** @brief Read len bits (len <= 64) from startPos, MSB first */
+
+        uint64_t getValue(const std::size_t startPos, const std::size_t len) const
+        {
+            if ((len == 0) || (startPos >= m_size))
+            {
+                return 0;
+            }
+
+            std::size_t word  = startPos / 64;
+            std::size_t shift = startPos % 64;
+
+            uint64_t val = m_words[word] << shift;
+            if ((shift > 0) && (word + 1 < m_words.size()))
+            {
+                val |= m_words[word + 1] >> (64 - shift);
+            }
+
+            return val >> (64 - len);
+        }
+
+        uint8_t at(const std::size_t pos) const
+        {
+            return (uint8_t)getValue(pos, 1);
+        }
+
+        /** @brief Copy of length bits from startPos, truncated to the end of buffer */
+
+        BitBuffer extract(const std::size_t startPos, const std::size_t length) const
+        {
+            BitBuffer res;
+
+            if (startPos < m_size)
+            {
+                std::size_t len = m_size - startPos < length ? m_size - startPos : length;
+                res.reserve(len);
+                for (std::size_t pos = 0; pos < len; pos += 64)
+                {
+                    std::size_t count = len - pos < 64 ? len - pos : 64;
+                    res.appendValue(getValue(startPos + pos, count), count);
+                }
+            }
+
+            return res;
+        }
+
+        /** @brief Write the size() bits one bit per byte to res */
+
+        void unpack(uint8_t * res) const
+        {
+            for (std::size_t pos = 0; pos < m_size; pos++)
+            {
+                res[pos] = (uint8_t)((m_words[pos / 64] >> (63 - pos % 64)) & 1);
+            }
+        }
+
+        /** @brief Copy the bits into a Pdu, one bit per byte, for upper layers */
+
+        Pdu toPdu() const
+        {
+            std::vector<uint8_t> bits(m_size);
+            unpack(bits.data());
+
+            return Pdu(bits);
+        }
+
+    private:
+        std::vector<uint64_t> m_words;                                          ///< Packed bits, first bit in MSB of first word
+        std::size_t m_size;                                                     ///< Length in bits
+    };
+
+};
+
+#endif /* BIT_BUFFER_H */
@@ -0,0 +1,145 @@
+/*
+ *  tetra-kit
+ *  Copyright (C) 2020  LarryTh <dev@logami.fr>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef LINK_QUALITY_H
+#define LINK_QUALITY_H
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+
+namespace Tetra {
+
+    /**
+     * @brief Running bit error statistics of the received bursts training sequences
+     *
+     * Each accepted burst gives the errors count of its training sequence and of the
+     * extended training sequence q11..q22 + q1..q10 surrounding it, the bit error rate is
+     * their exponentially weighted average over the last ~2^WEIGHT_SHIFT bursts.
+     *
+     * Once WARMUP_BURSTS were accepted, threshold() gives the largest errors count of a
+     * burst expected at this rate: mean plus 3 standard deviations of the binomial errors
+     * count, within [MIN_THRESHOLD, bits / 4]. Random bits average bits / 2 errors, so the
+     * upper bound keeps false bursts out even on bad channels.
+     *
+     * Viterbi decoded signalling blocks give their winning path metric, averaged the same
+     * way per decoded bit: hard input counts the received code bits the decoder corrected,
+     * soft input sums the magnitudes of the disagreeing symbols.
+     *
+     */
+
+    class LinkQuality {
+    public:
+        static const uint32_t WEIGHT_SHIFT  = 5;                                ///< Average weight of last burst is 2^-WEIGHT_SHIFT
+        static const uint32_t WARMUP_BURSTS = 32;                               ///< Accepted bursts before the rate is meaningful
+        static const uint32_t MIN_THRESHOLD = 3;                                ///< Lowest adapted threshold, tolerates error bursts on good channels
+
+        LinkQuality() : m_ber(0.0), m_accepted(0), m_rejected(0), m_errors(0), m_bits(0), m_pathMetric(0.0), m_pathBlocks(0) {}
+
+        /** @brief Add an accepted burst with errors errors among bits training bits */
+
+        void addBurst(const uint32_t errors, const uint32_t bits)
+        {
+            double rate = (double)errors / (double)bits;
+
+            if (m_accepted < WARMUP_BURSTS)
+            {
+                m_ber += (rate - m_ber) / (double)(m_accepted + 1);             // plain average until warmed up
+            }
+            else
+            {
+                m_ber += (rate - m_ber) / (double)(1 << WEIGHT_SHIFT);
+            }
+
+            m_accepted++;
+            m_errors += errors;
+            m_bits   += bits;
+        }
+
+        /** @brief Add a Viterbi decoded block with winning path metric metric over len decoded bits */
+
+        void addPathMetric(const uint32_t metric, const uint32_t len)
+        {
+            double rate = (double)metric / (double)len;
+
+            if (m_pathBlocks < WARMUP_BURSTS)
+            {
+                m_pathMetric += (rate - m_pathMetric) / (double)(m_pathBlocks + 1);
+            }
+            else
+            {
+                m_pathMetric += (rate - m_pathMetric) / (double)(1 << WEIGHT_SHIFT);
+            }
+
+            m_pathBlocks++;
+        }
+
+        /** @brief Count a burst rejected before channel decoding */
+
+        void rejectBurst()
+        {
+            m_rejected++;
+        }
+
+        /** @brief True once enough bursts were accepted for threshold() */
+
+        bool isWarmedUp() const
+        {
+            return m_accepted >= WARMUP_BURSTS;
+        }
+
+        /** @brief Largest errors count among bits training bits expected from a burst */
+
+        uint32_t threshold(const uint32_t bits) const
+        {
+            double mean  = m_ber * (double)bits;
+            double sigma = std::sqrt(mean * (1.0 - m_ber));
+            uint32_t res = (uint32_t)std::ceil(mean + 3.0 * sigma);
+
+            if (res < MIN_THRESHOLD)
+            {
+                res = MIN_THRESHOLD;
+            }
+            if (res > bits / 4)
+            {
+                res = bits / 4;
+            }
+
+            return res;
+        }
+
+        double ber() const { return m_ber; }                                    ///< Estimated bit error rate
+        uint64_t acceptedCount() const { return m_accepted; }
+        uint64_t rejectedCount() const { return m_rejected; }
+        uint64_t errorsCount() const { return m_errors; }
+        uint64_t bitsCount() const { return m_bits; }
+        double pathMetric() const { return m_pathMetric; }                      ///< Weighted average path metric per decoded bit
+        uint64_t pathBlocksCount() const { return m_pathBlocks; }
+
+    private:
+        double   m_ber;                                                         ///< Weighted average bit error rate
+        uint64_t m_accepted;                                                    ///< Bursts accepted
+        uint64_t m_rejected;                                                    ///< Bursts rejected
+        uint64_t m_errors;                                                      ///< Training bits errors in accepted bursts
+        uint64_t m_bits;                                                        ///< Training bits in accepted bursts
+        double   m_pathMetric;                                                  ///< Weighted average Viterbi path metric per decoded bit
+        uint64_t m_pathBlocks;                                                  ///< Viterbi decoded blocks
+    };
+
+};
+
+#endif /* LINK_QUALITY_H */
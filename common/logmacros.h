@@ -0,0 +1,43 @@
+/*
+ *  tetra-kit
+ *  Copyright (C) 2020  LarryTh <dev@logami.fr>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef LOG_MACROS_H
+#define LOG_MACROS_H
+#include "log.h"
+
+/**
+ * @brief Print to log only when level is enabled
+ *
+ * Unlike Log::print, format arguments are not evaluated when the message is suppressed,
+ * so strings built for debug output (Pdu::toString, vectorToString...) cost nothing at
+ * lower log levels.
+ *
+ * Usage: LOG_PRINT(m_log, LogLevel::HIGH, "pdu = %s\n", pdu.toString().c_str());
+ *
+ */
+
+#define LOG_PRINT(log, level, ...)                                              \
+    do                                                                          \
+    {                                                                           \
+        if ((log)->getLevel() >= (level))                                       \
+        {                                                                       \
+            (log)->print((level), __VA_ARGS__);                                 \
+        }                                                                       \
+    } while (0)
+
+#endif /* LOG_MACROS_H */
@@ -0,0 +1,140 @@
+/*
+ *  tetra-kit
+ *  Copyright (C) 2020  LarryTh <dev@logami.fr>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef PDU_VIEW_H
+#define PDU_VIEW_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include "pdu.h"
+
+namespace Tetra {
+
+    /**
+     * @brief Non-owning view of bits, one bit per byte, over a buffer held by the caller
+     *
+     * Views are used to parse PDU without copying them: sub-views only move the offset and
+     * length. The underlying buffer (ie. the decoded burst) must outlive the view, data which
+     * must outlive it is copied into an owning Pdu with toPdu().
+     *
+     * Reading past the end of the view returns 0 bits, as for Pdu::getValue.
+     *
+     */
+
+    class PduView {
+    public:
+        PduView() : m_data(NULL), m_size(0) {}
+        PduView(const uint8_t * data, const std::size_t len) : m_data(data), m_size(len) {}
+
+        /** @brief View over a bits container with data() and size(), eg. std::vector<uint8_t> */
+
+        template <typename T>
+        explicit PduView(const T & bits) : m_data(bits.data()), m_size(bits.size()) {}
+
+        /** @brief Sub-view from startPos to the end */
+
+        PduView(const PduView & view, const std::size_t startPos) : m_data(view.m_data), m_size(0)
+        {
+            if (startPos < view.m_size)
+            {
+                m_data += startPos;
+                m_size = view.m_size - startPos;
+            }
+        }
+
+        /** @brief Sub-view of length bits from startPos, truncated to the end of view */
+
+        PduView(const PduView & view, const std::size_t startPos, const std::size_t length) : m_data(view.m_data), m_size(0)
+        {
+            if (startPos < view.m_size)
+            {
+                m_data += startPos;
+                m_size = view.m_size - startPos < length ? view.m_size - startPos : length;
+            }
+        }
+
+        uint8_t at(const std::size_t pos) const
+        {
+            if (pos >= m_size)
+            {
+                throw std::out_of_range("PduView::at");
+            }
+
+            return m_data[pos];
+        }
+
+        const uint8_t * data() const { return m_data; }
+        bool isEmpty() const { return m_size == 0; }
+        std::size_t size() const { return m_size; }
+        void resize(const std::size_t len) { if (len < m_size) m_size = len; } ///< shrink only, the view can't grow
+
+        /** @brief Read len bits (len <= 64) from startPos, MSB first */
+
+        uint64_t getValue(const std::size_t startPos, const std::size_t len) const
+        {
+            uint64_t val = 0;
+
+            for (std::size_t idx = 0; idx < len; idx++)
+            {
+                val <<= 1;
+                if (startPos + idx < m_size)
+                {
+                    val |= m_data[startPos + idx];
+                }
+            }
+
+            return val;
+        }
+
+        /** @brief Copy the bits into an owning Pdu, for data outliving the underlying buffer */
+
+        Pdu toPdu() const
+        {
+            return Pdu(std::vector<uint8_t>(m_data, m_data + m_size));
+        }
+
+        /** @brief Copy the bits into an owning Pdu through buffer, which keeps its capacity so only the Pdu allocates */
+
+        Pdu toPdu(std::vector<uint8_t> & buffer) const
+        {
+            buffer.assign(m_data, m_data + m_size);
+            return Pdu(buffer);
+        }
+
+        std::string toString() const
+        {
+            std::string ret(m_size, '0');
+
+            for (std::size_t idx = 0; idx < m_size; idx++)
+            {
+                ret[idx] = (char)('0' + m_data[idx]);
+            }
+
+            return ret;
+        }
+
+    private:
+        const uint8_t * m_data;                                                 ///< First bit, one bit per byte
+        std::size_t m_size;                                                     ///< Length in bits
+    };
+
+};
+
+#endif /* PDU_VIEW_H */
@@ -0,0 +1,177 @@
+/*
+ *  tetra-kit
+ *  Copyright (C) 2020  LarryTh <dev@logami.fr>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+
+namespace Tetra {
+
+    /**
+     * @brief Lock-free single producer, single consumer bounded queue
+     *
+     * One thread only may push and one thread only may pop. Capacity N must be a power of 2.
+     * Elements are copied, so T should be small (eg. a pointer to a preallocated buffer).
+     *
+     */
+
+    template <typename T, std::size_t N>
+    class SpscQueue {
+        static_assert((N > 0) && ((N & (N - 1)) == 0), "SpscQueue capacity must be a power of 2");
+
+    public:
+        SpscQueue() : m_head(0), m_tail(0) {}
+
+        /** @brief Push element, return false if queue is full (producer only) */
+
+        bool push(const T & val)
+        {
+            std::size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail - m_head.load(std::memory_order_acquire) >= N)
+            {
+                return false;
+            }
+
+            m_buffer[tail & (N - 1)] = val;
+            m_tail.store(tail + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        /** @brief Pop element, return false if queue is empty (consumer only) */
+
+        bool pop(T * val)
+        {
+            std::size_t head = m_head.load(std::memory_order_relaxed);
+            if (head == m_tail.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+
+            *val = m_buffer[head & (N - 1)];
+            m_head.store(head + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        /** @brief Elements count, only a hint when called while the other thread is running */
+
+        std::size_t size() const
+        {
+            return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+        }
+
+    private:
+        T m_buffer[N];                                                          ///< Elements ring
+        std::atomic<std::size_t> m_head;                                        ///< Next element to pop, written by consumer
+        char m_padding[64];                                                     ///< Keep head and tail in different cache lines
+        std::atomic<std::size_t> m_tail;                                        ///< Next element to push, written by producer
+    };
+
+    /**
+     * @brief Lock-free single producer, single consumer bytes ring
+     *
+     * Producer writes whole chunks or nothing, consumer reads contiguous spans in place and
+     * releases them when done. Capacity is rounded up to a power of 2.
+     *
+     */
+
+    class SpscByteRing {
+    public:
+        SpscByteRing(std::size_t capacity) : m_head(0), m_tail(0)
+        {
+            m_capacity = 1;
+            while (m_capacity < capacity)
+            {
+                m_capacity <<= 1;
+            }
+            m_buffer = new uint8_t[m_capacity];
+        }
+
+        ~SpscByteRing()
+        {
+            delete[] m_buffer;
+        }
+
+        /** @brief Write len bytes, return false without writing anything if there is not enough space (producer only) */
+
+        bool write(const uint8_t * data, std::size_t len)
+        {
+            std::size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (m_capacity - (tail - m_head.load(std::memory_order_acquire)) < len)
+            {
+                return false;
+            }
+
+            std::size_t pos   = tail & (m_capacity - 1);
+            std::size_t first = std::min(len, m_capacity - pos);                // up to end of buffer, then wrap
+            memcpy(m_buffer + pos, data, first);
+            memcpy(m_buffer, data + first, len - first);
+
+            m_tail.store(tail + len, std::memory_order_release);
+
+            return true;
+        }
+
+        /** @brief Return contiguous readable span length, span is not released (consumer only) */
+
+        std::size_t peek(const uint8_t ** span)
+        {
+            std::size_t head = m_head.load(std::memory_order_relaxed);
+            std::size_t len  = m_tail.load(std::memory_order_acquire) - head;
+            std::size_t pos  = head & (m_capacity - 1);
+
+            *span = m_buffer + pos;
+
+            return std::min(len, m_capacity - pos);
+        }
+
+        /** @brief Release len bytes previously peeked (consumer only) */
+
+        void consume(std::size_t len)
+        {
+            m_head.store(m_head.load(std::memory_order_relaxed) + len, std::memory_order_release);
+        }
+
+        /** @brief Bytes count, only a hint when called while the other thread is running */
+
+        std::size_t size() const
+        {
+            return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+        }
+
+        std::size_t capacity() const
+        {
+            return m_capacity;
+        }
+
+    private:
+        uint8_t * m_buffer;                                                     ///< Bytes ring
+        std::size_t m_capacity;                                                 ///< Ring length, power of 2
+        std::atomic<std::size_t> m_head;                                        ///< Next byte to read, written by consumer
+        char m_padding[64];                                                     ///< Keep head and tail in different cache lines
+        std::atomic<std::size_t> m_tail;                                        ///< Next byte to write, written by producer
+    };
+
+};
+
+#endif /* SPSC_QUEUE_H */
@@ -0,0 +1,203 @@
+/*
+ *  tetra-kit
+ *  Copyright (C) 2020  LarryTh <dev@logami.fr>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef STAGE_STATS_H
+#define STAGE_STATS_H
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+
+namespace Tetra {
+
+    /** @brief Monotonic clock in ns for stage latencies */
+
+    inline uint64_t stageClockNs()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /** @brief Pick one call out of SAMPLE_PERIOD for latency measurement */
+
+    class StageSampler {
+    public:
+        static const uint32_t SAMPLE_PERIOD = 32;                               ///< Calls per latency sample, power of 2
+
+        StageSampler() : m_count(0) {}
+
+        /** @brief Return the start time when this call is sampled, 0 otherwise */
+
+        uint64_t start()
+        {
+            return ((m_count++ & (SAMPLE_PERIOD - 1)) == 0) ? stageClockNs() : 0;
+        }
+
+    private:
+        uint32_t m_count;                                                       ///< Calls counter
+    };
+
+    /**
+     * @brief Processing stage calls counter and latency histogram
+     *
+     * Calls are always counted, latency is only measured once every StageSampler::SAMPLE_PERIOD
+     * calls so the clock cost stays negligible. Histogram bucket k counts latencies in
+     * [2^k, 2^(k+1)) ns.
+     *
+     * Stats have a single writer, the thread running the stage, which updates counters with
+     * relaxed loads and stores: there is no lock nor read-modify-write, and any thread can
+     * read them while the stage runs (values may then be one sample late).
+     *
+     */
+
+    class StageStats {
+    public:
+        static const std::size_t BUCKETS_COUNT = 32;                            ///< Histogram buckets, last one holds latencies above 2 s
+
+        StageStats() : m_calls(0), m_samples(0), m_totalNs(0), m_maxNs(0)
+        {
+            for (std::size_t idx = 0; idx < BUCKETS_COUNT; idx++)
+            {
+                m_buckets[idx].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        /** @brief Return the start time when this call is sampled, 0 otherwise (writer only) */
+
+        uint64_t start()
+        {
+            return m_sampler.start();
+        }
+
+        /** @brief Count a call started at startNs, latency is recorded if the call was sampled (writer only) */
+
+        void record(const uint64_t startNs)
+        {
+            increment(m_calls, 1);
+
+            if (startNs == 0)
+            {
+                return;
+            }
+
+            uint64_t ns = stageClockNs() - startNs;
+            std::size_t bucket = (ns > 1) ? (std::size_t)(63 - __builtin_clzll(ns)) : 0;
+            if (bucket >= BUCKETS_COUNT)
+            {
+                bucket = BUCKETS_COUNT - 1;
+            }
+
+            increment(m_samples, 1);
+            increment(m_totalNs, ns);
+            increment(m_buckets[bucket], 1);
+            if (ns > m_maxNs.load(std::memory_order_relaxed))
+            {
+                m_maxNs.store(ns, std::memory_order_relaxed);
+            }
+        }
+
+        /** @brief Stats snapshot, several stages running the same code on different threads can be summed up */
+
+        struct Snapshot {
+            uint64_t calls;                                                     ///< Calls count
+            uint64_t samples;                                                   ///< Latency samples count
+            uint64_t totalNs;                                                   ///< Sampled latencies sum
+            uint64_t maxNs;                                                     ///< Highest sampled latency
+            uint64_t buckets[BUCKETS_COUNT];                                    ///< Latency histogram
+
+            Snapshot() : calls(0), samples(0), totalNs(0), maxNs(0)
+            {
+                for (std::size_t idx = 0; idx < BUCKETS_COUNT; idx++)
+                {
+                    buckets[idx] = 0;
+                }
+            }
+
+            uint64_t averageNs() const
+            {
+                return (samples > 0) ? totalNs / samples : 0;
+            }
+
+            /** @brief Upper bound of the bucket holding given percentile of samples, at most maxNs */
+
+            uint64_t percentileNs(const uint32_t percent) const
+            {
+                uint64_t count = 0;
+
+                for (std::size_t idx = 0; idx < BUCKETS_COUNT; idx++)
+                {
+                    count += buckets[idx];
+                    if ((count > 0) && (count * 100 >= samples * percent))
+                    {
+                        uint64_t bound = ((uint64_t)2 << idx) - 1;
+                        return (bound < maxNs) ? bound : maxNs;
+                    }
+                }
+
+                return 0;
+            }
+        };
+
+        /** @brief Add stats to snapshot (any thread) */
+
+        void addTo(Snapshot * res) const
+        {
+            res->calls   += m_calls.load(std::memory_order_relaxed);
+            res->samples += m_samples.load(std::memory_order_relaxed);
+            res->totalNs += m_totalNs.load(std::memory_order_relaxed);
+
+            uint64_t maxNs = m_maxNs.load(std::memory_order_relaxed);
+            if (maxNs > res->maxNs)
+            {
+                res->maxNs = maxNs;
+            }
+
+            for (std::size_t idx = 0; idx < BUCKETS_COUNT; idx++)
+            {
+                res->buckets[idx] += m_buckets[idx].load(std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        static void increment(std::atomic<uint64_t> & counter, const uint64_t val)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + val, std::memory_order_relaxed); // single writer, no RMW required
+        }
+
+        StageSampler m_sampler;                                                 ///< Latency sampling, writer only
+        std::atomic<uint64_t> m_calls;                                          ///< Calls count
+        std::atomic<uint64_t> m_samples;                                        ///< Latency samples count
+        std::atomic<uint64_t> m_totalNs;                                        ///< Sampled latencies sum
+        std::atomic<uint64_t> m_maxNs;                                          ///< Highest sampled latency
+        std::atomic<uint64_t> m_buckets[BUCKETS_COUNT];                         ///< Latency histogram
+    };
+
+    /** @brief Scoped stage timing, the call is recorded on destruction */
+
+    class StageTimer {
+    public:
+        StageTimer(StageStats & stats) : m_stats(stats), m_startNs(stats.start()) {}
+        ~StageTimer() { m_stats.record(m_startNs); }
+
+    private:
+        StageStats & m_stats;                                                   ///< Stage stats
+        const uint64_t m_startNs;                                               ///< Start time, 0 when not sampled
+    };
+
+};
+
+#endif /* STAGE_STATS_H */
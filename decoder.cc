@@ -2,14 +2,21 @@
 
 using namespace Tetra;
 
+const std::size_t TetraDecoder::FRAME_LEN;                                      // storage for the constants bound to std::min references
+const std::size_t TetraDecoder::BUFFER_LEN;
+const std::size_t TetraDecoder::BLOCK_LEN;
+
 /**
  * @brief Tetra decoder
  *
  */
 
-TetraDecoder::TetraDecoder(int socketFd, bool bRemoveFillBits, const LogLevel logLevel, bool bEnableWiresharkOutput)
+TetraDecoder::TetraDecoder(int socketFd, bool bRemoveFillBits, const LogLevel logLevel, bool bEnableWiresharkOutput, std::size_t macWorkersCount, bool bDeltaMode, const MacFilter & macFilter, uint32_t statsPeriod, RecordOutput * recordOutput, CaptureWriter * captureWriter, VoiceOutput * voiceOutput)
 {
     m_socketFd = socketFd;
+    m_recordOutput = recordOutput;
+    m_captureWriter = captureWriter;
+    m_voiceOutput   = voiceOutput;
 
     m_log       = new Log(logLevel);
 
@@ -32,12 +39,42 @@ TetraDecoder::TetraDecoder(int socketFd, bool bRemoveFillBits, const LogLevel lo
         m_wireMsg = NULL;
     }
 
-    m_mac    = new Mac(m_log, m_report, m_tetraCell, m_uPlane, m_llc, m_mle, m_wireMsg, bRemoveFillBits);
+    m_mac    = new Mac(m_log, m_report, m_tetraCell, m_uPlane, m_llc, m_mle, m_wireMsg, bRemoveFillBits, bDeltaMode, macFilter, m_recordOutput, m_voiceOutput, &m_linkQuality);
+
+    m_macPipeline = NULL;
+    if (macWorkersCount > 0)
+    {
+        m_macPipeline = new MacPipeline(m_log, m_mac, m_tetraCell, macWorkersCount);
+    }
+
+    m_normalTrainingSeq1      = packPattern(NORMAL_TRAINING_SEQ_1);
+    m_normalTrainingSeq2      = packPattern(NORMAL_TRAINING_SEQ_2);
+    m_normalTrainingSeq3Begin = packPattern(NORMAL_TRAINING_SEQ_3_BEGIN);
+    m_normalTrainingSeq3End   = packPattern(NORMAL_TRAINING_SEQ_3_END);
+    m_syncTrainingSeq         = packPattern(SYNC_TRAINING_SEQ);
 
-    m_frame.clear();
+    memset(m_burst,           0, sizeof(m_burst));
+    memset(m_softFrameBuffer, 0, sizeof(m_softFrameBuffer));
+    memset(m_packedBuffer,    0, sizeof(m_packedBuffer));
+    m_rxCount    = 0;
+    m_frameStart = 0;
+    m_frameCount = 0;
+    m_bSoftInput = false;
+
+    m_bAdaptiveSync  = false;
+    m_bBurstAccepted = false;
 
     m_bIsSynchronized = false;
     m_syncBitCounter  = 0;
+
+    m_statsPeriodNs = (uint64_t)statsPeriod * 1000000000;
+    m_statsLastNs   = stageClockNs();
+
+    m_snapshotPeriodNs = 0;
+    m_snapshotLastNs   = 0;
+
+    m_lastRxNs     = 0;
+    m_bIdleFlushed = false;
 }
 
 /**
@@ -47,6 +84,17 @@ TetraDecoder::TetraDecoder(int socketFd, bool bRemoveFillBits, const LogLevel lo
 
 TetraDecoder::~TetraDecoder()
 {
+    if (m_macPipeline)
+    {
+        delete m_macPipeline;                                                   // deliver bursts in flight before MAC is deleted
+        m_macPipeline = NULL;
+    }
+
+    if (!m_snapshotFilename.empty())
+    {
+        saveSnapshot();                                                         // last state for next start
+    }
+
     delete m_mac;
     delete m_uPlane;
     delete m_llc;
@@ -61,6 +109,63 @@ TetraDecoder::~TetraDecoder()
     delete m_wireMsg;
 }
 
+/**
+ * @brief Warm start from snapshot file if it exists, then save snapshot to it every period seconds and on destruction
+ *
+ * Must be called before any data is received.
+ *
+ * @return true if cell state was restored
+ *
+ */
+
+bool TetraDecoder::enableSnapshot(const std::string & filename, uint32_t period)
+{
+    m_snapshotFilename = filename;
+    m_snapshotPeriodNs = (uint64_t)period * 1000000000;
+    m_snapshotLastNs   = stageClockNs();
+
+    MacSnapshot snapshot;
+    if (!snapshot.load(filename))
+    {
+        printf("No valid snapshot '%s', waiting for SYNC\n", filename.c_str());
+        return false;
+    }
+
+    uint64_t now = MacSnapshot::currentTimeNs();
+    m_mac->restore(snapshot, now);
+
+    TetraTime time = m_mac->getTime();
+    printf("Warm start from snapshot '%s' (%.1f s old): MCC/MNC = %u/%u ColorCode = %u, TN/FN/MN = %u/%u/%u\n",
+           filename.c_str(), (now > snapshot.wallClockNs) ? (double)(now - snapshot.wallClockNs) * 1e-9 : 0.0,
+           snapshot.mcc, snapshot.mnc, snapshot.colorCode, time.tn, time.fn, time.mn);
+
+    return true;
+}
+
+/**
+ * @brief Save cell state snapshot, nothing is written until a SYNC has been received
+ *
+ */
+
+void TetraDecoder::saveSnapshot()
+{
+    MacSnapshot snapshot;
+    if (!m_mac->snapshot(&snapshot))
+    {
+        return;
+    }
+
+    if (m_macPipeline)
+    {
+        snapshot.time = m_macPipeline->receivedTime();                          // time of received data, not of delivered bursts
+    }
+
+    if (!snapshot.save(m_snapshotFilename))
+    {
+        fprintf(stderr, "Couldn't write snapshot '%s'\n", m_snapshotFilename.c_str());
+    }
+}
+
 /**
  * @brief Reset the synchronizer
  *
@@ -74,6 +179,33 @@ void TetraDecoder::resetSynchronizer()
     m_syncBitCounter  = FRAME_LEN * 50;                                         // allow 50 missing frames (in bits unit)
 }
 
+/**
+ * @brief Adapt burst acceptance to the link quality
+ *
+ * Once the bit error rate estimate is warmed up, a burst is accepted when the errors count
+ * of its training sequence and extended training sequence is within LinkQuality::threshold()
+ * instead of FIXED_BURST_THRESHOLD training sequence errors: bursts are rejected before
+ * channel decoding on good channels as soon as they are unlikely, and still accepted on
+ * weak ones. An accepted burst on a burst boundary also keeps synchronization, as a burst
+ * candidate does.
+ *
+ */
+
+void TetraDecoder::enableAdaptiveSync()
+{
+    m_bAdaptiveSync = true;
+}
+
+/**
+ * @brief Return training sequences error statistics, the estimated bit error rate of the carrier
+ *
+ */
+
+const LinkQuality & TetraDecoder::linkQuality() const
+{
+    return m_linkQuality;
+}
+
 /**
  * @brief Process a received symbol.
  *
@@ -88,54 +220,509 @@ void TetraDecoder::resetSynchronizer()
 
 bool TetraDecoder::rxSymbol(uint8_t sym)
 {
-    m_frame.push_back(sym);                                                     // insert symbol at buffer end
+    return rxBlock(sym & 1, NULL, 1) > 0;
+}
 
-    if (m_frame.size() < FRAME_LEN)                                             // not enough data to process
+/**
+ * @brief Process a received soft symbol.
+ *
+ * Soft symbol is a signed log-likelihood ratio, positive for bit 1, negative for bit 0
+ * and 0 for an erased bit. Synchronization runs on the hard decision, channel decoding
+ * on soft symbols.
+ *
+ * @return true if frame (burst) found, false otherwise
+ *
+ */
+
+bool TetraDecoder::rxSoftSymbol(int8_t sym)
+{
+    uint64_t bit = sym > 0 ? 1 : 0;
+
+    return rxBlock(bit, &sym, 1) > 0;
+}
+
+/**
+ * @brief Process a buffer of received symbols, same as calling rxSymbol for each of them
+ *
+ * @return Number of frames (bursts) found
+ *
+ */
+
+std::size_t TetraDecoder::rxSymbols(const uint8_t * syms, std::size_t len)
+{
+    std::size_t found = 0;
+
+    for (std::size_t pos = 0; pos < len; pos += BLOCK_LEN)
     {
-        return 0;
+        std::size_t count = std::min(BLOCK_LEN, len - pos);
+        uint64_t bits = 0;
+        for (std::size_t idx = 0; idx < count; idx++)
+        {
+            bits |= (uint64_t)(syms[pos + idx] & 1) << idx;
+        }
+
+        found += rxBlock(bits, NULL, count);
     }
 
-    bool frameFound = false;
-    uint32_t scoreBegin = patternAtPositionScore(m_frame, NORMAL_TRAINING_SEQ_3_BEGIN, 0);
-    uint32_t scoreEnd   = patternAtPositionScore(m_frame, NORMAL_TRAINING_SEQ_3_END, 500);
+    return found;
+}
+
+/**
+ * @brief Process a buffer of received soft symbols, same as calling rxSoftSymbol for each of them
+ *
+ * @return Number of frames (bursts) found
+ *
+ */
 
-    if ((scoreBegin == 0) && (scoreEnd < 2))                                    // frame (burst) is matched and can be processed
+std::size_t TetraDecoder::rxSoftSymbols(const int8_t * syms, std::size_t len)
+{
+    std::size_t found = 0;
+
+    for (std::size_t pos = 0; pos < len; pos += BLOCK_LEN)
     {
-        frameFound = true;
-        resetSynchronizer();                                                    // reset missing sync synchronizer
+        std::size_t count = std::min(BLOCK_LEN, len - pos);
+        uint64_t bits = 0;
+        for (std::size_t idx = 0; idx < count; idx++)
+        {
+            bits |= (uint64_t)(syms[pos + idx] > 0 ? 1 : 0) << idx;             // hard decision for synchronization
+        }
+
+        found += rxBlock(bits, syms + pos, count);
     }
 
-    bool clearedFlag = false;
+    return found;
+}
+
+/**
+ * @brief Process a buffer of packed bits (first bit in LSB), same as calling rxSymbol for each bit
+ *
+ * Bytes are gathered 8 at a time into the packed history word, bits are never unpacked
+ * except for bursts sent to lower MAC.
+ *
+ * @return Number of frames (bursts) found
+ *
+ */
+
+std::size_t TetraDecoder::rxPackedSymbols(const uint8_t * data, std::size_t len)
+{
+    std::size_t found = 0;
+
+    for (std::size_t pos = 0; pos < len; pos += BLOCK_LEN / 8)
+    {
+        std::size_t count = std::min(BLOCK_LEN / 8, len - pos);
+        uint64_t bits = 0;
+        for (std::size_t cnt = 0; cnt < count; cnt++)
+        {
+            bits |= (uint64_t)data[pos + cnt] << (cnt * 8);                     // first bit in LSB of both
+        }
+
+        found += rxBlock(bits, NULL, count * 8);
+    }
+
+    return found;
+}
+
+/**
+ * @brief Process a received buffer in given format
+ *
+ * @return Number of frames (bursts) found
+ *
+ */
+
+std::size_t TetraDecoder::rxData(const uint8_t * data, std::size_t len, RxFormat format)
+{
+    uint64_t now = stageClockNs();
+    runHousekeeping(now);
+    m_lastRxNs     = now;
+    m_bIdleFlushed = false;
+
+    if (m_captureWriter)
+    {
+        m_captureWriter->write(data, len);                                      // before decoding so bursts are indexed in the chunk holding their end
+    }
 
-    if (frameFound || (m_bIsSynchronized && ((m_syncBitCounter % 510) == 0)))   // the frame can be processed either by presence of training sequence, either by synchronised and still allowed missing frames
+    switch (format)
     {
-        m_mac->incrementTn();
-        processFrame();
+    case RX_FORMAT_PACKED:
+        return rxPackedSymbols(data, len);
 
-        // frame has been processed, so clear it
-        m_frame.clear();
+    case RX_FORMAT_SOFT:
+        return rxSoftSymbols((const int8_t *)data, len);
 
-        // set flag to prevent erasing first bit in frame
-        clearedFlag = true;
+    default:
+        return rxSymbols(data, len);
     }
+}
+
+/**
+ * @brief Periodic tasks to be called by a timer while no data is received
+ *
+ * Stats, snapshot and output periods keep running on a silent carrier. After IDLE_FLUSH_NS
+ * without data, bursts in flight and pending records are flushed once, and reassemblies
+ * are dropped when the carrier stays silent longer than the defragmenter timeout.
+ *
+ */
 
-    m_syncBitCounter--;
+void TetraDecoder::housekeeping()
+{
+    uint64_t now = stageClockNs();
+    runHousekeeping(now);
 
-    if (m_syncBitCounter <= 0)
+    if ((m_lastRxNs == 0) || (now - m_lastRxNs < IDLE_FLUSH_NS))
     {
-        // synchronization is lost
-        printf("* synchronization lost\n");
-        m_bIsSynchronized  = false;
-        m_syncBitCounter = 0;
+        return;
     }
 
-    if (!clearedFlag)
+    if (!m_bIdleFlushed)
     {
-        // remove first symbol from buffer to make space for next one
-        m_frame.erase(m_frame.begin());
+        flush();
+        m_bIdleFlushed = true;
     }
 
-    return frameFound;
+    m_mac->expireDefrag(now - m_lastRxNs);                                      // pipeline is flushed, upper MAC is idle
+}
+
+/**
+ * @brief Report stats, save snapshot and poll outputs when their period elapsed
+ *
+ */
+
+void TetraDecoder::runHousekeeping(const uint64_t now)
+{
+    if ((m_statsPeriodNs > 0) && (now - m_statsLastNs >= m_statsPeriodNs))
+    {
+        reportStats();
+        m_statsLastNs = now;
+    }
+
+    if ((m_snapshotPeriodNs > 0) && (now - m_snapshotLastNs >= m_snapshotPeriodNs))
+    {
+        saveSnapshot();
+        m_snapshotLastNs = now;
+    }
+
+    if (m_recordOutput)
+    {
+        m_recordOutput->poll();                                                 // send records held longer than the flush interval
+    }
+
+    if (m_voiceOutput)
+    {
+        m_voiceOutput->poll();                                                  // end idle calls
+    }
+}
+
+/**
+ * @brief Add stage stats to report as <name>_calls, _avg_ns, _p50_ns, _p99_ns and _max_ns
+ *
+ * Latencies are sampled, see StageStats
+ *
+ */
+
+static void reportStage(Report * report, const std::string & name, const StageStats::Snapshot & stats)
+{
+    report->add(name + "_calls",  stats.calls);
+    report->add(name + "_avg_ns", stats.averageNs());
+    report->add(name + "_p50_ns", stats.percentileNs(50));
+    report->add(name + "_p99_ns", stats.percentileNs(99));
+    report->add(name + "_max_ns", stats.maxNs);
+}
+
+/**
+ * @brief Send decoder counters and stage latencies as one JSON report
+ *
+ * Lower MAC stages are summed up over the ordered stage and the pipeline workers. CRC
+ * counters are only reported for logical channels which received blocks.
+ *
+ */
+
+void TetraDecoder::reportStats()
+{
+    MacAddress macAddress;
+    memset(&macAddress, 0, sizeof(macAddress));
+
+    m_report->start("STATS", "DECODER", m_mac->getTime(), macAddress);
+
+    StageStats::Snapshot syncSearch;
+    m_syncSearchStats.addTo(&syncSearch);
+    reportStage(m_report, "sync_search", syncSearch);
+
+    for (int idx = 0; idx < LowerMac::STAGES_COUNT; idx++)
+    {
+        LowerMac::Stage stage = (LowerMac::Stage)idx;
+
+        StageStats::Snapshot snapshot;
+        m_mac->addLowerMacStats(stage, &snapshot);
+        if (m_macPipeline)
+        {
+            m_macPipeline->addLowerMacStats(stage, &snapshot);
+        }
+        reportStage(m_report, LowerMac::stageName(stage), snapshot);
+    }
+
+    for (int idx = 0; idx < Mac::STAGES_COUNT; idx++)
+    {
+        Mac::Stage stage = (Mac::Stage)idx;
+
+        StageStats::Snapshot snapshot;
+        m_mac->stageStats(stage).addTo(&snapshot);
+        reportStage(m_report, Mac::stageName(stage), snapshot);
+    }
+
+    StageStats::Snapshot defrag;
+    m_mac->defragStats().addTo(&defrag);
+    reportStage(m_report, "defrag", defrag);
+
+    Mac::Stats stats = m_mac->stats();
+
+    for (std::size_t channel = 0; channel < Mac::LOGICAL_CHANNELS_COUNT; channel++)
+    {
+        if (stats.crcValid[channel] + stats.crcInvalid[channel] > 0)
+        {
+            std::string name = macLogicalChannelName((int)channel);
+            m_report->add("crc_valid_"   + name, stats.crcValid[channel]);
+            m_report->add("crc_invalid_" + name, stats.crcInvalid[channel]);
+        }
+    }
+
+    m_report->add("bursts_accepted",     m_linkQuality.acceptedCount());
+    m_report->add("bursts_rejected",     m_linkQuality.rejectedCount());
+    m_report->add("ber_ppm",             (uint64_t)(m_linkQuality.ber() * 1000000.0));
+    m_report->add("path_metric_milli",   (uint64_t)(m_linkQuality.pathMetric() * 1000.0));
+    m_report->add("aach_corrected_bits", stats.aachCorrectedBits);
+    m_report->add("delta_skipped",       stats.deltaSkipped);
+    m_report->add("defrag_started",      stats.defrag.started);
+    m_report->add("defrag_completed",    stats.defrag.completed);
+    m_report->add("defrag_timed_out",    stats.defrag.timedOut);
+    m_report->add("defrag_failed",       stats.defrag.failed);
+
+    m_report->send();
+}
+
+/**
+ * @brief Return number of unchanged broadcast PDU skipped in delta mode
+ *
+ */
+
+uint64_t TetraDecoder::deltaSkippedCount()
+{
+    return m_mac->deltaSkippedCount();
+}
+
+/**
+ * @brief Return MAC counters since start, bursts still decoded by the pipeline are not counted, see flush()
+ *
+ */
+
+Mac::Stats TetraDecoder::macStats()
+{
+    return m_mac->stats();
+}
+
+/**
+ * @brief Deliver bursts in flight in the pipeline to upper MAC and send pending binary records
+ *
+ */
+
+void TetraDecoder::flush()
+{
+    if (m_macPipeline)
+    {
+        m_macPipeline->flush();
+    }
+
+    if (m_recordOutput)
+    {
+        m_recordOutput->flush();
+    }
+}
+
+/**
+ * @brief Process a block of at most BLOCK_LEN received symbols, bit idx of bits is symbol idx
+ *
+ * Symbols are stored in the packed (and soft mirrored) history buffers, then all burst candidates
+ * of the block are found at once with bitsliced comparisons. The per symbol synchronizer
+ * then jumps from an event to the next one:
+ *   - burst window is full again after a processed burst
+ *   - candidate found (q11..q22 exact at window start, q1..q10 with less than 2 errors at end)
+ *   - synchronized and missing frame counter on a burst boundary
+ *   - synchronization lost
+ *
+ * @return Number of frames (bursts) found
+ *
+ */
+
+std::size_t TetraDecoder::rxBlock(uint64_t bits, const int8_t * softSyms, std::size_t len)
+{
+    const uint64_t base = m_rxCount;
+
+    // store symbols
+    if (softSyms != NULL)
+    {
+        for (std::size_t idx = 0; idx < len; idx++)
+        {
+            std::size_t pos = (std::size_t)((base + idx) & (BUFFER_LEN - 1));
+            int8_t val = softSyms[idx] == -128 ? -127 : softSyms[idx];          // keep symmetric range so descrambling can negate
+            m_softFrameBuffer[pos]              = val;
+            m_softFrameBuffer[pos + BUFFER_LEN] = val;
+        }
+
+        m_bSoftInput = true;
+    }
+
+    uint64_t mask     = len < 64 ? ((uint64_t)1 << len) - 1 : ~(uint64_t)0;
+    uint64_t packed   = bits & mask;
+    std::size_t word  = (std::size_t)((base >> 6) & (BUFFER_LEN / 64 - 1));
+    std::size_t shift = (std::size_t)(base & 63);
+    m_packedBuffer[word] = (m_packedBuffer[word] & ~(mask << shift)) | (packed << shift);
+    if ((shift > 0) && (shift + len > 64))
+    {
+        std::size_t next = (word + 1) & (BUFFER_LEN / 64 - 1);
+        m_packedBuffer[next] = (m_packedBuffer[next] & ~(mask >> (64 - shift))) | (packed >> (64 - shift));
+    }
+
+    m_rxCount += len;
+
+    uint64_t startNs = m_syncSearchStats.start();
+    uint64_t candidates = burstCandidates(base) & mask;                         // bit idx set when burst window ending with symbol idx is a candidate
+    m_syncSearchStats.record(startNs);
+    std::size_t found = 0;
+    std::size_t idx = 0;
+
+    while (idx < len)
+    {
+        if (m_frameCount + 1 < FRAME_LEN)                                       // not enough data to process
+        {
+            std::size_t fill = std::min(FRAME_LEN - 1 - m_frameCount, len - idx);
+            m_frameCount += fill;
+            idx += fill;
+            continue;
+        }
+
+        // symbols until next event only decrement the synchronization counter
+        uint64_t skip = len - idx;
+        if (candidates >> idx)
+        {
+            skip = std::min(skip, (uint64_t)__builtin_ctzll(candidates >> idx));
+        }
+        if (m_bIsSynchronized)
+        {
+            skip = std::min(skip, m_syncBitCounter % FRAME_LEN);
+        }
+        if (m_syncBitCounter > 0)
+        {
+            skip = std::min(skip, m_syncBitCounter - 1);
+        }
+
+        if (skip > 0)
+        {
+            m_syncBitCounter -= skip;
+            idx += (std::size_t)skip;
+            continue;
+        }
+
+        // burst window ending with symbol idx
+        m_frameStart = base + idx + 1 - FRAME_LEN;
+
+        bool frameFound = (candidates >> idx) & 1;
+        if (frameFound)                                                         // frame (burst) is matched and can be processed
+        {
+            resetSynchronizer();                                                // reset missing sync synchronizer
+            found++;
+        }
+
+        bool clearedFlag = false;
+
+        if (frameFound || (m_bIsSynchronized && ((m_syncBitCounter % 510) == 0)))   // the frame can be processed either by presence of training sequence, either by synchronised and still allowed missing frames
+        {
+            processFrame();
+
+            if (!frameFound && m_bAdaptiveSync && m_bBurstAccepted && m_linkQuality.isWarmedUp())
+            {
+                resetSynchronizer();                                            // burst found where expected
+            }
+
+            // frame has been processed, so clear it
+            m_frameCount = 0;
+
+            // set flag to prevent erasing first bit in frame
+            clearedFlag = true;
+        }
+
+        m_syncBitCounter--;
+
+        if (m_syncBitCounter <= 0)
+        {
+            // synchronization is lost
+            if (m_macPipeline)
+            {
+                m_macPipeline->flush();                                         // keep output in order with bursts in flight
+            }
+            printf("* synchronization lost\n");
+            m_bIsSynchronized  = false;
+            m_syncBitCounter = 0;
+        }
+
+        if (!clearedFlag)
+        {
+            // remove first symbol from window to make space for next one
+            m_frameCount = FRAME_LEN - 1;
+        }
+
+        idx++;
+    }
+
+    return found;
+}
+
+/**
+ * @brief Return 64 received bits starting at position from packed buffer
+ *
+ */
+
+uint64_t TetraDecoder::packedBits(uint64_t position)
+{
+    std::size_t word  = (std::size_t)((position >> 6) & (BUFFER_LEN / 64 - 1));
+    std::size_t shift = (std::size_t)(position & 63);
+
+    uint64_t res = m_packedBuffer[word] >> shift;
+    if (shift > 0)
+    {
+        res |= m_packedBuffer[(word + 1) & (BUFFER_LEN / 64 - 1)] << (64 - shift);
+    }
+
+    return res;
+}
+
+/**
+ * @brief Find burst candidates for the 64 burst windows ending at position
+ *
+ * Bit idx of the result is set when the window ending with symbol position + idx
+ * starts with q11..q22 without error and ends with q1..q10 with less than 2 errors.
+ * Each pattern element is compared for the 64 windows at once.
+ *
+ */
+
+uint64_t TetraDecoder::burstCandidates(uint64_t position)
+{
+    uint64_t beginErrors = 0;
+    for (std::size_t k = 0; k < NORMAL_TRAINING_SEQ_3_BEGIN.size(); k++)
+    {
+        uint64_t ref = ((m_normalTrainingSeq3Begin >> k) & 1) ? ~(uint64_t)0 : 0;
+        beginErrors |= packedBits(position - (FRAME_LEN - 1) + k) ^ ref;
+    }
+
+    uint64_t oneError = 0;
+    uint64_t twoErrors = 0;
+    for (std::size_t k = 0; k < NORMAL_TRAINING_SEQ_3_END.size(); k++)
+    {
+        uint64_t ref = ((m_normalTrainingSeq3End >> k) & 1) ? ~(uint64_t)0 : 0;
+        uint64_t errors = packedBits(position - (FRAME_LEN - 1) + 500 + k) ^ ref;
+        twoErrors |= oneError & errors;
+        oneError  |= errors;
+    }
+
+    return ~beginErrors & ~twoErrors;
 }
 
 /**
@@ -145,14 +732,17 @@ bool TetraDecoder::rxSymbol(uint8_t sym)
 
 void TetraDecoder::printData()
 {
+    unpackBurst();
+    const uint8_t * frame = m_burst;
+
     std::string txt = "";
-    for (int i = 0; i < 12; i++) txt += m_frame[i] == 0 ? "0" : "1";
+    for (int i = 0; i < 12; i++) txt += frame[i] == 0 ? "0" : "1";
 
     txt += " ";
-    for (int i = 12; i < 64; i++) txt += m_frame[i] == 0 ? "0" : "1";
+    for (int i = 12; i < 64; i++) txt += frame[i] == 0 ? "0" : "1";
 
     txt += " ";
-    for (int i = 510 - 11; i < 510; i++) txt += m_frame[i] == 0 ? "0" : "1";
+    for (int i = 510 - 11; i < 510; i++) txt += frame[i] == 0 ? "0" : "1";
 
     printf("%s", txt.c_str());
 }
@@ -164,9 +754,11 @@ void TetraDecoder::printData()
 
 void TetraDecoder::processFrame()
 {
-    uint32_t scoreSync    = patternAtPositionScore(m_frame, SYNC_TRAINING_SEQ,     214);
-    uint32_t scoreNormal1 = patternAtPositionScore(m_frame, NORMAL_TRAINING_SEQ_1, 244);
-    uint32_t scoreNormal2 = patternAtPositionScore(m_frame, NORMAL_TRAINING_SEQ_2, 244);
+    std::size_t start = (std::size_t)(m_frameStart & (BUFFER_LEN - 1));        // burst window in soft mirrored buffer
+
+    uint32_t scoreSync    = patternAtPositionScore(m_syncTrainingSeq,    SYNC_TRAINING_SEQ.size(),     214);
+    uint32_t scoreNormal1 = patternAtPositionScore(m_normalTrainingSeq1, NORMAL_TRAINING_SEQ_1.size(), 244);
+    uint32_t scoreNormal2 = patternAtPositionScore(m_normalTrainingSeq2, NORMAL_TRAINING_SEQ_2.size(), 244);
 
     // soft decision
     uint32_t scoreMin = scoreSync;
@@ -184,32 +776,113 @@ void TetraDecoder::processFrame()
         burstType = NDB_SF;
     }
 
-    if (scoreMin <= 5)
+    // training sequence and extended training sequence q11..q22 + q1..q10 errors
+    uint32_t errors = scoreMin + patternAtPositionScore(m_normalTrainingSeq3Begin, NORMAL_TRAINING_SEQ_3_BEGIN.size(), 0)
+                               + patternAtPositionScore(m_normalTrainingSeq3End,   NORMAL_TRAINING_SEQ_3_END.size(),   500);
+    uint32_t bits   = (uint32_t)((burstType == SB ? SYNC_TRAINING_SEQ.size() : NORMAL_TRAINING_SEQ_1.size()) + NORMAL_TRAINING_SEQ_3_BEGIN.size() + NORMAL_TRAINING_SEQ_3_END.size());
+
+    bool bValidBurst;
+    if (m_bAdaptiveSync && m_linkQuality.isWarmedUp())
+    {
+        bValidBurst = (errors <= m_linkQuality.threshold(bits));
+    }
+    else
+    {
+        bValidBurst = (scoreMin <= FIXED_BURST_THRESHOLD);
+    }
+
+    if (bValidBurst)
+    {
+        m_linkQuality.addBurst(errors, bits);
+    }
+    else
+    {
+        m_linkQuality.rejectBurst();                                            // not worth channel decoding
+    }
+    m_bBurstAccepted = bValidBurst;
+
+    if (m_macPipeline)
+    {
+        // time slot is counted even without valid burst
+        if (bValidBurst)
+        {
+            unpackBurst();
+        }
+
+        m_macPipeline->serviceLowerMac(bValidBurst ? m_burst : NULL, burstType, m_bSoftInput ? m_softFrameBuffer + start : NULL);
+
+        if (m_captureWriter && bValidBurst)
+        {
+            m_captureWriter->addBurst(m_frameStart, m_macPipeline->receivedTime(), burstType);
+        }
+        return;
+    }
+
+    m_mac->incrementTn();
+
+    if (m_captureWriter && bValidBurst)
+    {
+        m_captureWriter->addBurst(m_frameStart, m_mac->getTime(), burstType);
+    }
+
+    if (bValidBurst)
     {
         // valid burst found, send it to MAC
-        m_mac->serviceLowerMac(m_frame, burstType);
+        unpackBurst();
+        m_mac->serviceLowerMac(m_burst, burstType, m_bSoftInput ? m_softFrameBuffer + start : NULL);
     }
 }
 
 /**
- * @brief Return pattern/data comparison errors count at position in data vector
- *
- * @param data      Vector to look in from pattern
- * @param pattern   Pattern to search
- * @param position  Position in vector to start search
+ * @brief Unpack burst window from packed buffer to m_burst, one bit per byte
  *
- * @return Score based on similarity with pattern (differences count between vector and pattern)
+ */
+
+void TetraDecoder::unpackBurst()
+{
+    for (std::size_t pos = 0; pos < FRAME_LEN; pos += 64)
+    {
+        uint64_t word = packedBits(m_frameStart + pos);
+        std::size_t count = std::min((std::size_t)64, FRAME_LEN - pos);
+
+        for (std::size_t idx = 0; idx < count; idx++)
+        {
+            m_burst[pos + idx] = (uint8_t)((word >> idx) & 1);
+        }
+    }
+}
+
+/**
+ * @brief Pack pattern into a word, element k in bit k
  *
  */
 
-uint32_t TetraDecoder::patternAtPositionScore(std::vector<uint8_t> data, std::vector<uint8_t> pattern, std::size_t position)
+uint64_t TetraDecoder::packPattern(const std::vector<uint8_t> & pattern)
 {
-    uint32_t errors = 0;
+    uint64_t res = 0;
 
     for (std::size_t idx = 0; idx < pattern.size(); idx++)
     {
-        errors += (uint32_t)(pattern[idx] ^ data[position + idx]);
+        res |= (uint64_t)(pattern[idx] & 1) << idx;
     }
 
-    return errors;
+    return res;
+}
+
+/**
+ * @brief Return pattern/burst window comparison errors count at position in window
+ *
+ * @param pattern   Packed pattern to search
+ * @param len       Pattern length, up to 64 bits
+ * @param position  Position in burst window to start search
+ *
+ * @return Score based on similarity with pattern (differences count between window and pattern)
+ *
+ */
+
+uint32_t TetraDecoder::patternAtPositionScore(uint64_t pattern, std::size_t len, std::size_t position)
+{
+    uint64_t mask = len < 64 ? ((uint64_t)1 << len) - 1 : ~(uint64_t)0;
+
+    return (uint32_t)__builtin_popcountll((packedBits(m_frameStart + position) ^ pattern) & mask);
 }
@@ -1,6 +1,9 @@
 #ifndef DECODER_H
 #define DECODER_H
 #include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <string>
 #include <vector>
 #include <signal.h>
 #include <unistd.h>
@@ -17,7 +20,9 @@
 #include "common/log.h"
 #include "common/pdu.h"
 #include "common/report.h"
+#include "common/linkquality.h"
 #include "mac/mac.h"
+#include "mac/macpipeline.h"
 #include "uplane/uplane.h"
 #include "llc/llc.h"
 #include "mle/mle.h"
@@ -26,6 +31,9 @@
 #include "mm/mm.h"
 #include "sndcp/sndcp.h"
 #include "wiremsg/wiremsg.h"
+#include "recordoutput.h"
+#include "capture.h"
+#include "voiceoutput.h"
 
 /**
  * @defgroup tetra_common TETRA downlink decoder
@@ -49,10 +57,17 @@ namespace Tetra {
      *  - only decode continuous downlink burst channel
      *  - MAC PDU association not handled - see 23.4.2.3
      *  - LLC fragmentation not handled
-     *  - Viterbi codec is handling string, not optimized
      *
      */
 
+    /** @brief Received data format */
+
+    enum RxFormat {
+        RX_FORMAT_UNPACKED = 0,                                                 ///< 1 bit per byte
+        RX_FORMAT_PACKED   = 1,                                                 ///< 8 bits per byte, first bit in LSB
+        RX_FORMAT_SOFT     = 2,                                                 ///< 1 signed soft symbol per byte
+    };
+
     /**
      * @brief TETRA downlink decoder class
      *
@@ -64,13 +79,26 @@ namespace Tetra {
 
     class TetraDecoder {
     public:
-        TetraDecoder(int socketFd, bool bRemoveFillBits, const LogLevel logLevel, bool bEnableWiresharkOutput);
+        TetraDecoder(int socketFd, bool bRemoveFillBits, const LogLevel logLevel, bool bEnableWiresharkOutput, std::size_t macWorkersCount = 0, bool bDeltaMode = false, const MacFilter & macFilter = MacFilter(), uint32_t statsPeriod = 0, RecordOutput * recordOutput = NULL, CaptureWriter * captureWriter = NULL, VoiceOutput * voiceOutput = NULL);
         ~TetraDecoder();
 
         void printData();
         void processFrame();
         void resetSynchronizer();
         bool rxSymbol(uint8_t sym);
+        bool rxSoftSymbol(int8_t sym);
+        std::size_t rxSymbols(const uint8_t * syms, std::size_t len);
+        std::size_t rxSoftSymbols(const int8_t * syms, std::size_t len);
+        std::size_t rxPackedSymbols(const uint8_t * data, std::size_t len);
+        std::size_t rxData(const uint8_t * data, std::size_t len, RxFormat format);
+        uint64_t deltaSkippedCount();
+        Mac::Stats macStats();
+        void flush();
+        void housekeeping();
+        void reportStats();
+        bool enableSnapshot(const std::string & filename, uint32_t period);
+        void enableAdaptiveSync();
+        const LinkQuality & linkQuality() const;
 
     private:
         // 9.4.4.3.2 Normal training sequence
@@ -82,7 +110,20 @@ namespace Tetra {
         // 9.4.4.3.4 Synchronisation training sequence
         const std::vector<uint8_t> SYNC_TRAINING_SEQ = {1,1,0,0,0,0,0,1,1,0,0,1,1,1,0,0,1,1,1,0,1,0,0,1,1,1,0,0,0,0,0,1,1,0,0,1,1,1}; // y1..y38
 
-        uint32_t patternAtPositionScore(std::vector<uint8_t> data, std::vector<uint8_t> pattern, std::size_t position);
+        uint64_t packPattern(const std::vector<uint8_t> & pattern);
+        uint64_t packedBits(uint64_t position);
+        uint64_t burstCandidates(uint64_t position);
+        uint32_t patternAtPositionScore(uint64_t pattern, std::size_t len, std::size_t position);
+        std::size_t rxBlock(uint64_t bits, const int8_t * softSyms, std::size_t len);
+        void unpackBurst();
+        void saveSnapshot();
+        void runHousekeeping(const uint64_t now);
+
+        uint64_t m_normalTrainingSeq1;                                          ///< NORMAL_TRAINING_SEQ_1 packed, bit k is element k
+        uint64_t m_normalTrainingSeq2;                                          ///< NORMAL_TRAINING_SEQ_2 packed
+        uint64_t m_normalTrainingSeq3Begin;                                     ///< NORMAL_TRAINING_SEQ_3_BEGIN packed
+        uint64_t m_normalTrainingSeq3End;                                       ///< NORMAL_TRAINING_SEQ_3_END packed
+        uint64_t m_syncTrainingSeq;                                             ///< SYNC_TRAINING_SEQ packed
 
         int m_socketFd = 0;                                                     ///< UDP socket to write to
 
@@ -91,6 +132,7 @@ namespace Tetra {
         TetraCell * m_tetraCell;                                                ///< Tetra cell informations and timer
 
         Mac    * m_mac;                                                         ///< MAC layer
+        MacPipeline * m_macPipeline;                                            ///< Lower MAC decoding on worker threads, NULL when decoding inline
         UPlane * m_uPlane;                                                      ///< U-Plane layer
         Llc    * m_llc;                                                         ///< LLC layer
         Mle    * m_mle;                                                         ///< MLE layer
@@ -99,13 +141,41 @@ namespace Tetra {
         Sds    * m_sds;                                                         ///< CMCE/SDS sub layer
         Sndcp  * m_sndcp;                                                       ///< SNDCP layer
         WireMsg * m_wireMsg;                                                    ///< Wireshark output
+        RecordOutput * m_recordOutput;                                          ///< Binary MAC PDU records output, not owned, NULL if disabled
+        CaptureWriter * m_captureWriter;                                        ///< Indexed capture of received data, not owned, NULL if disabled
+        VoiceOutput * m_voiceOutput;                                            ///< TCH/S voice frames output, not owned, NULL if disabled
 
         bool m_bIsSynchronized;                                                 ///< True is program is synchronized with burst
         uint64_t m_syncBitCounter;                                              ///< Synchronization bits counter
 
-        // burst data
-        const std::size_t FRAME_LEN = 510;                                      ///< Burst length in bits
-        std::vector<uint8_t> m_frame;                                           ///< Burst data
+        // burst data, hard bits are only kept packed and unpacked for the bursts sent to lower MAC, soft symbols
+        // are written twice BUFFER_LEN apart so the last FRAME_LEN symbols are always contiguous
+        static const std::size_t FRAME_LEN  = 510;                              ///< Burst length in bits
+        static const std::size_t BUFFER_LEN = 1024;                             ///< Received symbols history length, power of 2 above FRAME_LEN + 64 bits block
+        static const std::size_t BLOCK_LEN  = 64;                               ///< Symbols scanned at once for burst candidates
+        uint8_t  m_burst[FRAME_LEN];                                            ///< Burst window bits unpacked for lower MAC
+        int8_t   m_softFrameBuffer[2 * BUFFER_LEN];                             ///< Received soft symbols mirrored buffer
+        uint64_t m_packedBuffer[BUFFER_LEN / 64];                               ///< Received bits packed, bit (position % 64) of word (position / 64) % 16
+        uint64_t m_rxCount;                                                     ///< Number of received symbols, also position of next one
+        uint64_t m_frameStart;                                                  ///< Position of the burst window being processed
+        std::size_t m_frameCount;                                               ///< Number of symbols in burst window
+        bool m_bSoftInput;                                                      ///< True when receiving soft symbols
+
+        static const uint32_t FIXED_BURST_THRESHOLD = 5;                        ///< Training sequence errors accepted without adaptive sync
+        LinkQuality m_linkQuality;                                              ///< Training sequences error and Viterbi path metric statistics
+        bool m_bAdaptiveSync;                                                   ///< Burst threshold adapted to link quality, accepted bursts keep synchronization
+        bool m_bBurstAccepted;                                                  ///< Last processed burst was accepted
+
+        StageStats m_syncSearchStats;                                           ///< Burst candidates search stats
+        uint64_t m_statsPeriodNs;                                               ///< Stats report period, 0 when disabled
+        uint64_t m_statsLastNs;                                                 ///< Time of last stats report
+        std::string m_snapshotFilename;                                         ///< Cell state snapshot file, empty when disabled
+        uint64_t m_snapshotPeriodNs;                                            ///< Snapshot save period, 0 to save only on destruction
+        uint64_t m_snapshotLastNs;                                              ///< Time of last snapshot save
+
+        static const uint64_t IDLE_FLUSH_NS = 200000000;                        ///< Time without data before pending output is flushed
+        uint64_t m_lastRxNs;                                                    ///< Time of last received data, 0 before first one
+        bool m_bIdleFlushed;                                                    ///< Pending output was flushed since last received data
     };
 
 };
@@ -0,0 +1,258 @@
+#include <cstdio>
+#include <cerrno>
+#include <csignal>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include "eventloop.h"
+
+using namespace Tetra;
+
+/**
+ * @brief Event loop, check isValid()
+ *
+ */
+
+EventLoop::EventLoop()
+{
+    m_bStop    = false;
+    m_epollFd  = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if ((m_epollFd < 0) || (m_wakeupFd < 0) || !addSource(SOURCE_WAKEUP, m_wakeupFd, NULL, NULL))
+    {
+        perror("Couldn't create event loop");
+    }
+}
+
+/**
+ * @brief Destructor, owned descriptors are closed
+ *
+ */
+
+EventLoop::~EventLoop()
+{
+    for (std::size_t idx = 0; idx < m_sources.size(); idx++)
+    {
+        if (m_sources[idx]->type != SOURCE_READER)
+        {
+            close(m_sources[idx]->fd);
+        }
+        delete m_sources[idx];
+    }
+
+    if (m_epollFd >= 0)
+    {
+        close(m_epollFd);
+    }
+}
+
+/**
+ * @brief Return true when the loop was successfully created
+ *
+ */
+
+bool EventLoop::isValid() const
+{
+    return (m_epollFd >= 0) && (m_wakeupFd >= 0);
+}
+
+/**
+ * @brief Register source in epoll
+ *
+ */
+
+bool EventLoop::addSource(SourceType type, int fd, Callback callback, void * arg)
+{
+    if ((m_epollFd < 0) || (fd < 0))
+    {
+        return false;
+    }
+
+    Source * source  = new Source();
+    source->type     = type;
+    source->fd       = fd;
+    source->callback = callback;
+    source->arg      = arg;
+
+    struct epoll_event event;
+    event.events   = EPOLLIN;
+    event.data.ptr = source;
+
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+    {
+        perror("Couldn't add event source");
+        delete source;
+        return false;
+    }
+
+    m_sources.push_back(source);
+
+    return true;
+}
+
+/**
+ * @brief Call callback whenever fd is readable, fd stays owned by the caller and must outlive the loop
+ *
+ */
+
+bool EventLoop::addReader(int fd, Callback callback, void * arg)
+{
+    return addSource(SOURCE_READER, fd, callback, arg);
+}
+
+/**
+ * @brief Call callback every periodMs on a monotonic timerfd
+ *
+ * Expirations missed while a callback was running result in a single call.
+ *
+ */
+
+bool EventLoop::addTimer(uint32_t periodMs, Callback callback, void * arg)
+{
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0)
+    {
+        perror("Couldn't create timer");
+        return false;
+    }
+
+    struct itimerspec spec;
+    spec.it_interval.tv_sec  = periodMs / 1000;
+    spec.it_interval.tv_nsec = (long)(periodMs % 1000) * 1000000;
+    spec.it_value            = spec.it_interval;
+
+    if ((periodMs == 0) || (timerfd_settime(fd, 0, &spec, NULL) != 0) || !addSource(SOURCE_TIMER, fd, callback, arg))
+    {
+        close(fd);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Stop the loop on SIGINT or SIGTERM received through a signalfd
+ *
+ * The signals are blocked in the calling thread, so this must be called before any other
+ * thread is created for them to inherit the mask, otherwise a thread with the signals
+ * unblocked may receive them instead.
+ *
+ */
+
+bool EventLoop::stopOnSignals()
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+
+    if (pthread_sigmask(SIG_BLOCK, &mask, NULL) != 0)
+    {
+        return false;
+    }
+
+    int fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd < 0)
+    {
+        perror("Couldn't create signalfd");
+        pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+        return false;
+    }
+
+    if (!addSource(SOURCE_SIGNAL, fd, NULL, NULL))
+    {
+        close(fd);
+        pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Wait for events and dispatch them until stop() or a stop signal
+ *
+ */
+
+void EventLoop::run()
+{
+    struct epoll_event events[EVENTS_LEN];
+
+    while (!m_bStop)
+    {
+        int count = epoll_wait(m_epollFd, events, EVENTS_LEN, -1);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int idx = 0; (idx < count) && !m_bStop; idx++)
+        {
+            Source * source = (Source *)events[idx].data.ptr;
+
+            switch (source->type)
+            {
+            case SOURCE_READER:
+                source->callback(source->arg);
+                break;
+
+            case SOURCE_TIMER:
+            {
+                uint64_t expirations;
+                if (read(source->fd, &expirations, sizeof(expirations)) == (ssize_t)sizeof(expirations))
+                {
+                    source->callback(source->arg);
+                }
+                break;
+            }
+
+            case SOURCE_SIGNAL:
+            {
+                struct signalfd_siginfo info;
+                if (read(source->fd, &info, sizeof(info)) == (ssize_t)sizeof(info))
+                {
+                    printf("Signal %u received, stopping\n", info.ssi_signo);
+                    m_bStop = true;
+                }
+                break;
+            }
+
+            default:
+            {
+                // reset eventfd, m_bStop is already set, a wakeup already reset is not an error
+                uint64_t val;
+                if ((read(source->fd, &val, sizeof(val)) < 0) && (errno != EAGAIN) && (errno != EINTR))
+                {
+                    perror("Couldn't reset event loop wakeup");
+                }
+                break;
+            }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Request run() to return, the loop wakes up immediately
+ *
+ */
+
+void EventLoop::stop()
+{
+    m_bStop = true;
+
+    uint64_t val = 1;
+    if (write(m_wakeupFd, &val, sizeof(val)) < 0)
+    {
+        perror("Couldn't wake event loop up");
+    }
+}
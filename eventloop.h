@@ -0,0 +1,66 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+#include <cstdint>
+#include <atomic>
+#include <vector>
+
+namespace Tetra {
+
+    /**
+     * @brief epoll event loop multiplexing file descriptors, periodic timers and stop signals
+     *
+     * The loop only wakes up for events: readable descriptors, timerfd expirations and
+     * signalfd signals, so it costs no CPU between events. The process is only idle-quiet
+     * if the threads behind its sources block too, as UdpReceiver and the MacPipeline
+     * workers do. Callbacks run on the thread calling run() and must not block, a reader
+     * callback must drain its descriptor (level triggered). stop() may be called from any
+     * thread or from a callback.
+     *
+     */
+
+    class EventLoop {
+    public:
+        typedef void (*Callback)(void * arg);                                   ///< Event callback, arg is given when adding the source
+
+        EventLoop();
+        ~EventLoop();
+
+        bool isValid() const;
+        bool addReader(int fd, Callback callback, void * arg);
+        bool addTimer(uint32_t periodMs, Callback callback, void * arg);
+        bool stopOnSignals();
+        void run();
+        void stop();
+
+    private:
+        /** @brief Event source types */
+
+        enum SourceType {
+            SOURCE_READER = 0,                                                  ///< Readable descriptor, owned by caller
+            SOURCE_TIMER  = 1,                                                  ///< timerfd, owned
+            SOURCE_SIGNAL = 2,                                                  ///< signalfd stopping the loop, owned
+            SOURCE_WAKEUP = 3,                                                  ///< eventfd written by stop(), owned
+        };
+
+        /** @brief One event source */
+
+        struct Source {
+            SourceType type;                                                    ///< Source type
+            int fd;                                                             ///< Descriptor registered in epoll
+            Callback callback;                                                  ///< Callback, NULL for signal and wakeup
+            void * arg;                                                         ///< Callback argument
+        };
+
+        bool addSource(SourceType type, int fd, Callback callback, void * arg);
+
+        static const int EVENTS_LEN = 16;                                       ///< Events read per epoll_wait call
+
+        int m_epollFd;                                                          ///< epoll instance
+        int m_wakeupFd;                                                         ///< eventfd waking the loop up on stop()
+        std::atomic<bool> m_bStop;                                              ///< Request loop to exit
+        std::vector<Source *> m_sources;                                        ///< Registered sources
+    };
+
+};
+
+#endif /* EVENTLOOP_H */
@@ -0,0 +1,149 @@
+/*
+ *  tetra-kit
+ *  Copyright (C) 2020  LarryTh <dev@logami.fr>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef BLOCK_CODEC_H
+#define BLOCK_CODEC_H
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <algorithm>
+
+namespace Tetra {
+
+    /**
+     * @brief Channel coding of a (K,a) signalling block with compile-time constants - clause 8
+     *
+     * Descrambling, deinterleaving (K,a) - 8.2.4 - and 2/3 depuncturing - 8.2.3.1.3 - are done
+     * in one pass into the mother code buffer owned by the codec or given by the caller,
+     * Viterbi decoding gives DECODED_LEN type-2 bits (tail bits included) whose first CRC_LEN
+     * bits are checked by the CRC16 - 8.2.3.2 - and whose first PAYLOAD_LEN type-1 bits are
+     * passed to upper MAC.
+     *
+     * Interleaving positions are computed incrementally instead of from a table, block sizes
+     * being known the loops are fully specialised for each block type.
+     *
+     */
+
+    template <uint32_t K, uint32_t A, std::size_t CRC_LEN, std::size_t PAYLOAD_LEN>
+    class BlockCodec {
+    public:
+        static const std::size_t BLOCK_LEN       = K;                           ///< type-5 bits received in burst
+        static const std::size_t DECODED_LEN     = K * 2 / 3;                   ///< type-2 bits after Viterbi decoding
+        static const std::size_t MOTHER_CODE_LEN = 4 * DECODED_LEN;             ///< depunctured rate 1/4 mother code
+        static const std::size_t CRC_BITS        = CRC_LEN;                     ///< bits covered by CRC, CRC included
+        static const std::size_t PAYLOAD_BITS    = PAYLOAD_LEN;                 ///< type-1 bits
+
+        static_assert(K % 3 == 0, "2/3 depuncturing needs a multiple of 3 bits");
+        static_assert(PAYLOAD_LEN + 16 == CRC_LEN, "CRC16 follows the type-1 bits");
+        static_assert(CRC_LEN + 4 == DECODED_LEN, "4 tail bits follow the CRC");
+
+        typedef std::array<uint8_t, MOTHER_CODE_LEN> MotherCode;
+        typedef std::array<int8_t, MOTHER_CODE_LEN>  SoftMotherCode;
+
+        /**
+         * @brief Descramble, deinterleave and depuncture K bits from data with scrambling sequence
+         *
+         * Erased bits are flagged with value 2 for Viterbi decoder
+         *
+         */
+
+        const MotherCode & deinterleaveDepuncture(const uint8_t * data, const uint8_t * sequence)
+        {
+            deinterleaveDepuncture(data, sequence, &m_motherCode);
+
+            return m_motherCode;
+        }
+
+        /**
+         * @brief Descramble, deinterleave and depuncture K bits from data with scrambling sequence into res
+         *
+         */
+
+        static void deinterleaveDepuncture(const uint8_t * data, const uint8_t * sequence, MotherCode * res)
+        {
+            res->fill(2);                                                       // 8.2.3.1.2 with flag 2 for erase bit in Viterbi routine
+
+            uint32_t src = A % K;                                               // to interleave: DataOut[j-1] = DataIn[k-1] with k = 1 + (a * j) % K
+            for (std::size_t dst = 0; dst < MOTHER_CODE_LEN; dst += PERIOD)
+            {
+                for (std::size_t idx = 0; idx < T; idx++)
+                {
+                    (*res)[dst + P[idx]] = data[src] ^ sequence[src];
+                    src = next(src);
+                }
+            }
+        }
+
+        /**
+         * @brief Descramble, deinterleave and depuncture K soft symbols from data with scrambling sequence
+         *
+         * Scrambling bit 1 flips the symbol sign, erased bits are 0
+         *
+         */
+
+        const SoftMotherCode & deinterleaveDepuncture(const int8_t * data, const uint8_t * sequence)
+        {
+            deinterleaveDepuncture(data, sequence, &m_softMotherCode);
+
+            return m_softMotherCode;
+        }
+
+        /**
+         * @brief Descramble, deinterleave and depuncture K soft symbols from data with scrambling sequence into res
+         *
+         */
+
+        static void deinterleaveDepuncture(const int8_t * data, const uint8_t * sequence, SoftMotherCode * res)
+        {
+            res->fill(0);                                                       // 8.2.3.1.2 with soft value 0 for erased bits
+
+            uint32_t src = A % K;
+            for (std::size_t dst = 0; dst < MOTHER_CODE_LEN; dst += PERIOD)
+            {
+                for (std::size_t idx = 0; idx < T; idx++)
+                {
+                    (*res)[dst + P[idx]] = sequence[src] ? (int8_t)(-data[src]) : data[src]; // soft symbols are in [-127, 127] so negation can't overflow
+                    src = next(src);
+                }
+            }
+        }
+
+    private:
+        static const std::size_t PERIOD = 8;                                    ///< puncturing period - 8.2.3.1.2
+        static const std::size_t T      = 3;                                    ///< bits kept per period - 8.2.3.1.3
+        static const uint8_t P[T];                                              ///< kept mother code positions in period, P[1..t] - 1
+
+        static uint32_t next(const uint32_t src)                                // interleaving position of next bit, (a * (j + 1)) % K
+        {
+            return src + A >= K ? src + A - K : src + A;
+        }
+
+        MotherCode     m_motherCode;                                            ///< Depunctured block
+        SoftMotherCode m_softMotherCode;                                        ///< Depunctured soft block
+    };
+
+    template <uint32_t K, uint32_t A, std::size_t CRC_LEN, std::size_t PAYLOAD_LEN>
+    const uint8_t BlockCodec<K, A, CRC_LEN, PAYLOAD_LEN>::P[BlockCodec<K, A, CRC_LEN, PAYLOAD_LEN>::T] = {0, 1, 4};
+
+    typedef BlockCodec<120, 11, 76, 60>    BschCodec;                           ///< BSCH - 8.3.1.2
+    typedef BlockCodec<216, 101, 140, 124> HalfSlotCodec;                       ///< SCH/HD, BNCH and STCH
+    typedef BlockCodec<432, 103, 284, 268> FullSlotCodec;                       ///< SCH/F
+
+};
+
+#endif /* BLOCK_CODEC_H */
@@ -16,24 +16,24 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *
  */
-#include "mac.h"
+#include "lowermac.h"
+#include <cassert>
+#include <algorithm>
 
 using namespace Tetra;
 
 
 /**
- * @brief Fibonacci LFSR descrambling - 8.2.5
+ * @brief Fibonacci LFSR scrambling sequence - 8.2.5
  *
  */
 
-std::vector<uint8_t> Mac::descramble(std::vector<uint8_t> data, const int len, const uint32_t scramblingCode)
+static void buildScramblingSequence(const uint32_t scramblingCode, uint8_t * res, const std::size_t len)
 {
     const uint8_t poly[14] = {32, 26, 23, 22, 16, 12, 11, 10, 8, 7, 5, 4, 2, 1}; // Feedback polynomial - see 8.2.5.2 (8.39)
 
-    std::vector<uint8_t> res;
-
     uint32_t lfsr = scramblingCode;                                             // linear feedback shift register initialization (=0 + 3 for BSCH, calculated from Color code ch 19 otherwise)
-    for (int i = 0; i < len; i++)
+    for (std::size_t i = 0; i < len; i++)
     {
         uint32_t bit = lfsr >> (32 - poly[0]);                                  // apply poly (Xj + ...)
         for (int j = 1; j < 14; j++)
@@ -43,213 +43,233 @@ std::vector<uint8_t> Mac::descramble(std::vector<uint8_t> data, const int len, c
         bit = bit & 1;                                                          // finish apply feedback polynomial (+ 1)
         lfsr = (lfsr >> 1) | (bit << 31);
 
-        res.push_back(data[i] ^ (bit & 0xff));
+        res[i] = (uint8_t)bit;
     }
-
-    return res;
 }
 
 /**
- * @brief (K,a) block deinterleaver - 8.2.4
+ * @brief BSCH scrambling sequence with predefined code 0x0003, shared by all lower MAC instances
+ *
+ */
+
+struct BschScramblingSequence {
+    uint8_t sequence[LowerMac::SCRAMBLING_SEQUENCE_LEN];
+
+    BschScramblingSequence()
+    {
+        buildScramblingSequence(LowerMac::BSCH_SCRAMBLING_CODE, sequence, LowerMac::SCRAMBLING_SEQUENCE_LEN);
+    }
+};
+
+/**
+ * @brief Return scrambling sequence - 8.2.5
+ *
+ * Cell sequence is rebuilt only when the scrambling code changes, BSCH sequence
+ * is built once
  *
  */
 
-std::vector<uint8_t> Mac::deinterleave(std::vector<uint8_t> data, const uint32_t K, const uint32_t a)
+const uint8_t * LowerMac::scramblingSequence(const uint32_t scramblingCode)
 {
-    std::vector<uint8_t> res(K, 0);                                             // output vector is size K
+    static const BschScramblingSequence bsch;
+
+    if (scramblingCode == BSCH_SCRAMBLING_CODE)
+    {
+        return bsch.sequence;
+    }
 
-    for (unsigned int idx = 1; idx <= K; idx++)
+    if (!m_bScramblingSequenceValid || (scramblingCode != m_scramblingSequenceCode))
     {
-        uint32_t k = 1 + (a * idx) % K;
-        res[idx - 1] = data[k - 1];                                             // to interleave: DataOut[i-1] = DataIn[k-1]
+        buildScramblingSequence(scramblingCode, m_scramblingSequence, SCRAMBLING_SEQUENCE_LEN);
+        m_scramblingSequenceCode   = scramblingCode;
+        m_bScramblingSequenceValid = true;
     }
 
-    return res;
+    return m_scramblingSequence;
 }
 
 /**
- * @brief Depuncture with 2/3 rate - 8.2.3.1.3
+ * @brief Descrambling in place - 8.2.5
  *
  */
 
-std::vector<uint8_t> Mac::depuncture23(std::vector<uint8_t> data, const uint32_t len)
+void LowerMac::descramble(uint8_t * data, const std::size_t len, const uint32_t scramblingCode)
 {
-    const uint8_t P[] = {0, 1, 2, 5};                                           // 8.2.3.1.3 - P[1..t]
-    std::vector<uint8_t> res(4 * len * 2 / 3, 2);                               // 8.2.3.1.2 with flag 2 for erase bit in Viterbi routine
+    assert(len <= SCRAMBLING_SEQUENCE_LEN);
+    const uint8_t * sequence = scramblingSequence(scramblingCode);
 
-    uint8_t t = 3;                                                              // 8.2.3.1.3
-    uint8_t period = 8;                                                         // 8.2.3.1.2
-
-    for (uint32_t j = 1; j <= len; j++)
+    for (std::size_t i = 0; i < len; i++)
     {
-        uint32_t i = j;                                                         // punct->i_func(j);
-        uint32_t k = period * ((i - 1) / t) + P[i - t * ((i - 1) / t)];         // punct->period * ((i-1)/t) + P[i - t*((i-1)/t)];
-        res[k - 1] = data[j - 1];
+        data[i] ^= sequence[i];
     }
-
-    return res;
 }
 
 /**
  * @brief Viterbi decoding of RCPC code 16-state mother code of rate 1/4 - 8.2.3.1.1
  *
+ * When built with VITERBI_REFERENCE_CHECK, the result is compared with the
+ * reference string codec
+ *
  */
 
-std::vector<uint8_t> Mac::viterbiDecode1614(std::vector<uint8_t> data)
+std::size_t LowerMac::viterbiDecode1614(const uint8_t * data, const std::size_t len, uint8_t * res, uint32_t * pathMetric)
+{
+    std::size_t count = m_viterbiDecoder1614->decode(data, len, res, pathMetric);
+
+#ifdef VITERBI_REFERENCE_CHECK
+    viterbiReferenceCheck(data, len, res, count);
+#endif
+
+    return count;
+}
+
+#ifdef VITERBI_REFERENCE_CHECK
+/**
+ * @brief Check count bits decoded from len depunctured data against the reference codec
+ *
+ */
+
+void LowerMac::viterbiReferenceCheck(const uint8_t * data, const std::size_t len, const uint8_t * res, const std::size_t count)
 {
     std::string sIn = "";
-    for (std::size_t idx = 0; idx < data.size(); idx++)
+    for (std::size_t idx = 0; idx < len; idx++)
     {
         sIn += (char)(data[idx] + '0');
     }
 
     std::string sOut = m_viterbiCodec1614->Decode(sIn);
 
-    std::vector<uint8_t> res;
+    bool bMatch = (sOut.size() == count);
+    for (std::size_t idx = 0; bMatch && (idx < sOut.size()); idx++)
+    {
+        bMatch = ((uint8_t)(sOut[idx] - '0') == res[idx]);
+    }
 
-    for (size_t idx = 0; idx < sOut.size(); idx++)
+    if (!bMatch)
     {
-        res.push_back((uint8_t)(sOut[idx] - '0'));
+        LOG_PRINT(m_log, LogLevel::LOW, "Viterbi     : decoder mismatch with reference codec on %u bits\n", (uint32_t)len);
     }
+}
+#endif
+
+/**
+ * @brief Soft Viterbi decoding of RCPC code 16-state mother code of rate 1/4 - 8.2.3.1.1
+ *
+ */
 
-    return res;
+std::size_t LowerMac::viterbiDecode1614(const int8_t * data, const std::size_t len, uint8_t * res, uint32_t * pathMetric)
+{
+    return m_viterbiDecoder1614->decodeSoft(data, len, res, pathMetric);
 }
 
 /**
- * @brief Reed-Muller decoder and FEC correction 30 bits in, 14 bits out
+ * @brief Reed-Muller (30,14) parity checks, 4 checks voting with each information bit
+ *
+ * Bit j of a mask is received bit j, parity bits are received bits 14 to 29
+ *
+ */
+
+static const uint32_t REED_MULLER_3014_CHECKS[14][4] = {
+    {0x011D0000, 0x006CC000, 0x00C78000, 0x01B64000},                           // bit 0
+    {0x01464000, 0x009CC000, 0x00378000, 0x01ED0000},                           // bit 1
+    {0x01A48000, 0x00D54000, 0x007E0000, 0x010FC000},                           // bit 2
+    {0x0E700000, 0x0F01C000, 0x0FAA8000, 0x0EDB4000},                           // bit 3
+    {0x17064000, 0x17AD0000, 0x16DCC000, 0x16778000},                           // bit 4
+    {0x1AD00000, 0x1B0A8000, 0x1BA1C000, 0x1A7B4000},                           // bit 5
+    {0x1D0D0000, 0x1DA64000, 0x1C7CC000, 0x1CD78000},                           // bit 6
+    {0x3E548000, 0x3F254000, 0x3F8E0000, 0x3EFFC000},                           // bit 7
+    {0x26418000, 0x27304000, 0x279B0000, 0x26EAC000},                           // bit 8
+    {0x2A214000, 0x2A8A0000, 0x2B508000, 0x2BFBC000},                           // bit 9
+    {0x2C10C000, 0x2D610000, 0x2DCA4000, 0x2CBB8000},                           // bit 10
+    {0x32488000, 0x33920000, 0x33394000, 0x32E3C000},                           // bit 11
+    {0x35A40000, 0x350F4000, 0x34D5C000, 0x347E8000},                           // bit 12
+    {0x38128000, 0x39C80000, 0x39634000, 0x38B9C000},                           // bit 13
+};
+
+/**
+ * @brief Reed-Muller decoder and FEC correction 30 bits in, 14 bits out, returns the number of corrected bits
+ *
+ * Each information bit is the majority of itself and its 4 parity checks, the checks are
+ * computed on the packed received word.
  *
  * FEC thanks to Lollo Gollo @logollo see "issue #21"
  *
  */
 
-std::vector<uint8_t> Mac::reedMuller3014Decode(std::vector<uint8_t> data)
+int LowerMac::reedMuller3014Decode(const uint8_t * data, uint8_t * res)
 {
-    uint8_t q[5];
-    std::vector<uint8_t> res(14);
-
-    q[0] = data[0];
-    q[1] = (data[13 + 3] + data[13 + 5] + data[13 + 6] + data[13 + 7] + data[13 + 11]) % 2;
-    q[2] = (data[13 + 1] + data[13 + 2] + data[13 + 5] + data[13 + 6] + data[13 + 8] + data[13 + 9]) % 2;
-    q[3] = (data[13 + 2] + data[13 + 3] + data[13 + 4] + data[13 + 5] + data[13 + 9] + data[13 + 10]) % 2;
-    q[4] = (data[13 + 1] + data[13 + 4] + data[13 + 5] + data[13 + 7] + data[13 + 8] + data[13 + 10] + data[13 + 11]) % 2;
-    res[0] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
-
-    q[0] = data[1];
-    q[1] = (data[13 + 1] + data[13 + 4] + data[13 + 5] + data[13 + 9] + data[13 + 11]) % 2;
-    q[2] = (data[13 + 1] + data[13 + 2] + data[13 + 5] + data[13 + 6] + data[13 + 7] + data[13 + 10]) % 2;
-    q[3] = (data[13 + 2] + data[13 + 3] + data[13 + 4] + data[13 + 5] + data[13 + 7] + data[13 + 8]) % 2;
-    q[4] = (data[13 + 3] + data[13 + 5] + data[13 + 6] + data[13 + 8] + data[13 + 9] + data[13 + 10] + data[13 + 11]) % 2;
-    res[1] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
-
-    q[0] = data[2];
-    q[1] = (data[13 + 2] + data[13 + 5] + data[13 + 8] + data[13 + 10] + data[13 + 11]) % 2;
-    q[2] = (data[13 + 1] + data[13 + 3] + data[13 + 5] + data[13 + 7] + data[13 + 9] + data[13 + 10]) % 2;
-    q[3] = (data[13 + 4] + data[13 + 5] + data[13 + 6] + data[13 + 7] + data[13 + 8] + data[13 + 9]) % 2;
-    q[4] = (data[13 + 1] + data[13 + 2] + data[13 + 3] + data[13 + 4] + data[13 + 5] + data[13 + 6] + data[13 + 11]) % 2;
-    res[2] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
-
-    q[0] = data[3];
-    q[1] = (data[13 + 7] + data[13 + 8] + data[13 + 9] + data[13 + 12] + data[13 + 13] + data[13 + 14]) % 2;
-    q[2] = (data[13 + 1] + data[13 + 2] + data[13 + 3] + data[13 + 11] + data[13 + 12] + data[13 + 13] + data[13 + 14]) % 2;
-    q[3] = (data[13 + 2] + data[13 + 4] + data[13 + 6] + data[13 + 8] + data[13 + 10] + data[13 + 11] + data[13 + 12] + data[13 + 13] + data[13 + 14]) % 2;
-    q[4] = (data[13 + 1] + data[13 + 3] + data[13 + 4] + data[13 + 6] + data[13 + 7] + data[13 + 9] + data[13 + 10] + data[13 + 12] + data[13 + 13] + data[13 + 14]) % 2;
-    res[3] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
-
-    q[0] = data[4];
-    q[1] = (data[13 + 1] + data[13 + 4] + data[13 + 5] + data[13 + 11] + data[13 + 12] + data[13 + 13] + data[13 + 15]) % 2;
-    q[2] = (data[13 + 3] + data[13 + 5] + data[13 + 6] + data[13 + 8] + data[13 + 10] + data[13 + 11] + data[13 + 12] + data[13 + 13] + data[13 + 15]) % 2;
-    q[3] = (data[13 + 1] + data[13 + 2] + data[13 + 5] + data[13 + 6] + data[13 + 7] + data[13 + 9] + data[13 + 10] + data[13 + 12] + data[13 + 13] + data[13 + 15]) % 2;
-    q[4] = (data[13 + 2] + data[13 + 3] + data[13 + 4] + data[13 + 5] + data[13 + 7] + data[13 + 8] + data[13 + 9] + data[13 + 12] + data[13 + 13] + data[13 + 15]) % 2;
-    res[4] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
-
-    q[0] = data[5];
-    q[1] = (data[13 + 7] + data[13 + 9] + data[13 + 10] + data[13 + 12] + data[13 + 14] + data[13 + 15]) % 2;
-    q[2] = (data[13 + 2] + data[13 + 4] + data[13 + 6] + data[13 + 11] + data[13 + 12] + data[13 + 14] + data[13 + 15]) % 2;
-    q[3] = (data[13 + 1] + data[13 + 2] + data[13 + 3] + data[13 + 8] + data[13 + 10] + data[13 + 11] + data[13 + 12] + data[13 + 14] + data[13 + 15]) % 2;
-    q[4] = (data[13 + 1] + data[13 + 3] + data[13 + 4] + data[13 + 6] + data[13 + 7] + data[13 + 8] + data[13 + 9] + data[13 + 12] + data[13 + 14] + data[13 + 15]) % 2;
-    res[5] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
-
-    q[0] = data[6];
-    q[1] = (data[13 + 3] + data[13 + 5] + data[13 + 6] + data[13 + 11] + data[13 + 13] + data[13 + 14] + data[13 + 15]) % 2;
-    q[2] = (data[13 + 1] + data[13 + 4] + data[13 + 5] + data[13 + 8] + data[13 + 10] + data[13 + 11] + data[13 + 13] + data[13 + 14] + data[13 + 15]) % 2;
-    q[3] = (data[13 + 1] + data[13 + 2] + data[13 + 5] + data[13 + 6] + data[13 + 7] + data[13 + 8] + data[13 + 9] + data[13 + 13] + data[13 + 14] + data[13 + 15]) % 2;
-    q[4] = (data[13 + 2] + data[13 + 3] + data[13 + 4] + data[13 + 5] + data[13 + 7] + data[13 + 9] + data[13 + 10] + data[13 + 13] + data[13 + 14] + data[13 + 15]) % 2;
-    res[6] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
-
-    q[0] = data[7];
-    q[1] = (data[13 + 2] + data[13 + 5] + data[13 + 7] + data[13 + 9] + data[13 + 12] + data[13 + 13] + data[13 + 14] + data[13 + 15] + data[13 + 16]) % 2;
-    q[2] = (data[13 + 1] + data[13 + 3] + data[13 + 5] + data[13 + 8] + data[13 + 11] + data[13 + 12] + data[13 + 13] + data[13 + 14] + data[13 + 15] + data[13 + 16]) % 2;
-    q[3] = (data[13 + 4] + data[13 + 5] + data[13 + 6] + data[13 + 10] + data[13 + 11] + data[13 + 12] + data[13 + 13] + data[13 + 14] + data[13 + 15] + data[13 + 16]) % 2;
-    q[4] = (data[13 + 1] + data[13 + 2] + data[13 + 3] + data[13 + 4] + data[13 + 5] + data[13 + 6] + data[13 + 7] + data[13 + 8] + data[13 + 9] + data[13 + 10] + data[13 + 12] + data[13 + 13] + data[13 + 14] + data[13 + 15] + data[13 + 16]) % 2;
-    res[7] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
-
-    q[0] = data[8];
-    q[1] = (data[13 + 2] + data[13 + 3] + data[13 + 9] + data[13 + 12] + data[13 + 13] + data[13 + 16]) % 2;
-    q[2] = (data[13 + 1] + data[13 + 7] + data[13 + 8] + data[13 + 11] + data[13 + 12] + data[13 + 13] + data[13 + 16]) % 2;
-    q[3] = (data[13 + 3] + data[13 + 4] + data[13 + 6] + data[13 + 7] + data[13 + 10] + data[13 + 11] + data[13 + 12] + data[13 + 13] + data[13 + 16]) % 2;
-    q[4] = (data[13 + 1] + data[13 + 2] + data[13 + 4] + data[13 + 6] + data[13 + 8] + data[13 + 9] + data[13 + 10] + data[13 + 12] + data[13 + 13] + data[13 + 16]) % 2;
-    res[8] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
-
-    q[0] = data[9];
-    q[1] = (data[13 + 1] + data[13 + 3] + data[13 + 8] + data[13 + 12] + data[13 + 14] + data[13 + 16]) % 2;
-    q[2] = (data[13 + 4] + data[13 + 6] + data[13 + 10] + data[13 + 12] + data[13 + 14] + data[13 + 16]) % 2;
-    q[3] = (data[13 + 2] + data[13 + 7] + data[13 + 9] + data[13 + 11] + data[13 + 12] + data[13 + 14] + data[13 + 16]) % 2;
-    q[4] = (data[13 + 1] + data[13 + 2] + data[13 + 3] + data[13 + 4] + data[13 + 6] + data[13 + 7] + data[13 + 8] + data[13 + 9] + data[13 + 10] + data[13 + 11] + data[13 + 12] + data[13 + 14] + data[13 + 16]) % 2;
-    res[9] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
-
-    q[0] = data[10];
-    q[1] = (data[13 + 1] + data[13 + 2] + data[13 + 7] + data[13 + 13] + data[13 + 14] + data[13 + 16]) % 2;
-    q[2] = (data[13 + 3] + data[13 + 8] + data[13 + 9] + data[13 + 11] + data[13 + 13] + data[13 + 14] + data[13 + 16]) % 2;
-    q[3] = (data[13 + 1] + data[13 + 4] + data[13 + 6] + data[13 + 9] + data[13 + 10] + data[13 + 11] + data[13 + 13] + data[13 + 14] + data[13 + 16]) % 2;
-    q[4] = (data[13 + 2] + data[13 + 3] + data[13 + 4] + data[13 + 6] + data[13 + 7] + data[13 + 8] + data[13 + 10] + data[13 + 13] + data[13 + 14] + data[13 + 16]) % 2;
-    res[10] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
-
-    q[0] = data[11];
-    q[1] = (data[13 + 2] + data[13 + 6] + data[13 + 9] + data[13 + 12] + data[13 + 15] + data[13 + 16]) % 2;
-    q[2] = (data[13 + 4] + data[13 + 7] + data[13 + 10] + data[13 + 11] + data[13 + 12] + data[13 + 15] + data[13 + 16]) % 2;
-    q[3] = (data[13 + 1] + data[13 + 3] + data[13 + 6] + data[13 + 7] + data[13 + 8] + data[13 + 11] + data[13 + 12] + data[13 + 15] + data[13 + 16]) % 2;
-    q[4] = (data[13 + 1] + data[13 + 2] + data[13 + 3] + data[13 + 4] + data[13 + 8] + data[13 + 9] + data[13 + 10] + data[13 + 12] + data[13 + 15] + data[13 + 16]) % 2;
-    res[11] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
-
-    q[0] = data[12];
-    q[1] = (data[13 + 5] + data[13 + 8] + data[13 + 10] + data[13 + 11] + data[13 + 13] + data[13 + 15] + data[13 + 16]) % 2;
-    q[2] = (data[13 + 1] + data[13 + 3] + data[13 + 4] + data[13 + 5] + data[13 + 6] + data[13 + 11] + data[13 + 13] + data[13 + 15] + data[13 + 16]) % 2;
-    q[3] = (data[13 + 1] + data[13 + 2] + data[13 + 3] + data[13 + 5] + data[13 + 7] + data[13 + 9] + data[13 + 10] + data[13 + 13] + data[13 + 15] + data[13 + 16]) % 2;
-    q[4] = (data[13 + 2] + data[13 + 4] + data[13 + 5] + data[13 + 6] + data[13 + 7] + data[13 + 8] + data[13 + 9] + data[13 + 13] + data[13 + 15] + data[13 + 16]) % 2;
-    res[12] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
-
-    q[0] = data[13];
-    q[1] = (data[13 + 2] + data[13 + 4] + data[13 + 7] + data[13 + 14] + data[13 + 15] + data[13 + 16]) % 2;
-    q[2] = (data[13 + 6] + data[13 + 9] + data[13 + 10] + data[13 + 11] + data[13 + 14] + data[13 + 15] + data[13 + 16]) % 2;
-    q[3] = (data[13 + 1] + data[13 + 3] + data[13 + 4] + data[13 + 8] + data[13 + 9] + data[13 + 11] + data[13 + 14] + data[13 + 15] + data[13 + 16]) % 2;
-    q[4] = (data[13 + 1] + data[13 + 2] + data[13 + 3] + data[13 + 6] + data[13 + 7] + data[13 + 8] + data[13 + 10] + data[13 + 14] + data[13 + 15] + data[13 + 16]) % 2;
-    res[13] = (q[0] + q[1] + q[2] + q[3] + q[4]) >= 3 ? 1 : 0;
-
-    // check deviation from input
-    // int deviation = 0;
-    // for (int cnt = 0; cnt < 14; cnt++)
-    // {
-    //     deviation += (data[cnt] != res[cnt]) ? 1 : 0;
-    // }
-    // printf("FEC correction %.2f\n", deviation / 14.);
-    // print_vector(data, 14);
-    // print_vector(res, 14);
-
-    //return vector_extract(data, 0, 14);
-
-    return res;
+    StageTimer timer(m_stageStats[STAGE_REED_MULLER]);
+
+    uint32_t word = 0;
+    for (int idx = 0; idx < 30; idx++)
+    {
+        word |= (uint32_t)data[idx] << idx;
+    }
+
+    int corrected = 0;
+    for (int idx = 0; idx < 14; idx++)
+    {
+        int votes = data[idx];
+        for (int check = 0; check < 4; check++)
+        {
+            votes += __builtin_popcount(word & REED_MULLER_3014_CHECKS[idx][check]) & 1;
+        }
+
+        res[idx] = votes >= 3 ? 1 : 0;
+        corrected += (res[idx] != data[idx]) ? 1 : 0;
+    }
+
+    return corrected;
 }
 
+/**
+ * @brief CRC16-CCITT table, register update for each byte value shifted in
+ *
+ */
+
+struct Crc16CcittTable {
+    uint16_t table[256];
+
+    Crc16CcittTable()
+    {
+        for (uint32_t val = 0; val < 256; val++)
+        {
+            uint16_t crc = (uint16_t)(val << 8);
+            for (int bit = 0; bit < 8; bit++)
+            {
+                crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+            }
+            table[val] = crc;
+        }
+    }
+};
+
 /**
  * @brief Calculated CRC16 ITU-T X.25 - CCITT
  *
+ * Bits are processed by bytes with a table, trailing bits one by one
+ *
  */
 
-int Mac::checkCrc16Ccitt(std::vector<uint8_t> data, const int len)
+int LowerMac::checkCrc16Ccitt(const uint8_t * data, const int len)
 {
+    static const Crc16CcittTable crcTable;
+
     uint16_t crc = 0xFFFF;                                                      // CRC16-CCITT initial value
 
-    for (int i = 0; i < len; i++)
+    int i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        uint8_t byte = 0;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            byte = (uint8_t)((byte << 1) | data[i + bit]);                      // first bit is MSB
+        }
+
+        crc = (uint16_t)((crc << 8) ^ crcTable.table[(crc >> 8) ^ byte]);
+    }
+
+    for (; i < len; i++)
     {
         uint16_t bit = (uint16_t)data[i];
 
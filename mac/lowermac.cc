@@ -0,0 +1,459 @@
+/*
+ *  tetra-kit
+ *  Copyright (C) 2020  LarryTh <dev@logami.fr>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "lowermac.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace Tetra;
+
+/**
+ * @brief Copy the two len symbols halves at pos1 and pos2 in burst to res
+ *
+ */
+
+template <typename T>
+static void burstGather(const T * data, const std::size_t pos1, const std::size_t pos2, const std::size_t len, T * res)
+{
+    std::copy(data + pos1, data + pos1 + len, res);
+    std::copy(data + pos2, data + pos2 + len, res + len);
+}
+
+/**
+ * @brief Constructor
+ *
+ */
+
+LowerMac::LowerMac(Log * log)
+{
+    m_log = log;
+
+    m_viterbiDecoder1614      = new ViterbiDecoder1614();
+    m_viterbiBatchDecoder1614 = new ViterbiBatchDecoder1614();
+    m_bBatchSimd = (strcmp(m_viterbiBatchDecoder1614->kernelName(), "scalar") != 0);
+
+    m_bBatch = false;
+    m_bschPending.count     = 0;
+    m_halfSlotPending.count = 0;
+    m_fullSlotPending.count = 0;
+
+    // cell scrambling sequence is built on first use
+    m_scramblingSequenceCode   = 0;
+    m_bScramblingSequenceValid = false;
+
+#ifdef VITERBI_REFERENCE_CHECK
+    /*
+     * Initialize reference Viterbi coder/decoder for MAC
+     *
+     * 8.2.3.1.1 Generator polynomials for the RCPC 16-state mother code of rate 1/4
+     *
+     * G1 = 1 + D +             D^4 (8.3)
+     * G2 = 1 +     D^2 + D^3 + D^4 (8.4)
+     * G3 = 1 + D + D^2 +       D^4 (8.5)
+     * G4 = 1 + D +       D^3 + D^4 (8.6)
+     *
+     * NOTE: representing bit order must be reversed for the codec, eg. 1 + D + 0 + 0 + D^4 -> 10011
+     *
+     */
+
+    std::vector<int> polynomials;
+    int constraint = 6;
+
+    polynomials.push_back(0b10011);
+    polynomials.push_back(0b11101);
+    polynomials.push_back(0b10111);
+    polynomials.push_back(0b11011);
+    m_viterbiCodec1614 = new ViterbiCodec(constraint, polynomials);
+#endif
+}
+
+/**
+ * @brief Destructor
+ *
+ */
+
+LowerMac::~LowerMac()
+{
+    delete m_viterbiDecoder1614;
+    delete m_viterbiBatchDecoder1614;
+#ifdef VITERBI_REFERENCE_CHECK
+    delete m_viterbiCodec1614;
+#endif
+}
+
+/**
+ * @brief Return stage name for stats
+ *
+ */
+
+const char * LowerMac::stageName(const Stage stage)
+{
+    switch (stage)
+    {
+    case STAGE_DEINTERLEAVE:
+        return "deinterleave";
+
+    case STAGE_VITERBI:
+        return "viterbi";
+
+    case STAGE_CRC:
+        return "crc";
+
+    case STAGE_REED_MULLER:
+        return "reed_muller";
+
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * @brief Return decoding stage stats, may be read from any thread
+ *
+ */
+
+const StageStats & LowerMac::stageStats(const Stage stage) const
+{
+    return m_stageStats[stage];
+}
+
+/**
+ * @brief Decode a block at pos in burst with codec, from soft symbols when available
+ *
+ * bValid is set when the block CRC is valid, the block is then truncated to its type-1 bits
+ * if bTruncate is set. When batching, the deinterleaved block is added to pending blocks
+ * and res and bValid are written when the batch is decoded.
+ *
+ */
+
+template <typename Codec, std::size_t N>
+void LowerMac::decodeBlock(Codec & codec, PendingBlocks<Codec> & pending, const uint8_t * data, const int8_t * softData, const std::size_t pos, const uint32_t scramblingCode, const bool bTruncate, LowerMacBlock<N> * res, bool * bValid)
+{
+    static_assert(N >= Codec::DECODED_LEN, "block too short for decoded bits");
+    static_assert(Codec::BLOCK_LEN <= SCRAMBLING_SEQUENCE_LEN, "scrambling sequence too short for block");
+
+    const uint8_t * sequence = scramblingSequence(scramblingCode);
+
+    if (m_bBatch)
+    {
+        if ((pending.count > 0) && (pending.bSoft != (softData != NULL)))       // a batch holds only hard or only soft blocks
+        {
+            decodePending(pending);
+        }
+
+        uint64_t startNs = m_stageStats[STAGE_DEINTERLEAVE].start();
+        if (softData)
+        {
+            Codec::deinterleaveDepuncture(softData + pos, sequence, &pending.softMotherCode[pending.count]);
+        }
+        else
+        {
+            Codec::deinterleaveDepuncture(data + pos, sequence, &pending.motherCode[pending.count]);
+        }
+        m_stageStats[STAGE_DEINTERLEAVE].record(startNs);
+
+        res->len        = 0;
+        res->pathMetric = 0;
+        res->pathLen    = 0;
+        *bValid         = false;
+
+        pending.bits[pending.count]       = res->bits;
+        pending.len[pending.count]        = &res->len;
+        pending.pathMetric[pending.count] = &res->pathMetric;
+        pending.pathLen[pending.count]    = &res->pathLen;
+        pending.bValid[pending.count]     = bValid;
+        pending.bTruncate[pending.count]  = bTruncate;
+        pending.bSoft = (softData != NULL);
+        pending.count++;
+
+        if (pending.count == BATCH_LANES)
+        {
+            decodePending(pending);
+        }
+
+        return;
+    }
+
+    uint64_t startNs = m_stageStats[STAGE_DEINTERLEAVE].start();
+
+    if (softData)
+    {
+        const typename Codec::SoftMotherCode & motherCode = codec.deinterleaveDepuncture(softData + pos, sequence);
+        m_stageStats[STAGE_DEINTERLEAVE].record(startNs);
+
+        startNs = m_stageStats[STAGE_VITERBI].start();
+        res->len = viterbiDecode1614(motherCode.data(), motherCode.size(), res->bits, &res->pathMetric);
+    }
+    else
+    {
+        const typename Codec::MotherCode & motherCode = codec.deinterleaveDepuncture(data + pos, sequence);
+        m_stageStats[STAGE_DEINTERLEAVE].record(startNs);
+
+        startNs = m_stageStats[STAGE_VITERBI].start();
+        res->len = viterbiDecode1614(motherCode.data(), motherCode.size(), res->bits, &res->pathMetric);
+    }
+    m_stageStats[STAGE_VITERBI].record(startNs);
+    res->pathLen = (uint32_t)res->len;
+
+    checkBlock(Codec::CRC_BITS, Codec::PAYLOAD_BITS, bTruncate, res->bits, &res->len, bValid);
+}
+
+/**
+ * @brief Check CRC of decoded bits and truncate them to their type-1 bits if valid and bTruncate is set
+ *
+ */
+
+void LowerMac::checkBlock(const std::size_t crcBits, const std::size_t payloadBits, const bool bTruncate, uint8_t * bits, std::size_t * len, bool * bValid)
+{
+    uint64_t startNs = m_stageStats[STAGE_CRC].start();
+    *bValid = checkCrc16Ccitt(bits, (int)crcBits);
+    m_stageStats[STAGE_CRC].record(startNs);
+
+    if (*bValid && bTruncate)
+    {
+        *len = payloadBits;
+    }
+}
+
+/**
+ * @brief Viterbi decode pending blocks and check their CRC
+ *
+ * Batches too small to pay off, or any batch without a SIMD batch kernel, are decoded block
+ * by block.
+ *
+ */
+
+template <typename Codec>
+void LowerMac::decodePending(PendingBlocks<Codec> & pending)
+{
+    if (pending.count == 0)
+    {
+        return;
+    }
+
+    uint64_t startNs = m_stageStats[STAGE_VITERBI].start();
+
+    std::size_t decodedLen[BATCH_LANES];
+    uint32_t pathMetrics[BATCH_LANES];
+    if (!m_bBatchSimd || (pending.count < BATCH_MIN_BLOCKS))
+    {
+        for (std::size_t idx = 0; idx < pending.count; idx++)
+        {
+            if (pending.bSoft)
+            {
+                decodedLen[idx] = viterbiDecode1614(pending.softMotherCode[idx].data(), Codec::MOTHER_CODE_LEN, pending.bits[idx], &pathMetrics[idx]);
+            }
+            else
+            {
+                decodedLen[idx] = viterbiDecode1614(pending.motherCode[idx].data(), Codec::MOTHER_CODE_LEN, pending.bits[idx], &pathMetrics[idx]);
+            }
+        }
+    }
+    else if (pending.bSoft)
+    {
+        const int8_t * blocks[BATCH_LANES];
+        for (std::size_t idx = 0; idx < pending.count; idx++)
+        {
+            blocks[idx] = pending.softMotherCode[idx].data();
+        }
+
+        std::size_t len = m_viterbiBatchDecoder1614->decodeSoft(blocks, pending.count, Codec::MOTHER_CODE_LEN, pending.bits, pathMetrics);
+        std::fill(decodedLen, decodedLen + pending.count, len);
+    }
+    else
+    {
+        const uint8_t * blocks[BATCH_LANES];
+        for (std::size_t idx = 0; idx < pending.count; idx++)
+        {
+            blocks[idx] = pending.motherCode[idx].data();
+        }
+
+        std::size_t len = m_viterbiBatchDecoder1614->decode(blocks, pending.count, Codec::MOTHER_CODE_LEN, pending.bits, pathMetrics);
+        std::fill(decodedLen, decodedLen + pending.count, len);
+
+#ifdef VITERBI_REFERENCE_CHECK
+        for (std::size_t idx = 0; idx < pending.count; idx++)
+        {
+            viterbiReferenceCheck(blocks[idx], Codec::MOTHER_CODE_LEN, pending.bits[idx], len);
+        }
+#endif
+    }
+
+    m_stageStats[STAGE_VITERBI].record(startNs);
+
+    for (std::size_t idx = 0; idx < pending.count; idx++)
+    {
+        *pending.pathMetric[idx] = pathMetrics[idx];
+        *pending.pathLen[idx]    = (uint32_t)decodedLen[idx];
+        *pending.len[idx]        = decodedLen[idx];
+        checkBlock(Codec::CRC_BITS, Codec::PAYLOAD_BITS, pending.bTruncate[idx], pending.bits[idx], pending.len[idx], pending.bValid[idx]);
+    }
+
+    pending.count = 0;
+}
+
+/**
+ * @brief Start batching signalling blocks Viterbi decoding
+ *
+ */
+
+void LowerMac::beginBatch()
+{
+    m_bBatch = true;
+}
+
+/**
+ * @brief Decode all pending signalling blocks and stop batching
+ *
+ */
+
+void LowerMac::endBatch()
+{
+    decodePending(m_bschPending);
+    decodePending(m_halfSlotPending);
+    decodePending(m_fullSlotPending);
+
+    m_bBatch = false;
+}
+
+/**
+ * @brief Decode the logical channels blocks of a burst - 9.4.4.2
+ *
+ * AACH, SB BSCH and NDB TCH/S (descrambling only) are always decoded. BKN1 and BKN2
+ * signalling blocks are decoded only when set in blocks, otherwise they are left to
+ * decodeBkn1() and decodeBkn2() when required: the logical channel carried by NDB blocks is
+ * only known once the burst AACH has been processed by upper MAC, and the blocks may be
+ * filtered out.
+ *
+ * NDB BKN1 is BKN1 + BKN2 decoded as SCH/F.
+ *
+ */
+
+void LowerMac::decode(const uint8_t * data, int burstType, const int8_t * softData, const uint32_t scramblingCode, const uint32_t blocks, LowerMacBurst * res)
+{
+    res->burstType      = burstType;
+    res->scramblingCode = scramblingCode;
+    res->bBschValid     = false;
+    res->bBkn1Valid     = false;
+    res->bBkn1Decoded   = false;
+    res->bBkn2Valid     = false;
+    res->bBkn2Decoded   = false;
+    res->aachCorrectedBits = 0;
+    res->aach.len = 0;
+    res->bsch.len = 0;
+    res->bkn1.len = 0;
+    res->bkn2.len = 0;
+    res->tch.len  = 0;
+    res->bsch.pathLen = 0;                                                      // path metric is meaningless until Viterbi decoded
+    res->bkn1.pathLen = 0;
+    res->bkn2.pathLen = 0;
+
+    if (burstType == SB)                                                        // synchronisation burst
+    {
+        // BKN1 block - BSCH - SB seems to be sent only on FN=18 thus BKN1 contains only BSCH
+        // descramble with predefined code 0x0003, deinterleave 120, 11, depuncture with 2/3 rate 120 bits -> 4 * 80 bits, Viterbi decode - see 8.3.1.2  (K1 + 16, K1) block code with K1 = 60
+        decodeBlock(m_bschCodec, m_bschPending, data, softData, 94, BSCH_SCRAMBLING_CODE, false, &res->bsch, &res->bBschValid);
+
+        // BBK block - AACH
+        std::copy(data + 252, data + 252 + 30, m_block);                        // BBK
+        descramble(m_block, 30, scramblingCode);                                // descramble
+        res->aachCorrectedBits = reedMuller3014Decode(m_block, res->aach.bits); // Reed-Muller correction
+        res->aach.len = 14;
+
+        res->bBkn1Decoded = true;                                               // BKN1 is BSCH
+    }
+    else if ((burstType == NDB) || (burstType == NDB_SF))                       // normal downlink bursts
+    {
+        // BBK block - AACH
+        std::copy(data + 230, data + 230 + 14, m_block);                        // BBK is in two parts
+        std::copy(data + 266, data + 266 + 16, m_block + 14);
+        descramble(m_block, 30, scramblingCode);                                // descramble
+        res->aachCorrectedBits = reedMuller3014Decode(m_block, res->aach.bits); // Reed-Muller correction
+        res->aach.len = 14;
+
+        if (burstType == NDB)                                                   // 1 logical channel in time slot
+        {
+            // BKN1 + BKN2 reconstructed to BKN1, descrambled for traffic mode
+            burstGather(data, 14, 282, 216, res->tch.bits);
+            descramble(res->tch.bits, 432, scramblingCode);
+            res->tch.len = 432;
+
+            res->bBkn2Decoded = true;                                           // BKN2 is part of BKN1
+        }
+    }
+
+    if ((blocks & DECODE_BKN1) && !res->bBkn1Decoded)
+    {
+        decodeBkn1(data, softData, res);
+    }
+
+    if ((blocks & DECODE_BKN2) && !res->bBkn2Decoded)
+    {
+        decodeBkn2(data, softData, res);
+    }
+}
+
+/**
+ * @brief Decode BKN1 with the burst scrambling code: NDB BKN1 + BKN2 as SCH/F or NDB_SF BKN1 as SCH/HD or STCH
+ *
+ */
+
+void LowerMac::decodeBkn1(const uint8_t * data, const int8_t * softData, LowerMacBurst * res)
+{
+    res->bBkn1Valid = false;
+
+    if (res->burstType == NDB)
+    {
+        // descramble, deinterleave, depuncture with 2/3 rate 288 bits -> 4 * 288 bits, Viterbi decode
+        if (softData)
+        {
+            burstGather(softData, 14, 282, 216, m_softBlock);
+        }
+        else
+        {
+            burstGather(data, 14, 282, 216, m_block);
+        }
+
+        decodeBlock(m_fullSlotCodec, m_fullSlotPending, m_block, softData ? m_softBlock : NULL, 0, res->scramblingCode, true, &res->bkn1, &res->bBkn1Valid);
+    }
+    else if (res->burstType == NDB_SF)
+    {
+        // BKN1 block - always SCH/HD (CP channel) - descramble, deinterleave, depuncture with 2/3 rate 144 bits -> 4 * 144 bits, Viterbi decode
+        decodeBlock(m_halfSlotCodec, m_halfSlotPending, data, softData, 14, res->scramblingCode, true, &res->bkn1, &res->bBkn1Valid);
+    }
+
+    res->bBkn1Decoded = true;
+}
+
+/**
+ * @brief Decode SB or NDB_SF BKN2 as SCH/HD, BNCH or STCH with the burst scrambling code
+ *
+ */
+
+void LowerMac::decodeBkn2(const uint8_t * data, const int8_t * softData, LowerMacBurst * res)
+{
+    res->bBkn2Valid = false;
+
+    if ((res->burstType == SB) || (res->burstType == NDB_SF))
+    {
+        // BKN2 block - descramble, deinterleave, depuncture with 2/3 rate 144 bits -> 4 * 144 bits, Viterbi decode
+        decodeBlock(m_halfSlotCodec, m_halfSlotPending, data, softData, 282, res->scramblingCode, true, &res->bkn2, &res->bBkn2Valid);
+    }
+
+    res->bBkn2Decoded = true;
+}
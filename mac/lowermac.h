@@ -0,0 +1,190 @@
+/*
+ *  tetra-kit
+ *  Copyright (C) 2020  LarryTh <dev@logami.fr>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef LOWER_MAC_H
+#define LOWER_MAC_H
+#include <cstdint>
+#include <vector>
+#include "../common/tetra.h"
+#include "../common/log.h"
+#include "../common/logmacros.h"
+#include "../common/utils.h"
+#include "../common/stagestats.h"
+#include "blockcodec.h"
+#include "viterbi.h"
+#include "viterbidecoder.h"
+
+namespace Tetra {
+
+    /**
+     * @brief Fixed capacity block of bits, one bit per byte
+     *
+     */
+
+    template <std::size_t N>
+    struct LowerMacBlock {
+        uint8_t bits[N];                                                        ///< Block bits
+        std::size_t len;                                                        ///< Meaningful bits count
+        uint32_t pathMetric;                                                    ///< Winning Viterbi path metric, see ViterbiDecoder1614
+        uint32_t pathLen;                                                       ///< Viterbi decoded bits of path metric, 0 until decoded (signalling blocks only)
+
+        const uint8_t * data() const { return bits; }
+        std::size_t size() const { return len; }
+    };
+
+    /**
+     * @brief Logical channels blocks decoded from one burst
+     *
+     * Blocks with a CRC are only meaningful when their valid flag is set and are already
+     * truncated to the type-1 bits passed to upper MAC.
+     *
+     * Blocks are sized for the longest content they can hold so decoding a burst doesn't
+     * allocate memory.
+     *
+     */
+
+    struct LowerMacBurst {
+        int burstType;                                                          ///< Burst type SB, NDB or NDB_SF
+        uint32_t scramblingCode;                                                ///< Scrambling code the blocks were decoded with
+        LowerMacBlock<14>  aach;                                                ///< BBK - AACH
+        int aachCorrectedBits;                                                  ///< AACH bits corrected by Reed-Muller decoding
+        LowerMacBlock<80>  bsch;                                                ///< SB BKN1 - BSCH, not truncated (only 60 bits are meaningful)
+        bool bBschValid;                                                        ///< BSCH CRC is valid
+        LowerMacBlock<288> bkn1;                                                ///< NDB_SF BKN1 SCH/HD or NDB BKN1 + BKN2 SCH/F
+        bool bBkn1Valid;                                                        ///< BKN1 CRC is valid
+        bool bBkn1Decoded;                                                      ///< BKN1 decoding has been done
+        LowerMacBlock<144> bkn2;                                                ///< SB and NDB_SF BKN2 - SCH/HD or BNCH
+        bool bBkn2Valid;                                                        ///< BKN2 CRC is valid
+        bool bBkn2Decoded;                                                      ///< BKN2 decoding has been done
+        LowerMacBlock<432> tch;                                                 ///< NDB: BKN1 + BKN2 descrambled as TCH/S
+    };
+
+    /**
+     * @brief Lower MAC channel decoding - clause 8
+     *
+     * Descrambling, deinterleaving, depuncturing, Viterbi, Reed-Muller and CRC are pure
+     * computation on the burst, they depend only on the scrambling code and never on the MAC
+     * state. Instances are independent so bursts can be decoded in parallel, one instance
+     * per thread.
+     *
+     * Between beginBatch() and endBatch(), signalling blocks are only deinterleaved when
+     * decoded, their Viterbi decoding is done by batches of blocks of the same type, one
+     * block per SIMD lane (see ViterbiBatchDecoder1614), when the CPU has a SIMD batch
+     * kernel. Signalling blocks and their valid flags are then only meaningful once
+     * endBatch() returns.
+     *
+     */
+
+    class LowerMac {
+    public:
+        LowerMac(Log * log);
+        ~LowerMac();
+
+        static const uint32_t BSCH_SCRAMBLING_CODE = 0x0003;                    ///< predefined BSCH scrambling code - 8.2.5.2
+        static const std::size_t SCRAMBLING_SEQUENCE_LEN = 432;                 ///< longest scrambled block
+
+        static const uint32_t DECODE_BKN1 = 0x01;                               ///< decode() also decodes BKN1 signalling block
+        static const uint32_t DECODE_BKN2 = 0x02;                               ///< decode() also decodes BKN2 signalling block
+
+        void decode(const uint8_t * data, int burstType, const int8_t * softData, const uint32_t scramblingCode, const uint32_t blocks, LowerMacBurst * res);
+        void decodeBkn1(const uint8_t * data, const int8_t * softData, LowerMacBurst * res);
+        void decodeBkn2(const uint8_t * data, const int8_t * softData, LowerMacBurst * res);
+        void beginBatch();
+        void endBatch();
+
+        void descramble(uint8_t * data, const std::size_t len, const uint32_t scramblingCode);
+        int  reedMuller3014Decode(const uint8_t * data, uint8_t * res);
+        int  checkCrc16Ccitt(const uint8_t * data, const int len);
+
+        /** @brief Decoding stages with latency stats */
+
+        enum Stage {
+            STAGE_DEINTERLEAVE = 0,                                             ///< Descrambling, deinterleaving and depuncturing, in one pass
+            STAGE_VITERBI      = 1,                                             ///< Viterbi decoding, of a whole batch when batching
+            STAGE_CRC          = 2,                                             ///< CRC16 check
+            STAGE_REED_MULLER  = 3,                                             ///< AACH Reed-Muller decoding
+            STAGES_COUNT       = 4,
+        };
+
+        static const char * stageName(const Stage stage);
+        const StageStats & stageStats(const Stage stage) const;
+
+    private:
+        Log * m_log;                                                            ///< LOG for reference Viterbi check
+
+        ViterbiDecoder1614 * m_viterbiDecoder1614;                              ///< Viterbi decoder
+        ViterbiBatchDecoder1614 * m_viterbiBatchDecoder1614;                    ///< Viterbi decoder of blocks batches
+        bool m_bBatchSimd;                                                      ///< Batch kernel is SIMD, the scalar one is slower than block by block decoding
+#ifdef VITERBI_REFERENCE_CHECK
+        ViterbiCodec * m_viterbiCodec1614;                                      ///< Reference string Viterbi codec to check decoder against
+        void viterbiReferenceCheck(const uint8_t * data, const std::size_t len, const uint8_t * res, const std::size_t count);
+#endif
+        uint8_t  m_scramblingSequence[SCRAMBLING_SEQUENCE_LEN];                 ///< Cell scrambling sequence cache
+        uint32_t m_scramblingSequenceCode;                                      ///< Scrambling code of cached sequence
+        bool     m_bScramblingSequenceValid;                                    ///< True when cached sequence is built
+        const uint8_t * scramblingSequence(const uint32_t scramblingCode);
+
+        // intermediate buffers, overwritten by each block decoded
+        uint8_t m_block[SCRAMBLING_SEQUENCE_LEN];                               ///< Block gathered from the two halves of NDB
+        int8_t  m_softBlock[SCRAMBLING_SEQUENCE_LEN];                           ///< Soft block gathered from the two halves of NDB
+
+        BschCodec     m_bschCodec;                                              ///< BSCH channel coding
+        HalfSlotCodec m_halfSlotCodec;                                          ///< SCH/HD, BNCH and STCH channel coding
+        FullSlotCodec m_fullSlotCodec;                                          ///< SCH/F channel coding
+
+        StageStats m_stageStats[STAGES_COUNT];                                  ///< Decoding stages stats, written by the thread owning the instance
+
+        std::size_t viterbiDecode1614(const uint8_t * data, const std::size_t len, uint8_t * res, uint32_t * pathMetric);
+        std::size_t viterbiDecode1614(const int8_t * data, const std::size_t len, uint8_t * res, uint32_t * pathMetric);
+
+        static const std::size_t BATCH_LANES      = ViterbiBatchDecoder1614::MAX_LANES; ///< Blocks decoded by one batch
+        static const std::size_t BATCH_MIN_BLOCKS = 8;                          ///< Smaller batches are faster decoded block by block, even with a SIMD batch kernel
+
+        /** @brief Deinterleaved blocks of one type waiting for batch Viterbi decoding */
+
+        template <typename Codec>
+        struct PendingBlocks {
+            typename Codec::MotherCode     motherCode[BATCH_LANES];             ///< Depunctured blocks
+            typename Codec::SoftMotherCode softMotherCode[BATCH_LANES];         ///< Depunctured soft blocks
+            uint8_t * bits[BATCH_LANES];                                        ///< Decoded bits destination
+            std::size_t * len[BATCH_LANES];                                     ///< Decoded bits count destination
+            uint32_t * pathMetric[BATCH_LANES];                                 ///< Winning path metric destination
+            uint32_t * pathLen[BATCH_LANES];                                    ///< Path metric decoded bits destination
+            bool * bValid[BATCH_LANES];                                         ///< CRC valid flag destination
+            bool bTruncate[BATCH_LANES];                                        ///< Truncate to type-1 bits when CRC is valid
+            std::size_t count;                                                  ///< Pending blocks count
+            bool bSoft;                                                         ///< Pending blocks are soft
+        };
+
+        bool m_bBatch;                                                          ///< True between beginBatch() and endBatch()
+        PendingBlocks<BschCodec>     m_bschPending;                             ///< BSCH blocks to decode
+        PendingBlocks<HalfSlotCodec> m_halfSlotPending;                         ///< SCH/HD, BNCH and STCH blocks to decode
+        PendingBlocks<FullSlotCodec> m_fullSlotPending;                         ///< SCH/F blocks to decode
+
+        template <typename Codec, std::size_t N>
+        void decodeBlock(Codec & codec, PendingBlocks<Codec> & pending, const uint8_t * data, const int8_t * softData, const std::size_t pos, const uint32_t scramblingCode, const bool bTruncate, LowerMacBlock<N> * res, bool * bValid);
+
+        template <typename Codec>
+        void decodePending(PendingBlocks<Codec> & pending);
+
+        void checkBlock(const std::size_t crcBits, const std::size_t payloadBits, const bool bTruncate, uint8_t * bits, std::size_t * len, bool * bValid);
+    };
+
+};
+
+#endif /* LOWER_MAC_H */
@@ -17,17 +17,28 @@
  *
  */
 #include "mac.h"
+#include <algorithm>
+#include <cstring>
 
 using namespace Tetra;
 
-static int curBurstType;
+/**
+ * @brief Extract len symbols from pos in burst
+ *
+ */
+
+template <typename T>
+static std::vector<T> burstExtract(const T * data, const std::size_t pos, const std::size_t len)
+{
+    return std::vector<T>(data + pos, data + pos + len);
+}
 
 /**
  * @brief Constructor
  *
  */
 
-Mac::Mac(Log * log, Report * report, TetraCell * tetraCell, UPlane * uPlane, Llc * llc, Mle * mle, WireMsg * wMsg, bool bRemoveFillBits) : Layer(log, report)
+Mac::Mac(Log * log, Report * report, TetraCell * tetraCell, UPlane * uPlane, Llc * llc, Mle * mle, WireMsg * wMsg, bool bRemoveFillBits, bool bDeltaMode, const MacFilter & macFilter, RecordOutput * recordOutput, VoiceOutput * voiceOutput, LinkQuality * linkQuality) : Layer(log, report)
 {
     m_tetraCell = tetraCell;
 
@@ -35,10 +46,28 @@ Mac::Mac(Log * log, Report * report, TetraCell * tetraCell, UPlane * uPlane, Llc
     m_llc     = llc;
     m_mle     = mle;
     m_wireMsg = wMsg;
+    m_recordOutput = recordOutput;
+    m_voiceOutput  = voiceOutput;
+    m_linkQuality  = linkQuality;
 
     m_bRemoveFillBits = bRemoveFillBits;
+    m_burstType       = 0;
+
+    m_macFilter = macFilter;
+
+    m_bDeltaMode        = bDeltaMode;
+    m_deltaSkippedCount = 0;
+    for (int idx = 0; idx < BROADCAST_PDU_COUNT; idx++)
+    {
+        m_broadcastHash[idx]       = 0;
+        m_bBroadcastHashValid[idx] = false;
+    }
+
+    m_macDefrag = new MacDefrag(log);
 
-    m_macDefrag = new MacDefrag(log->getLevel());
+    m_bSyncReceived = false;
+    memset(&m_macState, 0, sizeof(m_macState));
+    memset(&m_macAddress, 0, sizeof(m_macAddress));                            // reported with SYNC before any addressed PDU
 
     // initialize TDMA time
     m_tetraTime.tn = 1;
@@ -51,28 +80,14 @@ Mac::Mac(Log * log, Report * report, TetraCell * tetraCell, UPlane * uPlane, Llc
         m_usageMarkerEncryptionMode[idx] = 0;
     }
 
-    /*
-     * Initialize Viterbi coder/decoder for MAC
-     *
-     * 8.2.3.1.1 Generator polynomials for the RCPC 16-state mother code of rate 1/4
-     *
-     * G1 = 1 + D +             D^4 (8.3)
-     * G2 = 1 +     D^2 + D^3 + D^4 (8.4)
-     * G3 = 1 + D + D^2 +       D^4 (8.5)
-     * G4 = 1 + D +       D^3 + D^4 (8.6)
-     *
-     * NOTE: representing bit order must be reversed for the codec, eg. 1 + D + 0 + 0 + D^4 -> 10011
-     *
-     */
-
-    std::vector<int> polynomials;
-    int constraint = 6;
-
-    polynomials.push_back(0b10011);
-    polynomials.push_back(0b11101);
-    polynomials.push_back(0b10111);
-    polynomials.push_back(0b11011);
-    m_viterbiCodec1614 = new ViterbiCodec(constraint, polynomials);
+    m_lowerMac = new LowerMac(log);
+
+    for (std::size_t idx = 0; idx < LOGICAL_CHANNELS_COUNT; idx++)
+    {
+        m_crcValid[idx]   = 0;
+        m_crcInvalid[idx] = 0;
+    }
+    m_aachCorrectedBits = 0;
 }
 
 /**
@@ -82,7 +97,7 @@ Mac::Mac(Log * log, Report * report, TetraCell * tetraCell, UPlane * uPlane, Llc
 
 Mac::~Mac()
 {
-    delete m_viterbiCodec1614;
+    delete m_lowerMac;
 }
 
 /**
@@ -95,6 +110,191 @@ TetraTime Mac::getTime()
     return m_tetraTime;
 }
 
+/**
+ * @brief Return number of unchanged broadcast PDU skipped in delta mode
+ *
+ */
+
+uint64_t Mac::deltaSkippedCount()
+{
+    return m_deltaSkippedCount;
+}
+
+/**
+ * @brief Drop reassemblies in progress when no burst was received for idleNs, see MacDefrag::expireIdle
+ *
+ */
+
+void Mac::expireDefrag(const uint64_t idleNs)
+{
+    m_macDefrag->expireIdle(idleNs);
+}
+
+/**
+ * @brief Return ordered stage counters
+ *
+ */
+
+Mac::Stats Mac::stats()
+{
+    Stats res;
+
+    for (std::size_t idx = 0; idx < LOGICAL_CHANNELS_COUNT; idx++)
+    {
+        res.crcValid[idx]   = m_crcValid[idx];
+        res.crcInvalid[idx] = m_crcInvalid[idx];
+    }
+    res.aachCorrectedBits = m_aachCorrectedBits;
+    res.deltaSkipped      = m_deltaSkippedCount;
+    res.defrag            = m_macDefrag->stats();
+
+    return res;
+}
+
+/**
+ * @brief Return stage name for stats
+ *
+ */
+
+const char * Mac::stageName(const Stage stage)
+{
+    switch (stage)
+    {
+    case STAGE_ACCESS_ASSIGN:
+        return "access_assign";
+
+    case STAGE_SYNC:
+        return "sync";
+
+    case STAGE_TRAFFIC:
+        return "traffic";
+
+    case STAGE_RESOURCE:
+        return "resource";
+
+    case STAGE_FRAG:
+        return "frag";
+
+    case STAGE_END:
+        return "end";
+
+    case STAGE_SYSINFO:
+        return "sysinfo";
+
+    case STAGE_ACCESS_DEFINE:
+        return "access_define";
+
+    case STAGE_D_BLOCK:
+        return "d_block";
+
+    case STAGE_OTHER_PDU:
+        return "other_pdu";
+
+    case STAGE_LLC:
+        return "llc";
+
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * @brief Return processing stage stats
+ *
+ */
+
+const StageStats & Mac::stageStats(const Stage stage) const
+{
+    return m_stageStats[stage];
+}
+
+/**
+ * @brief Return defragmenter stage stats
+ *
+ */
+
+const StageStats & Mac::defragStats() const
+{
+    return m_macDefrag->stageStats();
+}
+
+/**
+ * @brief Add stats of the lower MAC used by ordered stage to res
+ *
+ */
+
+void Mac::addLowerMacStats(const LowerMac::Stage stage, StageStats::Snapshot * res) const
+{
+    m_lowerMac->stageStats(stage).addTo(res);
+}
+
+/**
+ * @brief Count CRC check result of a block passed to logical channel, and its Viterbi path
+ *        metric in link quality
+ *
+ */
+
+template <std::size_t N>
+void Mac::countBlock(const MacLogicalChannel channel, const LowerMacBlock<N> & block, const bool bValid)
+{
+    if (m_linkQuality && (block.pathLen > 0))
+    {
+        m_linkQuality->addPathMetric(block.pathMetric, block.pathLen);
+    }
+
+    if ((std::size_t)channel < LOGICAL_CHANNELS_COUNT)
+    {
+        if (bValid)
+        {
+            m_crcValid[channel]++;
+        }
+        else
+        {
+            m_crcInvalid[channel]++;
+        }
+    }
+}
+
+/**
+ * @brief Fill snapshot with cell informations, TDMA time and MAC state
+ *
+ * @return false if no SYNC was received yet, snapshot is then unchanged
+ *
+ */
+
+bool Mac::snapshot(MacSnapshot * res)
+{
+    if (!m_bSyncReceived)
+    {
+        return false;
+    }
+
+    res->mcc         = m_tetraCell->mcc();
+    res->mnc         = m_tetraCell->mnc();
+    res->colorCode   = m_tetraCell->colorCode();
+    res->time        = m_tetraTime;
+    res->wallClockNs = MacSnapshot::currentTimeNs();
+    res->macState    = m_macState;
+    memcpy(res->usageMarkerEncryptionMode, m_usageMarkerEncryptionMode, MacSnapshot::USAGE_MARKERS_COUNT);
+
+    return true;
+}
+
+/**
+ * @brief Restore cell informations, TDMA time advanced to nowNs and MAC state from snapshot
+ *
+ */
+
+void Mac::restore(const MacSnapshot & snapshot, const uint64_t nowNs)
+{
+    m_tetraCell->updateScramblingCode(snapshot.mcc, snapshot.mnc, snapshot.colorCode);
+    m_bSyncReceived = true;
+
+    m_tetraTime = snapshot.timeAt(nowNs);
+    m_macState  = snapshot.macState;
+    memcpy(m_usageMarkerEncryptionMode, snapshot.usageMarkerEncryptionMode, MacSnapshot::USAGE_MARKERS_COUNT);
+}
+
 /**
  * @brief Increment TDMA counter with wrap-up as required
  *
@@ -102,26 +302,36 @@ TetraTime Mac::getTime()
 
 void Mac::incrementTn()
 {
-    m_tetraTime.tn++;
+    incrementTime(&m_tetraTime);
+}
+
+/**
+ * @brief Increment TDMA time by one time slot with wrap-up as required
+ *
+ */
+
+void Mac::incrementTime(TetraTime * time)
+{
+    time->tn++;
 
     // time slot
-    if (m_tetraTime.tn > 4)
+    if (time->tn > 4)
     {
-        m_tetraTime.fn++;
-        m_tetraTime.tn = 1;
+        time->fn++;
+        time->tn = 1;
     }
 
     // frame number
-    if (m_tetraTime.fn > 18)
+    if (time->fn > 18)
     {
-        m_tetraTime.mn++;
-        m_tetraTime.fn = 1;
+        time->mn++;
+        time->fn = 1;
     }
 
     // multi-frame number
-    if (m_tetraTime.mn > 60)
+    if (time->mn > 60)
     {
-        m_tetraTime.mn = 1;
+        time->mn = 1;
     }
 }
 
@@ -170,20 +380,132 @@ std::string Mac::burstName(int val)
  *    TCH
  *    STCH
  *
+ * Burst data are BURST_LEN bits, one per byte.
+ *
  * Notes:
  *   - AACH must be processed first to get traffic or signalling mode
  *   - Fill bit deletion to be tested (see 23.4.3.2)
+ *   - when softData is given, convolutionally coded blocks are decoded from soft symbols,
+ *     AACH and TCH_S use data bits which must be the hard decision of softData
+ *
+ */
+
+void Mac::serviceLowerMac(const uint8_t * data, int burstType, const int8_t * softData)
+{
+    LowerMacBurst burst;
+    m_lowerMac->decode(data, burstType, softData, m_tetraCell->getScramblingCode(), 0, &burst);
+
+    serviceLowerMac(burst, data, softData);
+}
+
+/**
+ * @brief Return the BKN1 and BKN2 blocks worth decoding in advance for a burst on time slot tn,
+ *        see LowerMac::decode
+ *
+ * The logical channel of NDB blocks is only known after AACH, a block is decoded when any
+ * logical channel it may carry is allowed by filter.
+ *
+ */
+
+uint32_t Mac::lowerMacBlocks(int burstType, uint16_t tn)
+{
+    uint32_t blocks = 0;
+
+    if (burstType == SB)
+    {
+        if (m_macFilter.isAllowed(tn, SCH_HD))
+        {
+            blocks |= LowerMac::DECODE_BKN2;
+        }
+    }
+    else if (burstType == NDB)
+    {
+        if (m_macFilter.isAllowed(tn, SCH_F))
+        {
+            blocks |= LowerMac::DECODE_BKN1;
+        }
+    }
+    else if (burstType == NDB_SF)
+    {
+        if (m_macFilter.isAllowed(tn, STCH) || m_macFilter.isAllowed(tn, SCH_HD))
+        {
+            blocks |= LowerMac::DECODE_BKN1;
+        }
+        if (m_macFilter.isAllowed(tn, STCH) || m_macFilter.isAllowed(tn, SCH_HD) || m_macFilter.isAllowed(tn, BNCH))
+        {
+            blocks |= LowerMac::DECODE_BKN2;
+        }
+    }
+
+    return blocks;
+}
+
+/**
+ * @brief Return true if BKN1 carrying logical channel is allowed by filter and valid,
+ *        BKN1 is decoded first when required
+ *
+ */
+
+bool Mac::checkBkn1(LowerMacBurst & burst, const uint8_t * data, const int8_t * softData, const MacLogicalChannel channel)
+{
+    if (!m_macFilter.isAllowed(m_tetraTime.tn, channel))
+    {
+        return false;
+    }
+
+    if (!burst.bBkn1Decoded)
+    {
+        m_lowerMac->decodeBkn1(data, softData, &burst);
+    }
+
+    countBlock(channel, burst.bkn1, burst.bBkn1Valid);
+
+    return burst.bBkn1Valid;
+}
+
+/**
+ * @brief Return true if BKN2 carrying logical channel is allowed by filter and valid,
+ *        BKN2 is decoded first when required
+ *
+ */
+
+bool Mac::checkBkn2(LowerMacBurst & burst, const uint8_t * data, const int8_t * softData, const MacLogicalChannel channel)
+{
+    if (!m_macFilter.isAllowed(m_tetraTime.tn, channel))
+    {
+        return false;
+    }
+
+    if (!burst.bBkn2Decoded)
+    {
+        m_lowerMac->decodeBkn2(data, softData, &burst);
+    }
+
+    countBlock(channel, burst.bkn2, burst.bBkn2Valid);
+
+    return burst.bBkn2Valid;
+}
+
+/**
+ * @brief Lower MAC ordered stage, dispatch decoded burst blocks to logical channels
+ *
+ * Burst blocks may have been decoded in advance with a previous scrambling code, they
+ * are decoded again when the cell scrambling code changed meanwhile. BKN1 and BKN2 blocks
+ * not decoded in advance are decoded here only when their logical channel is allowed by
+ * filter.
  *
  */
 
-void Mac::serviceLowerMac(std::vector<uint8_t> data, int burstType)
+void Mac::serviceLowerMac(LowerMacBurst & burst, const uint8_t * data, const int8_t * softData)
 {
-    m_log->print(LogLevel::HIGH, "DEBUG ::%-44s - burst = %s data = %s\n", "service_lower_mac", burstName(burstType).c_str(), vectorToString(data, data.size()).c_str());
+    int burstType = burst.burstType;
+
+    LOG_PRINT(m_log, LogLevel::HIGH, "DEBUG ::%-44s - burst = %s data = %s\n", "service_lower_mac", burstName(burstType).c_str(), vectorToString(burstExtract(data, 0, BURST_LEN), BURST_LEN).c_str());
 
     bool bnchFlag = false;
     //bool bsch_flag = false;
 
-    curBurstType = burstType;
+    m_burstType = burstType;
 
     if (m_tetraTime.fn == 18)
     {
@@ -199,116 +521,87 @@ void Mac::serviceLowerMac(std::vector<uint8_t> data, int burstType)
 
     m_secondSlotStolenFlag = 0;                                                 // stolen flag lifetime is NDB_SF burst life only
 
-    std::vector<uint8_t> bkn1;                                                  // busrt block BKN1
-    std::vector<uint8_t> bkn2;                                                  // burst block BKN2
-    std::vector<uint8_t> bbk;                                                   // burst block BBK
-
     if (burstType == SB)                                                        // synchronisation burst
     {
-        // BKN1 block - BSCH - SB seems to be sent only on FN=18 thus BKN1 contains only BSCH
-        bkn1 = vectorExtract(data, 94,  120);
-        bkn1 = descramble(bkn1, 120, 0x0003);                                   // descramble with predefined code 0x0003
-        bkn1 = deinterleave(bkn1, 120, 11);                                     // deinterleave 120, 11
-        bkn1 = depuncture23(bkn1, 120);                                         // depuncture with 2/3 rate 120 bits -> 4 * 80 bits before Viterbi decoding
-        bkn1 = viterbiDecode1614(bkn1);                                         // Viterbi decode - see 8.3.1.2  (K1 + 16, K1) block code with K1 = 60
-        if (checkCrc16Ccitt(bkn1, 76))                                          // BSCH found process immediately to calculate scrambling code
+        countBlock(BSCH, burst.bsch, burst.bBschValid);
+
+        if (burst.bBschValid)                                                   // BSCH found process immediately to calculate scrambling code
         {
-            serviceUpperMac(bkn1, BSCH);                                        // only 60 bits are meaningful
+            serviceUpperMac(PduView(burst.bsch), BSCH);                         // only 60 bits are meaningful
         }
 
-        // BBK block - AACH
-        bbk = vectorExtract(data, 252, 30);                                     // BBK
-        bbk = descramble(bbk,  30, m_tetraCell->getScramblingCode());           // descramble
-        bbk = reedMuller3014Decode(bbk);                                        // Reed-Muller correction
-        serviceUpperMac(bbk, AACH);
-
-        // BKN2 block
-        bkn2 = vectorExtract(data, 282, 216);
-        bkn2 = descramble(bkn2, 216, m_tetraCell->getScramblingCode());         // descramble
-        bkn2 = deinterleave(bkn2, 216, 101);                                    // deinterleave
-        bkn2 = depuncture23(bkn2, 216);                                         // depuncture with 2/3 rate 144 bits -> 4 * 144 bits before Viterbi decoding
-        bkn2 = viterbiDecode1614(bkn2);                                         // Viterbi decode
-        if (checkCrc16Ccitt(bkn2, 140))                                         // check CRC
+        if (burst.scramblingCode != m_tetraCell->getScramblingCode())           // AACH and BKN2 use the scrambling code just received
         {
-            bkn2 = vectorExtract(bkn2, 0, 124);
-            serviceUpperMac(bkn2, SCH_HD);
+            m_lowerMac->decode(data, burstType, softData, m_tetraCell->getScramblingCode(), 0, &burst);
+        }
+
+        m_aachCorrectedBits += burst.aachCorrectedBits;
+        serviceUpperMac(PduView(burst.aach), AACH);
+
+        if (checkBkn2(burst, data, softData, SCH_HD))
+        {
+            serviceUpperMac(PduView(burst.bkn2), SCH_HD);
         }
     }
     else if (burstType == NDB)                                                  // 1 logical channel in time slot
     {
-        // BBK block
-        bbk = vectorAppend(vectorExtract(data, 230, 14), vectorExtract(data, 266, 16)); // BBK is in two parts
-        bbk = descramble(bbk, 30, m_tetraCell->getScramblingCode());                    // descramble
-        bbk = reedMuller3014Decode(bbk);                                                // Reed-Muller correction
-        serviceUpperMac(bbk, AACH);
+        if (burst.scramblingCode != m_tetraCell->getScramblingCode())
+        {
+            m_lowerMac->decode(data, burstType, softData, m_tetraCell->getScramblingCode(), 0, &burst);
+        }
 
-        // BKN1 + BKN2
-        bkn1 = vectorAppend(vectorExtract(data, 14, 216), vectorExtract(data, 282, 216)); // reconstruct block to BKN1
-        bkn1 = descramble(bkn1, 432, m_tetraCell->getScramblingCode());                   // descramble
+        m_aachCorrectedBits += burst.aachCorrectedBits;
+        serviceUpperMac(PduView(burst.aach), AACH);
 
         if ((m_macState.downlinkUsage == TRAFFIC) && (m_tetraTime.fn <= 17))    // traffic mode
         {
-            serviceUpperMac(bkn1, TCH_S);                                       // frame is sent directly to User plane
+            if (m_macFilter.isAllowed(m_tetraTime.tn, TCH_S))
+            {
+                if (m_voiceOutput)
+                {
+                    // voice fast path, no upper MAC dispatch, log nor copy
+                    uint64_t startNs = m_stageStats[STAGE_TRAFFIC].start();
+                    uint8_t usageMarker = m_macState.downlinkUsageMarker & 0x3F;
+                    m_macState.logicalChannel = TCH_S;
+                    m_voiceOutput->addFrame(m_tetraTime, usageMarker, m_usageMarkerEncryptionMode[usageMarker], burst.tch.data());
+                    m_stageStats[STAGE_TRAFFIC].record(startNs);
+                }
+                else
+                {
+                    serviceUpperMac(PduView(burst.tch), TCH_S);                 // frame is sent directly to User plane
+                }
+            }
         }
         else                                                                    // signalling mode
         {
-            bkn1 = deinterleave(bkn1, 432, 103);                                // deinterleave
-            bkn1 = depuncture23(bkn1, 432);                                     // depuncture with 2/3 rate 288 bits -> 4 * 288 bits before Viterbi decoding
-            bkn1 = viterbiDecode1614(bkn1);                                     // Viterbi decode
-            if (checkCrc16Ccitt(bkn1, 284))                                     // check CRC
+            if (checkBkn1(burst, data, softData, SCH_F))
             {
-                bkn1 = vectorExtract(bkn1, 0, 268);
-                serviceUpperMac(bkn1, SCH_F);
+                serviceUpperMac(PduView(burst.bkn1), SCH_F);
             }
         }
     }
     else if (burstType == NDB_SF)                                               // NDB with stolen flag
     {
-        bool bkn1ValidFlag = false;
-        bool bkn2ValidFlag = false;
-
-        // BBK block - AACH
-        bbk = vectorAppend(vectorExtract(data, 230, 14), vectorExtract(data, 266, 16)); // BBK is in two parts
-        bbk = descramble(bbk, 30, m_tetraCell->getScramblingCode());                    // descramble
-        bbk = reedMuller3014Decode(bbk);                                                // Reed-Muller correction
-        serviceUpperMac(Pdu(bbk), AACH);
-
-        // BKN1 block - always SCH/HD (CP channel)
-        bkn1 = vectorExtract  (data, 14, 216);
-        bkn1 = descramble(bkn1, 216, m_tetraCell->getScramblingCode());         // descramble
-        bkn1 = deinterleave(bkn1, 216, 101);                                    // deinterleave
-        bkn1 = depuncture23(bkn1, 216);                                         // depuncture with 2/3 rate 144 bits -> 4 * 144 bits before Viterbi decoding
-        bkn1 = viterbiDecode1614(bkn1);                                         // Viterbi decode
-        if (checkCrc16Ccitt(bkn1, 140))                                         // check CRC
+        if (burst.scramblingCode != m_tetraCell->getScramblingCode())
         {
-            bkn1 = vectorExtract(bkn1, 0, 124);
-            bkn1ValidFlag = true;
+            m_lowerMac->decode(data, burstType, softData, m_tetraCell->getScramblingCode(), 0, &burst);
         }
 
-        // BKN2 block - SCH/HD or BNCH
-        bkn2 = vectorExtract(data, 282, 216);
-        bkn2 = descramble(bkn2, 216, m_tetraCell->getScramblingCode());         // descramble
-        bkn2 = deinterleave(bkn2, 216, 101);                                    // deinterleave
-        bkn2 = depuncture23(bkn2, 216);                                         // depuncture with 2/3 rate 144 bits -> 4 * 144 bits before Viterbi decoding
-        bkn2 = viterbiDecode1614(bkn2);                                         // Viterbi decode
-        if (checkCrc16Ccitt(bkn2, 140))                                         // check CRC
-        {
-            bkn2 = vectorExtract(bkn2, 0, 124);
-            bkn2ValidFlag = true;
-        }
+        m_aachCorrectedBits += burst.aachCorrectedBits;
+        serviceUpperMac(PduView(burst.aach), AACH);
 
         if ((m_macState.downlinkUsage == TRAFFIC) && (m_tetraTime.fn <= 17))    // traffic mode
         {
-            if (bkn1ValidFlag)
+            if (checkBkn1(burst, data, softData, STCH))
             {
-                serviceUpperMac(Pdu(bkn1), STCH);                               // first block is stolen for C or U signalling
+                serviceUpperMac(PduView(burst.bkn1), STCH);                     // first block is stolen for C or U signalling
             }
 
             if (m_secondSlotStolenFlag)                                         // if second slot is also stolen
             {
-                if (bkn2ValidFlag)
+                if (checkBkn2(burst, data, softData, STCH))
                 {
-                    serviceUpperMac(Pdu(bkn2), STCH);                           // second block also stolen, reset flag
+                    serviceUpperMac(PduView(burst.bkn2), STCH);                 // second block also stolen, reset flag
                 }
             }
             else                                                                // second slot not stolen, so it is still traffic mode
@@ -318,22 +611,22 @@ void Mac::serviceLowerMac(std::vector<uint8_t> data, int burstType)
         }
         else                                                                    // otherwise signalling mode (see 19.4.4)
         {
-            if (bkn1ValidFlag)
+            if (checkBkn1(burst, data, softData, SCH_HD))
             {
-                serviceUpperMac(Pdu(bkn1), SCH_HD);
+                serviceUpperMac(PduView(burst.bkn1), SCH_HD);
             }
 
-            if (bkn2ValidFlag)
+            if (bnchFlag)
             {
-                if (bnchFlag)
-                {
-                    serviceUpperMac(Pdu(bkn2), BNCH);
-                }
-                else
+                if (checkBkn2(burst, data, softData, BNCH))
                 {
-                    serviceUpperMac(Pdu(bkn2), SCH_HD);
+                    serviceUpperMac(PduView(burst.bkn2), BNCH);
                 }
             }
+            else if (checkBkn2(burst, data, softData, SCH_HD))
+            {
+                serviceUpperMac(PduView(burst.bkn2), SCH_HD);
+            }
         }
     }
     else
@@ -343,6 +636,47 @@ void Mac::serviceLowerMac(std::vector<uint8_t> data, int burstType)
     }
 }
 
+/**
+ * @brief Return the binary record PDU type of a PDU processing stage
+ *
+ */
+
+static RecordOutput::PduType recordPduType(const Mac::Stage stage)
+{
+    switch (stage)
+    {
+    case Mac::STAGE_ACCESS_ASSIGN:
+        return RecordOutput::PDU_ACCESS_ASSIGN;
+
+    case Mac::STAGE_SYNC:
+        return RecordOutput::PDU_SYNC;
+
+    case Mac::STAGE_TRAFFIC:
+        return RecordOutput::PDU_TRAFFIC;
+
+    case Mac::STAGE_RESOURCE:
+        return RecordOutput::PDU_RESOURCE;
+
+    case Mac::STAGE_FRAG:
+        return RecordOutput::PDU_FRAG;
+
+    case Mac::STAGE_END:
+        return RecordOutput::PDU_END;
+
+    case Mac::STAGE_SYSINFO:
+        return RecordOutput::PDU_SYSINFO;
+
+    case Mac::STAGE_ACCESS_DEFINE:
+        return RecordOutput::PDU_ACCESS_DEFINE;
+
+    case Mac::STAGE_D_BLOCK:
+        return RecordOutput::PDU_D_BLOCK;
+
+    default:
+        return RecordOutput::PDU_OTHER;
+    }
+}
+
 /**
  * @brief Process data in logical channel from lower mac
  *        - MAC PDU mapping on logical channels (see 23.2.2)
@@ -370,16 +704,33 @@ void Mac::serviceLowerMac(std::vector<uint8_t> data, int burstType)
  *   unknown = 9
  */
 
-void Mac::serviceUpperMac(Pdu data, MacLogicalChannel macLogicalChannel)
+void Mac::serviceUpperMac(const PduView data, MacLogicalChannel macLogicalChannel)
 {
-    m_log->print(LogLevel::HIGH, "DEBUG ::%-44s - mac_channel = %s data = %s\n", "service_upper_mac", macLogicalChannelName(macLogicalChannel).c_str(), data.toString().c_str());
+    if (m_bDeltaMode && isRepeatedBroadcast(data, macLogicalChannel))
+    {
+        if (macLogicalChannel == BSCH)                                          // TDMA time is still taken from SYNC - see pduProcessSync
+        {
+            m_tetraTime.tn = data.getValue(10, 2) + 1;
+            m_tetraTime.fn = data.getValue(12, 5);
+            m_tetraTime.mn = data.getValue(17, 6);
+        }
+
+        m_deltaSkippedCount++;
+        return;
+    }
+
+    LOG_PRINT(m_log, LogLevel::HIGH, "DEBUG ::%-44s - mac_channel = %s data = %s\n", "service_upper_mac", macLogicalChannelName(macLogicalChannel).c_str(), data.toString().c_str());
 
     // send data to Wireshark if available
-    if (m_wireMsg) m_wireMsg->sendMsg(macLogicalChannel, m_tetraTime, data);
+    if (m_wireMsg) m_wireMsg->sendMsg(macLogicalChannel, m_tetraTime, data.toPdu(m_pduBuffer));
 
     static const int32_t MIN_MAC_RESOURCE_SIZE = 40;                            // NULL_PDU size is 16, but valid MAC-Resource must be longer than 40 bits
 
-    Pdu pdu(data);
+    // dissociation cursor moving forward over the block, each PDU is a view from the cursor to the
+    // end of block and only data outliving the burst is copied
+    const PduView block(data);
+    std::size_t cursor = 0;
+    PduView pdu;
 
     std::string txt;
     uint8_t pduType;
@@ -387,9 +738,10 @@ void Mac::serviceUpperMac(Pdu data, MacLogicalChannel macLogicalChannel)
     uint8_t broadcastType;
 
     bool bSendTmSduToLlc = true;
+    bool bPduAllowed = true;                                                    // TM-SDU of this PDU type may be passed to LLC
     bool fragmentedPacketFlag  = false;
 
-    Pdu tmSdu;
+    PduView tmSdu;
 
     bool dissociatePduFlag = false;
     int32_t pduSizeInMac = 0;                                                   // pdu size in MAC frame to handle MAC decomposition
@@ -399,34 +751,47 @@ void Mac::serviceUpperMac(Pdu data, MacLogicalChannel macLogicalChannel)
     int pduCount = 0;                                                           // number of pdu dissociated
     do
     {
+        uint64_t startNs = m_pduSampler.start();
+        Stage stage = STAGE_OTHER_PDU;
+
+        pdu = PduView(block, cursor);
+
         txt = "?";
 
         dissociatePduFlag = false;
+        pduSizeInMac = 0;                                                       // set by the PDU processing functions which know it
 
         bSendTmSduToLlc = true;
 
+        bPduAllowed = true;
+
         switch (macLogicalChannel)
         {
         case AACH:
+            stage = STAGE_ACCESS_ASSIGN;
             pduProcessAach(pdu);                                                // ACCESS-ASSIGN see 21.4.7 - stop after processing
             txt = "  aach";
             break;
 
         case BSCH:                                                              // SYNC PDU - stop after processing
             txt = "  bsch";
+            stage = STAGE_SYNC;
             tmSdu = pduProcessSync(pdu);
+            bPduAllowed = m_macFilter.isPduAllowed(MacFilter::PDU_SYNC);
             break;
 
         case TCH_S:                                                             // (TMD) MAC-TRAFFIC PDU full slot
-            m_log->print(LogLevel::NONE, "TCH_S       : TN/FN/MN = %2d/%2d/%2d    dl_usage_marker=%d, encr=%u\n", m_tetraTime.tn, m_tetraTime.fn, m_tetraTime.mn, m_macState.downlinkUsageMarker, m_usageMarkerEncryptionMode[m_macState.downlinkUsageMarker]);
+            LOG_PRINT(m_log, LogLevel::NONE, "TCH_S       : TN/FN/MN = %2d/%2d/%2d    dl_usage_marker=%d, encr=%u\n", m_tetraTime.tn, m_tetraTime.fn, m_tetraTime.mn, m_macState.downlinkUsageMarker, m_usageMarkerEncryptionMode[m_macState.downlinkUsageMarker]);
             txt = "  tch_s";
-            m_uPlane->service(pdu, TCH_S, m_tetraTime, m_macAddress, m_macState, m_usageMarkerEncryptionMode[(uint8_t)m_macState.downlinkUsageMarker]);
+            stage = STAGE_TRAFFIC;
+            m_uPlane->service(pdu.toPdu(m_pduBuffer), TCH_S, m_tetraTime, m_macAddress, m_macState, m_usageMarkerEncryptionMode[(uint8_t)m_macState.downlinkUsageMarker]);
             break;
 
         case TCH:                                                               // TCH half-slot TODO not taken into account for now
-            m_log->print(LogLevel::NONE, "TCH         : TN/FN/MN = %2d/%2d/%2d    dl_usage_marker=%d, encr=%u\n", m_tetraTime.tn, m_tetraTime.fn, m_tetraTime.mn, m_macState.downlinkUsageMarker, m_usageMarkerEncryptionMode[m_macState.downlinkUsageMarker]);
+            LOG_PRINT(m_log, LogLevel::NONE, "TCH         : TN/FN/MN = %2d/%2d/%2d    dl_usage_marker=%d, encr=%u\n", m_tetraTime.tn, m_tetraTime.fn, m_tetraTime.mn, m_macState.downlinkUsageMarker, m_usageMarkerEncryptionMode[m_macState.downlinkUsageMarker]);
             txt = "  tch";
-            m_uPlane->service(pdu, TCH, m_tetraTime, m_macAddress, m_macState, m_usageMarkerEncryptionMode[(uint8_t)m_macState.downlinkUsageMarker]);
+            stage = STAGE_TRAFFIC;
+            m_uPlane->service(pdu.toPdu(m_pduBuffer), TCH, m_tetraTime, m_macAddress, m_macState, m_usageMarkerEncryptionMode[(uint8_t)m_macState.downlinkUsageMarker]);
             break;
 
         case STCH:                                                              // TODO stolen channel for signalling if MAC state in traffic mode -> user signalling, otherwise, signalling 19.2.4
@@ -440,7 +805,9 @@ void Mac::serviceUpperMac(Pdu data, MacLogicalChannel macLogicalChannel)
             {
             case 0b00:                                                          // MAC PDU structure for downlink MAC-RESOURCE (TMA)
                 txt = "MAC-RESOURCE";
-                tmSdu = pduProcessResource(pdu, macLogicalChannel, &fragmentedPacketFlag, &pduSizeInMac);
+                stage = STAGE_RESOURCE;
+                tmSdu = pduProcessResource(pdu, &fragmentedPacketFlag, &pduSizeInMac);
+                bPduAllowed = m_macFilter.isPduAllowed(MacFilter::PDU_RESOURCE);
                 if (fragmentedPacketFlag)
                 {
                     // tmSdu to be hold until MAC-END received
@@ -457,14 +824,22 @@ void Mac::serviceUpperMac(Pdu data, MacLogicalChannel macLogicalChannel)
                 if (subType == 0)                                               // MAC-FRAG 21.4.3.2
                 {
                     txt = "MAC-FRAG";
+                    stage = STAGE_FRAG;
                     pduProcessMacFrag(pdu);                                     // no PDU returned // max 120 or 240 bits depending on channel
                     bSendTmSduToLlc = false;
                 }
                 else                                                            // MAC-END 21.4.3.3
                 {
                     txt = "MAC-END";
-                    tmSdu = pduProcessMacEnd(pdu);
-                    bSendTmSduToLlc = true;
+                    stage = STAGE_END;
+                    Pdu sdu = pduProcessMacEnd(pdu);                            // reassembled SDU is owned by the defragmenter, not by the burst
+                    if ((!sdu.isEmpty()) && m_macFilter.isPduAllowed(MacFilter::PDU_FRAG))
+                    {
+                        uint64_t llcStartNs = m_stageStats[STAGE_LLC].start();
+                        m_llc->service(sdu, macLogicalChannel, m_tetraTime, m_macAddress);
+                        m_stageStats[STAGE_LLC].record(llcStartNs);
+                    }
+                    bSendTmSduToLlc = false;
                 }
                 break;
 
@@ -474,11 +849,14 @@ void Mac::serviceUpperMac(Pdu data, MacLogicalChannel macLogicalChannel)
                 {
                 case 0b00:                                                      // SYSINFO see 21.4.4.1 / BNCH on SCH_HD or or STCH
                     txt = "SYSINFO";
+                    stage = STAGE_SYSINFO;
                     tmSdu = pduProcessSysinfo(pdu, &pduSizeInMac);              // TM-SDU (MLE data)
+                    bPduAllowed = m_macFilter.isPduAllowed(MacFilter::PDU_SYSINFO);
                     break;
 
                 case 0b01:                                                      // ACCESS-DEFINE see 21.4.4.3, no sdu
                     txt = "ACCESS-DEFINE";
+                    stage = STAGE_ACCESS_DEFINE;
                     pduProcessAccessDefine(pdu, &pduSizeInMac);                 // 21.4.4.3 - no sdu
                     break;
 
@@ -493,13 +871,15 @@ void Mac::serviceUpperMac(Pdu data, MacLogicalChannel macLogicalChannel)
                 if ((macLogicalChannel != STCH) && (macLogicalChannel != SCH_HD))
                 {
                     txt = "MAC-D-BLCK";                                         // 21.4.1 not sent on SCH/HD or STCH
+                    stage = STAGE_D_BLOCK;
                     tmSdu = pduProcessDBlock(pdu, &pduSizeInMac);
-                    m_log->print(LogLevel::NONE, "%-10s : TN/FN/MN = %2d/%2d/%2d\n", txt.c_str(), m_tetraTime.tn, m_tetraTime.fn, m_tetraTime.mn);
+                    bPduAllowed = m_macFilter.isPduAllowed(MacFilter::PDU_D_BLOCK);
+                    LOG_PRINT(m_log, LogLevel::NONE, "%-10s : TN/FN/MN = %2d/%2d/%2d\n", txt.c_str(), m_tetraTime.tn, m_tetraTime.fn, m_tetraTime.mn);
                 }
                 else
                 {
                     txt = "MAC-ERROR";
-                    m_log->print(LogLevel::NONE, "MAC error   : TN/FN/MN = %2d/%2d/%2d    supplementary block on channel %d\n", m_tetraTime.tn, m_tetraTime.fn, m_tetraTime.mn, macLogicalChannel);
+                    LOG_PRINT(m_log, LogLevel::NONE, "MAC error   : TN/FN/MN = %2d/%2d/%2d    supplementary block on channel %d\n", m_tetraTime.tn, m_tetraTime.fn, m_tetraTime.mn, macLogicalChannel);
                 }
                 break;
 
@@ -532,13 +912,23 @@ void Mac::serviceUpperMac(Pdu data, MacLogicalChannel macLogicalChannel)
         }
 #endif
 
+        if (m_recordOutput)
+        {
+            PduView macPdu = ((pduSizeInMac > 0) && ((std::size_t)pduSizeInMac < pdu.size())) ? PduView(pdu, 0, pduSizeInMac) : pdu;
+            m_recordOutput->addMacPdu(m_tetraTime, m_macAddress.ssi, macLogicalChannel, recordPduType(stage), macPdu);
+        }
+
         // service LLC
-        if ((!tmSdu.isEmpty()) && bSendTmSduToLlc)
+        if ((!tmSdu.isEmpty()) && bSendTmSduToLlc && bPduAllowed)
         {
             // service LLC
-            m_llc->service(tmSdu, macLogicalChannel, m_tetraTime, m_macAddress);
+            uint64_t llcStartNs = m_stageStats[STAGE_LLC].start();
+            m_llc->service(tmSdu.toPdu(m_pduBuffer), macLogicalChannel, m_tetraTime, m_macAddress);
+            m_stageStats[STAGE_LLC].record(llcStartNs);
         }
 
+        m_stageStats[stage].record(startNs);
+
         // Check the remaining size for disassociation
         if (((int32_t)pdu.size() - pduSizeInMac) < MIN_MAC_RESOURCE_SIZE)
         {
@@ -546,12 +936,74 @@ void Mac::serviceUpperMac(Pdu data, MacLogicalChannel macLogicalChannel)
         }
         else if (dissociatePduFlag)
         {
-            pdu = Pdu(pdu, pduSizeInMac);                                       // shift the packet
+            cursor += pduSizeInMac;                                             // next associated PDU
         }
 
     } while (bSendTmSduToLlc && dissociatePduFlag && (pduCount < 32));          // pduCount for loop protection
 }
 
+/**
+ * @brief Delta mode - return true when a SYNC, SYSINFO or ACCESS-DEFINE PDU is identical to
+ *        the last one of its type received, the hash is then updated
+ *
+ * SYNC TN/FN/MN change on each SYNC and are left out of the hash, as is the CRC.
+ *
+ */
+
+bool Mac::isRepeatedBroadcast(const PduView pdu, MacLogicalChannel macLogicalChannel)
+{
+    BroadcastPdu type;
+    std::size_t len = pdu.size();
+    std::size_t timeStart = 0;                                                  // bits [timeStart, timeEnd) are not hashed
+    std::size_t timeEnd   = 0;
+
+    if (macLogicalChannel == BSCH)
+    {
+        type      = BROADCAST_SYNC;
+        len       = std::min(len, (std::size_t)60);                             // only 60 bits are meaningful in BSCH block
+        timeStart = 10;
+        timeEnd   = 23;
+    }
+    else if (((macLogicalChannel == BNCH) || (macLogicalChannel == SCH_F) || (macLogicalChannel == SCH_HD) || (macLogicalChannel == STCH)) &&
+             (pdu.getValue(0, 2) == 0b10))                                      // MAC PDU structure for broadcast (TMB) 21.4.4
+    {
+        uint8_t broadcastType = pdu.getValue(2, 2);
+        if (broadcastType == 0b00)
+        {
+            type = BROADCAST_SYSINFO;
+        }
+        else if (broadcastType == 0b01)
+        {
+            type = BROADCAST_ACCESS_DEFINE;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    uint64_t hash = 0xCBF29CE484222325;                                         // FNV-1a 64 bits
+    for (std::size_t idx = 0; idx < len; idx++)
+    {
+        if ((idx < timeStart) || (idx >= timeEnd))
+        {
+            hash = (hash ^ pdu.data()[idx]) * 0x100000001B3;
+        }
+    }
+    hash = (hash ^ len) * 0x100000001B3;
+
+    bool bRepeated = m_bBroadcastHashValid[type] && (m_broadcastHash[type] == hash);
+
+    m_broadcastHash[type]       = hash;
+    m_bBroadcastHashValid[type] = true;
+
+    return bRepeated;
+}
+
 /**
  * @brief Decode length of MAC-RESOURCE PDU - see 21.4.3.1 table 21.55
  *
@@ -602,9 +1054,9 @@ int32_t Mac::decodeLength(uint32_t val)
  *
  */
 
-void Mac::pduProcessAach(Pdu pdu)
+void Mac::pduProcessAach(const PduView pdu)
 {
-    m_log->print(LogLevel::HIGH, "DEBUG ::%-44s - pdu = %s\n", "mac_pdu_process_aach", pdu.toString().c_str());
+    LOG_PRINT(m_log, LogLevel::HIGH, "DEBUG ::%-44s - pdu = %s\n", "mac_pdu_process_aach", pdu.toString().c_str());
 
     uint8_t pos = 0;
     uint8_t header = pdu.getValue(pos, 2);
@@ -661,24 +1113,25 @@ void Mac::pduProcessAach(Pdu pdu)
  *
  */
 
-Pdu Mac::removeFillBits(const Pdu pdu)
+PduView Mac::removeFillBits(const PduView pdu)
 {
-    Pdu ret = pdu;
+    PduView ret = pdu;
 
     if (m_bRemoveFillBits)
     {
-        if (ret.at(ret.size() - 1) == 1)
+        const uint8_t * bits = pdu.data();
+        std::size_t len = pdu.size();
+
+        while ((len > 0) && (bits[len - 1] == 0))
         {
-            ret.resize(ret.size() - 1);                                         // 23.4.3.2 remove last 1
+            len--;                                                              // 23.4.3.2 remove all 0
         }
-        else
+        if (len > 0)
         {
-            while (ret.at(ret.size() - 1) == 0)
-            {
-                ret.resize(ret.size() - 1);                                     // 23.4.3.2 remove all 0
-            }
-            ret.resize(ret.size() - 1);                                         // 23.4.3.2 then remove last 1
+            len--;                                                              // 23.4.3.2 then remove last 1
         }
+
+        ret.resize(len);                                                        // only the view length changes, empty if no 1 is found
     }
 
     return ret;
@@ -705,11 +1158,11 @@ Pdu Mac::removeFillBits(const Pdu pdu)
  */
 // MAC-RESOURCE 00 00000 000010 000 100000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000
 
-Pdu Mac::pduProcessResource(Pdu mac_pdu, MacLogicalChannel macLogicalChannel, bool * fragmentedPacketFlag, int32_t * pduSizeInMac)
+PduView Mac::pduProcessResource(const PduView mac_pdu, bool * fragmentedPacketFlag, int32_t * pduSizeInMac)
 {
-    m_log->print(LogLevel::HIGH, "DEBUG ::%-44s - pdu = %s\n", "mac_pdu_process_resource", mac_pdu.toString().c_str());
+    LOG_PRINT(m_log, LogLevel::HIGH, "DEBUG ::%-44s - pdu = %s\n", "mac_pdu_process_resource", mac_pdu.toString().c_str());
 
-    Pdu pdu = mac_pdu;
+    PduView pdu = mac_pdu;
 
     *fragmentedPacketFlag = false;
 
@@ -723,7 +1176,7 @@ Pdu Mac::pduProcessResource(Pdu mac_pdu, MacLogicalChannel macLogicalChannel, bo
         // discarded by the MS (see 21.4.3.1) so stop here
         *pduSizeInMac = -1;                                                     // null pdu flag
 
-        return Pdu();                                                           // return empty pdu
+        return PduView();                                                       // return empty pdu
     }
 
     // if we reach here, we don't have a NULL PDU
@@ -893,7 +1346,7 @@ Pdu Mac::pduProcessResource(Pdu mac_pdu, MacLogicalChannel macLogicalChannel, bo
     }
 
 
-    Pdu sdu;
+    PduView sdu;
 
     // in case of NULL pdu, the length shall be 16 bits
     if (! (*fragmentedPacketFlag))                                              // FIXME to check
@@ -911,11 +1364,11 @@ Pdu Mac::pduProcessResource(Pdu mac_pdu, MacLogicalChannel macLogicalChannel, bo
         if (*fragmentedPacketFlag)
         {
             m_macDefrag->start(m_macAddress, getTime());
-            m_macDefrag->append(Pdu(pdu, pos), m_macAddress);                   // length is the whole packet size - pos
+            m_macDefrag->append(PduView(pdu, pos), getTime());                  // length is the whole packet size - pos
         }
         else
         {
-            sdu = Pdu(pdu, pos, sduLength);
+            sdu = PduView(pdu, pos, sduLength);
         }
     }
 
@@ -933,11 +1386,11 @@ Pdu Mac::pduProcessResource(Pdu mac_pdu, MacLogicalChannel macLogicalChannel, bo
  *
  */
 
-void Mac::pduProcessMacFrag(Pdu mac_pdu)
+void Mac::pduProcessMacFrag(const PduView mac_pdu)
 {
-    m_log->print(LogLevel::HIGH, "DEBUG ::%-44s - pdu = %s\n", "mac_pdu_process_mac_frag", mac_pdu.toString().c_str());
+    LOG_PRINT(m_log, LogLevel::HIGH, "DEBUG ::%-44s - pdu = %s\n", "mac_pdu_process_mac_frag", mac_pdu.toString().c_str());
 
-    Pdu pdu = mac_pdu;
+    PduView pdu = mac_pdu;
 
     uint32_t pos = 3;                                                           // MAC PDU type and subtype (MAC-FRAG)
 
@@ -949,9 +1402,7 @@ void Mac::pduProcessMacFrag(Pdu mac_pdu)
         pdu = removeFillBits(pdu);
     }
 
-    Pdu sdu = Pdu(pdu, pos);
-
-    m_macDefrag->append(sdu, m_macAddress);
+    m_macDefrag->append(PduView(pdu, pos), m_tetraTime);                        // MAC-FRAG continues the SDU started on this timeslot
 }
 
 /**
@@ -964,11 +1415,11 @@ void Mac::pduProcessMacFrag(Pdu mac_pdu)
  *
  */
 
-Pdu Mac::pduProcessMacEnd(Pdu mac_pdu)
+Pdu Mac::pduProcessMacEnd(const PduView mac_pdu)
 {
-    m_log->print(LogLevel::HIGH, "DEBUG ::%-44s - pdu = %s\n", "mac_pdu_process_mac_end", mac_pdu.toString().c_str());
+    LOG_PRINT(m_log, LogLevel::HIGH, "DEBUG ::%-44s - pdu = %s\n", "mac_pdu_process_mac_end", mac_pdu.toString().c_str());
 
-    Pdu pdu = mac_pdu;
+    PduView pdu = mac_pdu;
 
     uint32_t pos = 3;                                                           // MAC PDU type and subtype (MAC-END)
 
@@ -1029,20 +1480,18 @@ Pdu Mac::pduProcessMacEnd(Pdu mac_pdu)
 
     Pdu sdu;
 
-    //m_macDefrag->append(vector_extract(pdu, pos, utils_substract(pdu.size(), pos)), m_macAddress);
-    m_macDefrag->append(Pdu(pdu, pos), m_macAddress);
+    m_macDefrag->append(PduView(pdu, pos), m_tetraTime);
 
-    uint8_t encryptionMode;
-    uint8_t usageMarker;
-    sdu = m_macDefrag->getSdu(&encryptionMode, &usageMarker);
+    MacAddress address;
+    sdu = m_macDefrag->getSdu(m_tetraTime, &address);
 
     if (sdu.size() > 0)
     {
-        m_usageMarkerEncryptionMode[usageMarker] = encryptionMode;
-        m_macAddress.encryptionMode              = encryptionMode;              // FIXME it may be required to overwrite the last m_macAddress encryption state with last fragment encryption state of MAC
+        m_usageMarkerEncryptionMode[address.usageMarker] = address.encryptionMode;
+        m_macAddress = address;                                                 // SDU is sent to LLC with the address it was started with, another SSI may have been addressed meanwhile
     }
 
-    m_macDefrag->stop();
+    m_macDefrag->stop(m_tetraTime);
 
     return sdu;
 }
@@ -1053,11 +1502,11 @@ Pdu Mac::pduProcessMacEnd(Pdu mac_pdu)
  *
  */
 
-Pdu Mac::pduProcessSysinfo(Pdu pdu, int32_t * pduSizeInMac)
+PduView Mac::pduProcessSysinfo(const PduView pdu, int32_t * pduSizeInMac)
 {
-    m_log->print(LogLevel::HIGH, "DEBUG ::%-44s - pdu = %s\n", "mac_pdu_process_sysinfo", pdu.toString().c_str());
+    LOG_PRINT(m_log, LogLevel::HIGH, "DEBUG ::%-44s - pdu = %s\n", "mac_pdu_process_sysinfo", pdu.toString().c_str());
 
-    Pdu sdu;
+    PduView sdu;
     *pduSizeInMac = 0;
 
     static const std::size_t MIN_SIZE = 82;
@@ -1104,7 +1553,7 @@ Pdu Mac::pduProcessSysinfo(Pdu pdu, int32_t * pduSizeInMac)
 
         m_tetraCell->setFrequencies((int32_t)band_frequency * 100000000 + (int32_t)main_carrier * 25000 + duplex[offset], 0);
 
-        sdu = Pdu(pdu, pos, 42);                                                // TM-SDU (MLE data) clause 18
+        sdu = PduView(pdu, pos, 42);                                            // TM-SDU (MLE data) clause 18
 
         *pduSizeInMac = pos + 42;                                               // PDU total size in MAC frame
     }
@@ -1123,12 +1572,12 @@ Pdu Mac::pduProcessSysinfo(Pdu pdu, int32_t * pduSizeInMac)
  *
  */
 
-Pdu Mac::pduProcessDBlock(Pdu mac_pdu, int32_t * pduSizeInMac)
+PduView Mac::pduProcessDBlock(const PduView mac_pdu, int32_t * pduSizeInMac)
 {
-    m_log->print(LogLevel::HIGH,"DEBUG ::%-44s - pdu = %s\n", "mac_pdu_process_d_block", mac_pdu.toString().c_str());
+    LOG_PRINT(m_log, LogLevel::HIGH,"DEBUG ::%-44s - pdu = %s\n", "mac_pdu_process_d_block", mac_pdu.toString().c_str());
 
-    Pdu pdu = mac_pdu;
-    Pdu sdu;
+    PduView pdu = mac_pdu;
+    PduView sdu;
 
     static const std::size_t MIN_SIZE = 268;                                    // size is implicit tables 21.62 and 21.63 (18 bits header + 250 SDU)
     *pduSizeInMac = 0;
@@ -1157,7 +1606,7 @@ Pdu Mac::pduProcessDBlock(Pdu mac_pdu, int32_t * pduSizeInMac)
             pos += 8;
         }
 
-        sdu = Pdu(pdu, pos);
+        sdu = PduView(pdu, pos);
         *pduSizeInMac = MIN_SIZE;
     }
     else
@@ -1174,11 +1623,11 @@ Pdu Mac::pduProcessDBlock(Pdu mac_pdu, int32_t * pduSizeInMac)
  *
  */
 
-Pdu Mac::pduProcessSync(Pdu pdu)
+PduView Mac::pduProcessSync(const PduView pdu)
 {
-    m_log->print(LogLevel::HIGH, "DEBUG ::%-44s - pdu = %s\n", "mac_pdu_process_sync", pdu.toString().c_str());
+    LOG_PRINT(m_log, LogLevel::HIGH, "DEBUG ::%-44s - pdu = %s\n", "mac_pdu_process_sync", pdu.toString().c_str());
 
-    Pdu sdu;
+    PduView sdu;
 
     static const std::size_t MIN_SIZE = 60;
 
@@ -1203,13 +1652,14 @@ Pdu Mac::pduProcessSync(Pdu pdu)
         uint16_t mnc = pdu.getValue(41, 14);
 
         m_tetraCell->updateScramblingCode(mcc, mnc, colorCode);
+        m_bSyncReceived = true;
 
         m_report->start("MAC", "SYNC", m_tetraTime, m_macAddress);
         m_report->send();
 
         if ((m_tetraTime.fn == 18) && (((m_tetraTime.mn + m_tetraTime.tn) % 4) == 3))
         {
-            m_log->print(LogLevel::NONE, "BSCH        : TN/FN/MN = %2u/%2u/%2u  MAC-SYNC              ColorCode=%3d  MCC/MNC = %3u/ %3u  Freq= %10.6f MHz  burst=%u\n",
+            LOG_PRINT(m_log, LogLevel::NONE, "BSCH        : TN/FN/MN = %2u/%2u/%2u  MAC-SYNC              ColorCode=%3d  MCC/MNC = %3u/ %3u  Freq= %10.6f MHz  burst=%u\n",
                    m_tetraTime.tn,
                    m_tetraTime.fn,
                    m_tetraTime.mn,
@@ -1217,10 +1667,10 @@ Pdu Mac::pduProcessSync(Pdu pdu)
                    m_tetraCell->mcc(),
                    m_tetraCell->mnc(),
                    m_tetraCell->downlinkFrequency() / 1.0e6,
-                   curBurstType);
+                   m_burstType);
         }
 
-        sdu = Pdu(pdu, pos, 29);
+        sdu = PduView(pdu, pos, 29);
     }
     else
     {
@@ -1236,12 +1686,12 @@ Pdu Mac::pduProcessSync(Pdu pdu)
  *
  */
 
-void Mac::pduProcessAccessDefine(Pdu mac_pdu, int32_t * pduSizeInMac)
+void Mac::pduProcessAccessDefine(const PduView mac_pdu, int32_t * pduSizeInMac)
 {
-    m_log->print(LogLevel::HIGH,"DEBUG ::%-44s - pdu = %s\n", "mac_pdu_process_access_define", mac_pdu.toString().c_str());
+    LOG_PRINT(m_log, LogLevel::HIGH,"DEBUG ::%-44s - pdu = %s\n", "mac_pdu_process_access_define", mac_pdu.toString().c_str());
 
-    Pdu pdu = mac_pdu;
-    Pdu sdu;
+    PduView pdu = mac_pdu;
+    PduView sdu;
 
     uint32_t pos = 2;
     pos += 2;
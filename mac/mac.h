@@ -1,17 +1,26 @@
 #ifndef MAC_H
 #define MAC_H
+#include <vector>
 #include "../common/tetra.h"
 #include "../common/tetracell.h"
 #include "../common/layer.h"
+#include "../common/linkquality.h"
 #include "../common/log.h"
+#include "../common/logmacros.h"
+#include "../common/pduview.h"
 #include "../common/report.h"
+#include "../common/stagestats.h"
 #include "../common/utils.h"
 #include "../llc/llc.h"
 #include "../mle/mle.h"
 #include "../uplane/uplane.h"
 #include "../wiremsg/wiremsg.h"
-#include "viterbi.h"
+#include "../recordoutput.h"
+#include "../voiceoutput.h"
+#include "lowermac.h"
 #include "macdefrag.h"
+#include "macfilter.h"
+#include "macsnapshot.h"
 
 namespace Tetra {
 
@@ -22,15 +31,59 @@ namespace Tetra {
 
     class Mac : public Layer {
     public:
-        Mac(Log * log, Report * report, TetraCell * tetraCell, UPlane * uPlane, Llc * llc, Mle * mle, WireMsg * wMsg, bool bRemoveFillBits);
+        Mac(Log * log, Report * report, TetraCell * tetraCell, UPlane * uPlane, Llc * llc, Mle * mle, WireMsg * wMsg, bool bRemoveFillBits, bool bDeltaMode, const MacFilter & macFilter, RecordOutput * recordOutput = NULL, VoiceOutput * voiceOutput = NULL, LinkQuality * linkQuality = NULL);
         ~Mac();
 
         void incrementTn();
+        static void incrementTime(TetraTime * time);
         TetraTime getTime();
+        uint64_t deltaSkippedCount();
 
-        void serviceLowerMac(std::vector<uint8_t> data, int burst_type);
+        static const std::size_t BURST_LEN = 510;                               ///< Burst length in bits
+
+        void serviceLowerMac(const uint8_t * data, int burst_type, const int8_t * softData = NULL);
+        void serviceLowerMac(LowerMacBurst & burst, const uint8_t * data, const int8_t * softData);
+        uint32_t lowerMacBlocks(int burstType, uint16_t tn);
         std::string burstName(int val);
 
+        /** @brief Ordered stage processing stages with latency stats, PDU stages include the LLC hand-off */
+
+        enum Stage {
+            STAGE_ACCESS_ASSIGN = 0,                                            ///< AACH ACCESS-ASSIGN
+            STAGE_SYNC          = 1,                                            ///< BSCH SYNC
+            STAGE_TRAFFIC       = 2,                                            ///< TCH and TCH_S to U-Plane
+            STAGE_RESOURCE      = 3,                                            ///< MAC-RESOURCE
+            STAGE_FRAG          = 4,                                            ///< MAC-FRAG
+            STAGE_END           = 5,                                            ///< MAC-END
+            STAGE_SYSINFO       = 6,                                            ///< SYSINFO
+            STAGE_ACCESS_DEFINE = 7,                                            ///< ACCESS-DEFINE
+            STAGE_D_BLOCK       = 8,                                            ///< MAC-D-BLCK
+            STAGE_OTHER_PDU     = 9,                                            ///< Reserved or invalid PDU
+            STAGE_LLC           = 10,                                           ///< TM-SDU processing by LLC and upper layers, reports included
+            STAGES_COUNT        = 11,
+        };
+
+        static const std::size_t LOGICAL_CHANNELS_COUNT = 10;                   ///< MacLogicalChannel values count
+
+        /** @brief Ordered stage counters */
+
+        struct Stats {
+            uint64_t crcValid[LOGICAL_CHANNELS_COUNT];                          ///< Blocks with valid CRC per logical channel
+            uint64_t crcInvalid[LOGICAL_CHANNELS_COUNT];                        ///< Blocks with invalid CRC per logical channel
+            uint64_t aachCorrectedBits;                                         ///< AACH bits corrected by Reed-Muller decoding
+            uint64_t deltaSkipped;                                              ///< Unchanged broadcast PDU skipped in delta mode
+            MacDefrag::Stats defrag;                                            ///< Defragmenter counters
+        };
+
+        Stats stats();
+        void expireDefrag(const uint64_t idleNs);
+        bool snapshot(MacSnapshot * res);
+        void restore(const MacSnapshot & snapshot, const uint64_t nowNs);
+        static const char * stageName(const Stage stage);
+        const StageStats & stageStats(const Stage stage) const;
+        const StageStats & defragStats() const;
+        void addLowerMacStats(const LowerMac::Stage stage, StageStats::Snapshot * res) const;
+
     private:
         TetraCell * m_tetraCell;                                                ///< Tetra cell informations
 
@@ -38,37 +91,59 @@ namespace Tetra {
         Mle    * m_mle;                                                         ///< MLE layer
         UPlane * m_uPlane;                                                      ///< U-Plane layer
         WireMsg * m_wireMsg;                                                    ///< Wireshark output
+        RecordOutput * m_recordOutput;                                          ///< Binary MAC PDU records output, NULL if disabled
+        VoiceOutput * m_voiceOutput;                                            ///< TCH/S voice frames fast path output, NULL if disabled
+        LinkQuality * m_linkQuality;                                            ///< Viterbi path metrics statistics, NULL if disabled
 
         MacDefrag * m_macDefrag;                                                ///< MAC defragmenter
+        MacFilter m_macFilter;                                                  ///< Time slots, logical channels and PDU types filter
 
+        bool m_bSyncReceived;                                                   ///< True once cell informations are known, from SYNC or snapshot
         MacState   m_macState;                                                  ///< Current MAC state (from ACCESS-ASSIGN PDU)
         MacAddress m_macAddress;                                                ///< Current MAc address (from MAC-RESOURCE PDU)
         uint8_t m_usageMarkerEncryptionMode[64];                                ///< Usage marker encryption mode for U-Plane (MAC TRAFFIC)
+        std::vector<uint8_t> m_pduBuffer;                                       ///< Bits of the Pdu handed to upper layers, see PduView::toPdu
 
+        int m_burstType;                                                        ///< Current burst type
         uint8_t m_secondSlotStolenFlag;                                         ///< 1 if second slot is stolen
         bool m_bRemoveFillBits;                                                 ///< Remove filling bits flags
-        Pdu removeFillBits(const Pdu pdu);
+        PduView removeFillBits(const PduView pdu);
         int32_t decodeLength(uint32_t val);
 
-        // decoding functions per clause 8
-        ViterbiCodec * m_viterbiCodec1614;                                      ///< Viterbi codec
-        std::vector<uint8_t> descramble(std::vector<uint8_t> data, const int len, const uint32_t scramblingCode);
-        std::vector<uint8_t> deinterleave(std::vector<uint8_t> data, const uint32_t K, const uint32_t a);
-        std::vector<uint8_t> depuncture23(std::vector<uint8_t> data, const uint32_t len);
-        std::vector<uint8_t> viterbiDecode1614(std::vector<uint8_t> data);
-        std::vector<uint8_t> reedMuller3014Decode(std::vector<uint8_t> data);
-        int checkCrc16Ccitt(std::vector<uint8_t> data, const int len);
-
-        void serviceUpperMac(const Pdu data, MacLogicalChannel macLogicalChannel);
-
-        Pdu  pduProcessSync(const Pdu pdu);                                                                                               // process SYNC
-        void pduProcessAach(const Pdu data);                                                                                              // process ACCESS-ASSIGN - no SDU
-        Pdu  pduProcessResource(const Pdu pdu, MacLogicalChannel macLogicalChannel, bool * fragmentedPacketFlag, int32_t * pduSizeInMac); // process MAC-RESOURCE
-        Pdu  pduProcessSysinfo(const Pdu pdu, int32_t * pduSizeInMac);                                                                    // process SYSINFO
-        void pduProcessMacFrag(const Pdu pdu);                                                                                            // process MAC-FRAG
-        Pdu  pduProcessMacEnd(const Pdu pdu);                                                                                             // process MAC-END
-        Pdu  pduProcessDBlock(const Pdu pdu, int32_t * pduSizeInMac);                                                                     // process MAC-D-BLCK
-        void pduProcessAccessDefine(const Pdu pdu, int32_t * pduSizeInMac);                                                               // process ACCESS-DEFINE - no SDU
+        enum BroadcastPdu {
+            BROADCAST_SYNC          = 0,
+            BROADCAST_SYSINFO       = 1,
+            BROADCAST_ACCESS_DEFINE = 2,
+            BROADCAST_PDU_COUNT     = 3,
+        };
+
+        bool m_bDeltaMode;                                                      ///< Skip broadcast PDU identical to the last received ones
+        uint64_t m_broadcastHash[BROADCAST_PDU_COUNT];                          ///< Hash of last broadcast PDU received of each type
+        bool m_bBroadcastHashValid[BROADCAST_PDU_COUNT];                        ///< True when a PDU of the type has been received
+        uint64_t m_deltaSkippedCount;                                           ///< Number of unchanged broadcast PDU skipped
+        bool isRepeatedBroadcast(const PduView pdu, MacLogicalChannel macLogicalChannel);
+
+        LowerMac * m_lowerMac;                                                  ///< Channel decoding per clause 8
+        uint64_t m_crcValid[LOGICAL_CHANNELS_COUNT];                            ///< see Stats
+        uint64_t m_crcInvalid[LOGICAL_CHANNELS_COUNT];                          ///< see Stats
+        uint64_t m_aachCorrectedBits;                                           ///< see Stats
+        StageStats m_stageStats[STAGES_COUNT];                                  ///< Processing stages stats
+        StageSampler m_pduSampler;                                              ///< PDU latency sampling, PDU stage is known only once parsed
+        template <std::size_t N>
+        void countBlock(const MacLogicalChannel channel, const LowerMacBlock<N> & block, const bool bValid);
+        bool checkBkn1(LowerMacBurst & burst, const uint8_t * data, const int8_t * softData, const MacLogicalChannel channel);
+        bool checkBkn2(LowerMacBurst & burst, const uint8_t * data, const int8_t * softData, const MacLogicalChannel channel);
+
+        void serviceUpperMac(const PduView data, MacLogicalChannel macLogicalChannel);
+
+        PduView pduProcessSync(const PduView pdu);                                                                                               // process SYNC
+        void    pduProcessAach(const PduView data);                                                                                              // process ACCESS-ASSIGN - no SDU
+        PduView pduProcessResource(const PduView pdu, bool * fragmentedPacketFlag, int32_t * pduSizeInMac); // process MAC-RESOURCE
+        PduView pduProcessSysinfo(const PduView pdu, int32_t * pduSizeInMac);                                                                    // process SYSINFO
+        void    pduProcessMacFrag(const PduView pdu);                                                                                            // process MAC-FRAG
+        Pdu     pduProcessMacEnd(const PduView pdu);                                                                                             // process MAC-END
+        PduView pduProcessDBlock(const PduView pdu, int32_t * pduSizeInMac);                                                                     // process MAC-D-BLCK
+        void    pduProcessAccessDefine(const PduView pdu, int32_t * pduSizeInMac);                                                               // process ACCESS-DEFINE - no SDU
     };
 
 };
@@ -1,21 +1,29 @@
 #include "macdefrag.h"
+#include <cstring>
+#include "../common/logmacros.h"
 
 using namespace Tetra;
 
-static const int DEBUG_VAL = 3;                                                 // start debug informations at this level
+static const LogLevel DEBUG_VAL = LogLevel::HIGH;                               // start debug informations at this level
+static const LogLevel LOSS_VAL  = LogLevel::LOW;                                // lost reassemblies informations at this level
+static const uint64_t TIME_SLOT_NS = 85000000 / 6;                              // 85/6 ms, see 9.3
 
 /**
  * @brief Defragmenter constructor
  *
  */
 
-MacDefrag::MacDefrag(int debug_level)
+MacDefrag::MacDefrag(Log * log)
 {
-    g_debug_level = debug_level;
-    m_sdu.clear();
+    m_log = log;
 
-    m_fragmentsCount = 0;
-    b_stopped        = true;
+    for (std::size_t idx = 0; idx < POOL_LEN; idx++)
+    {
+        m_entries[idx].bUsed = false;
+        m_entries[idx].sdu.clear();
+    }
+
+    memset(&m_stats, 0, sizeof(m_stats));
 }
 
 /**
@@ -25,138 +33,261 @@ MacDefrag::MacDefrag(int debug_level)
 
 MacDefrag::~MacDefrag()
 {
-    m_sdu.clear();
+    for (std::size_t idx = 0; idx < POOL_LEN; idx++)
+    {
+        m_entries[idx].sdu.clear();
+    }
 }
 
 /**
- * @brief Start defragmenter, flush previous data if already in use
- *        and report informations
+ * @brief Return counters
  *
- * NOTE: total fragmented length is unknown
+ */
+
+MacDefrag::Stats MacDefrag::stats()
+{
+    return m_stats;
+}
+
+/**
+ * @brief Return fragments append and SDU read latency stats
  *
  */
 
-void MacDefrag::start(const MacAddress address, const TetraTime timeSlot)
+const StageStats & MacDefrag::stageStats() const
 {
-    if (m_sdu.size() > 0u)
-    {
-        if (g_debug_level >= DEBUG_VAL)
-        {
-            printf("  * DEFRAG FAILED   : invalid %d fragments received for SSI = %u: %u recovered for address %u\n",
-                   m_fragmentsCount,
-                   macAddress.ssi,
-                   (uint32_t)m_sdu.size(),
-                   macAddress.ssi);
-        }
-    }
+    return m_stageStats;
+}
+
+/**
+ * @brief Time slot number in hyperframe-less TDMA time, wraps every 60 multiframes
+ *
+ */
+
+uint32_t MacDefrag::slotNumber(const TetraTime timeSlot)
+{
+    return ((uint32_t)(timeSlot.mn - 1) * 18 + (uint32_t)(timeSlot.fn - 1)) * 4 + (uint32_t)(timeSlot.tn - 1);
+}
 
-    macAddress     = address;                                                   // at this point, the defragmenter MAC address contains encryption mode
-    startTime      = timeSlot;
-    m_fragmentsCount = 0;
+/**
+ * @brief Return reassembly in progress on timeslot, NULL if none
+ *
+ */
 
-    if (g_debug_level >= DEBUG_VAL)
+MacDefrag::Entry * MacDefrag::current(const TetraTime timeSlot)
+{
+    if ((timeSlot.tn < 1) || (timeSlot.tn > POOL_LEN) || !m_entries[timeSlot.tn - 1].bUsed)
     {
-        printf("  * DEFRAG START    : SSI = %u - TN/FN/MN = %02u/%02u/%02u\n",
-               macAddress.ssi,
-               startTime.tn,
-               startTime.fn,
-               startTime.mn);
+        return NULL;
     }
 
-    m_sdu.clear();                                                              // clear the buffer
+    return &m_entries[timeSlot.tn - 1];
+}
 
-    b_stopped = false;
+/**
+ * @brief Free reassembly entry
+ *
+ */
+
+void MacDefrag::release(Entry * entry)
+{
+    entry->bUsed          = false;
+    entry->fragmentsCount = 0;
+    entry->sdu.clear();
 }
 
 /**
- * @brief Append data to defragmenter
+ * @brief Drop reassemblies started more than TIMEOUT_SLOTS ago
  *
  */
 
-void MacDefrag::append(Pdu sdu, const MacAddress address)
+void MacDefrag::expire(const TetraTime timeSlot)
 {
-    if (b_stopped)                                                              // we can't append if in stopped mode
+    const uint32_t HYPERFRAME_SLOTS = 60 * 18 * 4;                              // slot number period
+    uint32_t now = slotNumber(timeSlot);
+
+    for (std::size_t idx = 0; idx < POOL_LEN; idx++)
     {
-        if (g_debug_level >= DEBUG_VAL)
+        Entry * entry = &m_entries[idx];
+        if (entry->bUsed && (((now + HYPERFRAME_SLOTS - entry->startSlot) % HYPERFRAME_SLOTS) > TIMEOUT_SLOTS))
         {
-            printf("  * DEFRAG APPEND   : FAILED SSI = %u\n", address.ssi);
+            drop(entry);
         }
     }
-    else if (address.ssi != macAddress.ssi)                                     // check mac addresses
+}
+
+/**
+ * @brief Drop all reassemblies when no burst was received for more than TIMEOUT_SLOTS
+ *
+ */
+
+void MacDefrag::expireIdle(const uint64_t idleNs)
+{
+    if (idleNs <= TIMEOUT_SLOTS * TIME_SLOT_NS)
     {
-        stop();                                                                 // stop defragmenter
+        return;
+    }
 
-        if (g_debug_level >= DEBUG_VAL)
+    for (std::size_t idx = 0; idx < POOL_LEN; idx++)
+    {
+        if (m_entries[idx].bUsed)
         {
-            printf("  * DEFRAG APPEND   : FAILED appending SSI = %u while fragment SSI = %u\n", macAddress.ssi, address.ssi);
+            drop(&m_entries[idx]);
         }
     }
+}
+
+/**
+ * @brief Release timed out reassembly and report informations
+ *
+ */
+
+void MacDefrag::drop(Entry * entry)
+{
+    LOG_PRINT(m_log, LOSS_VAL, "  * DEFRAG TIMEOUT  : SSI = %u - TN/FN/MN = %02u/%02u/%02u - fragment %d - length = %u\n",
+                               entry->macAddress.ssi,
+                               entry->startTime.tn,
+                               entry->startTime.fn,
+                               entry->startTime.mn,
+                               entry->fragmentsCount,
+                               (uint32_t)entry->sdu.size());
+    m_stats.timedOut++;
+    release(entry);
+}
+
+/**
+ * @brief Release reassembly restarted or superseded by address before its end and report informations
+ *
+ */
+
+void MacDefrag::fail(Entry * entry, const MacAddress address)
+{
+    LOG_PRINT(m_log, LOSS_VAL, "  * DEFRAG FAILED   : invalid %d fragments received for SSI = %u: %u recovered for address %u\n",
+                               entry->fragmentsCount,
+                               entry->macAddress.ssi,
+                               (uint32_t)entry->sdu.size(),
+                               address.ssi);
+    m_stats.failed++;
+    release(entry);
+}
+
+/**
+ * @brief Start reassembly for address on timeslot and report informations
+ *
+ * The reassembly in progress on the timeslot fails, whether it is restarted by the same SSI
+ * or superseded by another one which following fragments can't be told apart from.
+ *
+ * NOTE: total fragmented length is unknown
+ *
+ */
+
+void MacDefrag::start(const MacAddress address, const TetraTime timeSlot)
+{
+    expire(timeSlot);
+
+    if ((timeSlot.tn < 1) || (timeSlot.tn > POOL_LEN))
+    {
+        LOG_PRINT(m_log, LOSS_VAL, "  * DEFRAG START    : FAILED TN = %u\n", timeSlot.tn);
+        m_stats.failed++;
+        return;
+    }
+
+    Entry * entry = &m_entries[timeSlot.tn - 1];
+    if (entry->bUsed)
+    {
+        fail(entry, address);
+    }
+
+    entry->bUsed          = true;
+    entry->macAddress     = address;                                            // at this point, the defragmenter MAC address contains encryption mode
+    entry->startTime      = timeSlot;
+    entry->startSlot      = slotNumber(timeSlot);
+    entry->fragmentsCount = 0;
+    entry->sdu.clear();                                                         // clear the buffer
+
+    m_stats.started++;
+
+    LOG_PRINT(m_log, DEBUG_VAL, "  * DEFRAG START    : SSI = %u - TN/FN/MN = %02u/%02u/%02u\n",
+                                entry->macAddress.ssi,
+                                entry->startTime.tn,
+                                entry->startTime.fn,
+                                entry->startTime.mn);
+}
+
+/**
+ * @brief Append data to the reassembly in progress on timeslot
+ *
+ */
+
+void MacDefrag::append(const PduView sdu, const TetraTime timeSlot)
+{
+    StageTimer timer(m_stageStats);
+
+    expire(timeSlot);
+
+    Entry * entry = current(timeSlot);
+
+    if (!entry)                                                                 // we can't append without reassembly started
+    {
+        LOG_PRINT(m_log, LOSS_VAL, "  * DEFRAG APPEND   : FAILED TN = %u\n", timeSlot.tn);
+        m_stats.failed++;
+    }
     else
     {
-        m_sdu.append(sdu);
-        m_fragmentsCount++;
+        entry->sdu.append(sdu);
+        entry->fragmentsCount++;
 
-        if (g_debug_level >= DEBUG_VAL)
-        {
-            std::size_t sduLen = sdu.size();
-            printf("  * DEFRAG APPEND   : SSI = %u - TN/FN/MN = %02u/%02u/%02u - fragment %d - length = sdu %u / m_sdu %u - encr = %u\n",
-                   macAddress.ssi,
-                   startTime.tn,
-                   startTime.fn,
-                   startTime.mn,
-                   m_fragmentsCount,
-                   (uint32_t)sduLen,
-                   (uint32_t)m_sdu.size(),
-                   macAddress.encryptionMode
-                );
-        }
+        LOG_PRINT(m_log, DEBUG_VAL, "  * DEFRAG APPEND   : SSI = %u - TN/FN/MN = %02u/%02u/%02u - fragment %d - length = sdu %u / m_sdu %u - encr = %u\n",
+                                    entry->macAddress.ssi,
+                                    entry->startTime.tn,
+                                    entry->startTime.fn,
+                                    entry->startTime.mn,
+                                    entry->fragmentsCount,
+                                    (uint32_t)sdu.size(),
+                                    (uint32_t)entry->sdu.size(),
+                                    entry->macAddress.encryptionMode);
     }
 }
 
 /**
- * @brief Check SDU validity and return it
+ * @brief Check SDU validity and return it with the reassembly MAC address
  *
  */
 
-Pdu MacDefrag::getSdu(uint8_t * encryptionMode, uint8_t * usageMarker)
+Pdu MacDefrag::getSdu(const TetraTime timeSlot, MacAddress * address)
 {
+    StageTimer timer(m_stageStats);
+
     Pdu ret;
 
-    if (b_stopped)
+    Entry * entry = current(timeSlot);
+
+    if (!entry)
     {
-        if (g_debug_level >= DEBUG_VAL)
-        {
-            printf("  * DEFRAG END      : FAILED SSI = %u - TN/FN/MN = %02u/%02u/%02u - fragment %d - length = %u - encr = %u\n",
-                   macAddress.ssi,
-                   startTime.tn,
-                   startTime.fn,
-                   startTime.mn,
-                   m_fragmentsCount,
-                   (uint32_t)m_sdu.size(),
-                   macAddress.encryptionMode
-                );
-        }
+        LOG_PRINT(m_log, LOSS_VAL, "  * DEFRAG END      : FAILED TN = %u\n", timeSlot.tn);
     }
     else
     {
         // FIXME add check
-        *encryptionMode = macAddress.encryptionMode;
-        *usageMarker    = macAddress.usageMarker;
-        ret = m_sdu;
+        *address = entry->macAddress;
+        ret = entry->sdu.toPdu();
+        m_stats.completed++;
     }
 
     return ret;
 }
 
 /**
- * @brief Stop defragmenter
+ * @brief Stop reassembly in progress on timeslot
  *
  */
 
-void MacDefrag::stop()
+void MacDefrag::stop(const TetraTime timeSlot)
 {
     // clean stop
-    b_stopped = true;
-    m_fragmentsCount = 0;
-    m_sdu.clear();
+    Entry * entry = current(timeSlot);
+    if (entry)
+    {
+        release(entry);
+    }
 }
@@ -23,34 +23,82 @@
 #include <string>
 #include "../common/tetra.h"
 #include "../common/pdu.h"
+#include "../common/log.h"
+#include "../common/stagestats.h"
+#include "../common/pduview.h"
+#include "../common/bitbuffer.h"
 
 namespace Tetra {
     
     /**
      * @brief MAC defragmenter
      *
+     * Reassemblies are keyed by (SSI, timeslot): a fragmented MAC-RESOURCE starts one,
+     * following MAC-FRAG and MAC-END carry no address and continue the reassembly in
+     * progress on their timeslot. Several SSI can thus be reassembled at once on different
+     * timeslots, but only one per timeslot: a reassembly another SSI leaves unfinished on
+     * the timeslot can't get any further fragment and fails.
+     *
+     * Reassemblies are held in a fixed pool of one entry per timeslot, and are dropped
+     * TIMEOUT_SLOTS time slots after their start. Since time slots only advance with
+     * received bursts, expireIdle() drops them too when the carrier is silent for as long.
+     *
+     * Fragments are appended to a packed bits buffer which keeps its capacity when the
+     * entry is reused, the SDU is only unpacked once complete.
+     *
      */
 
     class MacDefrag {
     public:
-        MacDefrag(int debug_level);
+        MacDefrag(Log * log);
         ~MacDefrag();
 
-        MacAddress macAddress;                                                  // MAC address
-        TetraTime  startTime;                                                   // start time of defragemnter (will be used to stop on missing/invalid end frag packet receive)
-
         void start(const MacAddress address, const TetraTime timeSlot);
-        void append(Pdu sdu, const MacAddress address);
-        void stop();
+        void append(const PduView sdu, const TetraTime timeSlot);
+        void stop(const TetraTime timeSlot);
+        void expireIdle(const uint64_t idleNs);
+
+        Pdu getSdu(const TetraTime timeSlot, MacAddress * address);
+
+        /** @brief Reassemblies counters */
 
-        Pdu getSdu(uint8_t * encryptionMode, uint8_t * usageMarker);
+        struct Stats {
+            uint64_t started;                                                   ///< Reassemblies started
+            uint64_t completed;                                                 ///< Reassemblies completed by a MAC-END
+            uint64_t timedOut;                                                  ///< Reassemblies dropped by timeout
+            uint64_t failed;                                                    ///< Restarted or superseded before end, or fragment without reassembly
+        };
+
+        Stats stats();
+        const StageStats & stageStats() const;
 
     private:
-        Pdu m_sdu;                                                              // reconstructed TM-SDU to be transfered to LLC
+        static const std::size_t POOL_LEN      = 4;                             ///< Reassemblies in progress at most, one per timeslot
+        static const uint32_t    TIMEOUT_SLOTS = 4 * 18 * 4;                    ///< Reassembly timeout since start, 4 multiframes ~ 4 s
+
+        /** @brief One reassembly */
+
+        struct Entry {
+            bool bUsed;                                                         ///< Entry is in use
+            MacAddress macAddress;                                              ///< MAC address, contains encryption mode and usage marker
+            TetraTime  startTime;                                               ///< Time slot of MAC-RESOURCE starting the reassembly
+            uint32_t   startSlot;                                               ///< startTime slot number, see slotNumber
+            uint8_t    fragmentsCount;                                          ///< Fragments count
+            BitBuffer  sdu;                                                     ///< Reconstructed TM-SDU to be transfered to LLC
+        };
+
+        Entry * current(const TetraTime timeSlot);
+        void release(Entry * entry);
+        void expire(const TetraTime timeSlot);
+        void drop(Entry * entry);
+        void fail(Entry * entry, const MacAddress address);
+        static uint32_t slotNumber(const TetraTime timeSlot);
+
+        Log * m_log;                                                            // LOG for defragmenter debug informations
 
-        int g_debug_level;
-        bool b_stopped;
-        uint8_t m_fragmentsCount;
+        Entry m_entries[POOL_LEN];                                              // Reassemblies pool, entry idx is timeslot TN idx + 1
+        Stats m_stats;                                                          // Counters
+        StageStats m_stageStats;                                                // Fragments append and SDU read latency
     };
 
 };
@@ -0,0 +1,166 @@
+/*
+ *  tetra-kit
+ *  Copyright (C) 2020  LarryTh <dev@logami.fr>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "macfilter.h"
+#include <cstring>
+#include <strings.h>
+
+using namespace Tetra;
+
+/** @brief Name of a list element and its bit */
+
+struct FilterName {
+    const char * name;
+    uint32_t bit;
+};
+
+/**
+ * @brief Parse comma separated list of names (case insensitive) to a bits mask
+ *
+ * @return false if a name is unknown or the list is empty, mask is then unchanged
+ *
+ */
+
+static bool parseNames(const char * str, const FilterName * names, const std::size_t namesCount, uint32_t * mask)
+{
+    uint32_t res = 0;
+
+    const char * pos = str;
+    while (*pos != '\0')
+    {
+        std::size_t len = strcspn(pos, ",");
+
+        std::size_t idx = 0;
+        while ((idx < namesCount) && ((strlen(names[idx].name) != len) || (strncasecmp(pos, names[idx].name, len) != 0)))
+        {
+            idx++;
+        }
+
+        if (idx == namesCount)
+        {
+            return false;
+        }
+
+        res |= 1U << names[idx].bit;
+
+        pos += len;
+        if (*pos == ',')
+        {
+            pos++;
+        }
+    }
+
+    if (res == 0)
+    {
+        return false;
+    }
+
+    *mask = res;
+
+    return true;
+}
+
+/**
+ * @brief Constructor, everything is allowed
+ *
+ */
+
+MacFilter::MacFilter()
+{
+    m_timeSlots = 0xFFFFFFFF;
+    m_channels  = 0xFFFFFFFF;
+    m_pduTypes  = 0xFFFFFFFF;
+}
+
+/**
+ * @brief Parse allowed time slots list, eg. "1,3"
+ *
+ */
+
+bool MacFilter::parseTimeSlots(const char * str)
+{
+    static const FilterName names[] = {
+        {"1", 1},
+        {"2", 2},
+        {"3", 3},
+        {"4", 4},
+    };
+
+    return parseNames(str, names, sizeof(names) / sizeof(names[0]), &m_timeSlots);
+}
+
+/**
+ * @brief Parse allowed logical channels list, eg. "SCH_F,SCH_HD,BNCH"
+ *
+ */
+
+bool MacFilter::parseChannels(const char * str)
+{
+    static const FilterName names[] = {
+        {"SCH_F",  SCH_F},
+        {"SCH_HD", SCH_HD},
+        {"STCH",   STCH},
+        {"BNCH",   BNCH},
+        {"TCH_S",  TCH_S},
+    };
+
+    return parseNames(str, names, sizeof(names) / sizeof(names[0]), &m_channels);
+}
+
+/**
+ * @brief Parse allowed MAC PDU types list, eg. "resource,frag"
+ *
+ */
+
+bool MacFilter::parsePduTypes(const char * str)
+{
+    static const FilterName names[] = {
+        {"sync",     PDU_SYNC},
+        {"resource", PDU_RESOURCE},
+        {"frag",     PDU_FRAG},
+        {"sysinfo",  PDU_SYSINFO},
+        {"dblock",   PDU_D_BLOCK},
+    };
+
+    return parseNames(str, names, sizeof(names) / sizeof(names[0]), &m_pduTypes);
+}
+
+/**
+ * @brief Return true if logical channel on time slot tn must be decoded, AACH and BSCH always are
+ *
+ */
+
+bool MacFilter::isAllowed(const uint16_t tn, const MacLogicalChannel channel) const
+{
+    if ((channel == AACH) || (channel == BSCH))
+    {
+        return true;
+    }
+
+    return ((m_timeSlots >> tn) & 1) && ((m_channels >> channel) & 1);
+}
+
+/**
+ * @brief Return true if TM-SDU of MAC PDU type must be passed to LLC
+ *
+ */
+
+bool MacFilter::isPduAllowed(const PduType type) const
+{
+    return (m_pduTypes >> type) & 1;
+}
@@ -0,0 +1,67 @@
+/*
+ *  tetra-kit
+ *  Copyright (C) 2020  LarryTh <dev@logami.fr>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef MAC_FILTER_H
+#define MAC_FILTER_H
+#include <cstdint>
+#include "../common/tetra.h"
+
+namespace Tetra {
+
+    /**
+     * @brief Time slots, logical channels and MAC PDU types filter
+     *
+     * Blocks on a time slot or logical channel not allowed are not channel decoded (no
+     * descrambling, deinterleaving, depuncturing nor Viterbi). AACH and BSCH are always
+     * decoded since they drive the MAC state and the synchronization.
+     *
+     * MAC PDU of types not allowed are still parsed to keep the MAC state (addresses, usage
+     * markers, defragmentation, cell informations), but their TM-SDU is not passed to LLC.
+     *
+     * Everything is allowed by default.
+     *
+     */
+
+    class MacFilter {
+    public:
+        MacFilter();
+
+        enum PduType {
+            PDU_SYNC     = 0,                                                   ///< SYNC on BSCH
+            PDU_RESOURCE = 1,                                                   ///< MAC-RESOURCE
+            PDU_FRAG     = 2,                                                   ///< MAC-FRAG and MAC-END
+            PDU_SYSINFO  = 3,                                                   ///< SYSINFO
+            PDU_D_BLOCK  = 4,                                                   ///< MAC-D-BLCK
+        };
+
+        bool parseTimeSlots(const char * str);
+        bool parseChannels(const char * str);
+        bool parsePduTypes(const char * str);
+
+        bool isAllowed(const uint16_t tn, const MacLogicalChannel channel) const;
+        bool isPduAllowed(const PduType type) const;
+
+    private:
+        uint32_t m_timeSlots;                                                   ///< Bit tn set when time slot tn is allowed
+        uint32_t m_channels;                                                    ///< Bit channel set when logical channel is allowed
+        uint32_t m_pduTypes;                                                    ///< Bit type set when PDU type is allowed
+    };
+
+};
+
+#endif /* MAC_FILTER_H */
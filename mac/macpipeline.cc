@@ -0,0 +1,395 @@
+/*
+ *  tetra-kit
+ *  Copyright (C) 2020  LarryTh <dev@logami.fr>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "macpipeline.h"
+
+using namespace Tetra;
+
+/**
+ * @brief Constructor, start workers
+ *
+ * When a worker thread can't be created, jobs are shared by the started ones, bursts are
+ * processed directly by the calling thread if none could be started.
+ *
+ */
+
+MacPipeline::MacPipeline(Log * log, Mac * mac, TetraCell * tetraCell, std::size_t workersCount)
+{
+    m_mac        = mac;
+    m_tetraCell  = tetraCell;
+    m_pushSeq    = 0;
+    m_deliverSeq = 0;
+    m_bStop      = false;
+    m_doneFd     = eventfd(0, EFD_CLOEXEC);
+
+    m_bDeliverWaiting = false;
+
+    if (workersCount < 1)
+    {
+        workersCount = 1;
+    }
+
+    m_jobsCount = workersCount * JOBS_PER_WORKER;
+    m_jobs      = new Job[m_jobsCount];
+
+    for (std::size_t idx = 0; idx < workersCount; idx++)
+    {
+        Worker * worker   = new Worker();
+        worker->parent    = this;
+        worker->lowerMac  = new LowerMac(log);
+        worker->wakeupFd  = eventfd(0, EFD_CLOEXEC);
+        worker->bSleeping = false;
+        worker->bStarted  = (m_doneFd >= 0) && (worker->wakeupFd >= 0) && (pthread_create(&worker->thread, NULL, workerThread, worker) == 0);
+
+        if (!worker->bStarted)
+        {
+            fprintf(stderr, "Couldn't create MAC worker thread %zu\n", idx);
+            if (worker->wakeupFd >= 0)
+            {
+                close(worker->wakeupFd);
+            }
+            delete worker->lowerMac;
+            delete worker;
+            break;
+        }
+
+        m_workers.push_back(worker);
+    }
+
+    if (m_workers.size() > 0)
+    {
+        m_jobsCount = m_workers.size() * JOBS_PER_WORKER;                       // workers queues can hold all jobs in flight
+    }
+}
+
+/**
+ * @brief Destructor, deliver pending bursts and stop workers
+ *
+ */
+
+MacPipeline::~MacPipeline()
+{
+    flush();
+
+    m_bStop = true;
+    for (std::size_t idx = 0; idx < m_workers.size(); idx++)
+    {
+        signalFd(m_workers[idx]->wakeupFd);
+        pthread_join(m_workers[idx]->thread, NULL);
+        close(m_workers[idx]->wakeupFd);
+        delete m_workers[idx]->lowerMac;
+        delete m_workers[idx];
+    }
+
+    if (m_doneFd >= 0)
+    {
+        close(m_doneFd);
+    }
+
+    delete[] m_jobs;
+}
+
+/**
+ * @brief Receive a time slot, data is NULL when no valid burst was found
+ *
+ * Burst is copied so buffers can be reused as soon as the function returns. Bursts
+ * already decoded are delivered, the call only blocks when all jobs are in flight.
+ *
+ */
+
+void MacPipeline::serviceLowerMac(const uint8_t * data, int burstType, const int8_t * softData)
+{
+    if (m_workers.empty())
+    {
+        m_mac->incrementTn();
+        if (data)
+        {
+            m_mac->serviceLowerMac(data, burstType, softData);
+        }
+        return;
+    }
+
+    if (m_pushSeq - m_deliverSeq >= m_jobsCount)                                // ring is full, wait for oldest job
+    {
+        deliver(true);
+    }
+
+    Job * job = &m_jobs[m_pushSeq % m_jobsCount];
+
+    uint16_t tn = (uint16_t)((m_mac->getTime().tn + (m_pushSeq - m_deliverSeq)) % 4 + 1); // time slot once pending jobs are delivered
+
+    job->bBurst         = (data != NULL);
+    job->bSoft          = (softData != NULL);
+    job->burstType      = burstType;
+    job->scramblingCode = m_tetraCell->getScramblingCode();                     // may be updated by a SYNC still in flight, see Mac::serviceLowerMac
+    job->blocks         = m_mac->lowerMacBlocks(burstType, tn);
+    job->bDone.store(!job->bBurst, std::memory_order_relaxed);
+
+    if (job->bBurst)
+    {
+        memcpy(job->data, data, Mac::BURST_LEN);
+        if (job->bSoft)
+        {
+            memcpy(job->softData, softData, Mac::BURST_LEN);
+        }
+
+        Worker * worker = m_workers[m_pushSeq % m_workers.size()];
+        worker->queue.push(job);                                                // can't fail, worker holds at most JOBS_PER_WORKER jobs
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);                    // push before sleeping flag, pairs with decodeJobs
+        if (worker->bSleeping.load(std::memory_order_relaxed))
+        {
+            signalFd(worker->wakeupFd);
+        }
+    }
+
+    m_pushSeq++;
+
+    while (deliver(false))
+    {
+        // deliver all bursts ready in order
+    }
+}
+
+/**
+ * @brief Return TDMA time of the last received time slot, once the time slots in flight are delivered
+ *
+ * Time is predicted from the MAC time, a SYNC in flight may still change it.
+ *
+ */
+
+TetraTime MacPipeline::receivedTime()
+{
+    TetraTime res = m_mac->getTime();
+
+    for (uint64_t seq = m_deliverSeq; seq < m_pushSeq; seq++)
+    {
+        Mac::incrementTime(&res);
+    }
+
+    return res;
+}
+
+/**
+ * @brief Add stats of the workers lower MAC to res, may be called while workers are running
+ *
+ */
+
+void MacPipeline::addLowerMacStats(const LowerMac::Stage stage, StageStats::Snapshot * res) const
+{
+    for (std::size_t idx = 0; idx < m_workers.size(); idx++)
+    {
+        m_workers[idx]->lowerMac->stageStats(stage).addTo(res);
+    }
+}
+
+/**
+ * @brief Deliver all pending time slots
+ *
+ */
+
+void MacPipeline::flush()
+{
+    while (deliver(true))
+    {
+        // wait for all bursts
+    }
+}
+
+/**
+ * @brief Deliver the oldest time slot to the MAC ordered stage
+ *
+ * @return false if there is no pending time slot, or it is not decoded yet and bWait is false
+ *
+ */
+
+bool MacPipeline::deliver(bool bWait)
+{
+    if (m_deliverSeq == m_pushSeq)
+    {
+        return false;
+    }
+
+    Job * job = &m_jobs[m_deliverSeq % m_jobsCount];
+
+    uint32_t count = 0;
+    while (!job->bDone.load(std::memory_order_acquire))
+    {
+        if (!bWait)
+        {
+            return false;
+        }
+
+        if (backoff(&count))
+        {
+            continue;
+        }
+
+        m_bDeliverWaiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);                    // sleeping flag before done check, pairs with decodeJobs
+        if (!job->bDone.load(std::memory_order_acquire))
+        {
+            waitFd(m_doneFd);
+        }
+        m_bDeliverWaiting.store(false, std::memory_order_relaxed);
+    }
+
+    m_mac->incrementTn();
+    if (job->bBurst)
+    {
+        m_mac->serviceLowerMac(job->burst, job->data, job->bSoft ? job->softData : NULL);
+    }
+
+    m_deliverSeq++;
+
+    return true;
+}
+
+/**
+ * @brief Wait a little longer on each call: spin, then yield
+ *
+ * @return false once the caller should block instead
+ *
+ */
+
+bool MacPipeline::backoff(uint32_t * count)
+{
+    const uint32_t SPIN_COUNT  = 64;
+    const uint32_t YIELD_COUNT = 128;
+
+    if (*count >= YIELD_COUNT)
+    {
+        return false;
+    }
+
+    if (*count >= SPIN_COUNT)
+    {
+        sched_yield();
+    }
+
+    (*count)++;
+
+    return true;
+}
+
+/**
+ * @brief Wake up a thread blocked in waitFd()
+ *
+ */
+
+void MacPipeline::signalFd(int fd)
+{
+    uint64_t val = 1;
+    if (write(fd, &val, sizeof(val)) < 0)
+    {
+        perror("Couldn't wake MAC pipeline thread up");
+    }
+}
+
+/**
+ * @brief Block until fd is signaled, stale signals only cause a spurious wake up
+ *
+ */
+
+void MacPipeline::waitFd(int fd)
+{
+    uint64_t val;
+    while ((read(fd, &val, sizeof(val)) < 0) && (errno == EINTR))
+    {
+        // interrupted, wait again
+    }
+}
+
+/**
+ * @brief Worker thread entry point
+ *
+ */
+
+void * MacPipeline::workerThread(void * arg)
+{
+    Worker * worker = (Worker *)arg;
+
+    worker->parent->decodeJobs(worker);
+
+    return NULL;
+}
+
+/**
+ * @brief Decode jobs until stop is requested
+ *
+ * All jobs waiting in the queue are decoded together so their signalling blocks are
+ * Viterbi decoded by batches, a lone job is decoded as soon as it is received.
+ *
+ */
+
+void MacPipeline::decodeJobs(Worker * worker)
+{
+    uint32_t count = 0;
+
+    while (!m_bStop.load(std::memory_order_relaxed))
+    {
+        Job * jobs[JOBS_PER_WORKER];
+        std::size_t jobsCount = 0;
+        while ((jobsCount < JOBS_PER_WORKER) && worker->queue.pop(&jobs[jobsCount]))
+        {
+            jobsCount++;
+        }
+
+        if (jobsCount == 0)
+        {
+            if (!backoff(&count))
+            {
+                worker->bSleeping.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);            // sleeping flag before queue check, pairs with serviceLowerMac
+                if ((worker->queue.size() == 0) && !m_bStop.load(std::memory_order_relaxed))
+                {
+                    waitFd(worker->wakeupFd);
+                }
+                worker->bSleeping.store(false, std::memory_order_relaxed);
+                count = 0;
+            }
+            continue;
+        }
+        count = 0;
+
+        worker->lowerMac->beginBatch();
+        for (std::size_t idx = 0; idx < jobsCount; idx++)
+        {
+            Job * job = jobs[idx];
+            worker->lowerMac->decode(job->data, job->burstType, job->bSoft ? job->softData : NULL, job->scramblingCode, job->blocks, &job->burst);
+        }
+        worker->lowerMac->endBatch();
+
+        for (std::size_t idx = 0; idx < jobsCount; idx++)
+        {
+            jobs[idx]->bDone.store(true, std::memory_order_release);
+        }
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);                    // done before waiting flag, pairs with deliver
+        if (m_bDeliverWaiting.load(std::memory_order_relaxed))
+        {
+            signalFd(m_doneFd);
+        }
+    }
+}
@@ -0,0 +1,117 @@
+/*
+ *  tetra-kit
+ *  Copyright (C) 2020  LarryTh <dev@logami.fr>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef MAC_PIPELINE_H
+#define MAC_PIPELINE_H
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <pthread.h>
+#include "../common/spscqueue.h"
+#include "../common/tetracell.h"
+#include "mac.h"
+#include "lowermac.h"
+
+namespace Tetra {
+
+    /**
+     * @brief Pipelined lower MAC
+     *
+     * Bursts channel decoding (LowerMac) runs on worker threads, decoded bursts are then
+     * delivered to the MAC ordered stage (TDMA time, upper MAC and above) in reception order
+     * on the calling thread.
+     *
+     * Bursts are kept in a ring of jobs indexed by a sequence number, job seq is decoded by
+     * worker seq % workers count through a SPSC queue and delivered once it and all previous
+     * ones are done. The ring is the reorder buffer: a sequence number identifies one
+     * TN/FN/MN time slot since the MAC time is incremented once per job. A worker decodes
+     * all the jobs waiting in its queue as one LowerMac batch.
+     *
+     * Waiting threads spin shortly then block on an eventfd: an idle worker sleeps until a
+     * job is pushed to its queue, and the ordered stage waiting for a job sleeps until a
+     * worker completes a batch, so the pipeline costs no CPU without bursts.
+     *
+     * NDB blocks are speculatively decoded both as traffic and signalling since the AACH
+     * deciding between them is only processed in the ordered stage, unless the MAC filter
+     * rejects them on the time slot the job will be delivered on. Bursts decoded with a
+     * stale scrambling code are decoded again by the ordered stage, as blocks not decoded
+     * in advance when they are required.
+     *
+     */
+
+    class MacPipeline {
+    public:
+        MacPipeline(Log * log, Mac * mac, TetraCell * tetraCell, std::size_t workersCount);
+        ~MacPipeline();
+
+        void serviceLowerMac(const uint8_t * data, int burstType, const int8_t * softData);
+        void flush();
+        TetraTime receivedTime();
+        void addLowerMacStats(const LowerMac::Stage stage, StageStats::Snapshot * res) const;
+
+    private:
+        static const std::size_t JOBS_PER_WORKER = 16;                          ///< Bursts in flight per worker
+
+        /** @brief One time slot to be processed */
+
+        struct Job {
+            uint8_t  data[Mac::BURST_LEN];                                      ///< Burst bits
+            int8_t   softData[Mac::BURST_LEN];                                  ///< Burst soft symbols if bSoft
+            bool     bSoft;                                                     ///< Soft symbols are available
+            bool     bBurst;                                                    ///< False when no valid burst, only the time slot is counted
+            int      burstType;                                                 ///< Burst type
+            uint32_t scramblingCode;                                            ///< Cell scrambling code when burst was received
+            uint32_t blocks;                                                    ///< BKN1 and BKN2 blocks to decode in advance, see LowerMac::decode
+            std::atomic<bool> bDone;                                            ///< Decoding is done, set by worker
+            LowerMacBurst burst;                                                ///< Decoded blocks
+        };
+
+        /** @brief Decoding worker thread */
+
+        struct Worker {
+            MacPipeline * parent;                                               ///< Owner
+            pthread_t thread;                                                   ///< Worker thread
+            bool bStarted;                                                      ///< True when thread is running
+            LowerMac * lowerMac;                                                ///< Worker own decoder
+            SpscQueue<Job *, JOBS_PER_WORKER> queue;                            ///< Jobs to decode
+            int wakeupFd;                                                       ///< eventfd signaled when a job is pushed while sleeping
+            std::atomic<bool> bSleeping;                                        ///< Worker is about to block on wakeupFd
+        };
+
+        static void * workerThread(void * arg);
+        static bool backoff(uint32_t * count);
+        static void signalFd(int fd);
+        static void waitFd(int fd);
+        void decodeJobs(Worker * worker);
+        bool deliver(bool bWait);
+
+        Mac * m_mac;                                                            ///< MAC ordered stage
+        TetraCell * m_tetraCell;                                                ///< Cell scrambling code at reception time
+        std::vector<Worker *> m_workers;                                        ///< Decoding workers
+        Job * m_jobs;                                                           ///< Jobs ring, job seq is m_jobs[seq % m_jobsCount]
+        std::size_t m_jobsCount;                                                ///< Jobs ring length
+        uint64_t m_pushSeq;                                                     ///< Sequence number of next received time slot
+        uint64_t m_deliverSeq;                                                  ///< Sequence number of next time slot to deliver
+        std::atomic<bool> m_bStop;                                              ///< Request workers to exit
+        int m_doneFd;                                                           ///< eventfd signaled when a batch is done while the ordered stage waits
+        std::atomic<bool> m_bDeliverWaiting;                                    ///< Ordered stage is about to block on m_doneFd
+    };
+
+};
+
+#endif /* MAC_PIPELINE_H */
@@ -0,0 +1,202 @@
+/*
+ *  tetra-kit
+ *  Copyright (C) 2020  LarryTh <dev@logami.fr>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "macsnapshot.h"
+#include "mac.h"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+
+using namespace Tetra;
+
+static const uint64_t TIME_SLOT_NS = 85000000 / 6;                              // 85/6 ms, see 9.3
+static const uint32_t TIME_SLOTS_PER_HYPERFRAME = 4 * 18 * 60;                  // TN, FN and MN wrap
+
+/**
+ * @brief Write snapshot to filename.tmp then rename it to filename
+ *
+ * @return false if the file can't be written, previous snapshot is then kept
+ *
+ */
+
+bool MacSnapshot::save(const std::string & filename) const
+{
+    std::string tmpName = filename + ".tmp";
+
+    FILE * file = fopen(tmpName.c_str(), "w");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    fprintf(file, "version %u\n", VERSION);
+    fprintf(file, "wall_clock_ns %llu\n", (unsigned long long)wallClockNs);
+    fprintf(file, "mcc %u\n", mcc);
+    fprintf(file, "mnc %u\n", mnc);
+    fprintf(file, "color_code %u\n", colorCode);
+    fprintf(file, "tn %u\n", time.tn);
+    fprintf(file, "fn %u\n", time.fn);
+    fprintf(file, "mn %u\n", time.mn);
+    fprintf(file, "logical_channel %d\n", (int)macState.logicalChannel);
+    fprintf(file, "downlink_usage %d\n", (int)macState.downlinkUsage);
+    fprintf(file, "downlink_usage_marker %u\n", macState.downlinkUsageMarker);
+    fprintf(file, "usage_marker_encryption");
+    for (std::size_t idx = 0; idx < USAGE_MARKERS_COUNT; idx++)
+    {
+        fprintf(file, " %u", usageMarkerEncryptionMode[idx]);
+    }
+    fprintf(file, "\n");
+
+    bool bOk = (fflush(file) == 0) && (fsync(fileno(file)) == 0);
+    bOk = (fclose(file) == 0) && bOk;
+
+    if (!bOk || (rename(tmpName.c_str(), filename.c_str()) != 0))
+    {
+        unlink(tmpName.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Read snapshot from filename
+ *
+ * @return false if the file is missing, of another version or incomplete, snapshot is then unchanged
+ *
+ */
+
+bool MacSnapshot::load(const std::string & filename)
+{
+    enum Key {
+        KEY_VERSION = 0, KEY_WALL_CLOCK, KEY_MCC, KEY_MNC, KEY_COLOR_CODE, KEY_TN, KEY_FN, KEY_MN,
+        KEY_LOGICAL_CHANNEL, KEY_DOWNLINK_USAGE, KEY_DOWNLINK_USAGE_MARKER, KEYS_COUNT
+    };
+
+    static const char * const KEY_NAMES[KEYS_COUNT] = {
+        "version", "wall_clock_ns", "mcc", "mnc", "color_code", "tn", "fn", "mn",
+        "logical_channel", "downlink_usage", "downlink_usage_marker"
+    };
+
+    FILE * file = fopen(filename.c_str(), "r");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    unsigned long long vals[KEYS_COUNT];
+    bool bFound[KEYS_COUNT] = {false};
+    uint8_t encryptionModes[USAGE_MARKERS_COUNT];
+    bool bEncryptionModes = false;
+    char key[64];
+
+    while (fscanf(file, "%63s", key) == 1)
+    {
+        if (strcmp(key, "usage_marker_encryption") == 0)
+        {
+            std::size_t idx = 0;
+            unsigned int val;
+            while ((idx < USAGE_MARKERS_COUNT) && (fscanf(file, "%u", &val) == 1))
+            {
+                encryptionModes[idx++] = (uint8_t)val;
+            }
+            bEncryptionModes = (idx == USAGE_MARKERS_COUNT);
+            continue;
+        }
+
+        unsigned long long val;
+        if (fscanf(file, "%llu", &val) != 1)
+        {
+            break;
+        }
+
+        for (int idx = 0; idx < KEYS_COUNT; idx++)
+        {
+            if (strcmp(key, KEY_NAMES[idx]) == 0)
+            {
+                vals[idx]   = val;
+                bFound[idx] = true;
+            }
+        }                                                                       // unknown keys are ignored
+    }
+
+    fclose(file);
+
+    bool bComplete = bEncryptionModes;
+    for (int idx = 0; idx < KEYS_COUNT; idx++)
+    {
+        bComplete = bComplete && bFound[idx];
+    }
+
+    if (!bComplete || (vals[KEY_VERSION] != VERSION) ||
+        (vals[KEY_TN] < 1) || (vals[KEY_TN] > 4) || (vals[KEY_FN] < 1) || (vals[KEY_FN] > 18) || (vals[KEY_MN] < 1) || (vals[KEY_MN] > 60))
+    {
+        return false;
+    }
+
+    mcc         = (uint32_t)vals[KEY_MCC];
+    mnc         = (uint16_t)vals[KEY_MNC];
+    colorCode   = (uint16_t)vals[KEY_COLOR_CODE];
+    time.tn     = (uint16_t)vals[KEY_TN];
+    time.fn     = (uint16_t)vals[KEY_FN];
+    time.mn     = (uint16_t)vals[KEY_MN];
+    wallClockNs = (uint64_t)vals[KEY_WALL_CLOCK];
+    macState.logicalChannel      = (MacLogicalChannel)vals[KEY_LOGICAL_CHANNEL];
+    macState.downlinkUsage       = (DownlinkUsage)vals[KEY_DOWNLINK_USAGE];
+    macState.downlinkUsageMarker = (uint8_t)vals[KEY_DOWNLINK_USAGE_MARKER];
+    memcpy(usageMarkerEncryptionMode, encryptionModes, USAGE_MARKERS_COUNT);
+
+    return true;
+}
+
+/**
+ * @brief Return TDMA time advanced by the time slots elapsed between snapshot and nowNs
+ *
+ * Only an estimate, the decoder input latency is not known. Actual time is set by the next SYNC.
+ *
+ */
+
+TetraTime MacSnapshot::timeAt(const uint64_t nowNs) const
+{
+    TetraTime res = time;
+
+    if (nowNs > wallClockNs)
+    {
+        uint64_t slots = ((nowNs - wallClockNs) / TIME_SLOT_NS) % TIME_SLOTS_PER_HYPERFRAME;
+        for (uint64_t idx = 0; idx < slots; idx++)
+        {
+            Mac::incrementTime(&res);
+        }
+    }
+
+    return res;
+}
+
+/**
+ * @brief Wall clock time in ns since epoch
+ *
+ */
+
+uint64_t MacSnapshot::currentTimeNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
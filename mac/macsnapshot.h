@@ -0,0 +1,61 @@
+/*
+ *  tetra-kit
+ *  Copyright (C) 2020  LarryTh <dev@logami.fr>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef MAC_SNAPSHOT_H
+#define MAC_SNAPSHOT_H
+#include <cstdint>
+#include <string>
+#include "../common/tetra.h"
+
+namespace Tetra {
+
+    /**
+     * @brief Cell and MAC state snapshot for warm start
+     *
+     * Holds what is otherwise only learnt from a SYNC and the following PDU: cell identity
+     * (so the scrambling code), TDMA time with the wall clock time it was valid at, MAC
+     * state and usage markers encryption modes. Restored at startup, AACH and SCH blocks are
+     * descrambled with the right code from the first burst found instead of the next SYNC.
+     *
+     * The file is a text file of "key value" lines, written to a temporary file then renamed
+     * so a crash never leaves a partial snapshot.
+     *
+     */
+
+    struct MacSnapshot {
+        static const uint32_t VERSION = 1;                                      ///< File format version
+        static const std::size_t USAGE_MARKERS_COUNT = 64;                      ///< Usage markers count
+
+        uint32_t mcc;                                                           ///< Mobile country code
+        uint16_t mnc;                                                           ///< Mobile network code
+        uint16_t colorCode;                                                     ///< Colour code
+        TetraTime time;                                                         ///< TDMA time at wallClockNs
+        uint64_t wallClockNs;                                                   ///< Wall clock time of the snapshot, ns since epoch
+        MacState macState;                                                      ///< MAC state from last ACCESS-ASSIGN
+        uint8_t usageMarkerEncryptionMode[USAGE_MARKERS_COUNT];                 ///< Encryption mode per usage marker
+
+        bool save(const std::string & filename) const;
+        bool load(const std::string & filename);
+        TetraTime timeAt(const uint64_t nowNs) const;
+
+        static uint64_t currentTimeNs();
+    };
+
+};
+
+#endif /* MAC_SNAPSHOT_H */
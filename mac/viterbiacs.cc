@@ -0,0 +1,918 @@
+/*
+ *  tetra-kit
+ *  Copyright (C) 2020  LarryTh <dev@logami.fr>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "viterbiacs.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VITERBI_ACS_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define VITERBI_ACS_NEON
+#include <arm_neon.h>
+#if defined(__linux__) && !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+using namespace Tetra;
+
+/**
+ * @brief Branch metric of output 0 and sum of both costs for the 4 symbols of a step
+ *
+ * The cost of hypothesis 0 is max(s, 0) and the cost of hypothesis 1 is max(-s, 0),
+ * so the metric of a branch with output bits b is c0 - sum(b[i] * s[i])
+ *
+ */
+
+static inline void stepCosts(const int8_t * sym, uint16_t * c0, uint16_t * total)
+{
+    int32_t cost0 = 0;
+    int32_t sum   = 0;
+
+    for (int idx = 0; idx < 4; idx++)
+    {
+        int32_t val = sym[idx];
+        cost0 += val > 0 ? val : 0;
+        sum   += val > 0 ? val : -val;
+    }
+
+    *c0    = (uint16_t)cost0;
+    *total = (uint16_t)sum;
+}
+
+/**
+ * @brief Portable kernel
+ *
+ */
+
+static void acsScalar(const int8_t * symbols, const std::size_t steps, const uint8_t * outputs, uint16_t * pathMetrics, uint16_t * traceback)
+{
+    for (std::size_t step = 0; step < steps; step++)
+    {
+        const int8_t * sym = symbols + 4 * step;
+
+        uint16_t c0;
+        uint16_t total;
+        stepCosts(sym, &c0, &total);
+
+        uint16_t newMetrics[16];
+        uint16_t decisions = 0;
+        uint16_t minMetric = 0xFFFF;
+
+        for (int j = 0; j < 8; j++)
+        {
+            int32_t dot = 0;
+            for (int idx = 0; idx < 4; idx++)
+            {
+                dot += ((outputs[j] >> idx) & 1) * sym[idx];
+            }
+
+            uint16_t bm0 = (uint16_t)(c0 - dot);                                // metric of branch output
+            uint16_t bm1 = (uint16_t)(total - bm0);                             // metric of complemented branch output
+
+            uint16_t even = pathMetrics[2 * j];
+            uint16_t odd  = pathMetrics[2 * j + 1];
+
+            uint16_t x0 = (uint16_t)(even + bm0);                               // state j, input 0
+            uint16_t x1 = (uint16_t)(odd  + bm1);
+            uint16_t y0 = (uint16_t)(even + bm1);                               // state j + 8, input 1
+            uint16_t y1 = (uint16_t)(odd  + bm0);
+
+            newMetrics[j]     = x0;
+            newMetrics[j + 8] = y0;
+
+            if (x1 < x0)
+            {
+                newMetrics[j] = x1;
+                decisions |= (uint16_t)(1 << j);
+            }
+
+            if (y1 < y0)
+            {
+                newMetrics[j + 8] = y1;
+                decisions |= (uint16_t)(1 << (j + 8));
+            }
+        }
+
+        for (int state = 0; state < 16; state++)
+        {
+            if (newMetrics[state] < minMetric)
+            {
+                minMetric = newMetrics[state];
+            }
+        }
+
+        for (int state = 0; state < 16; state++)
+        {
+            pathMetrics[state] = (uint16_t)(newMetrics[state] - minMetric);     // renormalise
+        }
+
+        traceback[step] = decisions;
+    }
+}
+
+#ifdef VITERBI_ACS_X86
+
+/**
+ * @brief Output bits of butterflies 0..3 and 4..7 laid out for maddubs against 4 broadcast symbols
+ *
+ */
+
+static void buildDotMasks(const uint8_t * outputs, uint8_t * mask0, uint8_t * mask1)
+{
+    for (int j = 0; j < 8; j++)
+    {
+        uint8_t * mask = j < 4 ? mask0 : mask1;
+        for (int idx = 0; idx < 4; idx++)
+        {
+            mask[4 * (j % 4) + idx] = (outputs[j] >> idx) & 1;
+        }
+    }
+}
+
+/**
+ * @brief SSE4.1 kernel, 16 states in two registers of 8 x 16 bits
+ *
+ */
+
+__attribute__((target("sse4.1")))
+static void acsSse41(const int8_t * symbols, const std::size_t steps, const uint8_t * outputs, uint16_t * pathMetrics, uint16_t * traceback)
+{
+    uint8_t mask0[16];
+    uint8_t mask1[16];
+    buildDotMasks(outputs, mask0, mask1);
+
+    const __m128i bits0   = _mm_loadu_si128((const __m128i *)mask0);
+    const __m128i bits1   = _mm_loadu_si128((const __m128i *)mask1);
+    const __m128i lowMask = _mm_set1_epi32(0xFFFF);
+
+    __m128i pmLo = _mm_loadu_si128((const __m128i *)pathMetrics);               // states 0..7
+    __m128i pmHi = _mm_loadu_si128((const __m128i *)(pathMetrics + 8));         // states 8..15
+
+    for (std::size_t step = 0; step < steps; step++)
+    {
+        const int8_t * sym = symbols + 4 * step;
+
+        uint16_t c0;
+        uint16_t total;
+        stepCosts(sym, &c0, &total);
+
+        int32_t sym32;
+        memcpy(&sym32, sym, sizeof(sym32));
+        __m128i sv = _mm_set1_epi32(sym32);
+
+        __m128i dot = _mm_hadd_epi16(_mm_maddubs_epi16(bits0, sv), _mm_maddubs_epi16(bits1, sv));
+        __m128i bm0 = _mm_sub_epi16(_mm_set1_epi16((int16_t)c0), dot);
+        __m128i bm1 = _mm_sub_epi16(_mm_set1_epi16((int16_t)total), bm0);
+
+        __m128i even = _mm_packus_epi32(_mm_and_si128(pmLo, lowMask), _mm_and_si128(pmHi, lowMask));
+        __m128i odd  = _mm_packus_epi32(_mm_srli_epi32(pmLo, 16), _mm_srli_epi32(pmHi, 16));
+
+        __m128i x0 = _mm_add_epi16(even, bm0);
+        __m128i x1 = _mm_add_epi16(odd,  bm1);
+        __m128i y0 = _mm_add_epi16(even, bm1);
+        __m128i y1 = _mm_add_epi16(odd,  bm0);
+
+        __m128i lo = _mm_min_epu16(x0, x1);
+        __m128i hi = _mm_min_epu16(y0, y1);
+
+        __m128i keep = _mm_packs_epi16(_mm_cmpeq_epi16(lo, x0), _mm_cmpeq_epi16(hi, y0));
+        traceback[step] = (uint16_t)~_mm_movemask_epi8(keep);
+
+        __m128i minMetric = _mm_minpos_epu16(_mm_min_epu16(lo, hi));
+        minMetric = _mm_shuffle_epi32(_mm_shufflelo_epi16(minMetric, 0), 0);
+
+        pmLo = _mm_sub_epi16(lo, minMetric);
+        pmHi = _mm_sub_epi16(hi, minMetric);
+    }
+
+    _mm_storeu_si128((__m128i *)pathMetrics, pmLo);
+    _mm_storeu_si128((__m128i *)(pathMetrics + 8), pmHi);
+}
+
+/**
+ * @brief AVX2 kernel, 16 states in one register of 16 x 16 bits
+ *
+ */
+
+__attribute__((target("avx2")))
+static void acsAvx2(const int8_t * symbols, const std::size_t steps, const uint8_t * outputs, uint16_t * pathMetrics, uint16_t * traceback)
+{
+    uint8_t mask0[16];
+    uint8_t mask1[16];
+    buildDotMasks(outputs, mask0, mask1);
+
+    const __m128i bits0   = _mm_loadu_si128((const __m128i *)mask0);
+    const __m128i bits1   = _mm_loadu_si128((const __m128i *)mask1);
+    const __m256i lowMask = _mm256_set1_epi32(0xFFFF);
+
+    __m256i pm = _mm256_loadu_si256((const __m256i *)pathMetrics);
+
+    for (std::size_t step = 0; step < steps; step++)
+    {
+        const int8_t * sym = symbols + 4 * step;
+
+        uint16_t c0;
+        uint16_t total;
+        stepCosts(sym, &c0, &total);
+
+        int32_t sym32;
+        memcpy(&sym32, sym, sizeof(sym32));
+        __m128i sv = _mm_set1_epi32(sym32);
+
+        __m128i dot = _mm_hadd_epi16(_mm_maddubs_epi16(bits0, sv), _mm_maddubs_epi16(bits1, sv));
+        __m128i bm0 = _mm_sub_epi16(_mm_set1_epi16((int16_t)c0), dot);
+        __m128i bm1 = _mm_sub_epi16(_mm_set1_epi16((int16_t)total), bm0);
+
+        __m256i bmX = _mm256_inserti128_si256(_mm256_castsi128_si256(bm0), bm1, 1); // [bm0 | bm1] for even predecessors
+        __m256i bmY = _mm256_permute2x128_si256(bmX, bmX, 0x01);                    // [bm1 | bm0] for odd predecessors
+
+        // packus gives quad words [even 0..6, odd 1..7 | even 8..14, odd 9..15]
+        __m256i packed = _mm256_packus_epi32(_mm256_and_si256(pm, lowMask), _mm256_srli_epi32(pm, 16));
+        __m256i even   = _mm256_permute4x64_epi64(packed, 0x88);
+        __m256i odd    = _mm256_permute4x64_epi64(packed, 0xDD);
+
+        __m256i x0 = _mm256_add_epi16(even, bmX);
+        __m256i x1 = _mm256_add_epi16(odd,  bmY);
+        __m256i metrics = _mm256_min_epu16(x0, x1);
+
+        __m256i keep = _mm256_cmpeq_epi16(metrics, x0);
+        __m128i keep8 = _mm_packs_epi16(_mm256_castsi256_si128(keep), _mm256_extracti128_si256(keep, 1));
+        traceback[step] = (uint16_t)~_mm_movemask_epi8(keep8);
+
+        __m128i minMetric = _mm_minpos_epu16(_mm_min_epu16(_mm256_castsi256_si128(metrics), _mm256_extracti128_si256(metrics, 1)));
+
+        pm = _mm256_sub_epi16(metrics, _mm256_broadcastw_epi16(minMetric));
+    }
+
+    _mm256_storeu_si256((__m256i *)pathMetrics, pm);
+}
+
+#endif /* VITERBI_ACS_X86 */
+
+#ifdef VITERBI_ACS_NEON
+
+/**
+ * @brief NEON kernel, 16 states in two registers of 8 x 16 bits
+ *
+ */
+
+static void acsNeon(const int8_t * symbols, const std::size_t steps, const uint8_t * outputs, uint16_t * pathMetrics, uint16_t * traceback)
+{
+    uint16_t masks[4][8];
+    for (int idx = 0; idx < 4; idx++)
+    {
+        for (int j = 0; j < 8; j++)
+        {
+            masks[idx][j] = ((outputs[j] >> idx) & 1) ? 0xFFFF : 0;
+        }
+    }
+
+    const int16x8_t mask0 = vreinterpretq_s16_u16(vld1q_u16(masks[0]));
+    const int16x8_t mask1 = vreinterpretq_s16_u16(vld1q_u16(masks[1]));
+    const int16x8_t mask2 = vreinterpretq_s16_u16(vld1q_u16(masks[2]));
+    const int16x8_t mask3 = vreinterpretq_s16_u16(vld1q_u16(masks[3]));
+
+    const uint8_t weightsTable[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    const uint8x16_t weights = vld1q_u8(weightsTable);
+
+    uint16x8_t pmLo = vld1q_u16(pathMetrics);
+    uint16x8_t pmHi = vld1q_u16(pathMetrics + 8);
+
+    for (std::size_t step = 0; step < steps; step++)
+    {
+        const int8_t * sym = symbols + 4 * step;
+
+        uint16_t c0;
+        uint16_t total;
+        stepCosts(sym, &c0, &total);
+
+        int16x8_t dot = vandq_s16(mask0, vdupq_n_s16(sym[0]));
+        dot = vaddq_s16(dot, vandq_s16(mask1, vdupq_n_s16(sym[1])));
+        dot = vaddq_s16(dot, vandq_s16(mask2, vdupq_n_s16(sym[2])));
+        dot = vaddq_s16(dot, vandq_s16(mask3, vdupq_n_s16(sym[3])));
+
+        uint16x8_t bm0 = vsubq_u16(vdupq_n_u16(c0), vreinterpretq_u16_s16(dot));
+        uint16x8_t bm1 = vsubq_u16(vdupq_n_u16(total), bm0);
+
+        uint16x8x2_t split = vuzpq_u16(pmLo, pmHi);                             // even / odd states
+        uint16x8_t even = split.val[0];
+        uint16x8_t odd  = split.val[1];
+
+        uint16x8_t x0 = vaddq_u16(even, bm0);
+        uint16x8_t x1 = vaddq_u16(odd,  bm1);
+        uint16x8_t y0 = vaddq_u16(even, bm1);
+        uint16x8_t y1 = vaddq_u16(odd,  bm0);
+
+        uint16x8_t lo = vminq_u16(x0, x1);
+        uint16x8_t hi = vminq_u16(y0, y1);
+
+        uint8x16_t take = vcombine_u8(vmovn_u16(vcltq_u16(x1, x0)), vmovn_u16(vcltq_u16(y1, y0)));
+        take = vandq_u8(take, weights);
+
+        uint16x8_t lowest = vminq_u16(lo, hi);
+#if defined(__aarch64__)
+        traceback[step] = (uint16_t)(vaddv_u8(vget_low_u8(take)) | (vaddv_u8(vget_high_u8(take)) << 8));
+        uint16_t minMetric = vminvq_u16(lowest);
+#else
+        uint8x8_t sum = vpadd_u8(vget_low_u8(take), vget_high_u8(take));
+        sum = vpadd_u8(sum, sum);
+        sum = vpadd_u8(sum, sum);
+        traceback[step] = (uint16_t)(vget_lane_u8(sum, 0) | (vget_lane_u8(sum, 1) << 8));
+
+        uint16x4_t low4 = vpmin_u16(vget_low_u16(lowest), vget_high_u16(lowest));
+        low4 = vpmin_u16(low4, low4);
+        low4 = vpmin_u16(low4, low4);
+        uint16_t minMetric = vget_lane_u16(low4, 0);
+#endif
+
+        pmLo = vsubq_u16(lo, vdupq_n_u16(minMetric));
+        pmHi = vsubq_u16(hi, vdupq_n_u16(minMetric));
+    }
+
+    vst1q_u16(pathMetrics, pmLo);
+    vst1q_u16(pathMetrics + 8, pmHi);
+}
+
+#endif /* VITERBI_ACS_NEON */
+
+/*
+ * Batch kernels: one trellis per lane, see ViterbiBatchAcsFunction
+ *
+ * Butterfly j branch output dot products are taken from the 16 subset sums of the
+ * step symbols, so the output table can be given at runtime without branching. Path
+ * metrics renormalisation is a vertical minimum over the 16 states of each lane.
+ *
+ */
+
+/**
+ * @brief Portable batch kernel
+ *
+ */
+
+static void batchScalar(const int8_t * symbols, const std::size_t steps, const uint8_t * outputs, uint16_t * pathMetrics, uint16_t * traceback)
+{
+    const std::size_t lanes = VITERBI_BATCH_LANES;
+
+    for (std::size_t step = 0; step < steps; step++)
+    {
+        uint16_t * decisions = traceback + 16 * step;
+        memset(decisions, 0, 16 * sizeof(uint16_t));
+
+        for (std::size_t lane = 0; lane < lanes; lane++)
+        {
+            int8_t sym[4];
+            for (int idx = 0; idx < 4; idx++)
+            {
+                sym[idx] = symbols[(4 * step + idx) * lanes + lane];
+            }
+
+            uint16_t c0;
+            uint16_t total;
+            stepCosts(sym, &c0, &total);
+
+            uint16_t newMetrics[16];
+            uint16_t minMetric = 0xFFFF;
+
+            for (int j = 0; j < 8; j++)
+            {
+                int32_t dot = 0;
+                for (int idx = 0; idx < 4; idx++)
+                {
+                    dot += ((outputs[j] >> idx) & 1) * sym[idx];
+                }
+
+                uint16_t bm0 = (uint16_t)(c0 - dot);
+                uint16_t bm1 = (uint16_t)(total - bm0);
+
+                uint16_t even = pathMetrics[(2 * j) * lanes + lane];
+                uint16_t odd  = pathMetrics[(2 * j + 1) * lanes + lane];
+
+                uint16_t x0 = (uint16_t)(even + bm0);
+                uint16_t x1 = (uint16_t)(odd  + bm1);
+                uint16_t y0 = (uint16_t)(even + bm1);
+                uint16_t y1 = (uint16_t)(odd  + bm0);
+
+                newMetrics[j]     = x0;
+                newMetrics[j + 8] = y0;
+
+                if (x1 < x0)
+                {
+                    newMetrics[j] = x1;
+                    decisions[j] |= (uint16_t)(1 << lane);
+                }
+
+                if (y1 < y0)
+                {
+                    newMetrics[j + 8] = y1;
+                    decisions[j + 8] |= (uint16_t)(1 << lane);
+                }
+            }
+
+            for (int state = 0; state < 16; state++)
+            {
+                if (newMetrics[state] < minMetric)
+                {
+                    minMetric = newMetrics[state];
+                }
+            }
+
+            for (int state = 0; state < 16; state++)
+            {
+                pathMetrics[state * lanes + lane] = (uint16_t)(newMetrics[state] - minMetric);
+            }
+        }
+    }
+}
+
+#ifdef VITERBI_ACS_X86
+
+/**
+ * @brief SSE4.1 batch kernel, each state holds 16 lanes in two registers of 8 x 16 bits
+ *
+ */
+
+__attribute__((target("sse4.1")))
+static void batchSse41(const int8_t * symbols, const std::size_t steps, const uint8_t * outputs, uint16_t * pathMetrics, uint16_t * traceback)
+{
+    const std::size_t lanes = VITERBI_BATCH_LANES;
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i metrics[2][16][2];                                                  // double buffered [state][lanes 0..7, 8..15]
+    for (int state = 0; state < 16; state++)
+    {
+        metrics[0][state][0] = _mm_loadu_si128((const __m128i *)(pathMetrics + state * lanes));
+        metrics[0][state][1] = _mm_loadu_si128((const __m128i *)(pathMetrics + state * lanes + 8));
+    }
+
+    int current = 0;
+
+    for (std::size_t step = 0; step < steps; step++)
+    {
+        __m128i sums[2][16];                                                    // dot product of symbols with each 4 bits output
+        __m128i c0[2];
+        __m128i total[2];
+
+        for (int half = 0; half < 2; half++)
+        {
+            __m128i sym[4];
+            for (int idx = 0; idx < 4; idx++)
+            {
+                __m128i packed = _mm_loadu_si128((const __m128i *)(symbols + (4 * step + idx) * lanes));
+                sym[idx] = _mm_cvtepi8_epi16(half ? _mm_srli_si128(packed, 8) : packed);
+            }
+
+            c0[half]    = _mm_add_epi16(_mm_add_epi16(_mm_max_epi16(sym[0], zero), _mm_max_epi16(sym[1], zero)),
+                                        _mm_add_epi16(_mm_max_epi16(sym[2], zero), _mm_max_epi16(sym[3], zero)));
+            total[half] = _mm_add_epi16(_mm_add_epi16(_mm_abs_epi16(sym[0]), _mm_abs_epi16(sym[1])),
+                                        _mm_add_epi16(_mm_abs_epi16(sym[2]), _mm_abs_epi16(sym[3])));
+
+            sums[half][0] = zero;
+            for (int bits = 1; bits < 16; bits++)
+            {
+                sums[half][bits] = _mm_add_epi16(sums[half][bits & (bits - 1)], sym[__builtin_ctz(bits)]);
+            }
+        }
+
+        __m128i (*pm)[2]   = metrics[current];
+        __m128i (*next)[2] = metrics[current ^ 1];
+        __m128i lowest[2]  = {_mm_set1_epi16(-1), _mm_set1_epi16(-1)};
+
+        for (int j = 0; j < 8; j++)
+        {
+            __m128i keepLo[2];
+            __m128i keepHi[2];
+
+            for (int half = 0; half < 2; half++)
+            {
+                __m128i bm0 = _mm_sub_epi16(c0[half], sums[half][outputs[j]]);
+                __m128i bm1 = _mm_sub_epi16(total[half], bm0);
+
+                __m128i x0 = _mm_add_epi16(pm[2 * j][half],     bm0);
+                __m128i x1 = _mm_add_epi16(pm[2 * j + 1][half], bm1);
+                __m128i y0 = _mm_add_epi16(pm[2 * j][half],     bm1);
+                __m128i y1 = _mm_add_epi16(pm[2 * j + 1][half], bm0);
+
+                __m128i lo = _mm_min_epu16(x0, x1);
+                __m128i hi = _mm_min_epu16(y0, y1);
+
+                keepLo[half] = _mm_cmpeq_epi16(lo, x0);
+                keepHi[half] = _mm_cmpeq_epi16(hi, y0);
+
+                next[j][half]     = lo;
+                next[j + 8][half] = hi;
+                lowest[half] = _mm_min_epu16(lowest[half], _mm_min_epu16(lo, hi));
+            }
+
+            traceback[16 * step + j]     = (uint16_t)~_mm_movemask_epi8(_mm_packs_epi16(keepLo[0], keepLo[1]));
+            traceback[16 * step + j + 8] = (uint16_t)~_mm_movemask_epi8(_mm_packs_epi16(keepHi[0], keepHi[1]));
+        }
+
+        for (int state = 0; state < 16; state++)
+        {
+            next[state][0] = _mm_sub_epi16(next[state][0], lowest[0]);
+            next[state][1] = _mm_sub_epi16(next[state][1], lowest[1]);
+        }
+
+        current ^= 1;
+    }
+
+    for (int state = 0; state < 16; state++)
+    {
+        _mm_storeu_si128((__m128i *)(pathMetrics + state * lanes),     metrics[current][state][0]);
+        _mm_storeu_si128((__m128i *)(pathMetrics + state * lanes + 8), metrics[current][state][1]);
+    }
+}
+
+/**
+ * @brief AVX2 batch kernel, each state holds 16 lanes in one register of 16 x 16 bits
+ *
+ */
+
+__attribute__((target("avx2")))
+static void batchAvx2(const int8_t * symbols, const std::size_t steps, const uint8_t * outputs, uint16_t * pathMetrics, uint16_t * traceback)
+{
+    const std::size_t lanes = VITERBI_BATCH_LANES;
+    const __m256i zero = _mm256_setzero_si256();
+
+    __m256i metrics[2][16];                                                     // double buffered
+    for (int state = 0; state < 16; state++)
+    {
+        metrics[0][state] = _mm256_loadu_si256((const __m256i *)(pathMetrics + state * lanes));
+    }
+
+    int current = 0;
+
+    for (std::size_t step = 0; step < steps; step++)
+    {
+        __m256i sym[4];
+        for (int idx = 0; idx < 4; idx++)
+        {
+            sym[idx] = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(symbols + (4 * step + idx) * lanes)));
+        }
+
+        __m256i c0    = _mm256_add_epi16(_mm256_add_epi16(_mm256_max_epi16(sym[0], zero), _mm256_max_epi16(sym[1], zero)),
+                                         _mm256_add_epi16(_mm256_max_epi16(sym[2], zero), _mm256_max_epi16(sym[3], zero)));
+        __m256i total = _mm256_add_epi16(_mm256_add_epi16(_mm256_abs_epi16(sym[0]), _mm256_abs_epi16(sym[1])),
+                                         _mm256_add_epi16(_mm256_abs_epi16(sym[2]), _mm256_abs_epi16(sym[3])));
+
+        __m256i sums[16];                                                       // dot product of symbols with each 4 bits output
+        sums[0] = zero;
+        for (int bits = 1; bits < 16; bits++)
+        {
+            sums[bits] = _mm256_add_epi16(sums[bits & (bits - 1)], sym[__builtin_ctz(bits)]);
+        }
+
+        __m256i * pm     = metrics[current];
+        __m256i * next   = metrics[current ^ 1];
+        __m256i lowest   = _mm256_set1_epi16(-1);
+
+        for (int j = 0; j < 8; j++)
+        {
+            __m256i bm0 = _mm256_sub_epi16(c0, sums[outputs[j]]);
+            __m256i bm1 = _mm256_sub_epi16(total, bm0);
+
+            __m256i x0 = _mm256_add_epi16(pm[2 * j],     bm0);
+            __m256i x1 = _mm256_add_epi16(pm[2 * j + 1], bm1);
+            __m256i y0 = _mm256_add_epi16(pm[2 * j],     bm1);
+            __m256i y1 = _mm256_add_epi16(pm[2 * j + 1], bm0);
+
+            __m256i lo = _mm256_min_epu16(x0, x1);
+            __m256i hi = _mm256_min_epu16(y0, y1);
+
+            __m256i keepLo = _mm256_cmpeq_epi16(lo, x0);
+            __m256i keepHi = _mm256_cmpeq_epi16(hi, y0);
+
+            traceback[16 * step + j]     = (uint16_t)~_mm_movemask_epi8(_mm_packs_epi16(_mm256_castsi256_si128(keepLo), _mm256_extracti128_si256(keepLo, 1)));
+            traceback[16 * step + j + 8] = (uint16_t)~_mm_movemask_epi8(_mm_packs_epi16(_mm256_castsi256_si128(keepHi), _mm256_extracti128_si256(keepHi, 1)));
+
+            next[j]     = lo;
+            next[j + 8] = hi;
+            lowest = _mm256_min_epu16(lowest, _mm256_min_epu16(lo, hi));
+        }
+
+        for (int state = 0; state < 16; state++)
+        {
+            next[state] = _mm256_sub_epi16(next[state], lowest);
+        }
+
+        current ^= 1;
+    }
+
+    for (int state = 0; state < 16; state++)
+    {
+        _mm256_storeu_si256((__m256i *)(pathMetrics + state * lanes), metrics[current][state]);
+    }
+}
+
+#endif /* VITERBI_ACS_X86 */
+
+#ifdef VITERBI_ACS_NEON
+
+/**
+ * @brief NEON batch kernel, each state holds 16 lanes in two registers of 8 x 16 bits
+ *
+ */
+
+static void batchNeon(const int8_t * symbols, const std::size_t steps, const uint8_t * outputs, uint16_t * pathMetrics, uint16_t * traceback)
+{
+    const std::size_t lanes = VITERBI_BATCH_LANES;
+    const int16x8_t zero = vdupq_n_s16(0);
+
+    const uint8_t weightsTable[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    const uint8x16_t weights = vld1q_u8(weightsTable);
+
+    uint16x8_t metrics[2][16][2];                                               // double buffered [state][lanes 0..7, 8..15]
+    for (int state = 0; state < 16; state++)
+    {
+        metrics[0][state][0] = vld1q_u16(pathMetrics + state * lanes);
+        metrics[0][state][1] = vld1q_u16(pathMetrics + state * lanes + 8);
+    }
+
+    int current = 0;
+
+    for (std::size_t step = 0; step < steps; step++)
+    {
+        uint16x8_t sums[2][16];                                                 // dot product of symbols with each 4 bits output
+        uint16x8_t c0[2];
+        uint16x8_t total[2];
+
+        for (int half = 0; half < 2; half++)
+        {
+            int16x8_t sym[4];
+            for (int idx = 0; idx < 4; idx++)
+            {
+                int8x16_t packed = vld1q_s8(symbols + (4 * step + idx) * lanes);
+                sym[idx] = vmovl_s8(half ? vget_high_s8(packed) : vget_low_s8(packed));
+            }
+
+            c0[half]    = vreinterpretq_u16_s16(vaddq_s16(vaddq_s16(vmaxq_s16(sym[0], zero), vmaxq_s16(sym[1], zero)),
+                                                          vaddq_s16(vmaxq_s16(sym[2], zero), vmaxq_s16(sym[3], zero))));
+            total[half] = vreinterpretq_u16_s16(vaddq_s16(vaddq_s16(vabsq_s16(sym[0]), vabsq_s16(sym[1])),
+                                                          vaddq_s16(vabsq_s16(sym[2]), vabsq_s16(sym[3]))));
+
+            sums[half][0] = vdupq_n_u16(0);
+            for (int bits = 1; bits < 16; bits++)
+            {
+                sums[half][bits] = vaddq_u16(sums[half][bits & (bits - 1)], vreinterpretq_u16_s16(sym[__builtin_ctz(bits)]));
+            }
+        }
+
+        uint16x8_t (*pm)[2]   = metrics[current];
+        uint16x8_t (*next)[2] = metrics[current ^ 1];
+        uint16x8_t lowest[2]  = {vdupq_n_u16(0xFFFF), vdupq_n_u16(0xFFFF)};
+
+        for (int j = 0; j < 8; j++)
+        {
+            uint8x8_t takeLo[2];
+            uint8x8_t takeHi[2];
+
+            for (int half = 0; half < 2; half++)
+            {
+                uint16x8_t bm0 = vsubq_u16(c0[half], sums[half][outputs[j]]);
+                uint16x8_t bm1 = vsubq_u16(total[half], bm0);
+
+                uint16x8_t x0 = vaddq_u16(pm[2 * j][half],     bm0);
+                uint16x8_t x1 = vaddq_u16(pm[2 * j + 1][half], bm1);
+                uint16x8_t y0 = vaddq_u16(pm[2 * j][half],     bm1);
+                uint16x8_t y1 = vaddq_u16(pm[2 * j + 1][half], bm0);
+
+                uint16x8_t lo = vminq_u16(x0, x1);
+                uint16x8_t hi = vminq_u16(y0, y1);
+
+                takeLo[half] = vmovn_u16(vcltq_u16(x1, x0));
+                takeHi[half] = vmovn_u16(vcltq_u16(y1, y0));
+
+                next[j][half]     = lo;
+                next[j + 8][half] = hi;
+                lowest[half] = vminq_u16(lowest[half], vminq_u16(lo, hi));
+            }
+
+            uint8x16_t takeJ  = vandq_u8(vcombine_u8(takeLo[0], takeLo[1]), weights);
+            uint8x16_t takeJ8 = vandq_u8(vcombine_u8(takeHi[0], takeHi[1]), weights);
+#if defined(__aarch64__)
+            traceback[16 * step + j]     = (uint16_t)(vaddv_u8(vget_low_u8(takeJ))  | (vaddv_u8(vget_high_u8(takeJ))  << 8));
+            traceback[16 * step + j + 8] = (uint16_t)(vaddv_u8(vget_low_u8(takeJ8)) | (vaddv_u8(vget_high_u8(takeJ8)) << 8));
+#else
+            uint8x8_t sum = vpadd_u8(vget_low_u8(takeJ), vget_high_u8(takeJ));
+            sum = vpadd_u8(sum, sum);
+            sum = vpadd_u8(sum, sum);
+            traceback[16 * step + j] = (uint16_t)(vget_lane_u8(sum, 0) | (vget_lane_u8(sum, 1) << 8));
+
+            sum = vpadd_u8(vget_low_u8(takeJ8), vget_high_u8(takeJ8));
+            sum = vpadd_u8(sum, sum);
+            sum = vpadd_u8(sum, sum);
+            traceback[16 * step + j + 8] = (uint16_t)(vget_lane_u8(sum, 0) | (vget_lane_u8(sum, 1) << 8));
+#endif
+        }
+
+        for (int state = 0; state < 16; state++)
+        {
+            next[state][0] = vsubq_u16(next[state][0], lowest[0]);
+            next[state][1] = vsubq_u16(next[state][1], lowest[1]);
+        }
+
+        current ^= 1;
+    }
+
+    for (int state = 0; state < 16; state++)
+    {
+        vst1q_u16(pathMetrics + state * lanes,     metrics[current][state][0]);
+        vst1q_u16(pathMetrics + state * lanes + 8, metrics[current][state][1]);
+    }
+}
+
+#endif /* VITERBI_ACS_NEON */
+
+static bool alwaysSupported()
+{
+    return true;
+}
+
+#ifdef VITERBI_ACS_X86
+static bool cpuHasSse41()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.1");
+}
+
+static bool cpuHasAvx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+#ifdef VITERBI_ACS_NEON
+static bool cpuHasNeon()
+{
+#if defined(__aarch64__) || !defined(__linux__)
+    return true;                                                                // advanced SIMD is mandatory on ARMv8
+#else
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+}
+#endif
+
+/**
+ * @brief Kernels table by order of preference, scalar fallback is last
+ *
+ * NOTE: the step is latency bound, AVX2 lane crossing permutes make it slightly slower than SSE4.1
+ *
+ */
+
+struct KernelEntry {
+    ViterbiAcsKernel kernel;
+    bool (*supported)();
+};
+
+static const KernelEntry KERNELS[] = {
+#ifdef VITERBI_ACS_X86
+    {{"sse4.1", acsSse41},  cpuHasSse41},
+    {{"avx2",   acsAvx2},   cpuHasAvx2},
+#endif
+#ifdef VITERBI_ACS_NEON
+    {{"neon",   acsNeon},   cpuHasNeon},
+#endif
+    {{"scalar", acsScalar}, alwaysSupported},
+};
+
+static const std::size_t KERNELS_COUNT = sizeof(KERNELS) / sizeof(KERNELS[0]);
+
+/**
+ * @brief Return kernel by name, or the best kernel supported by the CPU when name is NULL
+ *
+ * Returns NULL when the kernel is unknown or not supported by the CPU
+ *
+ */
+
+const ViterbiAcsKernel * Tetra::viterbiAcsKernel(const char * name)
+{
+    for (std::size_t idx = 0; idx < KERNELS_COUNT; idx++)
+    {
+        if ((name == NULL) || (strcmp(name, KERNELS[idx].kernel.name) == 0))
+        {
+            if (KERNELS[idx].supported())
+            {
+                return &KERNELS[idx].kernel;
+            }
+            else if (name != NULL)
+            {
+                return NULL;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Return all kernels supported by the CPU
+ *
+ */
+
+std::vector<const ViterbiAcsKernel *> Tetra::viterbiAcsKernels()
+{
+    std::vector<const ViterbiAcsKernel *> res;
+
+    for (std::size_t idx = 0; idx < KERNELS_COUNT; idx++)
+    {
+        if (KERNELS[idx].supported())
+        {
+            res.push_back(&KERNELS[idx].kernel);
+        }
+    }
+
+    return res;
+}
+
+/**
+ * @brief Batch kernels table by order of preference, scalar fallback is last
+ *
+ * NOTE: lanes are independent so batch kernels are throughput bound, the widest registers win
+ *
+ */
+
+struct BatchKernelEntry {
+    ViterbiBatchAcsKernel kernel;
+    bool (*supported)();
+};
+
+static const BatchKernelEntry BATCH_KERNELS[] = {
+#ifdef VITERBI_ACS_X86
+    {{"avx2",   batchAvx2},   cpuHasAvx2},
+    {{"sse4.1", batchSse41},  cpuHasSse41},
+#endif
+#ifdef VITERBI_ACS_NEON
+    {{"neon",   batchNeon},   cpuHasNeon},
+#endif
+    {{"scalar", batchScalar}, alwaysSupported},
+};
+
+static const std::size_t BATCH_KERNELS_COUNT = sizeof(BATCH_KERNELS) / sizeof(BATCH_KERNELS[0]);
+
+/**
+ * @brief Return batch kernel by name, or the best batch kernel supported by the CPU when name is NULL
+ *
+ * Returns NULL when the kernel is unknown or not supported by the CPU
+ *
+ */
+
+const ViterbiBatchAcsKernel * Tetra::viterbiBatchAcsKernel(const char * name)
+{
+    for (std::size_t idx = 0; idx < BATCH_KERNELS_COUNT; idx++)
+    {
+        if ((name == NULL) || (strcmp(name, BATCH_KERNELS[idx].kernel.name) == 0))
+        {
+            if (BATCH_KERNELS[idx].supported())
+            {
+                return &BATCH_KERNELS[idx].kernel;
+            }
+            else if (name != NULL)
+            {
+                return NULL;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Return all batch kernels supported by the CPU
+ *
+ */
+
+std::vector<const ViterbiBatchAcsKernel *> Tetra::viterbiBatchAcsKernels()
+{
+    std::vector<const ViterbiBatchAcsKernel *> res;
+
+    for (std::size_t idx = 0; idx < BATCH_KERNELS_COUNT; idx++)
+    {
+        if (BATCH_KERNELS[idx].supported())
+        {
+            res.push_back(&BATCH_KERNELS[idx].kernel);
+        }
+    }
+
+    return res;
+}
@@ -0,0 +1,81 @@
+/*
+ *  tetra-kit
+ *  Copyright (C) 2020  LarryTh <dev@logami.fr>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef VITERBI_ACS_H
+#define VITERBI_ACS_H
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace Tetra {
+
+    /**
+     * @brief Add-compare-select kernel for the 16-state trellis
+     *
+     * Processes steps of 4 received symbols. A symbol is signed: positive for a
+     * received 1, negative for a received 0, its magnitude is the confidence and
+     * 0 is an erased bit.
+     *
+     * outputs[j] is the branch output for state 2j and input 0. Other branches
+     * of the butterfly are the complement since G1..G4 all contain D^0 and D^4.
+     *
+     * Path metrics are 16 bits, renormalised to 0 after each step. traceback
+     * receives one word per step where bit s is set when state s survivor comes
+     * from the odd predecessor. All kernels return the same results.
+     *
+     */
+
+    typedef void (*ViterbiAcsFunction)(const int8_t * symbols, const std::size_t steps, const uint8_t * outputs, uint16_t * pathMetrics, uint16_t * traceback);
+
+    struct ViterbiAcsKernel {
+        const char * name;                                                      ///< kernel name
+        ViterbiAcsFunction run;                                                 ///< kernel function
+    };
+
+    const ViterbiAcsKernel * viterbiAcsKernel(const char * name);
+    std::vector<const ViterbiAcsKernel *> viterbiAcsKernels();
+
+    /**
+     * @brief Add-compare-select kernel running VITERBI_BATCH_LANES independent trellises
+     *
+     * Same computation as ViterbiAcsFunction with one block per lane, all blocks having the
+     * same number of steps. Arrays are lane-interleaved:
+     *   - symbols[(4 * step + idx) * VITERBI_BATCH_LANES + lane] is symbol idx of step
+     *   - pathMetrics[state * VITERBI_BATCH_LANES + lane]
+     *   - traceback[step * 16 + state] bit lane is set when the lane state survivor comes
+     *     from the odd predecessor
+     *
+     * Each lane gives the results of the single trellis kernels on its own symbols.
+     *
+     */
+
+    static const std::size_t VITERBI_BATCH_LANES = 16;                          ///< Trellises per batch kernel call
+
+    typedef void (*ViterbiBatchAcsFunction)(const int8_t * symbols, const std::size_t steps, const uint8_t * outputs, uint16_t * pathMetrics, uint16_t * traceback);
+
+    struct ViterbiBatchAcsKernel {
+        const char * name;                                                      ///< kernel name
+        ViterbiBatchAcsFunction run;                                            ///< kernel function
+    };
+
+    const ViterbiBatchAcsKernel * viterbiBatchAcsKernel(const char * name);
+    std::vector<const ViterbiBatchAcsKernel *> viterbiBatchAcsKernels();
+
+};
+
+#endif /* VITERBI_ACS_H */
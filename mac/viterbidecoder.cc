@@ -0,0 +1,513 @@
+/*
+ *  tetra-kit
+ *  Copyright (C) 2020  LarryTh <dev@logami.fr>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "viterbidecoder.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+using namespace Tetra;
+
+static const uint16_t UNREACHABLE_METRIC = 0x2000;                              // initial metric of states the encoder can't be in, above 4 steps of worst branch metrics
+
+/**
+ * @brief Branch output tables, built once and shared by all decoders
+ *
+ * 8.2.3.1.1 Generator polynomials for the RCPC 16-state mother code of rate 1/4
+ *
+ * G1 = 1 + D +             D^4 (8.3)
+ * G2 = 1 +     D^2 + D^3 + D^4 (8.4)
+ * G3 = 1 + D + D^2 +       D^4 (8.5)
+ * G4 = 1 + D +       D^3 + D^4 (8.6)
+ *
+ * NOTE: representing bit order is reversed like for the reference codec, eg. 1 + D + 0 + 0 + D^4 -> 10011
+ *       ie. bit k is the coefficient of D^k
+ *
+ */
+
+struct TrellisTables {
+    uint8_t outputs[ViterbiDecoder1614::STATES_COUNT][2];                       ///< branch output (G1..G4 in bits 0..3) for state and input bit
+    uint8_t butterflyOutputs[ViterbiDecoder1614::STATES_COUNT / 2];             ///< branch output of state 2j for input 0, given to kernel
+
+    TrellisTables()
+    {
+        const uint8_t polynomials[ViterbiDecoder1614::PARITY_BITS] = {0b10011, 0b11101, 0b10111, 0b11011};
+
+        for (uint8_t state = 0; state < ViterbiDecoder1614::STATES_COUNT; state++)
+        {
+            for (uint8_t input = 0; input < 2; input++)
+            {
+                uint8_t out = 0;
+
+                for (std::size_t idx = 0; idx < ViterbiDecoder1614::PARITY_BITS; idx++)
+                {
+                    uint8_t val = polynomials[idx] & input;                     // D^0 is the current input
+
+                    for (uint8_t k = 1; k <= 4; k++)                            // D^k is the input k steps ago, stored in state bit 4 - k
+                    {
+                        val ^= ((polynomials[idx] >> k) & (state >> (4 - k))) & 1;
+                    }
+
+                    out |= (uint8_t)(val << idx);
+                }
+
+                outputs[state][input] = out;
+            }
+        }
+
+        // butterfly kernels rely on odd predecessor and input 1 outputs being complemented
+        for (uint8_t j = 0; j < ViterbiDecoder1614::STATES_COUNT / 2; j++)
+        {
+            butterflyOutputs[j] = outputs[2 * j][0];
+
+            assert(outputs[2 * j][1]     == (uint8_t)(~outputs[2 * j][0] & 0x0f));
+            assert(outputs[2 * j + 1][0] == (uint8_t)(~outputs[2 * j][0] & 0x0f));
+            assert(outputs[2 * j + 1][1] == outputs[2 * j][0]);
+        }
+    }
+};
+
+static const TrellisTables & trellisTables()
+{
+    static const TrellisTables tables;
+
+    return tables;
+}
+
+/**
+ * @brief Cost of branch output bits out against the 4 symbols of a step, stride symbols apart
+ *
+ * Same costs as the add-compare-select kernels: a symbol disagreeing with its output bit
+ * costs its magnitude, an agreeing or erased one costs nothing. The cost of output bit b is
+ * max(s, 0) - b * s, branchless since decoded bits defeat prediction.
+ *
+ */
+
+static inline uint32_t branchMetric(const int8_t * sym, const uint8_t out, const std::size_t stride)
+{
+    uint32_t res = 0;
+
+    for (std::size_t idx = 0; idx < ViterbiDecoder1614::PARITY_BITS; idx++)
+    {
+        int32_t val = sym[idx * stride];
+        res += (uint32_t)((val > 0 ? val : 0) - (int32_t)((out >> idx) & 1) * val);
+    }
+
+    return res;
+}
+
+/**
+ * @brief Constructor
+ *
+ * When kernelName is NULL or not supported by the CPU, the best available kernel is used
+ *
+ */
+
+ViterbiDecoder1614::ViterbiDecoder1614(const char * kernelName)
+{
+    m_butterflyOutputs = trellisTables().butterflyOutputs;
+
+    m_kernel = NULL;
+    if (kernelName != NULL)
+    {
+        m_kernel = viterbiAcsKernel(kernelName);
+        if (m_kernel == NULL)
+        {
+            fprintf(stderr, "Viterbi kernel '%s' not supported, using default\n", kernelName);
+        }
+    }
+
+    if (m_kernel == NULL)
+    {
+        m_kernel = viterbiAcsKernel(NULL);
+    }
+}
+
+/**
+ * @brief Destructor
+ *
+ */
+
+ViterbiDecoder1614::~ViterbiDecoder1614()
+{
+
+}
+
+/**
+ * @brief Decode depunctured data vector
+ *
+ */
+
+std::vector<uint8_t> ViterbiDecoder1614::decode(const std::vector<uint8_t> & data)
+{
+    std::vector<uint8_t> res(MAX_STEPS);
+
+    std::size_t count = decode(data.data(), data.size(), res.data());
+    res.resize(count);
+
+    return res;
+}
+
+/**
+ * @brief Return the name of the add-compare-select kernel in use
+ *
+ */
+
+const char * ViterbiDecoder1614::kernelName() const
+{
+    return m_kernel->name;
+}
+
+/**
+ * @brief Decode len depunctured bits into res, returns the number of decoded bits
+ *
+ * res must hold at least (len + 3) / 4 bits, up to MAX_STEPS. When len is not a multiple of 4,
+ * missing bits are received as 0 like the reference codec does. The winning path metric is
+ * written to pathMetric when not NULL.
+ *
+ */
+
+std::size_t ViterbiDecoder1614::decode(const uint8_t * data, const std::size_t len, uint8_t * res, uint32_t * pathMetric)
+{
+    std::size_t steps = (len + PARITY_BITS - 1) / PARITY_BITS;
+    if (steps > MAX_STEPS)
+    {
+        steps = MAX_STEPS;
+    }
+
+    // hard bits to symbols: 0 -> -1, 1 -> +1, erased -> 0
+    for (std::size_t pos = 0; pos < steps * PARITY_BITS; pos++)
+    {
+        uint8_t bit = pos < len ? data[pos] : 0;
+        m_symbols[pos] = (bit == 0) ? -1 : (bit == 1) ? 1 : 0;
+    }
+
+    return run(steps, res, pathMetric);
+}
+
+/**
+ * @brief Decode soft depunctured data vector
+ *
+ */
+
+std::vector<uint8_t> ViterbiDecoder1614::decodeSoft(const std::vector<int8_t> & data)
+{
+    std::vector<uint8_t> res(MAX_STEPS);
+
+    std::size_t count = decodeSoft(data.data(), data.size(), res.data());
+    res.resize(count);
+
+    return res;
+}
+
+/**
+ * @brief Decode len soft depunctured symbols into res, returns the number of decoded bits
+ *
+ * res must hold at least (len + 3) / 4 bits, up to MAX_STEPS. When len is not a multiple of 4,
+ * missing symbols are erased. The winning path metric is written to pathMetric when not NULL.
+ *
+ */
+
+std::size_t ViterbiDecoder1614::decodeSoft(const int8_t * data, const std::size_t len, uint8_t * res, uint32_t * pathMetric)
+{
+    std::size_t steps = (len + PARITY_BITS - 1) / PARITY_BITS;
+    if (steps > MAX_STEPS)
+    {
+        steps = MAX_STEPS;
+    }
+
+    for (std::size_t pos = 0; pos < steps * PARITY_BITS; pos++)
+    {
+        m_symbols[pos] = pos < len ? data[pos] : 0;
+    }
+
+    return run(steps, res, pathMetric);
+}
+
+/**
+ * @brief Run add-compare-select on symbols and traceback, returns the number of decoded bits
+ *
+ * The winning path metric is summed along the traceback when pathMetric is not NULL.
+ *
+ */
+
+std::size_t ViterbiDecoder1614::run(const std::size_t steps, uint8_t * res, uint32_t * pathMetric)
+{
+    m_pathMetrics[0] = 0;                                                       // encoder starts in state 0
+    for (std::size_t state = 1; state < STATES_COUNT; state++)
+    {
+        m_pathMetrics[state] = UNREACHABLE_METRIC;
+    }
+
+    m_kernel->run(m_symbols, steps, m_butterflyOutputs, m_pathMetrics, m_traceback);
+
+    // traceback from the first best state
+    uint8_t state = 0;
+    for (uint8_t idx = 1; idx < STATES_COUNT; idx++)
+    {
+        if (m_pathMetrics[idx] < m_pathMetrics[state])
+        {
+            state = idx;
+        }
+    }
+
+    if (pathMetric == NULL)
+    {
+        for (std::size_t step = steps; step > 0; step--)
+        {
+            res[step - 1] = state >> 3;
+            state = (uint8_t)(((state & 7) << 1) | ((m_traceback[step - 1] >> state) & 1));
+        }
+
+        return steps;
+    }
+
+    const TrellisTables & tables = trellisTables();
+    uint32_t metric = 0;
+
+    for (std::size_t step = steps; step > 0; step--)
+    {
+        uint8_t input = state >> 3;
+        res[step - 1] = input;
+        state = (uint8_t)(((state & 7) << 1) | ((m_traceback[step - 1] >> state) & 1));
+        metric += branchMetric(m_symbols + (step - 1) * PARITY_BITS, tables.outputs[state][input], 1);
+    }
+
+    *pathMetric = metric;
+
+    return steps;
+}
+
+/**
+ * @brief Constructor
+ *
+ * When kernelName is NULL or not supported by the CPU, the best available batch kernel is used
+ *
+ */
+
+ViterbiBatchDecoder1614::ViterbiBatchDecoder1614(const char * kernelName)
+{
+    m_butterflyOutputs = trellisTables().butterflyOutputs;
+
+    m_kernel = NULL;
+    if (kernelName != NULL)
+    {
+        m_kernel = viterbiBatchAcsKernel(kernelName);
+        if (m_kernel == NULL)
+        {
+            fprintf(stderr, "Viterbi batch kernel '%s' not supported, using default\n", kernelName);
+        }
+    }
+
+    if (m_kernel == NULL)
+    {
+        m_kernel = viterbiBatchAcsKernel(NULL);
+    }
+}
+
+/**
+ * @brief Destructor
+ *
+ */
+
+ViterbiBatchDecoder1614::~ViterbiBatchDecoder1614()
+{
+
+}
+
+/**
+ * @brief Return the name of the batch add-compare-select kernel in use
+ *
+ */
+
+const char * ViterbiBatchDecoder1614::kernelName() const
+{
+    return m_kernel->name;
+}
+
+/**
+ * @brief Decode count blocks of len depunctured bits data[k] into res[k], returns the number of decoded bits per block
+ *
+ * Each res[k] must hold at least (len + 3) / 4 bits, up to MAX_STEPS. When pathMetrics is not
+ * NULL, it receives the count winning path metrics.
+ *
+ */
+
+std::size_t ViterbiBatchDecoder1614::decode(const uint8_t * const * data, const std::size_t count, const std::size_t len, uint8_t * const * res, uint32_t * pathMetrics)
+{
+    std::size_t steps = (len + PARITY_BITS - 1) / PARITY_BITS;
+    if (steps > MAX_STEPS)
+    {
+        steps = MAX_STEPS;
+    }
+
+    for (std::size_t first = 0; first < count; first += MAX_LANES)
+    {
+        std::size_t lanes = count - first;
+        if (lanes > MAX_LANES)
+        {
+            lanes = MAX_LANES;
+        }
+
+        if (lanes < MAX_LANES)
+        {
+            memset(m_symbols, 0, steps * PARITY_BITS * MAX_LANES);              // unused lanes are erased
+        }
+
+        // hard bits to lane-interleaved symbols: 0 -> -1, 1 -> +1, erased -> 0
+        const std::size_t symbolsCount = std::min(len, steps * PARITY_BITS);
+        for (std::size_t pos = 0; pos < symbolsCount; pos++)
+        {
+            int8_t * syms = m_symbols + pos * MAX_LANES;
+            for (std::size_t lane = 0; lane < lanes; lane++)
+            {
+                uint8_t bit = data[first + lane][pos];
+                syms[lane] = bit < 2 ? (int8_t)(2 * bit - 1) : 0;               // branchless, random bits defeat prediction
+            }
+        }
+        for (std::size_t pos = symbolsCount; pos < steps * PARITY_BITS; pos++)
+        {
+            memset(m_symbols + pos * MAX_LANES, -1, lanes);                     // missing bits are received as 0
+        }
+
+        run(steps, lanes, res + first, pathMetrics ? pathMetrics + first : NULL);
+    }
+
+    return steps;
+}
+
+/**
+ * @brief Decode count blocks of len soft depunctured symbols data[k] into res[k], returns the number of decoded bits per block
+ *
+ * Each res[k] must hold at least (len + 3) / 4 bits, up to MAX_STEPS. When pathMetrics is not
+ * NULL, it receives the count winning path metrics.
+ *
+ */
+
+std::size_t ViterbiBatchDecoder1614::decodeSoft(const int8_t * const * data, const std::size_t count, const std::size_t len, uint8_t * const * res, uint32_t * pathMetrics)
+{
+    std::size_t steps = (len + PARITY_BITS - 1) / PARITY_BITS;
+    if (steps > MAX_STEPS)
+    {
+        steps = MAX_STEPS;
+    }
+
+    for (std::size_t first = 0; first < count; first += MAX_LANES)
+    {
+        std::size_t lanes = count - first;
+        if (lanes > MAX_LANES)
+        {
+            lanes = MAX_LANES;
+        }
+
+        if (lanes < MAX_LANES)
+        {
+            memset(m_symbols, 0, steps * PARITY_BITS * MAX_LANES);
+        }
+
+        const std::size_t symbolsCount = std::min(len, steps * PARITY_BITS);
+        for (std::size_t pos = 0; pos < symbolsCount; pos++)
+        {
+            int8_t * syms = m_symbols + pos * MAX_LANES;
+            for (std::size_t lane = 0; lane < lanes; lane++)
+            {
+                syms[lane] = data[first + lane][pos];
+            }
+        }
+        for (std::size_t pos = symbolsCount; pos < steps * PARITY_BITS; pos++)
+        {
+            memset(m_symbols + pos * MAX_LANES, 0, lanes);                      // missing symbols are erased
+        }
+
+        run(steps, lanes, res + first, pathMetrics ? pathMetrics + first : NULL);
+    }
+
+    return steps;
+}
+
+/**
+ * @brief Run batch add-compare-select on symbols and traceback each of the count first lanes
+ *
+ * The winning path metrics are summed along the traceback when pathMetrics is not NULL.
+ *
+ */
+
+void ViterbiBatchDecoder1614::run(const std::size_t steps, const std::size_t count, uint8_t * const * res, uint32_t * pathMetrics)
+{
+    for (std::size_t lane = 0; lane < MAX_LANES; lane++)
+    {
+        m_pathMetrics[lane] = 0;                                                // encoder starts in state 0
+        for (std::size_t state = 1; state < STATES_COUNT; state++)
+        {
+            m_pathMetrics[state * MAX_LANES + lane] = UNREACHABLE_METRIC;
+        }
+    }
+
+    m_kernel->run(m_symbols, steps, m_butterflyOutputs, m_pathMetrics, m_traceback);
+
+    // traceback from the first best state of each lane, lanes are interleaved to overlap their dependency chains
+    uint8_t states[MAX_LANES];
+    for (std::size_t lane = 0; lane < count; lane++)
+    {
+        states[lane] = 0;
+        for (uint8_t idx = 1; idx < STATES_COUNT; idx++)
+        {
+            if (m_pathMetrics[idx * MAX_LANES + lane] < m_pathMetrics[states[lane] * MAX_LANES + lane])
+            {
+                states[lane] = idx;
+            }
+        }
+    }
+
+    if (pathMetrics == NULL)
+    {
+        for (std::size_t step = steps; step > 0; step--)
+        {
+            const uint16_t * decisions = m_traceback + (step - 1) * STATES_COUNT;
+
+            for (std::size_t lane = 0; lane < count; lane++)
+            {
+                uint8_t state = states[lane];
+                res[lane][step - 1] = state >> 3;
+                states[lane] = (uint8_t)(((state & 7) << 1) | ((decisions[state] >> lane) & 1));
+            }
+        }
+
+        return;
+    }
+
+    const TrellisTables & tables = trellisTables();
+    uint32_t metrics[MAX_LANES] = {0};
+
+    for (std::size_t step = steps; step > 0; step--)
+    {
+        const uint16_t * decisions = m_traceback + (step - 1) * STATES_COUNT;
+        const int8_t * syms = m_symbols + (step - 1) * PARITY_BITS * MAX_LANES;
+
+        for (std::size_t lane = 0; lane < count; lane++)
+        {
+            uint8_t input = states[lane] >> 3;
+            res[lane][step - 1] = input;
+            states[lane] = (uint8_t)(((states[lane] & 7) << 1) | ((decisions[states[lane]] >> lane) & 1));
+            metrics[lane] += branchMetric(syms + lane, tables.outputs[states[lane]][input], MAX_LANES);
+        }
+    }
+
+    std::copy(metrics, metrics + count, pathMetrics);
+}
@@ -0,0 +1,116 @@
+/*
+ *  tetra-kit
+ *  Copyright (C) 2020  LarryTh <dev@logami.fr>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef VITERBI_DECODER_H
+#define VITERBI_DECODER_H
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "viterbiacs.h"
+
+namespace Tetra {
+
+    /**
+     * @brief Table-driven Viterbi decoder for the RCPC 16-state mother code of rate 1/4 - 8.2.3.1.1
+     *
+     * Input is the depunctured mother code, either hard (one bit per byte, value 2 for erased bits)
+     * or soft (signed values, positive for 1, negative for 0, 0 for erased bits),
+     * output is one decoded bit per byte, flushing bits included.
+     *
+     * The trellis state holds the last 4 input bits, the most recent one in bit 3.
+     * Decoding is bit exact with the reference ViterbiCodec string implementation.
+     *
+     * The winning path metric is the cost of the decoded path against the received symbols:
+     * the number of hard bits it disagrees with, or the sum of the disagreeing soft symbols
+     * magnitudes. Kernels renormalise metrics at each step, so it is summed during traceback.
+     *
+     * The add-compare-select step runs in a SIMD kernel picked at runtime for the CPU
+     * (see viterbiacs.h), a kernel can be forced by name, eg. "scalar".
+     *
+     */
+
+    class ViterbiDecoder1614 {
+    public:
+        ViterbiDecoder1614(const char * kernelName = NULL);
+        ~ViterbiDecoder1614();
+
+        static const std::size_t STATES_COUNT = 16;                             ///< 16-state mother code
+        static const std::size_t PARITY_BITS  = 4;                              ///< mother code rate 1/4
+        static const std::size_t MAX_STEPS    = 288;                            ///< longest block is SCH/F: 432 bits depunctured to 4 * 288 bits
+
+        std::vector<uint8_t> decode(const std::vector<uint8_t> & data);
+        std::size_t decode(const uint8_t * data, const std::size_t len, uint8_t * res, uint32_t * pathMetric = NULL);
+        std::vector<uint8_t> decodeSoft(const std::vector<int8_t> & data);
+        std::size_t decodeSoft(const int8_t * data, const std::size_t len, uint8_t * res, uint32_t * pathMetric = NULL);
+
+        const char * kernelName() const;
+
+    private:
+        std::size_t run(const std::size_t steps, uint8_t * res, uint32_t * pathMetric);
+
+        const ViterbiAcsKernel * m_kernel;                                      ///< add-compare-select kernel
+        const uint8_t * m_butterflyOutputs;                                     ///< branch output of state 2j for input 0, shared table given to kernel
+        int8_t   m_symbols[MAX_STEPS * PARITY_BITS];                            ///< soft symbols given to kernel
+        uint16_t m_pathMetrics[STATES_COUNT];                                   ///< path metrics of current step
+        uint16_t m_traceback[MAX_STEPS];                                        ///< survivor decision bit per state for each step (1 = odd predecessor)
+    };
+
+    /**
+     * @brief Viterbi decoder of independent same length blocks, one block per SIMD lane
+     *
+     * Up to MAX_LANES blocks are decoded by a single add-compare-select pass, the survivor
+     * decisions of all lanes being stored in one shared traceback. More blocks are decoded by
+     * successive passes. Input and output formats are the ViterbiDecoder1614 ones and each
+     * block is decoded bit exact with it, winning path metric included.
+     *
+     * With a SIMD kernel, batches of at least 8 blocks available together (see MacPipeline
+     * workers) are faster per block than ViterbiDecoder1614. Smaller batches are not, nor
+     * are any batches with the scalar kernel, which is about twice as slow per block as the
+     * scalar ViterbiDecoder1614.
+     *
+     */
+
+    class ViterbiBatchDecoder1614 {
+    public:
+        ViterbiBatchDecoder1614(const char * kernelName = NULL);
+        ~ViterbiBatchDecoder1614();
+
+        static const std::size_t MAX_LANES = VITERBI_BATCH_LANES;               ///< blocks decoded by one pass
+        static const std::size_t MAX_STEPS = ViterbiDecoder1614::MAX_STEPS;     ///< longest block
+
+        std::size_t decode(const uint8_t * const * data, const std::size_t count, const std::size_t len, uint8_t * const * res, uint32_t * pathMetrics = NULL);
+        std::size_t decodeSoft(const int8_t * const * data, const std::size_t count, const std::size_t len, uint8_t * const * res, uint32_t * pathMetrics = NULL);
+
+        const char * kernelName() const;
+
+    private:
+        static const std::size_t STATES_COUNT = ViterbiDecoder1614::STATES_COUNT;
+        static const std::size_t PARITY_BITS  = ViterbiDecoder1614::PARITY_BITS;
+
+        void run(const std::size_t steps, const std::size_t count, uint8_t * const * res, uint32_t * pathMetrics);
+
+        const ViterbiBatchAcsKernel * m_kernel;                                 ///< batch add-compare-select kernel
+        const uint8_t * m_butterflyOutputs;                                     ///< branch output of state 2j for input 0, shared table given to kernel
+        int8_t   m_symbols[MAX_STEPS * PARITY_BITS * MAX_LANES];                ///< lane-interleaved soft symbols given to kernel
+        uint16_t m_pathMetrics[STATES_COUNT * MAX_LANES];                       ///< lane-interleaved path metrics of current step
+        uint16_t m_traceback[MAX_STEPS * STATES_COUNT];                         ///< survivor decisions lanes mask per state for each step (1 = odd predecessor)
+    };
+
+};
+
+#endif /* VITERBI_DECODER_H */
@@ -1,5 +1,12 @@
 #include <cstdio>
+#include <cerrno>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "decoder.h"
+#include "eventloop.h"
+#include "multicarrier.h"
+#include "udpreceiver.h"
 
 /** @brief Program working mode enumeration */
 
@@ -8,12 +15,26 @@ enum ProgramMode {
     READ_FROM_BINARY_FILE = 1,
     SAVE_TO_BINARY_FILE   = 2,
     RX_PACKED             = 4,
+    RX_SOFT               = 8,
 };
 
-/** @brief Interrupt flag */
+/** @brief Interrupt flag, file replay only: live input is stopped by the event loop */
 
 static volatile int gSigintFlag = 0;
 
+/** @brief Live input context for event loop callbacks */
+
+struct LiveInput {
+    Tetra::UdpReceiver * receiver;                                              ///< Received bits ring
+    Tetra::TetraDecoder * decoder;                                              ///< Decoder
+    Tetra::RxFormat rxFormat;                                                   ///< Received data format
+    int fdSave;                                                                 ///< Save file, 0 if none
+};
+
+/** @brief Writes to the save file which failed, the decoder keeps running without them */
+
+static uint64_t gSaveFailedWrites = 0;
+
 /**
  * @brief Handle SIGINT to clean up
  *
@@ -24,6 +45,218 @@ static void sigint_handler(int val)
     gSigintFlag = 1;
 }
 
+/**
+ * @brief Write len bytes of data to save file fd, failed writes are counted and the
+ *        first failure is reported
+ *
+ */
+
+static void saveData(int fd, const uint8_t * data, std::size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t written = write(fd, data, len);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            if (gSaveFailedWrites == 0)
+            {
+                perror("Couldn't write to save file");
+            }
+            gSaveFailedWrites++;
+            return;
+        }
+
+        data += written;
+        len  -= (std::size_t)written;
+    }
+}
+
+/**
+ * @brief Replay bytes [start, end) of a recorded file
+ *
+ * The file is memory mapped and handed to the decoder by spans, without copy. Falls back
+ * to read() when the input can't be mapped (eg. a pipe).
+ *
+ * @return Number of bursts found
+ *
+ */
+
+static std::size_t replayFile(int fd, Tetra::TetraDecoder * decoder, Tetra::RxFormat rxFormat, uint64_t start, uint64_t end, int fdSave)
+{
+    const std::size_t SPAN_LEN = 1024 * 1024;                                   // interrupt flag check period
+    std::size_t found = 0;
+
+    struct stat st;
+    void * map = MAP_FAILED;
+    uint64_t mapOffset = 0;
+
+    if ((fstat(fd, &st) == 0) && S_ISREG(st.st_mode))
+    {
+        end = std::min(end, (uint64_t)st.st_size);
+        start = std::min(start, end);
+
+        mapOffset = start & ~((uint64_t)sysconf(_SC_PAGESIZE) - 1);             // mmap offset must be page aligned
+        if (end > mapOffset)
+        {
+            map = mmap(NULL, end - mapOffset, PROT_READ, MAP_PRIVATE, fd, (off_t)mapOffset);
+        }
+        else
+        {
+            return 0;                                                           // nothing to replay
+        }
+    }
+
+    if (map != MAP_FAILED)
+    {
+        madvise(map, end - mapOffset, MADV_SEQUENTIAL);
+
+        const uint8_t * data = (const uint8_t *)map + (start - mapOffset);
+        uint64_t len = end - start;
+
+        for (uint64_t pos = 0; (pos < len) && !gSigintFlag; pos += SPAN_LEN)
+        {
+            std::size_t count = (std::size_t)std::min((uint64_t)SPAN_LEN, len - pos);
+
+            if (fdSave > 0)
+            {
+                saveData(fdSave, data + pos, count);
+            }
+
+            found += decoder->rxData(data + pos, count, rxFormat);
+        }
+
+        munmap(map, end - mapOffset);
+
+        return found;
+    }
+
+    // not a regular file, read by blocks after skipping start bytes
+    const int RXBUF_LEN = 1024;
+    uint8_t rxBuf[RXBUF_LEN];
+    uint64_t pos = 0;
+
+    while (!gSigintFlag && (pos < end))
+    {
+        int bytesRead = read(fd, rxBuf, (std::size_t)std::min((uint64_t)sizeof(rxBuf), end - pos));
+
+        if (errno == EINTR)
+        {
+            // print is required for ^C to be handled
+            fprintf(stderr, "EINTR\n");
+            break;
+        }
+        else if (bytesRead < 0)
+        {
+            fprintf(stderr, "Read error\n");
+            break;
+        }
+        else if (bytesRead == 0)
+        {
+            break;
+        }
+
+        uint64_t skip = (pos < start) ? std::min((uint64_t)bytesRead, start - pos) : 0;
+        pos += bytesRead;
+
+        if (skip < (uint64_t)bytesRead)
+        {
+            if (fdSave > 0)
+            {
+                saveData(fdSave, rxBuf + skip, (std::size_t)(bytesRead - skip));
+            }
+
+            // whole buffer is pushed into decoder which scans it for bursts
+            found += decoder->rxData(rxBuf + skip, bytesRead - skip, rxFormat);
+        }
+    }
+
+    return found;
+}
+
+/**
+ * @brief Replay stream bytes [start, end) of an indexed capture
+ *
+ * Only the chunks holding the range are read.
+ *
+ * @return Number of bursts found
+ *
+ */
+
+static std::size_t replayCapture(Tetra::CaptureReader * reader, Tetra::TetraDecoder * decoder, uint64_t start, uint64_t end, int fdSave)
+{
+    const std::vector<Tetra::Capture::Chunk> & chunks = reader->chunks();
+    Tetra::RxFormat rxFormat = (Tetra::RxFormat)reader->rxFormat();
+    std::size_t found = 0;
+
+    for (std::size_t idx = reader->chunkAtOffset(start); (idx < chunks.size()) && (chunks[idx].streamOffset < end) && !gSigintFlag; idx++)
+    {
+        std::size_t len;
+        const uint8_t * data = reader->readChunk(idx, &len);
+        if (data == NULL)
+        {
+            fprintf(stderr, "Couldn't read capture chunk %zu\n", idx);
+            break;
+        }
+
+        uint64_t offset = chunks[idx].streamOffset;
+        uint64_t first  = std::max(start, offset) - offset;
+        uint64_t last   = std::min(end, offset + len) - offset;
+        if (first >= last)
+        {
+            continue;
+        }
+
+        if (fdSave > 0)
+        {
+            saveData(fdSave, data + first, last - first);
+        }
+
+        found += decoder->rxData(data + first, last - first, rxFormat);
+    }
+
+    return found;
+}
+
+/**
+ * @brief Decode all spans received, called when the receiver event is signaled
+ *
+ */
+
+static void rxLiveInput(void * arg)
+{
+    LiveInput * input = (LiveInput *)arg;
+
+    input->receiver->clearEvent();                                              // before reading, so data written meanwhile signals again
+
+    const uint8_t * span;
+    std::size_t len;
+    while ((len = input->receiver->peek(&span, 0)) > 0)
+    {
+        if (input->fdSave > 0)
+        {
+            saveData(input->fdSave, span, len);
+        }
+
+        input->decoder->rxData(span, len, input->rxFormat);
+        input->receiver->consume(len);
+    }
+}
+
+/**
+ * @brief Decoder housekeeping timer callback
+ *
+ */
+
+static void housekeepingLiveInput(void * arg)
+{
+    ((LiveInput *)arg)->decoder->housekeeping();
+}
+
 /**
  * @brief Decoder program entry point
  *
@@ -42,6 +275,10 @@ int main(int argc, char * argv[])
     sigaction(SIGINT, &sa, 0);
 
     int udpPortRx = 42000;                                                      // UDP RX port (ie. where to receive bits from PHY layer)
+    std::vector<int> udpPortsRx(1, udpPortRx);                                  // UDP RX ports, one per carrier
+    std::size_t workersCount = 0;                                               // multi-carrier worker threads (0 = one per core)
+    std::size_t macWorkersCount = 0;                                            // lower MAC decoding threads per carrier (0 = inline)
+    int socketBufferSize = 0;                                                   // UDP RX socket buffer size (0 = system default)
     int udpPortTx = 42100;                                                      // UDP TX port (ie. where to send Json data)
 
     const int FILENAME_LEN = 256;
@@ -52,14 +289,173 @@ int main(int argc, char * argv[])
     int debugLevel = 1;
     bool bRemoveFillBits = true;
     bool bEnableWiresharkOutput = false;
+    bool bDeltaMode = false;
+    uint32_t statsPeriod = 0;                                                   // stats report period in seconds (0 = disabled)
+    const char * recordsDestination = NULL;                                     // binary MAC PDU records destination (NULL = disabled)
+    uint32_t recordsFlushMs = 10;                                               // longest time a binary record is held before being sent
+    uint64_t replayStart = 0;                                                   // replay from byte offset
+    uint64_t replayEnd   = UINT64_MAX;                                          // replay up to byte offset (excluded)
+    double replayFrom = -1.0;                                                   // replay capture from seconds after its start (< 0 = disabled)
+    double replayTo   = -1.0;                                                   // replay capture up to seconds after its start (< 0 = disabled)
+    int replayMn = 0;                                                           // replay capture from first burst of multiframe (0 = disabled)
+    const char * captureFilename = NULL;                                        // indexed capture output filename (NULL = disabled)
+    const char * snapshotFilename = NULL;                                       // cell state snapshot filename (NULL = disabled)
+    uint32_t snapshotPeriod = 10;                                               // snapshot save period in seconds (0 = on exit only)
+    const char * voiceDirectory = NULL;                                         // TCH/S voice frames output directory (NULL = disabled)
+    bool bAdaptiveSync = false;                                                 // burst acceptance adapted to link quality
+    Tetra::MacFilter macFilter;                                                 // time slots, logical channels and PDU types decoded
+
+    enum LongOption {
+        OPTION_START           = 256,
+        OPTION_END             = 257,
+        OPTION_DELTA           = 258,
+        OPTION_TN              = 259,
+        OPTION_CHANNELS        = 260,
+        OPTION_PDUS            = 261,
+        OPTION_STATS           = 262,
+        OPTION_RECORDS         = 263,
+        OPTION_FLUSH           = 264,
+        OPTION_CAPTURE         = 265,
+        OPTION_FROM            = 266,
+        OPTION_TO              = 267,
+        OPTION_MN              = 268,
+        OPTION_SNAPSHOT        = 269,
+        OPTION_SNAPSHOT_PERIOD = 270,
+        OPTION_VOICE           = 271,
+        OPTION_ADAPTIVE_SYNC   = 272,
+    };
+
+    const struct option longOptions[] = {
+        {"start",           required_argument, NULL, OPTION_START},
+        {"end",             required_argument, NULL, OPTION_END},
+        {"delta",           no_argument,       NULL, OPTION_DELTA},
+        {"tn",              required_argument, NULL, OPTION_TN},
+        {"channels",        required_argument, NULL, OPTION_CHANNELS},
+        {"pdus",            required_argument, NULL, OPTION_PDUS},
+        {"stats",           required_argument, NULL, OPTION_STATS},
+        {"records",         required_argument, NULL, OPTION_RECORDS},
+        {"flush",           required_argument, NULL, OPTION_FLUSH},
+        {"capture",         required_argument, NULL, OPTION_CAPTURE},
+        {"from",            required_argument, NULL, OPTION_FROM},
+        {"to",              required_argument, NULL, OPTION_TO},
+        {"mn",              required_argument, NULL, OPTION_MN},
+        {"snapshot",        required_argument, NULL, OPTION_SNAPSHOT},
+        {"snapshot-period", required_argument, NULL, OPTION_SNAPSHOT_PERIOD},
+        {"voice",           required_argument, NULL, OPTION_VOICE},
+        {"adaptive-sync",   no_argument,       NULL, OPTION_ADAPTIVE_SYNC},
+        {NULL,              0,                 NULL, 0}
+    };
 
     int option;
-    while ((option = getopt(argc, argv, "hPwr:t:i:o:d:f")) != -1)
+    while ((option = getopt_long(argc, argv, "hPSwr:t:i:o:d:fn:j:B:", longOptions, NULL)) != -1)
     {
         switch (option)
         {
+        case OPTION_START:
+            replayStart = strtoull(optarg, NULL, 0);
+            break;
+
+        case OPTION_END:
+            replayEnd = strtoull(optarg, NULL, 0);
+            break;
+
+        case OPTION_DELTA:
+            bDeltaMode = true;
+            break;
+
+        case OPTION_TN:
+            if (!macFilter.parseTimeSlots(optarg))
+            {
+                fprintf(stderr, "Invalid time slots '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case OPTION_CHANNELS:
+            if (!macFilter.parseChannels(optarg))
+            {
+                fprintf(stderr, "Invalid logical channels '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case OPTION_PDUS:
+            if (!macFilter.parsePduTypes(optarg))
+            {
+                fprintf(stderr, "Invalid PDU types '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case OPTION_STATS:
+            statsPeriod = (uint32_t)atoi(optarg);
+            break;
+
+        case OPTION_RECORDS:
+            recordsDestination = optarg;
+            break;
+
+        case OPTION_FLUSH:
+            recordsFlushMs = (uint32_t)atoi(optarg);
+            break;
+
+        case OPTION_CAPTURE:
+            captureFilename = optarg;
+            break;
+
+        case OPTION_FROM:
+            replayFrom = atof(optarg);
+            break;
+
+        case OPTION_TO:
+            replayTo = atof(optarg);
+            break;
+
+        case OPTION_MN:
+            replayMn = atoi(optarg);
+            if ((replayMn < 1) || (replayMn > 60))
+            {
+                fprintf(stderr, "Invalid multiframe '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case OPTION_SNAPSHOT:
+            snapshotFilename = optarg;
+            break;
+
+        case OPTION_SNAPSHOT_PERIOD:
+            snapshotPeriod = (uint32_t)atoi(optarg);
+            break;
+
+        case OPTION_VOICE:
+            voiceDirectory = optarg;
+            break;
+
+        case OPTION_ADAPTIVE_SYNC:
+            bAdaptiveSync = true;
+            break;
+
         case 'r':
-            udpPortRx = atoi(optarg);
+            udpPortsRx = Tetra::MultiCarrier::parsePorts(optarg);
+            if (udpPortsRx.empty())
+            {
+                fprintf(stderr, "Invalid RX ports '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            udpPortRx = udpPortsRx[0];
+            break;
+
+        case 'n':
+            workersCount = atoi(optarg);
+            break;
+
+        case 'j':
+            macWorkersCount = atoi(optarg);
+            break;
+
+        case 'B':
+            socketBufferSize = atoi(optarg);
             break;
 
         case 't':
@@ -69,6 +465,11 @@ int main(int argc, char * argv[])
         case 'P':
             programMode |= RX_PACKED;
             break;
+
+        case 'S':
+            programMode |= RX_SOFT;
+            break;
+
         case 'i':
             strncpy(optFilenameInput, optarg, FILENAME_LEN - 1);
             programMode |= READ_FROM_BINARY_FILE;
@@ -95,13 +496,33 @@ int main(int argc, char * argv[])
             printf("\nUsage: ./decoder [OPTIONS]\n\n"
                    "Options:\n"
                    "  -r <UDP socket> receiving from phy [default port is 42000]\n"
-                   "  -t <UDP socket> sending Json data [default port is 42100]\n"
-                   "  -i <file> replay data from binary file instead of UDP\n"
+                   "     port list or range (ie. 42000-42007 or 42000,42002) decodes one carrier per port\n"
+                   "  -t <UDP socket> sending Json data [default port is 42100], carrier N sends to port + N\n"
+                   "  -n <workers> multi-carrier worker threads, pinned to cores [default one per core]\n"
+                   "  -j <workers> decode bursts on worker threads, upper layers stay in order [default 0, no thread]\n"
+                   "  -B <bytes> UDP receive socket buffer size [default system value]\n"
+                   "  -i <file> replay data from binary file instead of UDP, as fast as possible\n"
+                   "  --start <offset> --end <offset> replay only file bytes [start, end), stream bytes for an indexed capture\n"
+                   "  --from <seconds> --to <seconds> replay only the indexed capture time window, seconds after its start\n"
+                   "  --mn <multiframe> replay the indexed capture from the first burst of multiframe (1-60)\n"
                    "  -o <file> record data to binary file (can be replayed with -i option)\n"
+                   "  --capture <file> record data to indexed capture with timestamps and bursts index (can be replayed with -i option)\n"
                    "  -d <level> print debug information\n"
                    "  -f keep fill bits\n"
                    "  -w enable wireshark output [EXPERIMENTAL]\n"
+                   "  --delta skip SYNC, SYSINFO and ACCESS-DEFINE identical to the last ones received\n"
+                   "  --tn <list> decode only blocks on these time slots (ie. 1,3), AACH and BSCH are always decoded\n"
+                   "  --channels <list> decode only these logical channels among SCH_F,SCH_HD,STCH,BNCH,TCH_S\n"
+                   "  --pdus <list> pass to LLC only these MAC PDU types among sync,resource,frag,sysinfo,dblock\n"
+                   "  --stats <seconds> report decoding stages counters and latencies as JSON every <seconds>\n"
+                   "  --records <udp:port|shm:name> also send MAC PDU as binary records, batched, to localhost UDP port or shared memory ring\n"
+                   "  --flush <ms> longest time a binary record is held before being sent [default 10 ms]\n"
+                   "  --snapshot <file> warm start from cell state snapshot and save it periodically, multi-carrier appends .<rx port>\n"
+                   "  --snapshot-period <seconds> snapshot save period, 0 to save on exit only [default 10 s]\n"
+                   "  --voice <directory> write TCH/S frames to one file per call in directory instead of U-Plane\n"
+                   "  --adaptive-sync adapt burst acceptance to the estimated bit error rate, accepted bursts keep synchronization\n"
                    "  -P pack rx data (1 byte = 8 bits)\n"
+                   "  -S soft rx data (1 signed byte per bit, > 0 for 1, < 0 for 0, 0 for erased)\n"
                    "  -h print this help\n\n");
             exit(EXIT_FAILURE);
             break;
@@ -114,22 +535,6 @@ int main(int argc, char * argv[])
     }
 
 
-    // create output destination socket
-    struct sockaddr_in addr_output;
-    memset(&addr_output, 0, sizeof(struct sockaddr_in));
-    addr_output.sin_family = AF_INET;
-    addr_output.sin_port = htons(udpPortTx);
-    inet_aton("127.0.0.1", &addr_output.sin_addr);
-
-    int udpSocketFd  = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    connect(udpSocketFd, (struct sockaddr *) & addr_output, sizeof(struct sockaddr));
-    printf("Output socket 0x%04x on port %d\n", udpSocketFd, udpPortTx);
-    if (udpSocketFd < 0)
-    {
-        perror("Couldn't create output socket");
-        exit(EXIT_FAILURE);
-    }
-
     // create decoder
     Tetra::LogLevel logLevel;
     switch (debugLevel)
@@ -154,6 +559,104 @@ int main(int argc, char * argv[])
 
     }
 
+    Tetra::RxFormat rxFormat = Tetra::RX_FORMAT_UNPACKED;
+    if (programMode & RX_SOFT)
+    {
+        rxFormat = Tetra::RX_FORMAT_SOFT;
+    }
+    else if (programMode & RX_PACKED)
+    {
+        rxFormat = Tetra::RX_FORMAT_PACKED;
+    }
+
+    // live input is served by an event loop, stop signals are blocked before any thread is created and read from it
+    Tetra::EventLoop * eventLoop = NULL;
+    if (!(programMode & READ_FROM_BINARY_FILE))
+    {
+        eventLoop = new Tetra::EventLoop();
+        if (!eventLoop->isValid() || !eventLoop->stopOnSignals())
+        {
+            fprintf(stderr, "Couldn't create event loop\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (udpPortsRx.size() > 1)
+    {
+        // multi-carrier: independent decoder per port, served by pinned worker threads
+        if (programMode & (READ_FROM_BINARY_FILE | SAVE_TO_BINARY_FILE))
+        {
+            fprintf(stderr, "-i and -o options are only available with a single carrier\n");
+            exit(EXIT_FAILURE);
+        }
+
+        if (recordsDestination)
+        {
+            fprintf(stderr, "--records option is only available with a single carrier\n");
+            exit(EXIT_FAILURE);
+        }
+
+        if (captureFilename)
+        {
+            fprintf(stderr, "--capture option is only available with a single carrier\n");
+            exit(EXIT_FAILURE);
+        }
+
+        if (voiceDirectory)
+        {
+            fprintf(stderr, "--voice option is only available with a single carrier\n");
+            exit(EXIT_FAILURE);
+        }
+
+        if (workersCount == 0)
+        {
+            long cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+            workersCount = cpuCount > 0 ? (std::size_t)cpuCount : 1;
+        }
+
+        Tetra::MultiCarrier * multiCarrier = new Tetra::MultiCarrier(udpPortsRx, udpPortTx, workersCount, rxFormat, bRemoveFillBits, logLevel, bEnableWiresharkOutput, macWorkersCount, bDeltaMode, macFilter, statsPeriod);
+
+        if (snapshotFilename)
+        {
+            multiCarrier->enableSnapshots(snapshotFilename, snapshotPeriod);
+        }
+
+        if (bAdaptiveSync)
+        {
+            multiCarrier->enableAdaptiveSync();
+        }
+
+        if (multiCarrier->start())
+        {
+            eventLoop->run();                                                   // until stop signal
+        }
+
+        multiCarrier->stop();
+        multiCarrier->wait();
+        delete multiCarrier;
+        delete eventLoop;
+
+        printf("Clean exit\n");
+
+        return EXIT_SUCCESS;
+    }
+
+    // create output destination socket
+    struct sockaddr_in addr_output;
+    memset(&addr_output, 0, sizeof(struct sockaddr_in));
+    addr_output.sin_family = AF_INET;
+    addr_output.sin_port = htons(udpPortTx);
+    inet_aton("127.0.0.1", &addr_output.sin_addr);
+
+    int udpSocketFd  = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    connect(udpSocketFd, (struct sockaddr *) & addr_output, sizeof(struct sockaddr));
+    printf("Output socket 0x%04x on port %d\n", udpSocketFd, udpPortTx);
+    if (udpSocketFd < 0)
+    {
+        perror("Couldn't create output socket");
+        exit(EXIT_FAILURE);
+    }
+
     // output file if any
     int fdOutputSaveFile = 0;
 
@@ -170,6 +673,7 @@ int main(int argc, char * argv[])
 
     // input source
     int fdInput = 0;
+    Tetra::CaptureReader * captureReader = NULL;
 
     if (programMode & READ_FROM_BINARY_FILE)
     {
@@ -183,6 +687,8 @@ int main(int argc, char * argv[])
             fprintf(stderr, "Couldn't open input bits file");
             exit(EXIT_FAILURE);
         }
+
+        captureReader = Tetra::CaptureReader::open(fdInput);                    // NULL when raw bytes
     }
     else
     {
@@ -205,68 +711,205 @@ int main(int argc, char * argv[])
         }
     }
 
-    // create decoder
-    Tetra::TetraDecoder * decoder = new Tetra::TetraDecoder(udpSocketFd, bRemoveFillBits, logLevel, bEnableWiresharkOutput);
+    // binary records output if any
+    Tetra::RecordOutput * recordOutput = NULL;
 
-    // receive buffer
-    const int RXBUF_LEN = 1024;
-    uint8_t rxBuf[RXBUF_LEN];
+    if (recordsDestination)
+    {
+        recordOutput = Tetra::RecordOutput::open(recordsDestination, recordsFlushMs);
+        if (recordOutput == NULL)
+        {
+            fprintf(stderr, "Couldn't open records output '%s'\n", recordsDestination);
+            exit(EXIT_FAILURE);
+        }
+    }
 
-    while (!gSigintFlag)
+    if (captureReader)
     {
-        int bytesRead = read(fdInput, rxBuf, sizeof(rxBuf));
+        // data format and replay window come from the capture
+        rxFormat = (Tetra::RxFormat)captureReader->rxFormat();
 
-        if (errno == EINTR)
+        const std::vector<Tetra::Capture::Chunk> & chunks = captureReader->chunks();
+        if (!chunks.empty())
         {
-            // print is required for ^C to be handled
-            fprintf(stderr, "EINTR\n");
-            break;
+            uint64_t origin = chunks[0].timestampNs;
+
+            if (replayFrom >= 0.0)
+            {
+                replayStart = std::max(replayStart, chunks[captureReader->chunkAtTime(origin + (uint64_t)(replayFrom * 1e9))].streamOffset);
+            }
+
+            if (replayTo >= 0.0)
+            {
+                const Tetra::Capture::Chunk & last = chunks[captureReader->chunkAtTime(origin + (uint64_t)(replayTo * 1e9))];
+                replayEnd = std::min(replayEnd, last.streamOffset + last.dataLen);
+            }
+
+            if (replayMn > 0)
+            {
+                uint64_t offset;
+                if (!captureReader->multiframeOffset((uint16_t)replayMn, replayStart, &offset))
+                {
+                    fprintf(stderr, "No burst of multiframe %d in capture\n", replayMn);
+                    offset = replayEnd;
+                }
+                replayStart = offset;
+            }
         }
-        else if (bytesRead < 0)
+
+        uint64_t streamLen = chunks.empty() ? 0 : chunks.back().streamOffset + chunks.back().dataLen;
+        printf("Input capture %zu chunks, replaying stream bytes [%llu, %llu)\n", chunks.size(), (unsigned long long)replayStart, (unsigned long long)std::min(replayEnd, streamLen));
+    }
+    else if ((replayFrom >= 0.0) || (replayTo >= 0.0) || (replayMn > 0))
+    {
+        fprintf(stderr, "--from, --to and --mn options require an indexed capture input\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // indexed capture output if any
+    Tetra::CaptureWriter * captureWriter = NULL;
+
+    if (captureFilename)
+    {
+        captureWriter = Tetra::CaptureWriter::open(captureFilename, (uint8_t)rxFormat);
+        if (captureWriter == NULL)
         {
-            fprintf(stderr, "Read error\n");
-            break;
+            fprintf(stderr, "Couldn't open capture output '%s'\n", captureFilename);
+            exit(EXIT_FAILURE);
         }
-        else if (bytesRead == 0)
+    }
+
+    // voice frames output if any
+    Tetra::VoiceOutput * voiceOutput = NULL;
+
+    if (voiceDirectory)
+    {
+        voiceOutput = Tetra::VoiceOutput::open(voiceDirectory);
+        if (voiceOutput == NULL)
         {
-            break;
+            fprintf(stderr, "Couldn't open voice output directory '%s'\n", voiceDirectory);
+            exit(EXIT_FAILURE);
         }
+    }
 
-        if (programMode & SAVE_TO_BINARY_FILE)
+    // create decoder
+    Tetra::TetraDecoder * decoder = new Tetra::TetraDecoder(udpSocketFd, bRemoveFillBits, logLevel, bEnableWiresharkOutput, macWorkersCount, bDeltaMode, macFilter, statsPeriod, recordOutput, captureWriter, voiceOutput);
+
+    if (snapshotFilename)
+    {
+        decoder->enableSnapshot(snapshotFilename, snapshotPeriod);
+    }
+
+    if (bAdaptiveSync)
+    {
+        decoder->enableAdaptiveSync();
+    }
+
+    if (programMode & READ_FROM_BINARY_FILE)
+    {
+        struct timeval timeStart;
+        struct timeval timeEnd;
+        gettimeofday(&timeStart, NULL);
+
+        int fdSave = (programMode & SAVE_TO_BINARY_FILE) ? fdOutputSaveFile : 0;
+        std::size_t bursts = captureReader ? replayCapture(captureReader, decoder, replayStart, replayEnd, fdSave) : replayFile(fdInput, decoder, rxFormat, replayStart, replayEnd, fdSave);
+
+        gettimeofday(&timeEnd, NULL);
+        double elapsed = (double)(timeEnd.tv_sec - timeStart.tv_sec) + (double)(timeEnd.tv_usec - timeStart.tv_usec) * 1e-6;
+
+        fprintf(stderr, "Decoded %zu bursts in %.3f s: %.0f bursts/s, %.2f us/burst\n",
+                bursts, elapsed, (elapsed > 0.0) ? (double)bursts / elapsed : 0.0, (bursts > 0) ? elapsed * 1e6 / (double)bursts : 0.0);
+    }
+    else
+    {
+        // UDP socket is drained by receive thread, decoder consumes received spans
+        const std::size_t RING_LEN = 4 * 1024 * 1024;                           // ~2 minutes of unpacked bits at 36 kbit/s
+        Tetra::UdpReceiver * receiver = new Tetra::UdpReceiver(fdInput, RING_LEN, socketBufferSize);
+
+        LiveInput input;
+        input.receiver = receiver;
+        input.decoder  = decoder;
+        input.rxFormat = rxFormat;
+        input.fdSave   = (programMode & SAVE_TO_BINARY_FILE) ? fdOutputSaveFile : 0;
+
+        // housekeeping often enough to honour the records flush interval
+        uint32_t periodMs = 100;
+        if (recordOutput)
         {
-            write(fdOutputSaveFile, rxBuf, bytesRead);
+            periodMs = std::max((uint32_t)1, std::min(periodMs, recordsFlushMs));
         }
 
-        // bytes must be pushed one at a time into decoder
-        for (int cnt = 0; cnt < bytesRead; cnt++)
+        if (receiver->start() &&
+            eventLoop->addReader(receiver->eventFd(), rxLiveInput, &input) &&
+            eventLoop->addTimer(periodMs, housekeepingLiveInput, &input))
         {
-        	if (programMode & RX_PACKED)
-        	{
-        		for (uint8_t idx = 0; idx <= 7; idx++)
-        	    {
-        			decoder->rxSymbol((rxBuf[cnt] >> idx) & 0x01);
-        		}
-        	}
-        	else
-        	{
-        		decoder->rxSymbol(rxBuf[cnt]);
-        	}
+            eventLoop->run();                                                   // until stop signal
         }
+
+        receiver->stop();
+        receiver->printStats();
+        delete eventLoop;                                                       // before receiver, it watches its event descriptor
+        delete receiver;
+    }
+
+    decoder->flush();                                                           // bursts in flight in the pipeline report before output socket is closed
+
+    if (statsPeriod > 0)
+    {
+        decoder->reportStats();                                                 // last report, bursts in flight included
     }
 
     close(udpSocketFd);
 
     // file or socket must be closed
+    delete captureReader;
     close(fdInput);
 
     // close save file only if openede
     if (programMode & SAVE_TO_BINARY_FILE)
     {
         close(fdOutputSaveFile);
+
+        if (gSaveFailedWrites > 0)
+        {
+            fprintf(stderr, "Save file   : %llu writes failed\n", (unsigned long long)gSaveFailedWrites);
+        }
+    }
+
+    if (bAdaptiveSync || (statsPeriod > 0))
+    {
+        const Tetra::LinkQuality & linkQuality = decoder->linkQuality();
+        fprintf(stderr, "Link quality: %llu bursts accepted, %llu rejected, estimated BER %.3f %%, Viterbi path metric %.3f per bit\n",
+                (unsigned long long)linkQuality.acceptedCount(), (unsigned long long)linkQuality.rejectedCount(), linkQuality.ber() * 100.0, linkQuality.pathMetric());
+    }
+
+    if (bDeltaMode)
+    {
+        fprintf(stderr, "Delta mode  : %llu unchanged broadcast PDU skipped\n", (unsigned long long)decoder->deltaSkippedCount());
     }
 
     delete decoder;
 
+    if (recordOutput)
+    {
+        recordOutput->flush();
+        recordOutput->printStats();
+        delete recordOutput;
+    }
+
+    if (voiceOutput)
+    {
+        voiceOutput->printStats();
+        delete voiceOutput;                                                     // calls in progress are written
+    }
+
+    if (captureWriter)
+    {
+        captureWriter->flush();
+        captureWriter->printStats();
+        delete captureWriter;                                                   // index is written
+    }
+
     printf("Clean exit\n");
 
     return EXIT_SUCCESS;
@@ -0,0 +1,352 @@
+#include <cstdio>
+#include <cstdlib>
+#include <sched.h>
+#include "multicarrier.h"
+
+using namespace Tetra;
+
+/**
+ * @brief Multi-carrier decoder
+ *
+ * Carrier i receives from rxPorts[i] and sends to txPortBase + i. Carriers are assigned
+ * round-robin to the workers.
+ *
+ */
+
+MultiCarrier::MultiCarrier(const std::vector<int> & rxPorts, int txPortBase, std::size_t workersCount, RxFormat rxFormat,
+                           bool bRemoveFillBits, const LogLevel logLevel, bool bEnableWiresharkOutput, std::size_t macWorkersCount, bool bDeltaMode,
+                           const MacFilter & macFilter, uint32_t statsPeriod)
+{
+    m_rxFormat = rxFormat;
+
+    if (workersCount < 1)
+    {
+        workersCount = 1;
+    }
+    if (workersCount > rxPorts.size())
+    {
+        workersCount = rxPorts.size();
+    }
+
+    long cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpuCount < 1)
+    {
+        cpuCount = 1;
+    }
+
+    for (std::size_t idx = 0; idx < workersCount; idx++)
+    {
+        Worker * worker  = new Worker();
+        worker->parent   = this;
+        worker->loop     = new EventLoop();
+        worker->bStarted = false;
+        worker->cpu      = (int)(idx % (std::size_t)cpuCount);
+        m_workers.push_back(worker);
+    }
+
+    for (std::size_t idx = 0; idx < rxPorts.size(); idx++)
+    {
+        Carrier * carrier = new Carrier();
+        carrier->parent  = this;
+        carrier->rxPort  = rxPorts[idx];
+        carrier->txPort  = txPortBase + (int)idx;
+        carrier->txFd    = openTxSocket(carrier->txPort);
+        carrier->rxFd    = openRxSocket(carrier->rxPort);
+        carrier->decoder = new TetraDecoder(carrier->txFd, bRemoveFillBits, logLevel, bEnableWiresharkOutput, macWorkersCount, bDeltaMode, macFilter, statsPeriod);
+
+        m_carriers.push_back(carrier);
+        m_workers[idx % workersCount]->carriers.push_back(carrier);
+
+        printf("Carrier %zu: rx port %d -> tx port %d, worker %zu\n", idx, carrier->rxPort, carrier->txPort, idx % workersCount);
+    }
+}
+
+/**
+ * @brief Warm start each carrier from its own snapshot file <prefix>.<rx port>, see TetraDecoder::enableSnapshot
+ *
+ * Must be called before start().
+ *
+ */
+
+void MultiCarrier::enableSnapshots(const std::string & filenamePrefix, uint32_t period)
+{
+    for (std::size_t idx = 0; idx < m_carriers.size(); idx++)
+    {
+        m_carriers[idx]->decoder->enableSnapshot(filenamePrefix + "." + std::to_string(m_carriers[idx]->rxPort), period);
+    }
+}
+
+/**
+ * @brief Adapt burst acceptance of each carrier to its own link quality, see TetraDecoder::enableAdaptiveSync
+ *
+ * Must be called before start().
+ *
+ */
+
+void MultiCarrier::enableAdaptiveSync()
+{
+    for (std::size_t idx = 0; idx < m_carriers.size(); idx++)
+    {
+        m_carriers[idx]->decoder->enableAdaptiveSync();
+    }
+}
+
+/**
+ * @brief Clean up, workers must be stopped before
+ *
+ */
+
+MultiCarrier::~MultiCarrier()
+{
+    stop();
+    wait();
+
+    for (std::size_t idx = 0; idx < m_carriers.size(); idx++)
+    {
+        delete m_carriers[idx]->decoder;
+        close(m_carriers[idx]->rxFd);
+        close(m_carriers[idx]->txFd);
+        delete m_carriers[idx];
+    }
+
+    for (std::size_t idx = 0; idx < m_workers.size(); idx++)
+    {
+        delete m_workers[idx]->loop;
+        delete m_workers[idx];
+    }
+}
+
+/**
+ * @brief Parse ports list: single "42000", range "42000-42007" or list "42000,42002,42010-42011"
+ *
+ * @return Ports list, empty on syntax error
+ *
+ */
+
+std::vector<int> MultiCarrier::parsePorts(const char * str)
+{
+    std::vector<int> ports;
+
+    const char * pos = str;
+    while (*pos != '\0')
+    {
+        char * end;
+        long first = strtol(pos, &end, 10);
+        if (end == pos || first <= 0 || first > 65535)
+        {
+            return std::vector<int>();
+        }
+
+        long last = first;
+        pos = end;
+        if (*pos == '-')
+        {
+            pos++;
+            last = strtol(pos, &end, 10);
+            if (end == pos || last < first || last > 65535)
+            {
+                return std::vector<int>();
+            }
+            pos = end;
+        }
+
+        for (long port = first; port <= last; port++)
+        {
+            ports.push_back((int)port);
+        }
+
+        if (*pos == ',')
+        {
+            pos++;
+        }
+        else if (*pos != '\0')
+        {
+            return std::vector<int>();
+        }
+    }
+
+    return ports;
+}
+
+/**
+ * @brief Create input socket bound to localhost port
+ *
+ */
+
+int MultiCarrier::openRxSocket(int port)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(struct sockaddr_in));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_aton("127.0.0.1", &addr.sin_addr);
+
+    int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(struct sockaddr)) < 0)
+    {
+        fprintf(stderr, "Couldn't create input socket on port %d\n", port);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Input socket 0x%04x on port %d\n", fd, port);
+
+    return fd;
+}
+
+/**
+ * @brief Create output socket connected to localhost port
+ *
+ */
+
+int MultiCarrier::openTxSocket(int port)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(struct sockaddr_in));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_aton("127.0.0.1", &addr.sin_addr);
+
+    int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd < 0)
+    {
+        perror("Couldn't create output socket");
+        exit(EXIT_FAILURE);
+    }
+    connect(fd, (struct sockaddr *)&addr, sizeof(struct sockaddr));
+
+    printf("Output socket 0x%04x on port %d\n", fd, port);
+
+    return fd;
+}
+
+/**
+ * @brief Start worker threads
+ *
+ * @return false if a thread couldn't be created
+ *
+ */
+
+bool MultiCarrier::start()
+{
+    for (std::size_t idx = 0; idx < m_workers.size(); idx++)
+    {
+        Worker * worker = m_workers[idx];
+        if (pthread_create(&worker->thread, NULL, workerThread, worker) != 0)
+        {
+            fprintf(stderr, "Couldn't create worker thread %zu\n", idx);
+            return false;
+        }
+        worker->bStarted = true;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Request workers to exit, their loops wake up immediately
+ *
+ */
+
+void MultiCarrier::stop()
+{
+    for (std::size_t idx = 0; idx < m_workers.size(); idx++)
+    {
+        m_workers[idx]->loop->stop();
+    }
+}
+
+/**
+ * @brief Wait for all workers to exit
+ *
+ */
+
+void MultiCarrier::wait()
+{
+    for (std::size_t idx = 0; idx < m_workers.size(); idx++)
+    {
+        if (m_workers[idx]->bStarted)
+        {
+            pthread_join(m_workers[idx]->thread, NULL);
+            m_workers[idx]->bStarted = false;
+        }
+    }
+}
+
+/**
+ * @brief Worker thread entry point, pin to core and serve carriers
+ *
+ */
+
+void * MultiCarrier::workerThread(void * arg)
+{
+    Worker * worker = (Worker *)arg;
+
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(worker->cpu, &cpuSet);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet) != 0)
+    {
+        fprintf(stderr, "Couldn't pin worker to cpu %d\n", worker->cpu);
+    }
+
+    worker->parent->serveCarriers(worker);
+
+    return NULL;
+}
+
+/**
+ * @brief Drain carrier socket into its decoder, so a busy carrier doesn't wait for one event per datagram
+ *
+ */
+
+void MultiCarrier::rxCarrier(void * arg)
+{
+    const int RXBUF_LEN = 1024;
+    uint8_t rxBuf[RXBUF_LEN];
+
+    Carrier * carrier = (Carrier *)arg;
+
+    ssize_t bytesRead;
+    while ((bytesRead = recv(carrier->rxFd, rxBuf, sizeof(rxBuf), MSG_DONTWAIT)) > 0)
+    {
+        carrier->decoder->rxData(rxBuf, (std::size_t)bytesRead, carrier->parent->m_rxFormat);
+    }
+}
+
+/**
+ * @brief Run periodic tasks of the worker carriers, see TetraDecoder::housekeeping
+ *
+ */
+
+void MultiCarrier::housekeepingWorker(void * arg)
+{
+    Worker * worker = (Worker *)arg;
+
+    for (std::size_t idx = 0; idx < worker->carriers.size(); idx++)
+    {
+        worker->carriers[idx]->decoder->housekeeping();
+    }
+}
+
+/**
+ * @brief Wait for data on any of the worker carriers and push it into the carrier decoder
+ *
+ */
+
+void MultiCarrier::serveCarriers(Worker * worker)
+{
+    const uint32_t HOUSEKEEPING_PERIOD_MS = 100;
+
+    if (!worker->loop->isValid())
+    {
+        return;
+    }
+
+    for (std::size_t idx = 0; idx < worker->carriers.size(); idx++)
+    {
+        worker->loop->addReader(worker->carriers[idx]->rxFd, rxCarrier, worker->carriers[idx]);
+    }
+    worker->loop->addTimer(HOUSEKEEPING_PERIOD_MS, housekeepingWorker, worker);
+
+    worker->loop->run();
+}
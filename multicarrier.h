@@ -0,0 +1,78 @@
+#ifndef MULTICARRIER_H
+#define MULTICARRIER_H
+#include <cstdint>
+#include <vector>
+#include <pthread.h>
+
+#include "decoder.h"
+#include "eventloop.h"
+
+namespace Tetra {
+
+    /**
+     * @brief Multi-carrier decoder, one independent TetraDecoder per carrier
+     *
+     * Each carrier receives from its own UDP port and sends Json data to its own UDP port.
+     * Carriers are spread over a pool of worker threads, each pinned to one core. Decoder stacks
+     * (TetraDecoder, Mac, TetraCell...) are never shared between carriers so a worker only ever
+     * touches its own carriers, read-only tables (Viterbi trellis, BSCH scrambling sequence)
+     * are shared by all.
+     *
+     * Each worker runs an EventLoop: it sleeps until one of its sockets is readable, and a
+     * housekeeping timer keeps stats, outputs and timeouts of silent carriers running.
+     *
+     */
+
+    class MultiCarrier {
+    public:
+        MultiCarrier(const std::vector<int> & rxPorts, int txPortBase, std::size_t workersCount, RxFormat rxFormat,
+                     bool bRemoveFillBits, const LogLevel logLevel, bool bEnableWiresharkOutput, std::size_t macWorkersCount = 0, bool bDeltaMode = false,
+                     const MacFilter & macFilter = MacFilter(), uint32_t statsPeriod = 0);
+        ~MultiCarrier();
+
+        void enableSnapshots(const std::string & filenamePrefix, uint32_t period);
+        void enableAdaptiveSync();
+        bool start();
+        void stop();
+        void wait();
+
+        static std::vector<int> parsePorts(const char * str);
+
+    private:
+        /** @brief One carrier: sockets and decoder stack */
+
+        struct Carrier {
+            MultiCarrier * parent;                                              ///< Owner, for format
+            int rxPort;                                                         ///< UDP port to receive bits from
+            int txPort;                                                         ///< UDP port to send Json data to
+            int rxFd;                                                           ///< Input socket
+            int txFd;                                                           ///< Output socket
+            TetraDecoder * decoder;                                             ///< Carrier decoder stack
+        };
+
+        /** @brief One worker thread serving a set of carriers */
+
+        struct Worker {
+            MultiCarrier * parent;                                              ///< Owner
+            EventLoop * loop;                                                   ///< Carriers sockets and housekeeping timer
+            pthread_t thread;                                                   ///< Worker thread
+            bool bStarted;                                                      ///< True when thread is running
+            int cpu;                                                            ///< Core the worker is pinned to
+            std::vector<Carrier *> carriers;                                    ///< Carriers served by worker
+        };
+
+        static int openRxSocket(int port);
+        static int openTxSocket(int port);
+        static void * workerThread(void * arg);
+        static void rxCarrier(void * arg);
+        static void housekeepingWorker(void * arg);
+        void serveCarriers(Worker * worker);
+
+        std::vector<Carrier *> m_carriers;                                      ///< All carriers
+        std::vector<Worker *> m_workers;                                        ///< Worker pool
+        RxFormat m_rxFormat;                                                    ///< Received data format, same for all carriers
+    };
+
+};
+
+#endif /* MULTICARRIER_H */
@@ -0,0 +1,375 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include "common/stagestats.h"
+#include "recordoutput.h"
+
+using namespace Tetra;
+
+/**
+ * @brief UDP sink on an already connected socket, the socket is closed on destruction
+ *
+ */
+
+UdpRecordSink::UdpRecordSink(int socketFd)
+{
+    m_socketFd         = socketFd;
+    m_datagramsSent    = 0;
+    m_datagramsDropped = 0;
+}
+
+/**
+ * @brief Destructor
+ *
+ */
+
+UdpRecordSink::~UdpRecordSink()
+{
+    close(m_socketFd);
+}
+
+/**
+ * @brief Pack records into datagrams and send them by batches
+ *
+ */
+
+void UdpRecordSink::write(const uint8_t * records, const std::size_t len)
+{
+    struct mmsghdr msgs[BATCH_LEN];
+    struct iovec iovecs[BATCH_LEN];
+    std::size_t pos = 0;
+
+    while (pos < len)
+    {
+        unsigned int count = 0;
+
+        while ((pos < len) && (count < BATCH_LEN))
+        {
+            // gather whole records up to the datagram length
+            std::size_t start = pos;
+            while (pos < len)
+            {
+                std::size_t recordLen = (std::size_t)records[pos] | ((std::size_t)records[pos + 1] << 8);
+                if ((pos > start) && (pos + recordLen - start > DATAGRAM_LEN))
+                {
+                    break;
+                }
+                pos += recordLen;
+            }
+
+            iovecs[count].iov_base = (void *)(records + start);
+            iovecs[count].iov_len  = pos - start;
+
+            memset(&msgs[count], 0, sizeof(msgs[count]));
+            msgs[count].msg_hdr.msg_iov    = &iovecs[count];
+            msgs[count].msg_hdr.msg_iovlen = 1;
+            count++;
+        }
+
+        int sent = sendmmsg(m_socketFd, msgs, count, MSG_DONTWAIT);
+        if (sent < 0)
+        {
+            sent = 0;                                                           // no listener or socket buffer full, records are lost
+        }
+
+        m_datagramsSent    += (uint64_t)sent;
+        m_datagramsDropped += (uint64_t)(count - (unsigned int)sent);
+    }
+}
+
+/**
+ * @brief Print counters
+ *
+ */
+
+void UdpRecordSink::printStats()
+{
+    fprintf(stderr, "Records UDP : %llu datagrams sent, %llu dropped\n", (unsigned long long)m_datagramsSent, (unsigned long long)m_datagramsDropped);
+}
+
+/**
+ * @brief Create or reuse the POSIX shared memory object name, ring is reset
+ *
+ */
+
+ShmRecordSink::ShmRecordSink(const std::string & name, const std::size_t capacity)
+{
+    m_name   = name;
+    m_header = NULL;
+    m_ring   = NULL;
+    m_mapLen = sizeof(ShmRingHeader) + capacity;
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        perror("Couldn't open shared memory");
+        return;
+    }
+
+    if (ftruncate(fd, (off_t)m_mapLen) < 0)
+    {
+        perror("Couldn't size shared memory");
+        close(fd);
+        return;
+    }
+
+    void * map = mmap(NULL, m_mapLen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);                                                                  // mapping keeps the object
+    if (map == MAP_FAILED)
+    {
+        perror("Couldn't map shared memory");
+        return;
+    }
+
+    m_header = (ShmRingHeader *)map;
+    m_ring   = (uint8_t *)map + sizeof(ShmRingHeader);
+
+    m_header->capacity = capacity;
+    m_header->version  = RecordOutput::RECORD_VERSION;
+    m_header->writePos.store(0, std::memory_order_relaxed);
+    m_header->writeStart.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_header->magic    = MAGIC;                                                 // header is valid
+}
+
+/**
+ * @brief Destructor, the shared memory object is left for consumers
+ *
+ */
+
+ShmRecordSink::~ShmRecordSink()
+{
+    if (m_header)
+    {
+        munmap(m_header, m_mapLen);
+    }
+}
+
+/**
+ * @brief Return true when the shared memory is mapped
+ *
+ */
+
+bool ShmRecordSink::isOpen() const
+{
+    return m_header != NULL;
+}
+
+/**
+ * @brief Append records to ring, overwritten range is published before the copy
+ *
+ */
+
+void ShmRecordSink::write(const uint8_t * records, const std::size_t len)
+{
+    if (!m_header)
+    {
+        return;
+    }
+
+    uint64_t writePos = m_header->writePos.load(std::memory_order_relaxed);
+    std::size_t capacity = (std::size_t)m_header->capacity;
+    std::size_t pos = (std::size_t)(writePos % capacity);
+
+    m_header->writeStart.store(writePos + len, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);                        // consumers see writeStart before any overwritten byte
+
+    std::size_t first = std::min(len, capacity - pos);                          // ring wraps around
+    memcpy(m_ring + pos, records, first);
+    memcpy(m_ring, records + first, len - first);
+
+    m_header->writePos.store(writePos + len, std::memory_order_release);
+}
+
+/**
+ * @brief Print counters
+ *
+ */
+
+void ShmRecordSink::printStats()
+{
+    if (m_header)
+    {
+        fprintf(stderr, "Records shm : %llu bytes written to %s\n", (unsigned long long)m_header->writePos.load(std::memory_order_relaxed), m_name.c_str());
+    }
+}
+
+/**
+ * @brief Binary records output to sink, which is owned
+ *
+ * @param flushIntervalMs  Longest time a record is held in batch when poll() is called regularly
+ *
+ */
+
+RecordOutput::RecordOutput(RecordSink * sink, const uint32_t flushIntervalMs)
+{
+    m_sink            = sink;
+    m_flushIntervalNs = (uint64_t)flushIntervalMs * 1000000;
+    m_firstRecordNs   = 0;
+    m_recordsCount    = 0;
+
+    m_batch.reserve(BATCH_LEN);
+}
+
+/**
+ * @brief Destructor, pending records are sent
+ *
+ */
+
+RecordOutput::~RecordOutput()
+{
+    flush();
+    delete m_sink;
+}
+
+/**
+ * @brief Create output to destination "udp:<port>" (localhost) or "shm:<name>"
+ *
+ * @return NULL when destination is invalid or can't be opened
+ *
+ */
+
+RecordOutput * RecordOutput::open(const char * destination, const uint32_t flushIntervalMs)
+{
+    std::string dest(destination);
+
+    if (dest.compare(0, 4, "udp:") == 0)
+    {
+        char * end;
+        long port = strtol(dest.c_str() + 4, &end, 10);
+        if ((*end != '\0') || (end == dest.c_str() + 4) || (port <= 0) || (port > 65535))
+        {
+            return NULL;
+        }
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(struct sockaddr_in));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)port);
+        inet_aton("127.0.0.1", &addr.sin_addr);
+
+        int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (fd < 0)
+        {
+            perror("Couldn't create records socket");
+            return NULL;
+        }
+        connect(fd, (struct sockaddr *)&addr, sizeof(struct sockaddr));
+
+        return new RecordOutput(new UdpRecordSink(fd), flushIntervalMs);
+    }
+    else if ((dest.compare(0, 4, "shm:") == 0) && (dest.size() > 4))
+    {
+        std::string name = dest.substr(4);
+        if (name[0] != '/')
+        {
+            name = "/" + name;                                                  // POSIX shared memory names start with a slash
+        }
+
+        ShmRecordSink * sink = new ShmRecordSink(name, SHM_RING_LEN);
+        if (!sink->isOpen())
+        {
+            delete sink;
+            return NULL;
+        }
+
+        return new RecordOutput(sink, flushIntervalMs);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Append a MAC PDU record to batch, batch is sent first if the record doesn't fit
+ *
+ */
+
+void RecordOutput::addMacPdu(const TetraTime & time, const uint32_t ssi, const MacLogicalChannel channel, const PduType type, const PduView pdu)
+{
+    std::size_t bits = std::min(pdu.size(), (std::size_t)0xFFFF);
+    std::size_t len  = HEADER_LEN + (bits + 7) / 8;
+
+    if (m_batch.size() + len > BATCH_LEN)
+    {
+        flush();
+    }
+
+    if (m_batch.empty())
+    {
+        m_firstRecordNs = stageClockNs();
+    }
+
+    std::size_t start = m_batch.size();
+    m_batch.resize(start + len, 0);
+    uint8_t * record = m_batch.data() + start;
+
+    record[0]  = (uint8_t)(len & 0xFF);
+    record[1]  = (uint8_t)(len >> 8);
+    record[2]  = RECORD_VERSION;
+    record[3]  = RECORD_MAC_PDU;
+    record[4]  = (uint8_t)time.tn;
+    record[5]  = (uint8_t)time.fn;
+    record[6]  = (uint8_t)time.mn;
+    record[7]  = (uint8_t)channel;
+    record[8]  = (uint8_t)type;
+    record[9]  = 0;
+    record[10] = (uint8_t)(bits & 0xFF);
+    record[11] = (uint8_t)(bits >> 8);
+    record[12] = (uint8_t)(ssi & 0xFF);
+    record[13] = (uint8_t)((ssi >> 8) & 0xFF);
+    record[14] = (uint8_t)((ssi >> 16) & 0xFF);
+    record[15] = (uint8_t)((ssi >> 24) & 0xFF);
+
+    const uint8_t * data = pdu.data();
+    for (std::size_t idx = 0; idx < bits; idx++)
+    {
+        record[HEADER_LEN + idx / 8] |= (uint8_t)((data[idx] & 1) << (7 - idx % 8));
+    }
+
+    m_recordsCount++;
+}
+
+/**
+ * @brief Send batch if its first record is older than the flush interval
+ *
+ */
+
+void RecordOutput::poll()
+{
+    if (!m_batch.empty() && (stageClockNs() - m_firstRecordNs >= m_flushIntervalNs))
+    {
+        flush();
+    }
+}
+
+/**
+ * @brief Send pending records
+ *
+ */
+
+void RecordOutput::flush()
+{
+    if (!m_batch.empty())
+    {
+        m_sink->write(m_batch.data(), m_batch.size());
+        m_batch.clear();
+    }
+}
+
+/**
+ * @brief Print counters
+ *
+ */
+
+void RecordOutput::printStats()
+{
+    fprintf(stderr, "Records     : %llu MAC PDU\n", (unsigned long long)m_recordsCount);
+    m_sink->printStats();
+}
@@ -0,0 +1,167 @@
+#ifndef RECORDOUTPUT_H
+#define RECORDOUTPUT_H
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "common/tetra.h"
+#include "common/pduview.h"
+
+namespace Tetra {
+
+    /**
+     * @brief Destination of binary records batches
+     *
+     * write() receives whole records only, laid out back to back.
+     *
+     */
+
+    class RecordSink {
+    public:
+        virtual ~RecordSink() {}
+
+        virtual void write(const uint8_t * records, const std::size_t len) = 0;
+        virtual void printStats() = 0;
+    };
+
+    /**
+     * @brief Records sent over a connected UDP socket, records are packed into datagrams
+     *        and datagrams are sent by sendmmsg calls
+     *
+     */
+
+    class UdpRecordSink : public RecordSink {
+    public:
+        UdpRecordSink(int socketFd);
+        ~UdpRecordSink();
+
+        void write(const uint8_t * records, const std::size_t len);
+        void printStats();
+
+    private:
+        static const std::size_t BATCH_LEN    = 64;                             ///< Datagrams sent per sendmmsg call
+        static const std::size_t DATAGRAM_LEN = 1472;                           ///< Longest datagram, no IP fragmentation on Ethernet
+
+        int m_socketFd;                                                         ///< Output socket, owned
+        uint64_t m_datagramsSent;                                               ///< Datagrams sent
+        uint64_t m_datagramsDropped;                                            ///< Datagrams not sent (no listener, buffer full)
+    };
+
+    /**
+     * @brief Records written to a shared memory ring for a co-located consumer
+     *
+     * The POSIX shared memory object starts with a ShmRingHeader followed by the ring bytes.
+     * Records are written as a byte stream at writePos % capacity, wrapping around. Like a
+     * seqlock, the end of the bytes about to be written is first published in writeStart,
+     * then bytes are copied and writePos is advanced to writeStart with release semantics.
+     *
+     * The producer never waits, a consumer keeps its own read position readPos:
+     *   - bytes up to writePos (acquire load) are readable, records are missed when
+     *     writePos - readPos exceeds capacity
+     *   - after copying bytes, an acquire fence then a writeStart load tell if they may have
+     *     been overwritten meanwhile: the copy is only valid if writeStart - readPos does not
+     *     exceed capacity. Checking writePos instead is racy, the producer may be
+     *     overwriting the bytes before it advances writePos.
+     *
+     */
+
+    class ShmRecordSink : public RecordSink {
+    public:
+        ShmRecordSink(const std::string & name, const std::size_t capacity);
+        ~ShmRecordSink();
+
+        static const uint32_t MAGIC = 0x4252544b;                               ///< "TKRB" in little endian
+
+        /** @brief Shared memory ring header */
+
+        struct ShmRingHeader {
+            uint32_t magic;                                                     ///< MAGIC
+            uint32_t version;                                                   ///< RecordOutput::RECORD_VERSION
+            uint64_t capacity;                                                  ///< Ring length in bytes
+            std::atomic<uint64_t> writePos;                                     ///< Bytes written since creation
+            std::atomic<uint64_t> writeStart;                                   ///< End of bytes being written, equals writePos between writes
+        };
+
+        bool isOpen() const;
+        void write(const uint8_t * records, const std::size_t len);
+        void printStats();
+
+    private:
+        std::string m_name;                                                     ///< Shared memory object name
+        ShmRingHeader * m_header;                                               ///< Mapped header, NULL if not open
+        uint8_t * m_ring;                                                       ///< Mapped ring bytes
+        std::size_t m_mapLen;                                                   ///< Mapped length
+    };
+
+    /**
+     * @brief Binary records output, batched
+     *
+     * Alternative to per message JSON and Wireshark datagrams at high message rates: one
+     * compact record per MAC PDU is appended to a batch, the batch is handed to the sink
+     * when full, when poll() is called once the flush interval has elapsed since its first
+     * record, and on destruction.
+     *
+     * Record format, little endian:
+     *
+     *   offset  size
+     *        0     2  record length in bytes, header and padding included
+     *        2     1  format version, RECORD_VERSION
+     *        3     1  record type, RECORD_MAC_PDU
+     *        4     1  TN
+     *        5     1  FN
+     *        6     1  MN
+     *        7     1  logical channel, MacLogicalChannel value
+     *        8     1  PDU type, PduType value
+     *        9     1  reserved, 0
+     *       10     2  PDU length in bits
+     *       12     4  SSI
+     *       16     n  PDU bits packed, first bit in MSB, last byte padded with 0
+     *
+     */
+
+    class RecordOutput {
+    public:
+        RecordOutput(RecordSink * sink, const uint32_t flushIntervalMs);
+        ~RecordOutput();
+
+        static RecordOutput * open(const char * destination, const uint32_t flushIntervalMs);
+
+        static const uint8_t RECORD_VERSION     = 1;                            ///< Format version
+        static const uint8_t RECORD_MAC_PDU     = 1;                            ///< Record type of MAC PDU
+        static const std::size_t HEADER_LEN     = 16;                           ///< Fixed header length
+        static const std::size_t SHM_RING_LEN   = 4 * 1024 * 1024;              ///< Shared memory ring length
+
+        /** @brief MAC PDU types in records */
+
+        enum PduType {
+            PDU_ACCESS_ASSIGN = 0,                                              ///< AACH ACCESS-ASSIGN
+            PDU_SYNC          = 1,                                              ///< BSCH SYNC
+            PDU_TRAFFIC       = 2,                                              ///< TCH and TCH_S
+            PDU_RESOURCE      = 3,                                              ///< MAC-RESOURCE
+            PDU_FRAG          = 4,                                              ///< MAC-FRAG
+            PDU_END           = 5,                                              ///< MAC-END
+            PDU_SYSINFO       = 6,                                              ///< SYSINFO
+            PDU_ACCESS_DEFINE = 7,                                              ///< ACCESS-DEFINE
+            PDU_D_BLOCK       = 8,                                              ///< MAC-D-BLCK
+            PDU_OTHER         = 9,                                              ///< Reserved or invalid PDU
+        };
+
+        void addMacPdu(const TetraTime & time, const uint32_t ssi, const MacLogicalChannel channel, const PduType type, const PduView pdu);
+        void poll();
+        void flush();
+        void printStats();
+
+    private:
+        static const std::size_t BATCH_LEN = 32 * 1024;                         ///< Batch length in bytes
+
+        RecordSink * m_sink;                                                    ///< Records destination, owned
+        uint64_t m_flushIntervalNs;                                             ///< Longest time a record waits in batch
+        uint64_t m_firstRecordNs;                                               ///< Time of the first record in batch
+        std::vector<uint8_t> m_batch;                                           ///< Pending records
+        uint64_t m_recordsCount;                                                ///< Records written
+    };
+
+};
+
+#endif /* RECORDOUTPUT_H */
@@ -0,0 +1,647 @@
+/*
+ * Decoder output regression harness
+ *
+ * Replays every capture of a corpus directory, raw files recorded with -o or indexed
+ * captures recorded with --capture, through TetraDecoder and turns its output into a
+ * normalised text stream:
+ *
+ *   report <JSON>                                      one line per Report message, in order
+ *   pdu <TN> <FN> <MN> <channel> <type> <SSI> <bits>   one line per MAC PDU, bits in hex
+ *   crc <channel> <valid> <invalid>                    CRC counters per logical channel
+ *   bursts <count>
+ *
+ * MAC PDU are captured through the binary records output (RecordSink) as Wireshark
+ * messages are sent by WireMsg on its own socket. The stream is compared line by line to
+ * the golden baseline <golden dir>/<capture>.golden, or recorded as baseline with -r. On
+ * mismatch the stream is written to <golden dir>/<capture>.new for inspection. Decoding
+ * wall time is compared to the one recorded with the baseline (<capture>.time).
+ *
+ * Each capture is decoded in its own process so decoders are fully isolated, at most
+ * -n processes at once. Exit status is failure when a stream differs from its baseline,
+ * a capture can't be decoded, or with -t when a capture is slower than its baseline by
+ * more than the given percentage.
+ *
+ * Build with the decoder sources except main.cc, eg.
+ *   g++ -O2 -pthread regress/decoderregress.cc decoder.cc mac/(*).cc <upper layers sources> -o decoderregress
+ *
+ * Usage: decoderregress -c <corpus dir> -g <golden dir> [-r] [-n <processes>] [-j <workers>]
+ *                       [-t <percent>] [-f] [-P | -S]
+ *
+ */
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "../decoder.h"
+
+using namespace Tetra;
+
+/** @brief Result of one capture, written by the child process in shared memory */
+
+struct Result {
+    enum Status {
+        NOT_RUN   = 0,                                                          ///< Child didn't complete
+        PASS      = 1,                                                          ///< Identical to baseline
+        FAIL      = 2,                                                          ///< Different from baseline
+        RECORDED  = 3,                                                          ///< Baseline recorded
+        NO_GOLDEN = 4,                                                          ///< No baseline to compare to
+        ERROR     = 5,                                                          ///< Capture or baseline file error
+    };
+
+    Status status;
+    uint64_t bursts;                                                            ///< Bursts found
+    uint64_t wallNs;                                                            ///< Decoding wall time
+    uint64_t goldenWallNs;                                                      ///< Decoding wall time recorded with baseline, 0 if unknown
+    uint64_t firstDiffLine;                                                     ///< First different line, 1 based
+    uint64_t crcValid[Mac::LOGICAL_CHANNELS_COUNT];                             ///< Blocks with valid CRC per logical channel
+    uint64_t crcInvalid[Mac::LOGICAL_CHANNELS_COUNT];                           ///< Blocks with invalid CRC per logical channel
+};
+
+/** @brief Harness options */
+
+struct Options {
+    std::string corpusDir;                                                      ///< Captures directory
+    std::string goldenDir;                                                      ///< Baselines directory
+    bool bRecord;                                                               ///< Record baselines instead of comparing
+    std::size_t processesCount;                                                 ///< Captures decoded at once
+    std::size_t macWorkersCount;                                                ///< TetraDecoder -j workers
+    double slowerPercent;                                                       ///< Wall time regression failing the run, < 0 to disable
+    bool bRemoveFillBits;                                                       ///< Remove fill bits
+    RxFormat rxFormat;                                                          ///< Format of raw captures
+};
+
+/**
+ * @brief Records sink keeping records in memory
+ *
+ */
+
+class MemoryRecordSink : public RecordSink {
+public:
+    MemoryRecordSink(std::vector<uint8_t> * records) : m_records(records) {}
+
+    void write(const uint8_t * records, const std::size_t len)
+    {
+        m_records->insert(m_records->end(), records, records + len);
+    }
+
+    void printStats() {}
+
+private:
+    std::vector<uint8_t> * m_records;                                           ///< Records destination, not owned
+};
+
+/** @brief Report messages read from the decoder socket */
+
+struct ReportReader {
+    int fd;                                                                     ///< Receiving end of the socket pair
+    std::vector<std::string> messages;                                          ///< Messages received
+};
+
+/**
+ * @brief Read report messages until the decoder end of the socket pair is closed
+ *
+ */
+
+static void * reportThread(void * arg)
+{
+    ReportReader * reader = (ReportReader *)arg;
+    std::vector<char> buffer(65536);
+
+    for (;;)
+    {
+        ssize_t len = recv(reader->fd, buffer.data(), buffer.size(), 0);
+        if ((len < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        if (len <= 0)
+        {
+            break;
+        }
+        reader->messages.push_back(std::string(buffer.data(), (std::size_t)len));
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Append binary records as normalised "pdu" lines
+ *
+ */
+
+static void appendRecords(const std::vector<uint8_t> & records, std::string * res)
+{
+    static const char HEX[] = "0123456789abcdef";
+    std::size_t pos = 0;
+
+    while (pos + RecordOutput::HEADER_LEN <= records.size())
+    {
+        const uint8_t * record = records.data() + pos;
+        std::size_t len  = (std::size_t)record[0] | ((std::size_t)record[1] << 8);
+        std::size_t bits = (std::size_t)record[10] | ((std::size_t)record[11] << 8);
+        uint32_t ssi = (uint32_t)record[12] | ((uint32_t)record[13] << 8) | ((uint32_t)record[14] << 16) | ((uint32_t)record[15] << 24);
+
+        if ((len < RecordOutput::HEADER_LEN) || (pos + len > records.size()))
+        {
+            break;                                                              // truncated, can't happen with whole batches
+        }
+
+        char line[128];
+        snprintf(line, sizeof(line), "pdu %u %u %u %s %u %u %zu ", record[4], record[5], record[6], macLogicalChannelName(record[7]).c_str(), record[8], ssi, bits);
+        *res += line;
+
+        for (std::size_t idx = 0; idx < (bits + 7) / 8; idx++)
+        {
+            *res += HEX[record[RecordOutput::HEADER_LEN + idx] >> 4];
+            *res += HEX[record[RecordOutput::HEADER_LEN + idx] & 0x0f];
+        }
+        *res += '\n';
+
+        pos += len;
+    }
+}
+
+/**
+ * @brief Read whole file
+ *
+ * @return false if the file can't be read
+ *
+ */
+
+static bool readFile(const std::string & filename, std::string * res)
+{
+    FILE * file = fopen(filename.c_str(), "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    char buffer[65536];
+    std::size_t len;
+    res->clear();
+    while ((len = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        res->append(buffer, len);
+    }
+    bool bOk = !ferror(file);
+    fclose(file);
+
+    return bOk;
+}
+
+static bool writeFile(const std::string & filename, const std::string & data)
+{
+    FILE * file = fopen(filename.c_str(), "wb");
+    if (!file)
+    {
+        return false;
+    }
+
+    bool bOk = fwrite(data.data(), 1, data.size(), file) == data.size();
+    bOk = (fclose(file) == 0) && bOk;
+
+    return bOk;
+}
+
+/**
+ * @brief Return first different line of two streams, 1 based, or 0 if they are identical
+ *
+ */
+
+static uint64_t firstDifferentLine(const std::string & golden, const std::string & current)
+{
+    if (golden == current)
+    {
+        return 0;
+    }
+
+    uint64_t line = 1;
+    std::size_t len = std::min(golden.size(), current.size());
+    for (std::size_t idx = 0; idx < len && golden[idx] == current[idx]; idx++)
+    {
+        if (golden[idx] == '\n')
+        {
+            line++;
+        }
+    }
+
+    return line;
+}
+
+/**
+ * @brief Decode a whole capture with a stand alone decoder
+ *
+ * @return false if the capture can't be read
+ *
+ */
+
+static bool decodeCapture(const std::string & filename, const Options & options, std::string * stream, Result * result)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets) != 0)                   // message boundaries kept, end of stream on close
+    {
+        close(fd);
+        return false;
+    }
+
+    ReportReader reportReader;
+    reportReader.fd = sockets[1];
+    pthread_t thread;
+    pthread_create(&thread, NULL, reportThread, &reportReader);
+
+    std::vector<uint8_t> records;
+    RecordOutput * recordOutput = new RecordOutput(new MemoryRecordSink(&records), 0xffffffff);
+    TetraDecoder * decoder = new TetraDecoder(sockets[0], options.bRemoveFillBits, NONE, false, options.macWorkersCount, false, MacFilter(), 0, recordOutput);
+
+    bool bOk = true;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    CaptureReader * captureReader = CaptureReader::open(fd);
+    if (captureReader)
+    {
+        for (std::size_t idx = 0; idx < captureReader->chunks().size(); idx++)
+        {
+            std::size_t len = 0;
+            const uint8_t * data = captureReader->readChunk(idx, &len);
+            if (!data)
+            {
+                bOk = false;
+                break;
+            }
+            result->bursts += decoder->rxData(data, len, (RxFormat)captureReader->rxFormat());
+        }
+        delete captureReader;
+    }
+    else
+    {
+        std::vector<uint8_t> buffer(1024 * 1024);
+        for (;;)
+        {
+            ssize_t len = read(fd, buffer.data(), buffer.size());
+            if ((len < 0) && (errno == EINTR))
+            {
+                continue;
+            }
+            if (len <= 0)
+            {
+                bOk = (len == 0);
+                break;
+            }
+            result->bursts += decoder->rxData(buffer.data(), (std::size_t)len, options.rxFormat);
+        }
+    }
+
+    decoder->flush();
+    result->wallNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    Mac::Stats stats = decoder->macStats();
+
+    delete decoder;
+    delete recordOutput;
+    close(fd);
+
+    shutdown(sockets[0], SHUT_WR);
+    pthread_join(thread, NULL);
+    close(sockets[0]);
+    close(sockets[1]);
+
+    for (std::size_t idx = 0; idx < reportReader.messages.size(); idx++)
+    {
+        *stream += "report " + reportReader.messages[idx] + "\n";
+    }
+
+    appendRecords(records, stream);
+
+    for (std::size_t channel = 0; channel < Mac::LOGICAL_CHANNELS_COUNT; channel++)
+    {
+        result->crcValid[channel]   = stats.crcValid[channel];
+        result->crcInvalid[channel] = stats.crcInvalid[channel];
+
+        if (stats.crcValid[channel] + stats.crcInvalid[channel] > 0)
+        {
+            char line[128];
+            snprintf(line, sizeof(line), "crc %s %llu %llu\n", macLogicalChannelName((int)channel).c_str(), (unsigned long long)stats.crcValid[channel], (unsigned long long)stats.crcInvalid[channel]);
+            *stream += line;
+        }
+    }
+
+    char line[64];
+    snprintf(line, sizeof(line), "bursts %llu\n", (unsigned long long)result->bursts);
+    *stream += line;
+
+    return bOk;
+}
+
+/**
+ * @brief Child process: decode capture, then record or compare its stream to the baseline
+ *
+ */
+
+static void runCapture(const std::string & name, const Options & options, Result * result)
+{
+    int devNull = open("/dev/null", O_WRONLY);                                  // decoder prints to stdout
+    if (devNull >= 0)
+    {
+        dup2(devNull, STDOUT_FILENO);
+        close(devNull);
+    }
+
+    std::string stream;
+    if (!decodeCapture(options.corpusDir + "/" + name, options, &stream, result))
+    {
+        result->status = Result::ERROR;
+        return;
+    }
+
+    std::string goldenFilename = options.goldenDir + "/" + name + ".golden";
+    std::string timeFilename   = options.goldenDir + "/" + name + ".time";
+    char wallTime[32];
+    snprintf(wallTime, sizeof(wallTime), "%llu\n", (unsigned long long)result->wallNs);
+
+    if (options.bRecord)
+    {
+        bool bOk = writeFile(goldenFilename, stream) && writeFile(timeFilename, wallTime);
+        result->status = bOk ? Result::RECORDED : Result::ERROR;
+        return;
+    }
+
+    std::string golden;
+    if (!readFile(goldenFilename, &golden))
+    {
+        result->status = Result::NO_GOLDEN;
+        return;
+    }
+
+    std::string goldenTime;
+    if (readFile(timeFilename, &goldenTime))
+    {
+        result->goldenWallNs = strtoull(goldenTime.c_str(), NULL, 10);
+    }
+
+    result->firstDiffLine = firstDifferentLine(golden, stream);
+    if (result->firstDiffLine == 0)
+    {
+        result->status = Result::PASS;
+        unlink((options.goldenDir + "/" + name + ".new").c_str());
+    }
+    else
+    {
+        result->status = Result::FAIL;
+        writeFile(options.goldenDir + "/" + name + ".new", stream);
+    }
+}
+
+/**
+ * @brief Print capture result
+ *
+ * @return true if the capture doesn't fail the run
+ *
+ */
+
+static bool printResult(const std::string & name, const Result & result, int waitStatus, const Options & options)
+{
+    static const char * STATUS_NAMES[] = {"CRASH", "PASS", "FAIL", "RECORDED", "NOGOLDEN", "ERROR"};
+
+    bool bOk = (result.status == Result::PASS) || (result.status == Result::RECORDED);
+    double ms = (double)result.wallNs / 1000000.0;
+
+    printf("%-32s %-8s %8llu bursts %10.1f ms", name.c_str(), STATUS_NAMES[result.status], (unsigned long long)result.bursts, ms);
+
+    if (result.goldenWallNs > 0)
+    {
+        double percent = 100.0 * ((double)result.wallNs - (double)result.goldenWallNs) / (double)result.goldenWallNs;
+        printf(" %+6.1f%%", percent);
+        if ((options.slowerPercent >= 0) && (percent > options.slowerPercent))
+        {
+            printf(" SLOWER");
+            bOk = false;
+        }
+    }
+
+    if (result.status == Result::FAIL)
+    {
+        printf(" first difference line %llu", (unsigned long long)result.firstDiffLine);
+    }
+    else if (result.status == Result::NOT_RUN)
+    {
+        printf(" wait status 0x%x", waitStatus);
+    }
+
+    for (std::size_t channel = 0; channel < Mac::LOGICAL_CHANNELS_COUNT; channel++)
+    {
+        if (result.crcValid[channel] + result.crcInvalid[channel] > 0)
+        {
+            printf(" %s %llu/%llu", macLogicalChannelName((int)channel).c_str(), (unsigned long long)result.crcValid[channel], (unsigned long long)(result.crcValid[channel] + result.crcInvalid[channel]));
+        }
+    }
+    printf("\n");
+
+    return bOk;
+}
+
+/**
+ * @brief Regular files of directory, sorted by name, hidden files excluded
+ *
+ */
+
+static std::vector<std::string> listCaptures(const std::string & directory)
+{
+    std::vector<std::string> res;
+
+    DIR * dir = opendir(directory.c_str());
+    if (!dir)
+    {
+        return res;
+    }
+
+    struct dirent * entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        struct stat st;
+        if ((entry->d_name[0] != '.') && (stat((directory + "/" + entry->d_name).c_str(), &st) == 0) && S_ISREG(st.st_mode))
+        {
+            res.push_back(entry->d_name);
+        }
+    }
+    closedir(dir);
+
+    std::sort(res.begin(), res.end());
+
+    return res;
+}
+
+int main(int argc, char * argv[])
+{
+    Options options;
+    options.bRecord         = false;
+    options.processesCount  = (std::size_t)std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    options.macWorkersCount = 0;
+    options.slowerPercent   = -1.0;
+    options.bRemoveFillBits = true;
+    options.rxFormat        = RX_FORMAT_UNPACKED;
+
+    int option;
+    while ((option = getopt(argc, argv, "c:g:rn:j:t:fPSh")) != -1)
+    {
+        switch (option)
+        {
+        case 'c':
+            options.corpusDir = optarg;
+            break;
+
+        case 'g':
+            options.goldenDir = optarg;
+            break;
+
+        case 'r':
+            options.bRecord = true;
+            break;
+
+        case 'n':
+            options.processesCount = (std::size_t)std::max(1, atoi(optarg));
+            break;
+
+        case 'j':
+            options.macWorkersCount = (std::size_t)std::max(0, atoi(optarg));
+            break;
+
+        case 't':
+            options.slowerPercent = atof(optarg);
+            break;
+
+        case 'f':
+            options.bRemoveFillBits = false;
+            break;
+
+        case 'P':
+            options.rxFormat = RX_FORMAT_PACKED;
+            break;
+
+        case 'S':
+            options.rxFormat = RX_FORMAT_SOFT;
+            break;
+
+        default:
+            fprintf(stderr, "Usage: decoderregress -c <corpus dir> -g <golden dir> [-r] [-n <processes>] [-j <workers>] [-t <percent>] [-f] [-P | -S]\n"
+                    "  -c <dir> captures recorded with -o or --capture\n"
+                    "  -g <dir> golden baselines\n"
+                    "  -r record baselines instead of comparing\n"
+                    "  -n <processes> captures decoded at once [default one per core]\n"
+                    "  -j <workers> decode bursts on worker threads [default 0, no thread]\n"
+                    "  -t <percent> fail when a capture is slower than its baseline by more than percent\n"
+                    "  -f keep fill bits\n"
+                    "  -P raw captures are packed (1 byte = 8 bits)\n"
+                    "  -S raw captures are soft (1 signed byte per bit)\n");
+            return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (options.corpusDir.empty() || options.goldenDir.empty())
+    {
+        fprintf(stderr, "-c and -g options are required\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::string> captures = listCaptures(options.corpusDir);
+    if (captures.empty())
+    {
+        fprintf(stderr, "No capture in '%s'\n", options.corpusDir.c_str());
+        return EXIT_FAILURE;
+    }
+
+    // one result slot per capture, shared with child processes
+    std::size_t resultsLen = captures.size() * sizeof(Result);
+    Result * results = (Result *)mmap(NULL, resultsLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (results == MAP_FAILED)
+    {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+    memset(results, 0, resultsLen);
+
+    std::vector<pid_t> pids(captures.size(), -1);
+    std::vector<int> waitStatus(captures.size(), 0);
+    std::size_t next = 0;
+    std::size_t running = 0;
+
+    fflush(stdout);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    while ((next < captures.size()) || (running > 0))
+    {
+        if ((next < captures.size()) && (running < options.processesCount))
+        {
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                runCapture(captures[next], options, &results[next]);
+                _exit(EXIT_SUCCESS);
+            }
+            else if (pid < 0)
+            {
+                perror("fork");
+                results[next].status = Result::ERROR;
+            }
+            else
+            {
+                running++;
+            }
+            pids[next] = pid;
+            next++;
+            continue;
+        }
+
+        int status = 0;
+        pid_t pid = wait(&status);
+        if (pid < 0)
+        {
+            break;
+        }
+
+        for (std::size_t idx = 0; idx < captures.size(); idx++)
+        {
+            if (pids[idx] == pid)
+            {
+                waitStatus[idx] = status;
+                running--;
+                break;
+            }
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::size_t failed = 0;
+    for (std::size_t idx = 0; idx < captures.size(); idx++)
+    {
+        if (!printResult(captures[idx], results[idx], waitStatus[idx], options))
+        {
+            failed++;
+        }
+    }
+
+    printf("%zu captures, %zu failed, %.1f s with %zu processes\n", captures.size(), failed, seconds, options.processesCount);
+
+    munmap(results, resultsLen);
+
+    return failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
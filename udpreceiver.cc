@@ -0,0 +1,314 @@
+#include <cstdio>
+#include <cerrno>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include "udpreceiver.h"
+
+using namespace Tetra;
+
+/**
+ * @brief UDP receiver on an already bound socket
+ *
+ * @param ringSize          Ring length in bytes
+ * @param socketBufferSize  Kernel socket buffer size (SO_RCVBUF), 0 to keep system default
+ *
+ */
+
+UdpReceiver::UdpReceiver(int socketFd, std::size_t ringSize, int socketBufferSize) : m_ring(ringSize)
+{
+    m_socketFd = socketFd;
+    m_bStarted = false;
+    m_bStop    = false;
+    m_eventFd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_stopFd   = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    m_bytesReceived     = 0;
+    m_datagramsReceived = 0;
+    m_datagramsDropped  = 0;
+    m_kernelDropped     = 0;
+    m_ringHighWater     = 0;
+    m_wakeupsFailed     = 0;
+
+    if (socketBufferSize > 0)
+    {
+        if (setsockopt(m_socketFd, SOL_SOCKET, SO_RCVBUF, &socketBufferSize, sizeof(socketBufferSize)) < 0)
+        {
+            perror("Couldn't set socket buffer size");
+        }
+    }
+
+    int val = 0;
+    socklen_t len = sizeof(val);
+    getsockopt(m_socketFd, SOL_SOCKET, SO_RCVBUF, &val, &len);
+    printf("Input socket buffer %d bytes, ring %zu bytes\n", val, m_ring.capacity());
+
+    // report datagrams dropped by kernel
+    int enable = 1;
+    setsockopt(m_socketFd, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable));
+}
+
+/**
+ * @brief Destructor, stop receive thread
+ *
+ */
+
+UdpReceiver::~UdpReceiver()
+{
+    stop();
+    close(m_eventFd);
+    close(m_stopFd);
+}
+
+/**
+ * @brief Start receive thread
+ *
+ */
+
+bool UdpReceiver::start()
+{
+    m_bStarted = (pthread_create(&m_thread, NULL, receiveThread, this) == 0);
+    if (!m_bStarted)
+    {
+        fprintf(stderr, "Couldn't create receive thread\n");
+    }
+
+    return m_bStarted;
+}
+
+/**
+ * @brief Stop receive thread, it is woken up immediately
+ *
+ */
+
+void UdpReceiver::stop()
+{
+    m_bStop = true;
+
+    uint64_t val = 1;
+    if (write(m_stopFd, &val, sizeof(val)) < 0)
+    {
+        perror("Couldn't wake receive thread up");
+    }
+
+    if (m_bStarted)
+    {
+        pthread_join(m_thread, NULL);
+        m_bStarted = false;
+    }
+}
+
+/**
+ * @brief Wait up to timeoutMs for received data
+ *
+ * @return Contiguous span length, 0 on timeout
+ *
+ */
+
+std::size_t UdpReceiver::peek(const uint8_t ** span, int timeoutMs)
+{
+    std::size_t len = m_ring.peek(span);
+
+    if ((len == 0) && (timeoutMs > 0))
+    {
+        struct pollfd fd;
+        fd.fd     = m_eventFd;
+        fd.events = POLLIN;
+        poll(&fd, 1, timeoutMs);
+
+        clearEvent();
+        len = m_ring.peek(span);
+    }
+
+    return len;
+}
+
+/**
+ * @brief Release len bytes of the span returned by peek
+ *
+ */
+
+void UdpReceiver::consume(std::size_t len)
+{
+    m_ring.consume(len);
+}
+
+/**
+ * @brief Return descriptor readable when bytes were written to the ring since last clearEvent()
+ *
+ */
+
+int UdpReceiver::eventFd() const
+{
+    return m_eventFd;
+}
+
+/**
+ * @brief Reset event, must be called before reading the ring so no write is missed
+ *
+ */
+
+void UdpReceiver::clearEvent()
+{
+    // event not signaled (EAGAIN) is not an error
+    uint64_t val;
+    if ((read(m_eventFd, &val, sizeof(val)) < 0) && (errno != EAGAIN) && (errno != EINTR))
+    {
+        perror("Couldn't reset receiver event");
+    }
+}
+
+/**
+ * @brief Return reception counters
+ *
+ */
+
+UdpReceiver::Stats UdpReceiver::stats()
+{
+    Stats res;
+    res.bytesReceived     = m_bytesReceived.load(std::memory_order_relaxed);
+    res.datagramsReceived = m_datagramsReceived.load(std::memory_order_relaxed);
+    res.datagramsDropped  = m_datagramsDropped.load(std::memory_order_relaxed);
+    res.kernelDropped     = m_kernelDropped.load(std::memory_order_relaxed);
+    res.ringHighWater     = m_ringHighWater.load(std::memory_order_relaxed);
+    res.wakeupsFailed     = m_wakeupsFailed.load(std::memory_order_relaxed);
+    res.ringSize          = m_ring.capacity();
+
+    return res;
+}
+
+/**
+ * @brief Print reception counters
+ *
+ */
+
+void UdpReceiver::printStats()
+{
+    Stats val = stats();
+
+    printf("RX stats    : %llu bytes in %llu datagrams, dropped %llu (ring full) + %llu (socket buffer full), ring high-water %zu / %zu bytes\n",
+           (unsigned long long)val.bytesReceived, (unsigned long long)val.datagramsReceived,
+           (unsigned long long)val.datagramsDropped, (unsigned long long)val.kernelDropped,
+           val.ringHighWater, val.ringSize);
+
+    if (val.wakeupsFailed > 0)
+    {
+        printf("RX stats    : %llu decoding thread wakeups failed\n", (unsigned long long)val.wakeupsFailed);
+    }
+}
+
+/**
+ * @brief Receive thread entry point
+ *
+ */
+
+void * UdpReceiver::receiveThread(void * arg)
+{
+    ((UdpReceiver *)arg)->receive();
+
+    return NULL;
+}
+
+/**
+ * @brief Read datagrams by batches until stop is requested
+ *
+ * The thread sleeps in poll() until datagrams or stop request arrive. A datagram which
+ * doesn't fit in the ring is dropped as a whole.
+ *
+ */
+
+void UdpReceiver::receive()
+{
+    std::vector<uint8_t> buffers(BATCH_LEN * DATAGRAM_LEN);                     // datagrams batch
+    uint8_t control[BATCH_LEN][CMSG_SPACE(sizeof(uint32_t))];
+    struct iovec iovs[BATCH_LEN];
+    struct mmsghdr msgs[BATCH_LEN];
+
+    struct pollfd fds[2];
+    fds[0].fd     = m_socketFd;
+    fds[0].events = POLLIN;
+    fds[1].fd     = m_stopFd;
+    fds[1].events = POLLIN;
+
+    while (!m_bStop.load(std::memory_order_relaxed))
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("Receive poll error");
+            break;
+        }
+
+        if (!(fds[0].revents & POLLIN))
+        {
+            continue;                                                           // stop requested
+        }
+
+        for (std::size_t idx = 0; idx < BATCH_LEN; idx++)
+        {
+            iovs[idx].iov_base = &buffers[idx * DATAGRAM_LEN];
+            iovs[idx].iov_len  = DATAGRAM_LEN;
+
+            memset(&msgs[idx], 0, sizeof(struct mmsghdr));
+            msgs[idx].msg_hdr.msg_iov        = &iovs[idx];
+            msgs[idx].msg_hdr.msg_iovlen     = 1;
+            msgs[idx].msg_hdr.msg_control    = control[idx];
+            msgs[idx].msg_hdr.msg_controllen = sizeof(control[idx]);
+        }
+
+        int count = recvmmsg(m_socketFd, msgs, BATCH_LEN, MSG_DONTWAIT, NULL);
+        if (count < 0)
+        {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+            {
+                continue;
+            }
+            perror("Receive error");
+            break;
+        }
+
+        for (int idx = 0; idx < count; idx++)
+        {
+            for (struct cmsghdr * cmsg = CMSG_FIRSTHDR(&msgs[idx].msg_hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(&msgs[idx].msg_hdr, cmsg))
+            {
+                if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SO_RXQ_OVFL))
+                {
+                    uint32_t dropped;
+                    memcpy(&dropped, CMSG_DATA(cmsg), sizeof(dropped));
+                    m_kernelDropped.store(dropped, std::memory_order_relaxed);  // kernel counter since socket creation
+                }
+            }
+
+            m_datagramsReceived.fetch_add(1, std::memory_order_relaxed);
+
+            if (m_ring.write(&buffers[idx * DATAGRAM_LEN], msgs[idx].msg_len))
+            {
+                m_bytesReceived.fetch_add(msgs[idx].msg_len, std::memory_order_relaxed);
+            }
+            else
+            {
+                m_datagramsDropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        if (count > 0)
+        {
+            uint64_t val = 1;
+            if (write(m_eventFd, &val, sizeof(val)) < 0)                        // wake decoding thread up
+            {
+                m_wakeupsFailed.fetch_add(1, std::memory_order_relaxed);        // next write signals again, bytes are not lost
+            }
+        }
+
+        std::size_t filling = m_ring.size();
+        if (filling > m_ringHighWater.load(std::memory_order_relaxed))
+        {
+            m_ringHighWater.store(filling, std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef UDPRECEIVER_H
+#define UDPRECEIVER_H
+#include <cstdint>
+#include <atomic>
+#include <pthread.h>
+
+#include "common/spscqueue.h"
+
+namespace Tetra {
+
+    /**
+     * @brief UDP receive thread
+     *
+     * Drains the socket with recvmmsg into a lock-free ring, so the kernel socket buffer doesn't
+     * overflow while decoding stalls. Decoding thread reads the ring by spans. Counters tell
+     * overload (ring full, socket buffer full) apart from RF issues.
+     *
+     * eventFd() becomes readable when bytes were written to the ring, so the decoding thread
+     * can wait for data in an event loop. Both threads sleep while nothing is received.
+     *
+     */
+
+    class UdpReceiver {
+    public:
+        UdpReceiver(int socketFd, std::size_t ringSize, int socketBufferSize);
+        ~UdpReceiver();
+
+        bool start();
+        void stop();
+
+        std::size_t peek(const uint8_t ** span, int timeoutMs);
+        void consume(std::size_t len);
+        int eventFd() const;
+        void clearEvent();
+
+        /** @brief Reception counters */
+
+        struct Stats {
+            uint64_t bytesReceived;                                             ///< Bytes written to ring
+            uint64_t datagramsReceived;                                         ///< Datagrams read from socket
+            uint64_t datagramsDropped;                                          ///< Datagrams dropped because ring was full
+            uint64_t kernelDropped;                                             ///< Datagrams dropped by kernel because socket buffer was full (SO_RXQ_OVFL)
+            std::size_t ringHighWater;                                          ///< Ring maximum filling in bytes
+            uint64_t wakeupsFailed;                                             ///< Decoding thread wakeups not signaled, eventfd write failed
+            std::size_t ringSize;                                               ///< Ring length in bytes
+        };
+
+        Stats stats();
+        void printStats();
+
+    private:
+        static const std::size_t BATCH_LEN    = 32;                             ///< Datagrams read per recvmmsg call
+        static const std::size_t DATAGRAM_LEN = 2048;                           ///< Longest datagram
+
+        static void * receiveThread(void * arg);
+        void receive();
+
+        int m_socketFd;                                                         ///< Input socket
+        SpscByteRing m_ring;                                                    ///< Received bytes
+        int m_eventFd;                                                          ///< eventfd signaled when bytes are written to ring
+        int m_stopFd;                                                           ///< eventfd waking up receive thread on stop
+        pthread_t m_thread;                                                     ///< Receive thread
+        bool m_bStarted;                                                        ///< True when thread is running
+        std::atomic<bool> m_bStop;                                              ///< Request receive thread to exit
+
+        std::atomic<uint64_t> m_bytesReceived;                                  ///< see Stats
+        std::atomic<uint64_t> m_datagramsReceived;                              ///< see Stats
+        std::atomic<uint64_t> m_datagramsDropped;                               ///< see Stats
+        std::atomic<uint64_t> m_kernelDropped;                                  ///< see Stats
+        std::atomic<std::size_t> m_ringHighWater;                               ///< see Stats
+        std::atomic<uint64_t> m_wakeupsFailed;                                  ///< see Stats
+    };
+
+};
+
+#endif /* UDPRECEIVER_H */
@@ -0,0 +1,228 @@
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "common/stagestats.h"
+#include "voiceoutput.h"
+
+using namespace Tetra;
+
+/**
+ * @brief Voice output to existing directory
+ *
+ */
+
+VoiceOutput::VoiceOutput(const std::string & directory)
+{
+    m_directory   = directory;
+    m_lastPollNs  = 0;
+    m_callsCount    = 0;
+    m_callsFailed   = 0;
+    m_framesCount   = 0;
+    m_framesDropped = 0;
+    m_writeErrors   = 0;
+
+    for (std::size_t idx = 0; idx < USAGE_MARKERS_COUNT; idx++)
+    {
+        m_calls[idx].fd      = -1;
+        m_calls[idx].bFailed = false;
+        m_calls[idx].count   = 0;
+        m_calls[idx].lastFrameNs = 0;
+    }
+}
+
+/**
+ * @brief Destructor, calls in progress are written and closed
+ *
+ */
+
+VoiceOutput::~VoiceOutput()
+{
+    for (std::size_t idx = 0; idx < USAGE_MARKERS_COUNT; idx++)
+    {
+        endCall(&m_calls[idx]);
+    }
+}
+
+/**
+ * @brief Create output to directory
+ *
+ * @return NULL when directory doesn't exist
+ *
+ */
+
+VoiceOutput * VoiceOutput::open(const char * directory)
+{
+    struct stat st;
+    if ((stat(directory, &st) != 0) || !S_ISDIR(st.st_mode))
+    {
+        return NULL;
+    }
+
+    return new VoiceOutput(directory);
+}
+
+/**
+ * @brief Append a TCH/S frame of FRAME_BITS bits to the call of usage marker
+ *
+ */
+
+void VoiceOutput::addFrame(const TetraTime & time, const uint8_t usageMarker, const uint8_t encryptionMode, const uint8_t * bits)
+{
+    Call * call = &m_calls[usageMarker & (USAGE_MARKERS_COUNT - 1)];
+
+    if ((call->fd < 0) && !call->bFailed)
+    {
+        startCall(call, usageMarker);
+    }
+
+    if (call->bFailed)
+    {
+        call->lastFrameNs = stageClockNs();                                     // call goes on until idle
+        m_framesCount++;
+        m_framesDropped++;
+        return;
+    }
+
+    uint8_t * frame = call->batch + call->count * FRAME_LEN;
+    memset(frame, 0, FRAME_LEN);
+
+    frame[0] = (uint8_t)time.tn;
+    frame[1] = (uint8_t)time.fn;
+    frame[2] = (uint8_t)time.mn;
+    frame[3] = usageMarker;
+    frame[4] = encryptionMode;
+
+    uint8_t * packed = frame + 8;
+    for (std::size_t idx = 0; idx < FRAME_BITS; idx += 8)
+    {
+        packed[idx / 8] = (uint8_t)((bits[idx] << 7) | (bits[idx + 1] << 6) | (bits[idx + 2] << 5) | (bits[idx + 3] << 4) |
+                                    (bits[idx + 4] << 3) | (bits[idx + 5] << 2) | (bits[idx + 6] << 1) | bits[idx + 7]);
+    }
+
+    call->count++;
+    call->lastFrameNs = stageClockNs();
+    m_framesCount++;
+
+    if (call->count == BATCH_FRAMES)
+    {
+        writeBatch(call);
+    }
+}
+
+/**
+ * @brief End calls without frame for CALL_IDLE_NS, checked every POLL_PERIOD_NS
+ *
+ */
+
+void VoiceOutput::poll()
+{
+    uint64_t now = stageClockNs();
+    if (now - m_lastPollNs < POLL_PERIOD_NS)
+    {
+        return;
+    }
+    m_lastPollNs = now;
+
+    for (std::size_t idx = 0; idx < USAGE_MARKERS_COUNT; idx++)
+    {
+        if (((m_calls[idx].fd >= 0) || m_calls[idx].bFailed) && (now - m_calls[idx].lastFrameNs >= CALL_IDLE_NS))
+        {
+            endCall(&m_calls[idx]);
+        }
+    }
+}
+
+/**
+ * @brief Open a new call file, the call is marked failed if it can't be created
+ *
+ */
+
+void VoiceOutput::startCall(Call * call, const uint8_t usageMarker)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/call_%llu_%llu_um%02u.tch", (unsigned long long)time(NULL), (unsigned long long)m_callsCount, usageMarker);
+
+    std::string filename = m_directory + name;
+
+    call->fd    = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP);
+    call->count = 0;
+
+    if (call->fd < 0)
+    {
+        perror("Couldn't create call file");
+        call->bFailed = true;
+        m_callsFailed++;
+        return;
+    }
+
+    m_callsCount++;
+}
+
+/**
+ * @brief Write pending frames and close call file, a failed call is reset
+ *
+ */
+
+void VoiceOutput::endCall(Call * call)
+{
+    call->bFailed = false;
+
+    if (call->fd < 0)
+    {
+        call->count = 0;
+        return;
+    }
+
+    writeBatch(call);
+    close(call->fd);
+    call->fd = -1;
+}
+
+/**
+ * @brief Write pending frames of call, they are dropped if the file can't be written
+ *
+ */
+
+void VoiceOutput::writeBatch(Call * call)
+{
+    std::size_t len = call->count * FRAME_LEN;
+    call->count = 0;
+
+    if (len == 0)
+    {
+        return;
+    }
+
+    std::size_t pos = 0;
+    while (pos < len)
+    {
+        ssize_t count = write(call->fd, call->batch + pos, len - pos);
+        if ((count < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            m_writeErrors++;
+            m_framesDropped += (len - pos + FRAME_LEN - 1) / FRAME_LEN;         // frames not entirely written
+            return;
+        }
+        pos += (std::size_t)count;
+    }
+}
+
+/**
+ * @brief Print counters
+ *
+ */
+
+void VoiceOutput::printStats()
+{
+    fprintf(stderr, "Voice       : %llu TCH/S frames in %llu calls, %llu frames dropped, %llu batches not written, %llu call files not created\n",
+            (unsigned long long)m_framesCount, (unsigned long long)m_callsCount, (unsigned long long)m_framesDropped,
+            (unsigned long long)m_writeErrors, (unsigned long long)m_callsFailed);
+}
@@ -0,0 +1,84 @@
+#ifndef VOICEOUTPUT_H
+#define VOICEOUTPUT_H
+#include <cstdint>
+#include <string>
+
+#include "common/tetra.h"
+
+namespace Tetra {
+
+    /**
+     * @brief TCH/S voice frames output, one file per call
+     *
+     * Fast path for voice recording: the MAC hands TCH/S frames here straight from the
+     * decoded burst, without per frame log, Pdu copy nor upper MAC dispatch. A call is
+     * identified by its downlink usage marker, each one has a preallocated batch of frames
+     * which is written to the call file when full, when the call ends and on destruction,
+     * so a codec process can consume whole batches.
+     *
+     * A call ends when no frame was received for CALL_IDLE_NS (checked by poll()). Call
+     * files are named <directory>/call_<epoch seconds>_<count>_um<usage marker>.tch. When
+     * a call file can't be created, the call frames are dropped until it ends.
+     *
+     * Frame record, FRAME_LEN bytes:
+     *
+     *   offset  size
+     *        0     1  TN
+     *        1     1  FN
+     *        2     1  MN
+     *        3     1  usage marker
+     *        4     1  encryption mode
+     *        5     3  reserved, 0
+     *        8    54  TCH/S 432 bits packed, first bit in MSB
+     *       62     2  padding, 0
+     *
+     */
+
+    class VoiceOutput {
+    public:
+        ~VoiceOutput();
+
+        static VoiceOutput * open(const char * directory);
+
+        static const std::size_t FRAME_BITS = 432;                              ///< TCH/S bits per frame
+        static const std::size_t FRAME_LEN  = 64;                               ///< Frame record length in bytes
+
+        void addFrame(const TetraTime & time, const uint8_t usageMarker, const uint8_t encryptionMode, const uint8_t * bits);
+        void poll();
+        void printStats();
+
+    private:
+        VoiceOutput(const std::string & directory);
+
+        static const std::size_t USAGE_MARKERS_COUNT = 64;                      ///< Usage markers count
+        static const std::size_t BATCH_FRAMES        = 64;                      ///< Frames per call written at once, ~3.6 s of voice
+        static const uint64_t    CALL_IDLE_NS        = 2000000000;              ///< Time without frame ending a call
+        static const uint64_t    POLL_PERIOD_NS      = 100000000;               ///< Idle calls check period
+
+        /** @brief One call in progress */
+
+        struct Call {
+            int fd;                                                             ///< Call file, -1 when no call
+            bool bFailed;                                                       ///< Call file couldn't be created, frames are dropped until call ends
+            uint64_t lastFrameNs;                                               ///< Time of last frame
+            std::size_t count;                                                  ///< Frames in batch
+            uint8_t batch[BATCH_FRAMES * FRAME_LEN];                            ///< Frames not written yet
+        };
+
+        void startCall(Call * call, const uint8_t usageMarker);
+        void endCall(Call * call);
+        void writeBatch(Call * call);
+
+        std::string m_directory;                                                ///< Call files directory
+        Call m_calls[USAGE_MARKERS_COUNT];                                      ///< Calls, indexed by usage marker
+        uint64_t m_lastPollNs;                                                  ///< Time of last idle calls check
+        uint64_t m_callsCount;                                                  ///< Call files created
+        uint64_t m_callsFailed;                                                 ///< Call files which couldn't be created
+        uint64_t m_framesCount;                                                 ///< Frames received
+        uint64_t m_framesDropped;                                               ///< Frames received but not written
+        uint64_t m_writeErrors;                                                 ///< Batches not written
+    };
+
+};
+
+#endif /* VOICEOUTPUT_H */